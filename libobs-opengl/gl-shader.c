@@ -16,6 +16,8 @@
 ******************************************************************************/
 
 #include <assert.h>
+#include <util/platform.h>
+#include <util/dstr.h>
 
 #include <graphics/vec2.h>
 #include <graphics/vec3.h>
@@ -187,6 +189,21 @@ static inline bool gl_process_attribs(struct gs_shader *shader,
 	return true;
 }
 
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+
+/* 64bit FNV-1a */
+static inline uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
 static bool gl_shader_init(struct gs_shader *shader,
 		struct gl_shader_parser *glsp,
 		const char *file, char **error_string)
@@ -204,6 +221,9 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glShaderSource"))
 		return false;
 
+	shader->gl_string_hash = hash_data(FNV_OFFSET_BASIS,
+			glsp->gl_string.array, glsp->gl_string.len);
+
 	glCompileShader(shader->obj);
 	if (!gl_success("glCompileShader"))
 		return false;
@@ -590,38 +610,224 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+/* ------------------------------------------------------------------------- */
+/* program binary cache */
+
+#define PROGRAM_CACHE_MAGIC   0x4E49424F /* "OBIN" */
+#define PROGRAM_CACHE_VERSION 1
+
+static inline uint64_t hash_gl_string(uint64_t hash, GLenum name)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
-	int linked = false;
+	const char *str = (const char*)glGetString(name);
+	gl_success("glGetString");
 
-	program->device        = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader  = device->cur_pixel_shader;
+	return str ? hash_data(hash, str, strlen(str) + 1) : hash;
+}
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+void gl_init_program_cache(struct gs_device *device)
+{
+	GLint num_formats = 0;
+	uint64_t hash = FNV_OFFSET_BASIS;
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if (!gl_success("glGetIntegerv") || num_formats <= 0)
+		return;
+
+	/* binaries are only valid for the exact same driver */
+	hash = hash_gl_string(hash, GL_VENDOR);
+	hash = hash_gl_string(hash, GL_RENDERER);
+	hash = hash_gl_string(hash, GL_VERSION);
+
+	device->driver_hash = hash;
+	device->program_binary_available = true;
+}
+
+static inline bool program_cache_enabled(struct gs_device *device)
+{
+	return device->program_binary_available && device->program_cache_path;
+}
+
+static void get_program_cache_file(struct gs_program *program,
+		struct dstr *path)
+{
+	struct gs_device *device = program->device;
+	uint64_t key = device->driver_hash;
+
+	key = hash_data(key, &program->vertex_shader->gl_string_hash,
+			sizeof(uint64_t));
+	key = hash_data(key, &program->pixel_shader->gl_string_hash,
+			sizeof(uint64_t));
+
+	dstr_copy(path, device->program_cache_path);
+	dstr_replace(path, "\\", "/");
+	if (dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+
+	dstr_catf(path, "%016llX.glprog", (unsigned long long)key);
+}
+
+static bool load_program_binary(struct gs_program *program)
+{
+	struct dstr path = {0};
+	uint32_t header[4];
+	void *binary = NULL;
+	GLint linked = GL_FALSE;
+	FILE *f;
+
+	if (!program_cache_enabled(program->device))
+		return false;
+
+	get_program_cache_file(program, &path);
+
+	f = os_fopen(path.array, "rb");
+	if (!f)
+		goto exit;
+
+	if (fread(header, sizeof(uint32_t), 4, f) != 4 ||
+	    header[0] != PROGRAM_CACHE_MAGIC ||
+	    header[1] != PROGRAM_CACHE_VERSION ||
+	    (int64_t)header[3] > os_fgetsize(f))
+		goto exit;
+
+	binary = bmalloc(header[3]);
+	if (fread(binary, 1, header[3], f) != header[3])
+		goto exit;
+
+	glProgramBinary(program->obj, (GLenum)header[2], binary,
+			(GLsizei)header[3]);
+	if (!gl_success("glProgramBinary"))
+		goto exit;
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	if (!gl_success("glGetProgramiv"))
+		linked = GL_FALSE;
+
+exit:
+	if (f)
+		fclose(f);
+
+	/* rejected binaries (e.g. after a driver update) are just relinked
+	 * and replaced */
+	if (f && linked == GL_FALSE) {
+		blog(LOG_DEBUG, "load_program_binary: Discarding cached "
+		                "program '%s'", path.array);
+		os_unlink(path.array);
+	}
+
+	bfree(binary);
+	dstr_free(&path);
+	return linked != GL_FALSE;
+}
+
+static void save_program_binary(struct gs_program *program)
+{
+	struct dstr path = {0};
+	struct dstr tmp_path = {0};
+	GLint size = 0;
+	GLenum format = 0;
+	uint32_t header[4];
+	void *binary;
+	bool success = false;
+	FILE *f;
+
+	if (!program_cache_enabled(program->device))
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0)
+		return;
+
+	binary = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &size, &format, binary);
+	if (!gl_success("glGetProgramBinary"))
+		goto exit;
+
+	get_program_cache_file(program, &path);
+	dstr_printf(&tmp_path, "%s.tmp", path.array);
+
+	header[0] = PROGRAM_CACHE_MAGIC;
+	header[1] = PROGRAM_CACHE_VERSION;
+	header[2] = (uint32_t)format;
+	header[3] = (uint32_t)size;
+
+	f = os_fopen(tmp_path.array, "wb");
+	if (!f)
+		goto exit;
+
+	success = fwrite(header, sizeof(uint32_t), 4, f) == 4 &&
+	          fwrite(binary, 1, size, f) == (size_t)size;
+	success = (fclose(f) == 0) && success;
+
+	if (!success || os_rename(tmp_path.array, path.array) != 0)
+		os_unlink(tmp_path.array);
+
+exit:
+	bfree(binary);
+	dstr_free(&tmp_path);
+	dstr_free(&path);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool link_program(struct gs_program *program)
+{
+	GLint linked = GL_FALSE;
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
 		goto error_detach_vertex;
 
+	if (program_cache_enabled(program->device)) {
+		glProgramParameteri(program->obj,
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
+
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
 		goto error;
 
 	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
 	if (!gl_success("glGetProgramiv"))
-		goto error;
-
-	if (linked == GL_FALSE) {
+		linked = GL_FALSE;
+	else if (linked == GL_FALSE)
 		print_link_errors(program->obj);
+
+error:
+	glDetachShader(program->obj, program->pixel_shader->obj);
+	gl_success("glDetachShader (pixel)");
+
+error_detach_vertex:
+	glDetachShader(program->obj, program->vertex_shader->obj);
+	gl_success("glDetachShader (vertex)");
+
+	return linked != GL_FALSE;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device        = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader  = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
 		goto error;
+
+	if (!load_program_binary(program)) {
+		if (!link_program(program))
+			goto error;
+
+		save_program_binary(program);
 	}
 
 	if (!assign_program_attribs(program))
@@ -629,12 +835,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!assign_program_params(program))
 		goto error;
 
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
 	program->next = device->first_program;
 	program->prev_next = &device->first_program;
 	device->first_program = program;
@@ -644,14 +844,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	return program;
 
 error:
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
-error_detach_vertex:
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-error_detach_neither:
 	gs_program_destroy(program);
 	return NULL;
 }
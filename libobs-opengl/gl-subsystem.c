@@ -197,6 +197,12 @@ int device_get_type(void)
 	return GS_DEVICE_OPENGL;
 }
 
+void device_set_cache_path(gs_device_t *device, const char *path)
+{
+	bfree(device->program_cache_path);
+	device->program_cache_path = path ? bstrdup(path) : NULL;
+}
+
 const char *device_preprocessor_name(void)
 {
 	return "_OPENGL";
@@ -217,6 +223,7 @@ int device_create(gs_device_t **p_device, const struct gs_init_data *info)
 	}
 	
 	gl_enable(GL_CULL_FACE);
+	gl_init_program_cache(device);
 	
 	device_leave_context(device);
 	device->cur_swap = gl_platform_getswap(device->plat);
@@ -245,6 +252,7 @@ void device_destroy(gs_device_t *device)
 
 		da_free(device->proj_stack);
 		da_free(device->fbos);
+		bfree(device->program_cache_path);
 		gl_platform_destroy(device->plat);
 		bfree(device);
 	}
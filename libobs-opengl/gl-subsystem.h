@@ -331,6 +331,9 @@ struct gs_shader {
 	enum gs_shader_type  type;
 	GLuint               obj;
 
+	/* hash of the generated GLSL, used as a program binary cache key */
+	uint64_t             gl_string_hash;
+
 	struct gs_shader_param  *viewproj;
 	struct gs_shader_param  *world;
 
@@ -357,6 +360,7 @@ struct gs_program {
 	struct gs_program            *next;
 };
 
+extern void gl_init_program_cache(struct gs_device *device);
 extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
@@ -502,6 +506,11 @@ struct gs_device {
 
 	DARRAY(struct fbo_info*) fbos;
 	struct fbo_info          *cur_fbo;
+
+	/* on-disk cache of linked program binaries */
+	char                     *program_cache_path;
+	uint64_t                 driver_hash;
+	bool                     program_binary_available;
 };
 
 extern struct fbo_info *get_fbo(struct gs_device *device,
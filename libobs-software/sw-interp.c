@@ -0,0 +1,3190 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#include "sw-subsystem.h"
+#include "sw-interp.h"
+
+/* guards against shaders that would otherwise never finish */
+#define MAX_LOOP_ITERATIONS 65536
+
+enum sw_base_type {
+	SW_TYPE_VOID,
+	SW_TYPE_BOOL,
+	SW_TYPE_INT,
+	SW_TYPE_FLOAT,
+	SW_TYPE_STRUCT,
+	SW_TYPE_TEXTURE,
+	SW_TYPE_SAMPLER
+};
+
+struct sw_type {
+	enum sw_base_type base;
+	uint32_t          dim;         /* vector size, or matrix rows/columns */
+	bool              matrix;
+	uint32_t          array_count; /* 0 if not an array */
+	int               struct_idx;
+	uint32_t          size;        /* total number of floats */
+};
+
+struct sw_member {
+	char              *name;
+	enum sw_semantic  semantic;
+	uint32_t          index;
+	struct sw_type    type;
+	uint32_t          offset;
+};
+
+struct sw_struct {
+	char                     *name;
+	DARRAY(struct sw_member) members;
+	uint32_t                 size;
+};
+
+struct sw_global {
+	char              *name;
+	struct sw_type    type;
+	uint32_t          offset;
+};
+
+enum sw_node_type {
+	NODE_CONST,
+	NODE_LOCAL,
+	NODE_GLOBAL,
+	NODE_SAMPLER,
+	NODE_MEMBER,
+	NODE_INDEX,
+	NODE_SWIZZLE,
+	NODE_CONVERT,
+	NODE_CONSTRUCT,
+	NODE_UNARY,
+	NODE_BINARY,
+	NODE_ASSIGN,
+	NODE_INCDEC,
+	NODE_TERNARY,
+	NODE_CALL,
+	NODE_INTRINSIC,
+	NODE_SAMPLE
+};
+
+enum sw_intrinsic {
+	/* component-wise */
+	INTR_ABS,
+	INTR_ACOS,
+	INTR_ASIN,
+	INTR_ATAN,
+	INTR_ATAN2,
+	INTR_CEIL,
+	INTR_CLAMP,
+	INTR_COS,
+	INTR_DEGREES,
+	INTR_EXP,
+	INTR_EXP2,
+	INTR_FLOOR,
+	INTR_FMOD,
+	INTR_FRAC,
+	INTR_LERP,
+	INTR_LOG,
+	INTR_LOG2,
+	INTR_LOG10,
+	INTR_MAD,
+	INTR_MAX,
+	INTR_MIN,
+	INTR_POW,
+	INTR_RADIANS,
+	INTR_ROUND,
+	INTR_RSQRT,
+	INTR_SATURATE,
+	INTR_SIGN,
+	INTR_SIN,
+	INTR_SMOOTHSTEP,
+	INTR_SQRT,
+	INTR_STEP,
+	INTR_TAN,
+	INTR_TRUNC,
+	INTR_DDX,
+	INTR_DDY,
+	INTR_LAST_COMPONENTWISE = INTR_DDY,
+
+	INTR_DOT,
+	INTR_LENGTH,
+	INTR_DISTANCE,
+	INTR_NORMALIZE,
+	INTR_CROSS,
+	INTR_ANY,
+	INTR_ALL,
+	INTR_CLIP,
+	INTR_TRANSPOSE,
+	INTR_MUL,
+
+	/* resolved variants of mul */
+	INTR_MUL_VM,
+	INTR_MUL_MV,
+	INTR_MUL_MM
+};
+
+static const struct {
+	const char        *name;
+	enum sw_intrinsic id;
+	size_t            num_args;
+} intrinsics[] = {
+	{"abs",        INTR_ABS,        1},
+	{"acos",       INTR_ACOS,       1},
+	{"asin",       INTR_ASIN,       1},
+	{"atan",       INTR_ATAN,       1},
+	{"atan2",      INTR_ATAN2,      2},
+	{"ceil",       INTR_CEIL,       1},
+	{"clamp",      INTR_CLAMP,      3},
+	{"cos",        INTR_COS,        1},
+	{"degrees",    INTR_DEGREES,    1},
+	{"exp",        INTR_EXP,        1},
+	{"exp2",       INTR_EXP2,       1},
+	{"floor",      INTR_FLOOR,      1},
+	{"fmod",       INTR_FMOD,       2},
+	{"frac",       INTR_FRAC,       1},
+	{"lerp",       INTR_LERP,       3},
+	{"log",        INTR_LOG,        1},
+	{"log2",       INTR_LOG2,       1},
+	{"log10",      INTR_LOG10,      1},
+	{"mad",        INTR_MAD,        3},
+	{"max",        INTR_MAX,        2},
+	{"min",        INTR_MIN,        2},
+	{"pow",        INTR_POW,        2},
+	{"radians",    INTR_RADIANS,    1},
+	{"round",      INTR_ROUND,      1},
+	{"rsqrt",      INTR_RSQRT,      1},
+	{"saturate",   INTR_SATURATE,   1},
+	{"sign",       INTR_SIGN,       1},
+	{"sin",        INTR_SIN,        1},
+	{"smoothstep", INTR_SMOOTHSTEP, 3},
+	{"sqrt",       INTR_SQRT,       1},
+	{"step",       INTR_STEP,       2},
+	{"tan",        INTR_TAN,        1},
+	{"trunc",      INTR_TRUNC,      1},
+	{"ddx",        INTR_DDX,        1},
+	{"ddy",        INTR_DDY,        1},
+	{"dot",        INTR_DOT,        2},
+	{"length",     INTR_LENGTH,     1},
+	{"distance",   INTR_DISTANCE,   2},
+	{"normalize",  INTR_NORMALIZE,  1},
+	{"cross",      INTR_CROSS,      2},
+	{"any",        INTR_ANY,        1},
+	{"all",        INTR_ALL,        1},
+	{"clip",       INTR_CLIP,       1},
+	{"transpose",  INTR_TRANSPOSE,  1},
+	{"mul",        INTR_MUL,        2},
+};
+
+enum sw_sample_method {
+	SAMPLE_SAMPLE,
+	SAMPLE_LOAD
+};
+
+struct sw_func;
+
+struct sw_node {
+	enum sw_node_type kind;
+	struct sw_type    type;
+
+	/* operator, intrinsic, or sampling method */
+	int               op;
+	bool              prefix;
+
+	/* local/global/member offset, element size when indexing, or
+	 * sampler index */
+	uint32_t          offset;
+	uint32_t          count;
+	uint8_t           swizzle[4];
+
+	float             *values;
+	struct sw_func    *func;
+	struct sw_node    **args;
+	size_t            num_args;
+
+	bool              addressable;
+	bool              lvalue;
+
+	/* stack space needed to evaluate the node by value or by address */
+	uint32_t          stack_need;
+	uint32_t          ref_need;
+};
+
+enum sw_stmt_type {
+	STMT_BLOCK,
+	STMT_EXPR,
+	STMT_DECL,
+	STMT_IF,
+	STMT_FOR,
+	STMT_DO,
+	STMT_RETURN,
+	STMT_BREAK,
+	STMT_CONTINUE,
+	STMT_DISCARD
+};
+
+struct sw_stmt {
+	enum sw_stmt_type kind;
+	struct sw_node    *expr;
+	struct sw_node    *post;
+	struct sw_stmt    *init;
+	struct sw_stmt    *body;
+	struct sw_stmt    *else_body;
+	struct sw_stmt    *next;
+	uint32_t          offset;
+	uint32_t          size;
+	uint32_t          stack_need;
+};
+
+struct sw_func {
+	char               *name;
+	struct sw_type     ret;
+	DARRAY(struct sw_type) param_types;
+	DARRAY(uint32_t)   param_offsets;
+	uint32_t           frame_size;
+	uint32_t           stack_need;
+	struct sw_stmt     *body;
+};
+
+struct sw_program {
+	DARRAY(struct sw_struct) structs;
+	DARRAY(struct sw_global) globals;
+	DARRAY(char*)            samplers;
+	DARRAY(struct sw_func*)  funcs;
+	DARRAY(void*)            allocs;
+
+	struct sw_func           *main;
+	uint32_t                 globals_size;
+	uint32_t                 stack_size;
+
+	struct sw_io             inputs;
+	struct sw_io             outputs;
+};
+
+struct sw_exec {
+	gs_shader_t              *shader;
+	const struct sw_program  *program;
+
+	float                    *stack;
+	uint32_t                 stack_capacity;
+	uint32_t                 sp;
+
+	float                    *globals;
+	uint32_t                 globals_capacity;
+
+	float                    *frame;
+	float                    *ret;
+	bool                     discarded;
+};
+
+/* ========================================================================= */
+/* Types                                                                     */
+
+static inline void *prog_alloc(struct sw_program *program, size_t size)
+{
+	void *ptr = bzalloc(size);
+	da_push_back(program->allocs, &ptr);
+	return ptr;
+}
+
+static uint32_t get_element_size(const struct sw_program *program,
+		const struct sw_type *type)
+{
+	switch (type->base) {
+	case SW_TYPE_VOID:
+		return 0;
+	case SW_TYPE_STRUCT:
+		return program->structs.array[type->struct_idx].size;
+	case SW_TYPE_TEXTURE:
+	case SW_TYPE_SAMPLER:
+		return 1;
+	case SW_TYPE_BOOL:
+	case SW_TYPE_INT:
+	case SW_TYPE_FLOAT:
+		break;
+	}
+
+	return type->matrix ? type->dim * type->dim : type->dim;
+}
+
+static inline void type_update_size(const struct sw_program *program,
+		struct sw_type *type)
+{
+	uint32_t count = type->array_count ? type->array_count : 1;
+	type->size = get_element_size(program, type) * count;
+}
+
+static inline struct sw_type make_type(enum sw_base_type base, uint32_t dim,
+		bool matrix)
+{
+	struct sw_type type = {0};
+	type.base       = base;
+	type.dim        = dim;
+	type.matrix     = matrix;
+	type.struct_idx = -1;
+	type.size       = base == SW_TYPE_VOID ? 0 :
+	                  (matrix ? dim * dim : dim);
+	return type;
+}
+
+static inline bool type_numeric(const struct sw_type *type)
+{
+	return (type->base == SW_TYPE_BOOL ||
+	        type->base == SW_TYPE_INT ||
+	        type->base == SW_TYPE_FLOAT) && !type->array_count;
+}
+
+static inline bool type_scalar(const struct sw_type *type)
+{
+	return type_numeric(type) && !type->matrix && type->dim == 1;
+}
+
+static inline bool type_vector(const struct sw_type *type)
+{
+	return type_numeric(type) && !type->matrix;
+}
+
+static inline bool types_equal(const struct sw_type *a,
+		const struct sw_type *b)
+{
+	return a->base == b->base &&
+	       a->dim == b->dim &&
+	       a->matrix == b->matrix &&
+	       a->array_count == b->array_count &&
+	       a->struct_idx == b->struct_idx;
+}
+
+static inline bool shapes_equal(const struct sw_type *a,
+		const struct sw_type *b)
+{
+	return a->dim == b->dim && a->matrix == b->matrix;
+}
+
+static bool get_builtin_type(const char *name, size_t len,
+		struct sw_type *type)
+{
+	static const struct {
+		const char        *name;
+		enum sw_base_type base;
+	} prefixes[] = {
+		{"float",      SW_TYPE_FLOAT},
+		{"half",       SW_TYPE_FLOAT},
+		{"double",     SW_TYPE_FLOAT},
+		{"min16float", SW_TYPE_FLOAT},
+		{"int",        SW_TYPE_INT},
+		{"uint",       SW_TYPE_INT},
+		{"bool",       SW_TYPE_BOOL}
+	};
+
+	if (len == 4 && strncmp(name, "void", 4) == 0) {
+		*type = make_type(SW_TYPE_VOID, 0, false);
+		return true;
+	}
+	if (len == 6 && strncmp(name, "matrix", 6) == 0) {
+		*type = make_type(SW_TYPE_FLOAT, 4, true);
+		return true;
+	}
+	if (len == 9 && (strncmp(name, "texture2d", 9) == 0)) {
+		*type = make_type(SW_TYPE_TEXTURE, 2, false);
+		type->size = 1;
+		return true;
+	}
+	if ((len == 9  && strncmp(name, "texture3d", 9) == 0) ||
+	    (len == 12 && strncmp(name, "texture_cube", 12) == 0)) {
+		*type = make_type(SW_TYPE_TEXTURE, 3, false);
+		type->size = 1;
+		return true;
+	}
+	if (len == 12 && strncmp(name, "texture_rect", 12) == 0) {
+		*type = make_type(SW_TYPE_TEXTURE, 2, false);
+		type->size = 1;
+		return true;
+	}
+
+	for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+		size_t      prefix_len = strlen(prefixes[i].name);
+		const char *rest       = name + prefix_len;
+		size_t      rest_len   = len - prefix_len;
+
+		if (len < prefix_len ||
+		    strncmp(name, prefixes[i].name, prefix_len) != 0)
+			continue;
+
+		if (rest_len == 0) {
+			*type = make_type(prefixes[i].base, 1, false);
+			return true;
+
+		} else if (rest_len == 1 && rest[0] >= '1' && rest[0] <= '4') {
+			*type = make_type(prefixes[i].base,
+					(uint32_t)(rest[0] - '0'), false);
+			return true;
+
+		} else if (rest_len == 3 && rest[1] == 'x' &&
+		           rest[0] >= '2' && rest[0] <= '4' &&
+		           rest[0] == rest[2]) {
+			*type = make_type(prefixes[i].base,
+					(uint32_t)(rest[0] - '0'), true);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int find_struct(const struct sw_program *program, const char *name,
+		size_t len)
+{
+	for (size_t i = 0; i < program->structs.num; i++) {
+		const char *struct_name = program->structs.array[i].name;
+		if (strlen(struct_name) == len &&
+		    strncmp(struct_name, name, len) == 0)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+static bool get_type(const struct sw_program *program, const char *name,
+		size_t len, struct sw_type *type)
+{
+	int struct_idx;
+
+	if (get_builtin_type(name, len, type))
+		return true;
+
+	struct_idx = find_struct(program, name, len);
+	if (struct_idx == -1)
+		return false;
+
+	*type = make_type(SW_TYPE_STRUCT, 1, false);
+	type->struct_idx = struct_idx;
+	type_update_size(program, type);
+	return true;
+}
+
+static inline bool get_type_str(const struct sw_program *program,
+		const char *name, int array_count, struct sw_type *type)
+{
+	if (!get_type(program, name, strlen(name), type))
+		return false;
+
+	type->array_count = (uint32_t)array_count;
+	type_update_size(program, type);
+	return true;
+}
+
+/* ========================================================================= */
+/* Semantics                                                                 */
+
+static void parse_semantic(const char *mapping, bool pixel_output,
+		enum sw_semantic *semantic, uint32_t *index)
+{
+	size_t len;
+
+	*semantic = SW_SEMANTIC_OTHER;
+	*index    = 0;
+
+	if (!mapping)
+		return;
+
+	if (astrcmpi_n(mapping, "SV_", 3) == 0)
+		mapping += 3;
+
+	len = strlen(mapping);
+	while (len && mapping[len - 1] >= '0' && mapping[len - 1] <= '9')
+		len--;
+
+	if (mapping[len])
+		*index = (uint32_t)strtol(mapping + len, NULL, 10);
+
+	if (len == 8 && astrcmpi_n(mapping, "POSITION", 8) == 0)
+		*semantic = SW_SEMANTIC_POSITION;
+	else if (len == 6 && astrcmpi_n(mapping, "NORMAL", 6) == 0)
+		*semantic = SW_SEMANTIC_NORMAL;
+	else if (len == 7 && astrcmpi_n(mapping, "TANGENT", 7) == 0)
+		*semantic = SW_SEMANTIC_TANGENT;
+	else if (len == 8 && astrcmpi_n(mapping, "TEXCOORD", 8) == 0)
+		*semantic = SW_SEMANTIC_TEXCOORD;
+	else if (len == 6 && astrcmpi_n(mapping, "TARGET", 6) == 0)
+		*semantic = SW_SEMANTIC_TARGET;
+	else if (len == 5 && astrcmpi_n(mapping, "COLOR", 5) == 0)
+		*semantic = pixel_output ?
+			SW_SEMANTIC_TARGET : SW_SEMANTIC_COLOR;
+}
+
+static void add_varying(struct sw_io *io, enum sw_semantic semantic,
+		uint32_t index, uint32_t offset, uint32_t size)
+{
+	struct sw_varying *var = da_push_back_new(io->vars);
+	var->semantic = semantic;
+	var->index    = index;
+	var->offset   = offset;
+	var->size     = size;
+}
+
+/* pixel shader outputs with a COLOR semantic are render targets */
+static void add_varyings(const struct sw_program *program, struct sw_io *io,
+		const struct sw_type *type, const char *mapping,
+		uint32_t offset, bool pixel_output)
+{
+	enum sw_semantic semantic;
+	uint32_t         index;
+
+	if (type->base == SW_TYPE_STRUCT) {
+		const struct sw_struct *st;
+		st = program->structs.array + type->struct_idx;
+
+		for (size_t i = 0; i < st->members.num; i++) {
+			const struct sw_member *member = st->members.array+i;
+
+			semantic = member->semantic;
+			if (pixel_output && semantic == SW_SEMANTIC_COLOR)
+				semantic = SW_SEMANTIC_TARGET;
+
+			add_varying(io, semantic, member->index,
+					offset + member->offset,
+					member->type.size);
+		}
+		return;
+	}
+
+	parse_semantic(mapping, pixel_output, &semantic, &index);
+	add_varying(io, semantic, index, offset, type->size);
+}
+
+/* ========================================================================= */
+/* Compiler                                                                  */
+
+struct sw_local {
+	struct strref     name;
+	struct sw_type    type;
+	uint32_t          offset;
+	int               depth;
+};
+
+struct sw_compiler {
+	struct sw_program    *program;
+	gs_shader_t          *shader;
+	const char           *file;
+
+	struct cf_token      *token;
+	struct sw_func       *func;
+	DARRAY(struct sw_local) locals;
+	int                  depth;
+
+	struct dstr          errors;
+	bool                 error;
+};
+
+static void compile_error(struct sw_compiler *c, const char *format, ...)
+{
+	va_list args;
+
+	if (c->error)
+		return;
+
+	c->error = true;
+
+	dstr_catf(&c->errors, "%s: ", c->file ? c->file : "(unknown)");
+	va_start(args, format);
+	dstr_vcatf(&c->errors, format, args);
+	va_end(args);
+
+	if (c->token && c->token->type != CFTOKEN_NONE) {
+		dstr_cat(&c->errors, " (near '");
+		dstr_cat_strref(&c->errors, &c->token->str);
+		dstr_cat(&c->errors, "')");
+	}
+	dstr_cat(&c->errors, "\n");
+}
+
+static inline struct cf_token *skip_whitespace(struct cf_token *token)
+{
+	while (token->type == CFTOKEN_SPACETAB ||
+	       token->type == CFTOKEN_NEWLINE)
+		token++;
+	return token;
+}
+
+static inline void next_token(struct sw_compiler *c)
+{
+	if (c->token->type != CFTOKEN_NONE)
+		c->token = skip_whitespace(c->token + 1);
+}
+
+static inline struct cf_token *peek_token(struct sw_compiler *c)
+{
+	if (c->token->type == CFTOKEN_NONE)
+		return c->token;
+	return skip_whitespace(c->token + 1);
+}
+
+static inline bool token_is(const struct cf_token *token, const char *str)
+{
+	return strref_cmp(&token->str, str) == 0;
+}
+
+static inline bool token_is_ch(const struct cf_token *token, char ch)
+{
+	return token->type == CFTOKEN_OTHER && token->str.len == 1 &&
+	       token->str.array[0] == ch;
+}
+
+/* multi-character operators are lexed as adjacent single character tokens */
+static inline bool is_op2(struct sw_compiler *c, char ch1, char ch2)
+{
+	return token_is_ch(c->token, ch1) && token_is_ch(c->token + 1, ch2);
+}
+
+static inline bool is_op1(struct sw_compiler *c, char ch)
+{
+	return token_is_ch(c->token, ch) && !token_is_ch(c->token + 1, '=') &&
+	       !token_is_ch(c->token + 1, ch);
+}
+
+static inline void next_op2(struct sw_compiler *c)
+{
+	c->token = skip_whitespace(c->token + 2);
+}
+
+static inline bool accept(struct sw_compiler *c, const char *str)
+{
+	if (token_is(c->token, str)) {
+		next_token(c);
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool expect(struct sw_compiler *c, const char *str)
+{
+	if (accept(c, str))
+		return true;
+
+	compile_error(c, "expected '%s'", str);
+	return false;
+}
+
+static inline bool token_type(struct sw_compiler *c,
+		const struct cf_token *token, struct sw_type *type)
+{
+	return token->type == CFTOKEN_NAME &&
+		get_type(c->program, token->str.array, token->str.len, type);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline uint32_t src_need(const struct sw_node *node)
+{
+	return node->addressable ?
+		node->ref_need : node->type.size + node->stack_need;
+}
+
+static struct sw_node *new_node(struct sw_compiler *c, enum sw_node_type kind,
+		const struct sw_type *type, size_t num_args)
+{
+	struct sw_node *node = prog_alloc(c->program, sizeof(struct sw_node));
+	node->kind = kind;
+	node->type = *type;
+
+	if (num_args) {
+		node->args = prog_alloc(c->program,
+				sizeof(struct sw_node*) * num_args);
+		node->num_args = num_args;
+	}
+
+	return node;
+}
+
+/* sums up the stack usage of arguments that are evaluated to temporaries */
+static void update_need(struct sw_node *node)
+{
+	uint32_t need = 0;
+	for (size_t i = 0; i < node->num_args; i++)
+		if (node->args[i])
+			need += src_need(node->args[i]);
+	node->stack_need = need;
+}
+
+static struct sw_node *make_const(struct sw_compiler *c,
+		const struct sw_type *type, const float *values)
+{
+	struct sw_node *node = new_node(c, NODE_CONST, type, 0);
+	node->values = prog_alloc(c->program, sizeof(float) * type->size);
+	memcpy(node->values, values, sizeof(float) * type->size);
+	return node;
+}
+
+static bool can_convert(const struct sw_type *from, const struct sw_type *to,
+		bool explicit_cast)
+{
+	if (types_equal(from, to))
+		return true;
+	if (!type_numeric(from) || !type_numeric(to))
+		return false;
+	if (type_scalar(from))
+		return true;
+	if (from->matrix != to->matrix)
+		return false;
+
+	/* HLSL implicitly truncates vectors and matrices */
+	if (from->dim >= to->dim)
+		return true;
+
+	UNUSED_PARAMETER(explicit_cast);
+	return false;
+}
+
+static struct sw_node *convert(struct sw_compiler *c, struct sw_node *node,
+		const struct sw_type *type, bool explicit_cast)
+{
+	struct sw_node *conv;
+
+	if (!node)
+		return NULL;
+	if (types_equal(&node->type, type))
+		return node;
+
+	if (!can_convert(&node->type, type, explicit_cast)) {
+		compile_error(c, "cannot convert between incompatible types");
+		return NULL;
+	}
+
+	/* integer and boolean values are stored as whole floats already */
+	if (type->base == SW_TYPE_FLOAT && shapes_equal(&node->type, type))
+		return node;
+
+	conv = new_node(c, NODE_CONVERT, type, 1);
+	conv->args[0] = node;
+	update_need(conv);
+	return conv;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static struct sw_node *parse_expr(struct sw_compiler *c);
+static struct sw_node *parse_assignment(struct sw_compiler *c);
+static struct sw_node *parse_unary(struct sw_compiler *c);
+
+static bool parse_args(struct sw_compiler *c, struct darray *args)
+{
+	if (!expect(c, "("))
+		return false;
+
+	if (accept(c, ")"))
+		return true;
+
+	for (;;) {
+		struct sw_node *arg = parse_assignment(c);
+		if (!arg)
+			return false;
+
+		darray_push_back(sizeof(struct sw_node*), args, &arg);
+
+		if (accept(c, ")"))
+			return true;
+		if (!expect(c, ","))
+			return false;
+	}
+}
+
+static struct sw_node *make_construct(struct sw_compiler *c,
+		const struct sw_type *type, struct darray *args)
+{
+	struct sw_node **arg_array = args->array;
+	struct sw_node *node;
+	uint32_t       total = 0;
+
+	for (size_t i = 0; i < args->num; i++) {
+		if (type_numeric(&arg_array[i]->type) ||
+		    arg_array[i]->type.base == SW_TYPE_STRUCT)
+			total += arg_array[i]->type.size;
+		else
+			total = (uint32_t)-1;
+	}
+
+	if (args->num == 1 && type_scalar(&arg_array[0]->type) &&
+	    type_numeric(type))
+		return convert(c, arg_array[0], type, true);
+
+	if (total != type->size) {
+		compile_error(c, "wrong number of components in constructor");
+		return NULL;
+	}
+
+	node = new_node(c, NODE_CONSTRUCT, type, args->num);
+	memcpy(node->args, args->array, sizeof(struct sw_node*) * args->num);
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *parse_constructor(struct sw_compiler *c,
+		const struct sw_type *type)
+{
+	DARRAY(struct sw_node*) args;
+	struct sw_node *node = NULL;
+
+	da_init(args);
+	if (parse_args(c, &args.da))
+		node = make_construct(c, type, &args.da);
+
+	da_free(args);
+	return node;
+}
+
+/* gets the common operand type of two numeric operands */
+static bool get_common_type(struct sw_compiler *c, const struct sw_type *a,
+		const struct sw_type *b, struct sw_type *common)
+{
+	enum sw_base_type base;
+
+	if (!type_numeric(a) || !type_numeric(b)) {
+		compile_error(c, "invalid operand types");
+		return false;
+	}
+
+	if (a->base == SW_TYPE_FLOAT || b->base == SW_TYPE_FLOAT)
+		base = SW_TYPE_FLOAT;
+	else if (a->base == SW_TYPE_INT || b->base == SW_TYPE_INT)
+		base = SW_TYPE_INT;
+	else
+		base = SW_TYPE_BOOL;
+
+	if (type_scalar(a)) {
+		*common = make_type(base, b->dim, b->matrix);
+	} else if (type_scalar(b)) {
+		*common = make_type(base, a->dim, a->matrix);
+	} else if (a->matrix != b->matrix) {
+		compile_error(c, "invalid operand types");
+		return false;
+	} else {
+		uint32_t dim = a->dim < b->dim ? a->dim : b->dim;
+		*common = make_type(base, dim, a->matrix);
+	}
+
+	return true;
+}
+
+static inline bool is_comparison(int op)
+{
+	return op == '<' || op == '>' || op == 'l' || op == 'g' ||
+	       op == 'e' || op == 'n';
+}
+
+static struct sw_node *make_binary(struct sw_compiler *c, int op,
+		struct sw_node *a, struct sw_node *b)
+{
+	struct sw_type common;
+	struct sw_node *node;
+
+	if (!a || !b)
+		return NULL;
+	if (!get_common_type(c, &a->type, &b->type, &common))
+		return NULL;
+
+	if (op == '&' || op == '|')
+		common.base = SW_TYPE_BOOL;
+	else if (common.base == SW_TYPE_BOOL && !is_comparison(op))
+		common.base = SW_TYPE_INT;
+
+	a = convert(c, a, &common, false);
+	b = convert(c, b, &common, false);
+	if (!a || !b)
+		return NULL;
+
+	node = new_node(c, NODE_BINARY, &common, 2);
+	node->op      = op;
+	node->args[0] = a;
+	node->args[1] = b;
+
+	if (is_comparison(op))
+		node->type.base = SW_TYPE_BOOL;
+
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *make_assign(struct sw_compiler *c, int op,
+		struct sw_node *lhs, struct sw_node *rhs)
+{
+	struct sw_node *node;
+
+	if (!lhs || !rhs)
+		return NULL;
+	if (!lhs->lvalue) {
+		compile_error(c, "assignment to a non-modifiable value");
+		return NULL;
+	}
+	if (op != '=' && !type_numeric(&lhs->type)) {
+		compile_error(c, "invalid operand types");
+		return NULL;
+	}
+
+	rhs = convert(c, rhs, &lhs->type, false);
+	if (!rhs)
+		return NULL;
+
+	node = new_node(c, NODE_ASSIGN, &lhs->type, 2);
+	node->op      = op;
+	node->args[0] = lhs;
+	node->args[1] = rhs;
+	node->stack_need = lhs->type.size * 2 + rhs->stack_need +
+		lhs->stack_need + lhs->ref_need;
+	return node;
+}
+
+static struct sw_node *make_incdec(struct sw_compiler *c, int op,
+		struct sw_node *lhs, bool prefix)
+{
+	struct sw_node *node;
+
+	if (!lhs)
+		return NULL;
+	if (!lhs->lvalue || !type_numeric(&lhs->type)) {
+		compile_error(c, "invalid increment/decrement operand");
+		return NULL;
+	}
+
+	node = new_node(c, NODE_INCDEC, &lhs->type, 1);
+	node->op         = op;
+	node->prefix     = prefix;
+	node->args[0]    = lhs;
+	node->stack_need = lhs->type.size + lhs->stack_need + lhs->ref_need;
+	return node;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static struct sw_node *make_componentwise(struct sw_compiler *c,
+		enum sw_intrinsic id, struct sw_node **args, size_t num_args)
+{
+	struct sw_type result = make_type(SW_TYPE_FLOAT, 1, false);
+	bool           have_shape = false;
+	struct sw_node *node;
+
+	for (size_t i = 0; i < num_args; i++) {
+		const struct sw_type *type = &args[i]->type;
+
+		if (!type_numeric(type)) {
+			compile_error(c, "invalid intrinsic argument");
+			return NULL;
+		}
+		if (type_scalar(type))
+			continue;
+
+		if (!have_shape) {
+			result = make_type(SW_TYPE_FLOAT, type->dim,
+					type->matrix);
+			have_shape = true;
+		} else if (type->matrix != result.matrix) {
+			compile_error(c, "invalid intrinsic argument");
+			return NULL;
+		} else if (type->dim < result.dim) {
+			result = make_type(SW_TYPE_FLOAT, type->dim,
+					type->matrix);
+		}
+	}
+
+	node = new_node(c, NODE_INTRINSIC, &result, num_args);
+	node->op = id;
+
+	for (size_t i = 0; i < num_args; i++) {
+		node->args[i] = convert(c, args[i], &result, false);
+		if (!node->args[i])
+			return NULL;
+	}
+
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *make_vector_intrinsic(struct sw_compiler *c,
+		enum sw_intrinsic id, struct sw_node **args, size_t num_args)
+{
+	struct sw_node *node;
+	struct sw_type operand;
+	struct sw_type result;
+
+	operand = args[0]->type;
+	if (num_args == 2 && !get_common_type(c, &args[0]->type,
+				&args[1]->type, &operand))
+		return NULL;
+
+	if (!type_vector(&operand)) {
+		compile_error(c, "invalid intrinsic argument");
+		return NULL;
+	}
+
+	operand.base = SW_TYPE_FLOAT;
+
+	switch (id) {
+	case INTR_NORMALIZE:
+		result = operand;
+		break;
+	case INTR_CROSS:
+		operand = make_type(SW_TYPE_FLOAT, 3, false);
+		result  = operand;
+		break;
+	case INTR_ANY:
+	case INTR_ALL:
+		result = make_type(SW_TYPE_BOOL, 1, false);
+		break;
+	case INTR_CLIP:
+		result = make_type(SW_TYPE_VOID, 0, false);
+		break;
+	default:
+		result = make_type(SW_TYPE_FLOAT, 1, false);
+	}
+
+	node = new_node(c, NODE_INTRINSIC, &result, num_args);
+	node->op = id;
+
+	for (size_t i = 0; i < num_args; i++) {
+		node->args[i] = convert(c, args[i], &operand, false);
+		if (!node->args[i])
+			return NULL;
+	}
+
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *make_mul(struct sw_compiler *c, struct sw_node **args)
+{
+	const struct sw_type *a = &args[0]->type;
+	const struct sw_type *b = &args[1]->type;
+	enum sw_intrinsic    id;
+	struct sw_type       result;
+	struct sw_node       *node;
+
+	if (!type_numeric(a) || !type_numeric(b)) {
+		compile_error(c, "invalid intrinsic argument");
+		return NULL;
+	}
+
+	if (type_scalar(a) || type_scalar(b))
+		return make_binary(c, '*', args[0], args[1]);
+	if (!a->matrix && !b->matrix)
+		return make_vector_intrinsic(c, INTR_DOT, args, 2);
+
+	if (!a->matrix) {
+		id = INTR_MUL_VM;
+		result = make_type(SW_TYPE_FLOAT, b->dim, false);
+	} else if (!b->matrix) {
+		id = INTR_MUL_MV;
+		result = make_type(SW_TYPE_FLOAT, a->dim, false);
+	} else {
+		id = INTR_MUL_MM;
+		result = make_type(SW_TYPE_FLOAT, a->dim, true);
+	}
+
+	if (a->dim != b->dim) {
+		compile_error(c, "mul: mismatched dimensions");
+		return NULL;
+	}
+
+	node = new_node(c, NODE_INTRINSIC, &result, 2);
+	node->op      = id;
+	node->args[0] = args[0];
+	node->args[1] = args[1];
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *make_intrinsic(struct sw_compiler *c,
+		enum sw_intrinsic id, struct sw_node **args, size_t num_args)
+{
+	struct sw_node *node;
+
+	if (id <= INTR_LAST_COMPONENTWISE)
+		return make_componentwise(c, id, args, num_args);
+
+	switch (id) {
+	case INTR_MUL:
+		return make_mul(c, args);
+
+	case INTR_TRANSPOSE:
+		if (!type_numeric(&args[0]->type) || !args[0]->type.matrix) {
+			compile_error(c, "invalid intrinsic argument");
+			return NULL;
+		}
+
+		node = new_node(c, NODE_INTRINSIC, &args[0]->type, 1);
+		node->op      = id;
+		node->args[0] = args[0];
+		update_need(node);
+		return node;
+
+	default:
+		return make_vector_intrinsic(c, id, args, num_args);
+	}
+}
+
+static struct sw_func *find_func(struct sw_compiler *c,
+		const struct strref *name, size_t num_args)
+{
+	for (size_t i = 0; i < c->program->funcs.num; i++) {
+		struct sw_func *func = c->program->funcs.array[i];
+
+		if (strref_cmp(name, func->name) == 0 &&
+		    func->param_types.num == num_args)
+			return func;
+	}
+
+	return NULL;
+}
+
+static struct sw_node *parse_call(struct sw_compiler *c)
+{
+	DARRAY(struct sw_node*) args;
+	struct strref  name = c->token->str;
+	struct sw_node *node = NULL;
+	struct sw_func *func;
+
+	da_init(args);
+	next_token(c);
+
+	if (!parse_args(c, &args.da))
+		goto exit;
+
+	for (size_t i = 0; i < sizeof(intrinsics)/sizeof(intrinsics[0]); i++) {
+		if (strref_cmp(&name, intrinsics[i].name) != 0)
+			continue;
+
+		if (args.num != intrinsics[i].num_args) {
+			compile_error(c, "wrong number of arguments to '%s'",
+					intrinsics[i].name);
+			goto exit;
+		}
+
+		node = make_intrinsic(c, intrinsics[i].id, args.array,
+				args.num);
+		goto exit;
+	}
+
+	func = find_func(c, &name, args.num);
+	if (!func) {
+		compile_error(c, "unknown function");
+		goto exit;
+	}
+
+	node = new_node(c, NODE_CALL, &func->ret, args.num);
+	node->func = func;
+
+	for (size_t i = 0; i < args.num; i++) {
+		node->args[i] = convert(c, args.array[i],
+				func->param_types.array+i, false);
+		if (!node->args[i]) {
+			node = NULL;
+			goto exit;
+		}
+
+		if (node->args[i]->stack_need > node->stack_need)
+			node->stack_need = node->args[i]->stack_need;
+	}
+
+	if (func->stack_need > node->stack_need)
+		node->stack_need = func->stack_need;
+	node->stack_need += func->frame_size;
+
+exit:
+	da_free(args);
+	return node;
+}
+
+static struct sw_node *parse_number(struct sw_compiler *c)
+{
+	const struct cf_token *token = c->token;
+	bool                  is_float = false;
+	struct sw_type        type;
+	float                 val;
+
+	for (size_t i = 0; i < token->str.len; i++) {
+		char ch = token->str.array[i];
+		if (ch == '.' || ch == 'e' || ch == 'E' ||
+		    ch == 'f' || ch == 'F')
+			is_float = true;
+	}
+
+	if (is_float) {
+		val  = (float)os_strtod(token->str.array);
+		type = make_type(SW_TYPE_FLOAT, 1, false);
+	} else {
+		val  = (float)strtol(token->str.array, NULL, 0);
+		type = make_type(SW_TYPE_INT, 1, false);
+	}
+
+	next_token(c);
+	return make_const(c, &type, &val);
+}
+
+static struct sw_node *find_variable(struct sw_compiler *c,
+		const struct strref *name)
+{
+	struct sw_program *program = c->program;
+	struct sw_node    *node;
+
+	for (size_t i = c->locals.num; i > 0; i--) {
+		struct sw_local *local = c->locals.array + i - 1;
+		if (strref_cmp_strref(&local->name, name) != 0)
+			continue;
+
+		node = new_node(c, NODE_LOCAL, &local->type, 0);
+		node->offset      = local->offset;
+		node->addressable = true;
+		node->lvalue      = true;
+		return node;
+	}
+
+	for (size_t i = 0; i < program->globals.num; i++) {
+		struct sw_global *global = program->globals.array+i;
+		if (strref_cmp(name, global->name) != 0)
+			continue;
+
+		node = new_node(c, NODE_GLOBAL, &global->type, 0);
+		node->offset      = global->offset;
+		node->addressable = global->type.base != SW_TYPE_TEXTURE;
+		if (!node->addressable)
+			node->offset = (uint32_t)i;
+		return node;
+	}
+
+	for (size_t i = 0; i < program->samplers.num; i++) {
+		struct sw_type type;
+		if (strref_cmp(name, program->samplers.array[i]) != 0)
+			continue;
+
+		type = make_type(SW_TYPE_SAMPLER, 1, false);
+		type.size = 1;
+
+		node = new_node(c, NODE_SAMPLER, &type, 0);
+		node->offset = (uint32_t)i;
+		return node;
+	}
+
+	compile_error(c, "unknown identifier");
+	return NULL;
+}
+
+static struct sw_node *parse_primary(struct sw_compiler *c)
+{
+	struct cf_token *token = c->token;
+	struct sw_type  type;
+
+	if (token->type == CFTOKEN_NUM)
+		return parse_number(c);
+
+	if (token_is_ch(token, '(')) {
+		struct cf_token *after = peek_token(c);
+		struct sw_node  *node;
+
+		/* C-style cast */
+		if (token_type(c, after, &type) &&
+		    token_is_ch(skip_whitespace(after + 1), ')')) {
+			c->token = skip_whitespace(after + 1);
+			next_token(c);
+			return convert(c, parse_unary(c), &type, true);
+		}
+
+		next_token(c);
+		node = parse_expr(c);
+		if (!expect(c, ")"))
+			return NULL;
+		return node;
+	}
+
+	if (token->type != CFTOKEN_NAME) {
+		compile_error(c, "syntax error");
+		return NULL;
+	}
+
+	if (token_is(token, "true") || token_is(token, "false")) {
+		float val = token_is(token, "true") ? 1.0f : 0.0f;
+		type = make_type(SW_TYPE_BOOL, 1, false);
+		next_token(c);
+		return make_const(c, &type, &val);
+	}
+
+	if (token_is_ch(peek_token(c), '(')) {
+		if (token_type(c, token, &type)) {
+			next_token(c);
+			return parse_constructor(c, &type);
+		}
+
+		return parse_call(c);
+	}
+
+	next_token(c);
+	return find_variable(c, &token->str);
+}
+
+static struct sw_node *parse_sample(struct sw_compiler *c,
+		struct sw_node *texture)
+{
+	DARRAY(struct sw_node*) args;
+	struct sw_type coord_type;
+	struct sw_type float4 = make_type(SW_TYPE_FLOAT, 4, false);
+	struct sw_node *node = NULL;
+	bool           load = token_is(c->token, "Load");
+
+	if (!load && astrcmp_n(c->token->str.array, "Sample", 6) != 0) {
+		compile_error(c, "unsupported texture method");
+		return NULL;
+	}
+
+	da_init(args);
+	next_token(c);
+
+	if (!parse_args(c, &args.da))
+		goto exit;
+
+	if (args.num < (load ? 1u : 2u)) {
+		compile_error(c, "wrong number of arguments");
+		goto exit;
+	}
+
+	node = new_node(c, NODE_SAMPLE, &float4, 3);
+	node->op      = load ? SAMPLE_LOAD : SAMPLE_SAMPLE;
+	node->args[0] = texture;
+
+	if (load) {
+		coord_type = make_type(SW_TYPE_INT, 3, false);
+		node->args[2] = convert(c, args.array[0], &coord_type, false);
+	} else {
+		if (args.array[0]->type.base != SW_TYPE_SAMPLER) {
+			compile_error(c, "expected a sampler");
+			node = NULL;
+			goto exit;
+		}
+
+		coord_type = make_type(SW_TYPE_FLOAT, texture->type.dim,
+				false);
+		node->args[1] = args.array[0];
+		node->args[2] = convert(c, args.array[1], &coord_type, false);
+	}
+
+	if (!node->args[2])
+		node = NULL;
+	else
+		update_need(node);
+
+exit:
+	da_free(args);
+	return node;
+}
+
+static int get_swizzle_component(char ch)
+{
+	switch (ch) {
+	case 'x': case 'r': return 0;
+	case 'y': case 'g': return 1;
+	case 'z': case 'b': return 2;
+	case 'w': case 'a': return 3;
+	}
+
+	return -1;
+}
+
+static struct sw_node *parse_swizzle(struct sw_compiler *c,
+		struct sw_node *base)
+{
+	const struct strref *str = &c->token->str;
+	struct sw_type      type;
+	struct sw_node      *node;
+	bool                unique = true;
+
+	if (!type_vector(&base->type) || str->len < 1 || str->len > 4) {
+		compile_error(c, "invalid swizzle");
+		return NULL;
+	}
+
+	type = make_type(base->type.base, (uint32_t)str->len, false);
+	node = new_node(c, NODE_SWIZZLE, &type, 1);
+	node->args[0] = base;
+	node->count   = (uint32_t)str->len;
+
+	for (size_t i = 0; i < str->len; i++) {
+		int comp = get_swizzle_component(str->array[i]);
+		if (comp < 0 || (uint32_t)comp >= base->type.dim) {
+			compile_error(c, "invalid swizzle");
+			return NULL;
+		}
+
+		for (size_t j = 0; j < i; j++)
+			if (node->swizzle[j] == (uint8_t)comp)
+				unique = false;
+
+		node->swizzle[i] = (uint8_t)comp;
+	}
+
+	next_token(c);
+
+	node->lvalue   = base->lvalue && unique;
+	node->ref_need = base->ref_need;
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *parse_member(struct sw_compiler *c,
+		struct sw_node *base)
+{
+	const struct sw_struct *st;
+	struct sw_node         *node;
+
+	if (base->type.base == SW_TYPE_TEXTURE)
+		return parse_sample(c, base);
+
+	if (base->type.base != SW_TYPE_STRUCT || base->type.array_count)
+		return parse_swizzle(c, base);
+
+	st = c->program->structs.array + base->type.struct_idx;
+
+	for (size_t i = 0; i < st->members.num; i++) {
+		const struct sw_member *member = st->members.array+i;
+		if (strref_cmp(&c->token->str, member->name) != 0)
+			continue;
+
+		node = new_node(c, NODE_MEMBER, &member->type, 1);
+		node->args[0]     = base;
+		node->offset      = member->offset;
+		node->addressable = base->addressable;
+		node->lvalue      = base->lvalue;
+		node->ref_need    = base->ref_need;
+		update_need(node);
+
+		next_token(c);
+		return node;
+	}
+
+	compile_error(c, "unknown structure member");
+	return NULL;
+}
+
+static struct sw_node *parse_index(struct sw_compiler *c,
+		struct sw_node *base)
+{
+	struct sw_type int_type = make_type(SW_TYPE_INT, 1, false);
+	struct sw_type type     = base->type;
+	struct sw_node *index;
+	struct sw_node *node;
+	uint32_t       count;
+
+	next_token(c);
+	index = convert(c, parse_expr(c), &int_type, false);
+	if (!index || !expect(c, "]"))
+		return NULL;
+
+	if (type.array_count) {
+		count = type.array_count;
+		type.array_count = 0;
+		type_update_size(c->program, &type);
+	} else if (type_numeric(&type) && type.matrix) {
+		count = type.dim;
+		type  = make_type(type.base, type.dim, false);
+	} else if (type_numeric(&type) && type.dim > 1) {
+		count = type.dim;
+		type  = make_type(type.base, 1, false);
+	} else {
+		compile_error(c, "invalid index operation");
+		return NULL;
+	}
+
+	node = new_node(c, NODE_INDEX, &type, 2);
+	node->args[0]     = base;
+	node->args[1]     = index;
+	node->offset      = type.size;
+	node->count       = count;
+	node->addressable = base->addressable;
+	node->lvalue      = base->lvalue;
+	node->ref_need    = base->ref_need + src_need(index);
+	update_need(node);
+	return node;
+}
+
+static struct sw_node *parse_postfix(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_primary(c);
+
+	while (node) {
+		if (token_is_ch(c->token, '.')) {
+			next_token(c);
+			if (c->token->type != CFTOKEN_NAME) {
+				compile_error(c, "expected member name");
+				return NULL;
+			}
+			node = parse_member(c, node);
+
+		} else if (token_is_ch(c->token, '[')) {
+			node = parse_index(c, node);
+
+		} else if (is_op2(c, '+', '+') || is_op2(c, '-', '-')) {
+			int op = c->token->str.array[0];
+			next_op2(c);
+			node = make_incdec(c, op, node, false);
+
+		} else {
+			break;
+		}
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_unary(struct sw_compiler *c)
+{
+	struct sw_type type;
+	struct sw_node *node;
+	struct sw_node *unary;
+	int            op;
+
+	if (is_op2(c, '+', '+') || is_op2(c, '-', '-')) {
+		op = c->token->str.array[0];
+		next_op2(c);
+		return make_incdec(c, op, parse_unary(c), true);
+	}
+
+	if (token_is_ch(c->token, '+')) {
+		next_token(c);
+		return parse_unary(c);
+	}
+
+	if (!token_is_ch(c->token, '-') && !token_is_ch(c->token, '!'))
+		return parse_postfix(c);
+
+	op = c->token->str.array[0];
+	next_token(c);
+
+	node = parse_unary(c);
+	if (!node)
+		return NULL;
+	if (!type_numeric(&node->type)) {
+		compile_error(c, "invalid operand type");
+		return NULL;
+	}
+
+	type = node->type;
+	if (op == '!')
+		type.base = SW_TYPE_BOOL;
+	else if (type.base == SW_TYPE_BOOL)
+		type.base = SW_TYPE_INT;
+
+	node = convert(c, node, &type, false);
+	if (!node)
+		return NULL;
+
+	unary = new_node(c, NODE_UNARY, &type, 1);
+	unary->op      = op;
+	unary->args[0] = node;
+	update_need(unary);
+	return unary;
+}
+
+static struct sw_node *parse_multiplicative(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_unary(c);
+
+	while (node) {
+		int op;
+
+		if (is_op1(c, '*') || is_op1(c, '/') || is_op1(c, '%'))
+			op = c->token->str.array[0];
+		else
+			break;
+
+		next_token(c);
+		node = make_binary(c, op, node, parse_unary(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_additive(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_multiplicative(c);
+
+	while (node) {
+		int op;
+
+		if (is_op1(c, '+') || is_op1(c, '-'))
+			op = c->token->str.array[0];
+		else
+			break;
+
+		next_token(c);
+		node = make_binary(c, op, node, parse_multiplicative(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_relational(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_additive(c);
+
+	while (node) {
+		int op;
+
+		if (is_op2(c, '<', '=')) {
+			op = 'l';
+			next_op2(c);
+		} else if (is_op2(c, '>', '=')) {
+			op = 'g';
+			next_op2(c);
+		} else if (is_op1(c, '<') || is_op1(c, '>')) {
+			op = c->token->str.array[0];
+			next_token(c);
+		} else {
+			break;
+		}
+
+		node = make_binary(c, op, node, parse_additive(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_equality(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_relational(c);
+
+	while (node) {
+		int op;
+
+		if (is_op2(c, '=', '='))
+			op = 'e';
+		else if (is_op2(c, '!', '='))
+			op = 'n';
+		else
+			break;
+
+		next_op2(c);
+		node = make_binary(c, op, node, parse_relational(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_logical_and(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_equality(c);
+
+	while (node && is_op2(c, '&', '&')) {
+		next_op2(c);
+		node = make_binary(c, '&', node, parse_equality(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_logical_or(struct sw_compiler *c)
+{
+	struct sw_node *node = parse_logical_and(c);
+
+	while (node && is_op2(c, '|', '|')) {
+		next_op2(c);
+		node = make_binary(c, '|', node, parse_logical_and(c));
+	}
+
+	return node;
+}
+
+static struct sw_node *parse_conditional(struct sw_compiler *c)
+{
+	struct sw_type bool_type = make_type(SW_TYPE_BOOL, 1, false);
+	struct sw_type common;
+	struct sw_node *cond = parse_logical_or(c);
+	struct sw_node *a, *b, *node;
+
+	if (!cond || !token_is_ch(c->token, '?'))
+		return cond;
+
+	next_token(c);
+	cond = convert(c, cond, &bool_type, false);
+	a = parse_assignment(c);
+	if (!cond || !a || !expect(c, ":"))
+		return NULL;
+	b = parse_conditional(c);
+	if (!b)
+		return NULL;
+
+	if (types_equal(&a->type, &b->type)) {
+		common = a->type;
+	} else if (!get_common_type(c, &a->type, &b->type, &common)) {
+		return NULL;
+	}
+
+	node = new_node(c, NODE_TERNARY, &common, 3);
+	node->args[0] = cond;
+	node->args[1] = convert(c, a, &common, false);
+	node->args[2] = convert(c, b, &common, false);
+	if (!node->args[1] || !node->args[2])
+		return NULL;
+
+	node->stack_need = node->args[1]->stack_need;
+	if (node->args[2]->stack_need > node->stack_need)
+		node->stack_need = node->args[2]->stack_need;
+	node->stack_need += src_need(cond);
+	return node;
+}
+
+static struct sw_node *parse_assignment(struct sw_compiler *c)
+{
+	struct sw_node *lhs = parse_conditional(c);
+	int op;
+
+	if (!lhs)
+		return NULL;
+
+	if (token_is_ch(c->token, '=') && !token_is_ch(c->token + 1, '=')) {
+		next_token(c);
+		return make_assign(c, '=', lhs, parse_assignment(c));
+	}
+
+	if (is_op2(c, '+', '=') || is_op2(c, '-', '=') ||
+	    is_op2(c, '*', '=') || is_op2(c, '/', '=')) {
+		op = c->token->str.array[0];
+		next_op2(c);
+		return make_assign(c, op, lhs, parse_assignment(c));
+	}
+
+	return lhs;
+}
+
+/* comma expressions are not supported */
+static inline struct sw_node *parse_expr(struct sw_compiler *c)
+{
+	return parse_assignment(c);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline struct sw_stmt *new_stmt(struct sw_compiler *c,
+		enum sw_stmt_type kind)
+{
+	struct sw_stmt *stmt = prog_alloc(c->program, sizeof(struct sw_stmt));
+	stmt->kind = kind;
+	return stmt;
+}
+
+static inline uint32_t stmt_list_need(const struct sw_stmt *stmt)
+{
+	uint32_t need = 0;
+	for (; stmt; stmt = stmt->next)
+		if (stmt->stack_need > need)
+			need = stmt->stack_need;
+	return need;
+}
+
+static inline void max_need(uint32_t *need, uint32_t val)
+{
+	if (val > *need)
+		*need = val;
+}
+
+static uint32_t add_local(struct sw_compiler *c, const struct strref *name,
+		const struct sw_type *type)
+{
+	struct sw_local *local = da_push_back_new(c->locals);
+	local->name   = *name;
+	local->type   = *type;
+	local->offset = c->func->frame_size;
+	local->depth  = c->depth;
+
+	c->func->frame_size += type->size;
+	return local->offset;
+}
+
+static inline void enter_scope(struct sw_compiler *c)
+{
+	c->depth++;
+}
+
+static inline void leave_scope(struct sw_compiler *c)
+{
+	while (c->locals.num &&
+	       c->locals.array[c->locals.num - 1].depth == c->depth)
+		da_pop_back(c->locals);
+	c->depth--;
+}
+
+static bool parse_init_list(struct sw_compiler *c, struct darray *args)
+{
+	if (!expect(c, "{"))
+		return false;
+
+	while (!accept(c, "}")) {
+		if (token_is_ch(c->token, '{')) {
+			if (!parse_init_list(c, args))
+				return false;
+		} else {
+			struct sw_node *arg = parse_assignment(c);
+			if (!arg)
+				return false;
+			darray_push_back(sizeof(struct sw_node*), args, &arg);
+		}
+
+		if (!token_is_ch(c->token, '}') && !expect(c, ","))
+			return false;
+	}
+
+	return true;
+}
+
+static struct sw_stmt *parse_declaration(struct sw_compiler *c)
+{
+	struct sw_stmt *first = NULL, *last = NULL;
+	struct sw_type base_type;
+
+	if (!token_type(c, c->token, &base_type)) {
+		compile_error(c, "unknown type");
+		return NULL;
+	}
+
+	next_token(c);
+
+	do {
+		struct sw_type type = base_type;
+		struct sw_node *init = NULL;
+		struct sw_stmt *stmt;
+		struct strref  name;
+
+		if (c->token->type != CFTOKEN_NAME) {
+			compile_error(c, "expected variable name");
+			return NULL;
+		}
+
+		name = c->token->str;
+		next_token(c);
+
+		if (accept(c, "[")) {
+			if (c->token->type != CFTOKEN_NUM) {
+				compile_error(c, "expected array size");
+				return NULL;
+			}
+
+			type.array_count = (uint32_t)strtol(
+					c->token->str.array, NULL, 10);
+			type_update_size(c->program, &type);
+			next_token(c);
+			if (!expect(c, "]"))
+				return NULL;
+		}
+
+		if (token_is_ch(c->token, '=')) {
+			next_token(c);
+
+			if (token_is_ch(c->token, '{')) {
+				DARRAY(struct sw_node*) args;
+				da_init(args);
+				if (parse_init_list(c, &args.da))
+					init = make_construct(c, &type,
+							&args.da);
+				da_free(args);
+			} else {
+				init = convert(c, parse_assignment(c), &type,
+						false);
+			}
+
+			if (!init)
+				return NULL;
+		}
+
+		stmt = new_stmt(c, STMT_DECL);
+		stmt->expr       = init;
+		stmt->size       = type.size;
+		stmt->offset     = add_local(c, &name, &type);
+		stmt->stack_need = init ? init->stack_need : 0;
+
+		if (last)
+			last->next = stmt;
+		else
+			first = stmt;
+		last = stmt;
+
+	} while (accept(c, ","));
+
+	if (!expect(c, ";"))
+		return NULL;
+
+	if (first == last)
+		return first;
+
+	last = new_stmt(c, STMT_BLOCK);
+	last->body       = first;
+	last->stack_need = stmt_list_need(first);
+	return last;
+}
+
+static inline bool is_declaration(struct sw_compiler *c)
+{
+	struct sw_type type;
+	return token_type(c, c->token, &type) &&
+	       peek_token(c)->type == CFTOKEN_NAME;
+}
+
+static struct sw_stmt *parse_statement(struct sw_compiler *c);
+
+static struct sw_stmt *parse_block(struct sw_compiler *c)
+{
+	struct sw_stmt *block = new_stmt(c, STMT_BLOCK);
+	struct sw_stmt *last  = NULL;
+
+	if (!expect(c, "{"))
+		return NULL;
+
+	enter_scope(c);
+
+	while (!accept(c, "}")) {
+		struct sw_stmt *stmt;
+
+		if (c->token->type == CFTOKEN_NONE) {
+			compile_error(c, "unexpected end of file");
+			return NULL;
+		}
+
+		stmt = parse_statement(c);
+		if (!stmt)
+			return NULL;
+
+		if (last)
+			last->next = stmt;
+		else
+			block->body = stmt;
+		last = stmt;
+	}
+
+	leave_scope(c);
+
+	block->stack_need = stmt_list_need(block->body);
+	return block;
+}
+
+static struct sw_node *parse_condition(struct sw_compiler *c)
+{
+	struct sw_type bool_type = make_type(SW_TYPE_BOOL, 1, false);
+	struct sw_node *cond;
+
+	if (!expect(c, "("))
+		return NULL;
+
+	cond = convert(c, parse_expr(c), &bool_type, false);
+	if (!cond || !expect(c, ")"))
+		return NULL;
+
+	return cond;
+}
+
+static struct sw_stmt *parse_if(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt = new_stmt(c, STMT_IF);
+
+	next_token(c);
+
+	stmt->expr = parse_condition(c);
+	if (!stmt->expr)
+		return NULL;
+
+	stmt->body = parse_statement(c);
+	if (!stmt->body)
+		return NULL;
+
+	if (accept(c, "else")) {
+		stmt->else_body = parse_statement(c);
+		if (!stmt->else_body)
+			return NULL;
+	}
+
+	stmt->stack_need = src_need(stmt->expr);
+	max_need(&stmt->stack_need, stmt->body->stack_need);
+	if (stmt->else_body)
+		max_need(&stmt->stack_need, stmt->else_body->stack_need);
+	return stmt;
+}
+
+static struct sw_stmt *parse_expr_statement(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt = new_stmt(c, STMT_EXPR);
+
+	stmt->expr = parse_expr(c);
+	if (!stmt->expr)
+		return NULL;
+
+	stmt->stack_need = src_need(stmt->expr);
+	return stmt;
+}
+
+static struct sw_stmt *parse_for(struct sw_compiler *c)
+{
+	struct sw_type bool_type = make_type(SW_TYPE_BOOL, 1, false);
+	struct sw_stmt *stmt     = new_stmt(c, STMT_FOR);
+
+	next_token(c);
+	if (!expect(c, "("))
+		return NULL;
+
+	enter_scope(c);
+
+	if (is_declaration(c)) {
+		stmt->init = parse_declaration(c);
+		if (!stmt->init)
+			return NULL;
+	} else if (!accept(c, ";")) {
+		stmt->init = parse_expr_statement(c);
+		if (!stmt->init || !expect(c, ";"))
+			return NULL;
+	}
+
+	if (!accept(c, ";")) {
+		stmt->expr = convert(c, parse_expr(c), &bool_type, false);
+		if (!stmt->expr || !expect(c, ";"))
+			return NULL;
+	}
+
+	if (!accept(c, ")")) {
+		stmt->post = parse_expr(c);
+		if (!stmt->post || !expect(c, ")"))
+			return NULL;
+	}
+
+	stmt->body = parse_statement(c);
+	if (!stmt->body)
+		return NULL;
+
+	leave_scope(c);
+
+	if (stmt->init)
+		max_need(&stmt->stack_need, stmt->init->stack_need);
+	if (stmt->expr)
+		max_need(&stmt->stack_need, src_need(stmt->expr));
+	if (stmt->post)
+		max_need(&stmt->stack_need, src_need(stmt->post));
+	max_need(&stmt->stack_need, stmt->body->stack_need);
+	return stmt;
+}
+
+static struct sw_stmt *parse_while(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt = new_stmt(c, STMT_FOR);
+
+	next_token(c);
+
+	stmt->expr = parse_condition(c);
+	if (!stmt->expr)
+		return NULL;
+
+	stmt->body = parse_statement(c);
+	if (!stmt->body)
+		return NULL;
+
+	stmt->stack_need = src_need(stmt->expr);
+	max_need(&stmt->stack_need, stmt->body->stack_need);
+	return stmt;
+}
+
+static struct sw_stmt *parse_do(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt = new_stmt(c, STMT_DO);
+
+	next_token(c);
+
+	stmt->body = parse_statement(c);
+	if (!stmt->body || !expect(c, "while"))
+		return NULL;
+
+	stmt->expr = parse_condition(c);
+	if (!stmt->expr || !expect(c, ";"))
+		return NULL;
+
+	stmt->stack_need = src_need(stmt->expr);
+	max_need(&stmt->stack_need, stmt->body->stack_need);
+	return stmt;
+}
+
+static struct sw_stmt *parse_return(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt = new_stmt(c, STMT_RETURN);
+
+	next_token(c);
+
+	if (!token_is_ch(c->token, ';')) {
+		stmt->expr = convert(c, parse_expr(c), &c->func->ret, false);
+		if (!stmt->expr)
+			return NULL;
+
+		stmt->stack_need = stmt->expr->stack_need;
+	}
+
+	if (!expect(c, ";"))
+		return NULL;
+
+	return stmt;
+}
+
+static struct sw_stmt *parse_statement(struct sw_compiler *c)
+{
+	struct sw_stmt *stmt;
+
+	/* skip attributes such as [unroll] or [branch] */
+	while (token_is_ch(c->token, '[')) {
+		while (c->token->type != CFTOKEN_NONE &&
+		       !token_is_ch(c->token, ']'))
+			next_token(c);
+		next_token(c);
+	}
+
+	while (token_is(c->token, "const") || token_is(c->token, "static") ||
+	       token_is(c->token, "precise"))
+		next_token(c);
+
+	if (token_is_ch(c->token, '{'))
+		return parse_block(c);
+	if (token_is(c->token, "if"))
+		return parse_if(c);
+	if (token_is(c->token, "for"))
+		return parse_for(c);
+	if (token_is(c->token, "while"))
+		return parse_while(c);
+	if (token_is(c->token, "do"))
+		return parse_do(c);
+	if (token_is(c->token, "return"))
+		return parse_return(c);
+
+	if (token_is(c->token, "break") || token_is(c->token, "continue") ||
+	    token_is(c->token, "discard")) {
+		enum sw_stmt_type kind = token_is(c->token, "break") ?
+			STMT_BREAK : token_is(c->token, "continue") ?
+			STMT_CONTINUE : STMT_DISCARD;
+
+		stmt = new_stmt(c, kind);
+		next_token(c);
+		return expect(c, ";") ? stmt : NULL;
+	}
+
+	if (accept(c, ";"))
+		return new_stmt(c, STMT_BLOCK);
+
+	if (is_declaration(c))
+		return parse_declaration(c);
+
+	stmt = parse_expr_statement(c);
+	if (!stmt || !expect(c, ";"))
+		return NULL;
+
+	return stmt;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool compile_structs(struct sw_compiler *c, struct shader_parser *sp)
+{
+	for (size_t i = 0; i < sp->structs.num; i++) {
+		struct shader_struct *src = sp->structs.array+i;
+		struct sw_struct     *st;
+
+		st = da_push_back_new(c->program->structs);
+		st->name = bstrdup(src->name);
+
+		for (size_t j = 0; j < src->vars.num; j++) {
+			struct shader_var *var = src->vars.array+j;
+			struct sw_member  *member;
+
+			member = da_push_back_new(st->members);
+			member->name   = bstrdup(var->name);
+			member->offset = st->size;
+
+			if (!get_type_str(c->program, var->type,
+						var->array_count,
+						&member->type)) {
+				compile_error(c, "unknown type '%s'",
+						var->type);
+				return false;
+			}
+
+			parse_semantic(var->mapping, false, &member->semantic,
+					&member->index);
+			st->size += member->type.size;
+		}
+	}
+
+	return true;
+}
+
+static bool compile_globals(struct sw_compiler *c, struct shader_parser *sp)
+{
+	struct sw_program *program = c->program;
+
+	for (size_t i = 0; i < sp->params.num; i++) {
+		struct shader_var *var = sp->params.array+i;
+		struct sw_global  *global = da_push_back_new(program->globals);
+
+		global->name   = bstrdup(var->name);
+		global->offset = program->globals_size;
+
+		if (!get_type_str(program, var->type, var->array_count,
+					&global->type)) {
+			compile_error(c, "unknown type '%s'", var->type);
+			return false;
+		}
+
+		program->globals_size += global->type.size;
+	}
+
+	for (size_t i = 0; i < sp->samplers.num; i++) {
+		char *name = bstrdup(sp->samplers.array[i].name);
+		da_push_back(program->samplers, &name);
+	}
+
+	return true;
+}
+
+static bool compile_func(struct sw_compiler *c, struct shader_func *src)
+{
+	struct sw_func *func = bzalloc(sizeof(struct sw_func));
+	da_push_back(c->program->funcs, &func);
+
+	func->name = bstrdup(src->name);
+	c->func = func;
+
+	if (!get_type_str(c->program, src->return_type, 0, &func->ret)) {
+		compile_error(c, "unknown type '%s'", src->return_type);
+		return false;
+	}
+
+	enter_scope(c);
+
+	for (size_t i = 0; i < src->params.num; i++) {
+		struct shader_var *var = src->params.array+i;
+		struct sw_type    type;
+		struct strref     name;
+		uint32_t          offset;
+
+		if (!get_type_str(c->program, var->type, var->array_count,
+					&type)) {
+			compile_error(c, "unknown type '%s'", var->type);
+			return false;
+		}
+
+		strref_set(&name, var->name, strlen(var->name));
+		offset = add_local(c, &name, &type);
+
+		da_push_back(func->param_types, &type);
+		da_push_back(func->param_offsets, &offset);
+	}
+
+	c->token = src->start;
+	func->body = parse_block(c);
+
+	leave_scope(c);
+
+	if (!func->body)
+		return false;
+
+	func->stack_need = func->body->stack_need;
+	return true;
+}
+
+static bool compile_main(struct sw_compiler *c, struct shader_parser *sp)
+{
+	struct sw_program  *program = c->program;
+	struct shader_func *src     = shader_parser_getfunc(sp, "main");
+	struct sw_func     *main_func;
+
+	if (!src) {
+		compile_error(c, "shader has no main function");
+		return false;
+	}
+
+	main_func = find_func(c, &(struct strref){"main", 4}, src->params.num);
+	if (!main_func)
+		return false;
+
+	program->main = main_func;
+
+	for (size_t i = 0; i < src->params.num; i++) {
+		struct shader_var *var = src->params.array+i;
+		add_varyings(program, &program->inputs,
+				main_func->param_types.array+i, var->mapping,
+				main_func->param_offsets.array[i], false);
+		program->inputs.size += main_func->param_types.array[i].size;
+	}
+
+	add_varyings(program, &program->outputs, &main_func->ret,
+			src->mapping, 0, c->shader->type == GS_SHADER_PIXEL);
+	program->outputs.size = main_func->ret.size;
+
+	program->stack_size = main_func->frame_size + main_func->stack_need;
+	return true;
+}
+
+static inline void sw_func_destroy(struct sw_func *func)
+{
+	bfree(func->name);
+	da_free(func->param_types);
+	da_free(func->param_offsets);
+	bfree(func);
+}
+
+void sw_program_destroy(struct sw_program *program)
+{
+	size_t i, j;
+
+	if (!program)
+		return;
+
+	for (i = 0; i < program->structs.num; i++) {
+		struct sw_struct *st = program->structs.array+i;
+		for (j = 0; j < st->members.num; j++)
+			bfree(st->members.array[j].name);
+		da_free(st->members);
+		bfree(st->name);
+	}
+	for (i = 0; i < program->globals.num; i++)
+		bfree(program->globals.array[i].name);
+	for (i = 0; i < program->samplers.num; i++)
+		bfree(program->samplers.array[i]);
+	for (i = 0; i < program->funcs.num; i++)
+		sw_func_destroy(program->funcs.array[i]);
+	for (i = 0; i < program->allocs.num; i++)
+		bfree(program->allocs.array[i]);
+
+	da_free(program->structs);
+	da_free(program->globals);
+	da_free(program->samplers);
+	da_free(program->funcs);
+	da_free(program->allocs);
+	da_free(program->inputs.vars);
+	da_free(program->outputs.vars);
+	bfree(program);
+}
+
+struct sw_program *sw_program_create(gs_shader_t *shader,
+		struct shader_parser *sp, const char *file,
+		char **error_string)
+{
+	struct sw_compiler c = {0};
+	bool success = true;
+
+	c.program = bzalloc(sizeof(struct sw_program));
+	c.shader  = shader;
+	c.file    = file;
+
+	success = compile_structs(&c, sp) && compile_globals(&c, sp);
+
+	for (size_t i = 0; success && i < sp->funcs.num; i++)
+		success = compile_func(&c, sp->funcs.array+i);
+
+	if (success)
+		success = compile_main(&c, sp);
+
+	da_free(c.locals);
+
+	if (!success) {
+		blog(LOG_DEBUG, "Software shader compile errors:\n%s",
+				c.errors.array);
+		if (error_string)
+			*error_string = bstrdup(c.errors.array);
+
+		sw_program_destroy(c.program);
+		c.program = NULL;
+	}
+
+	dstr_free(&c.errors);
+	return c.program;
+}
+
+const struct sw_io *sw_program_inputs(const struct sw_program *program)
+{
+	return &program->inputs;
+}
+
+const struct sw_io *sw_program_outputs(const struct sw_program *program)
+{
+	return &program->outputs;
+}
+
+/* ========================================================================= */
+/* Evaluation                                                                */
+
+enum sw_flow {
+	FLOW_NORMAL,
+	FLOW_BREAK,
+	FLOW_CONTINUE,
+	FLOW_RETURN
+};
+
+static void eval(struct sw_exec *ex, const struct sw_node *node, float *out);
+static enum sw_flow exec_stmt(struct sw_exec *ex, const struct sw_stmt *stmt);
+
+static inline float *stack_push(struct sw_exec *ex, uint32_t size)
+{
+	float *ptr = ex->stack + ex->sp;
+	ex->sp += size;
+	assert(ex->sp <= ex->stack_capacity);
+	return ptr;
+}
+
+static inline int clamp_index(float val, uint32_t count)
+{
+	int idx = (int)val;
+	if (idx < 0)
+		return 0;
+	if ((uint32_t)idx >= count)
+		return (int)count - 1;
+	return idx;
+}
+
+static float *eval_ref(struct sw_exec *ex, const struct sw_node *node);
+
+/* returns the value of a node, either directly from the variable it refers
+ * to, or from a temporary on the stack */
+static inline const float *eval_src(struct sw_exec *ex,
+		const struct sw_node *node)
+{
+	float *tmp;
+
+	if (node->addressable)
+		return eval_ref(ex, node);
+
+	tmp = stack_push(ex, node->type.size);
+	eval(ex, node, tmp);
+	return tmp;
+}
+
+static float *eval_ref(struct sw_exec *ex, const struct sw_node *node)
+{
+	uint32_t sp;
+	float    *base;
+	int      idx;
+
+	switch (node->kind) {
+	case NODE_LOCAL:
+		return ex->frame + node->offset;
+	case NODE_GLOBAL:
+		return ex->globals + node->offset;
+	case NODE_MEMBER:
+		return eval_ref(ex, node->args[0]) + node->offset;
+	case NODE_INDEX:
+		base = eval_ref(ex, node->args[0]);
+		sp   = ex->sp;
+		idx  = clamp_index(eval_src(ex, node->args[1])[0],
+				node->count);
+		ex->sp = sp;
+		return base + idx * node->offset;
+	default:
+		break;
+	}
+
+	assert(false);
+	return NULL;
+}
+
+static void store(struct sw_exec *ex, const struct sw_node *lhs,
+		const float *val)
+{
+	if (lhs->kind == NODE_SWIZZLE) {
+		float *dst = eval_ref(ex, lhs->args[0]);
+		for (uint32_t i = 0; i < lhs->count; i++)
+			dst[lhs->swizzle[i]] = val[i];
+	} else {
+		memcpy(eval_ref(ex, lhs), val, lhs->type.size * sizeof(float));
+	}
+}
+
+static inline float convert_val(enum sw_base_type base, float val)
+{
+	if (base == SW_TYPE_INT)
+		return truncf(val);
+	if (base == SW_TYPE_BOOL)
+		return val != 0.0f ? 1.0f : 0.0f;
+	return val;
+}
+
+static void eval_convert(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const struct sw_type *from = &node->args[0]->type;
+	const struct sw_type *to   = &node->type;
+	const float          *src  = eval_src(ex, node->args[0]);
+
+	if (from->size == 1) {
+		float val = convert_val(to->base, src[0]);
+		for (uint32_t i = 0; i < to->size; i++)
+			out[i] = val;
+
+	} else if (from->matrix && to->matrix) {
+		for (uint32_t r = 0; r < to->dim; r++)
+			for (uint32_t c = 0; c < to->dim; c++)
+				out[r * to->dim + c] = convert_val(to->base,
+						src[r * from->dim + c]);
+
+	} else {
+		for (uint32_t i = 0; i < to->size; i++)
+			out[i] = convert_val(to->base, src[i]);
+	}
+}
+
+static void eval_construct(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	uint32_t pos = 0;
+
+	for (size_t i = 0; i < node->num_args; i++) {
+		const struct sw_node *arg = node->args[i];
+		uint32_t sp = ex->sp;
+
+		memcpy(out + pos, eval_src(ex, arg),
+				arg->type.size * sizeof(float));
+		pos += arg->type.size;
+		ex->sp = sp;
+	}
+
+	if (node->type.base == SW_TYPE_INT || node->type.base == SW_TYPE_BOOL)
+		for (uint32_t i = 0; i < node->type.size; i++)
+			out[i] = convert_val(node->type.base, out[i]);
+}
+
+static inline float binary_op(int op, enum sw_base_type base, float a,
+		float b)
+{
+	switch (op) {
+	case '+': return a + b;
+	case '-': return a - b;
+	case '*': return a * b;
+	case '/':
+		if (base == SW_TYPE_INT)
+			return b != 0.0f ? truncf(a / b) : 0.0f;
+		return a / b;
+	case '%': return b != 0.0f ? fmodf(a, b) : 0.0f;
+	case '<': return a <  b ? 1.0f : 0.0f;
+	case '>': return a >  b ? 1.0f : 0.0f;
+	case 'l': return a <= b ? 1.0f : 0.0f;
+	case 'g': return a >= b ? 1.0f : 0.0f;
+	case 'e': return a == b ? 1.0f : 0.0f;
+	case 'n': return a != b ? 1.0f : 0.0f;
+	case '&': return (a != 0.0f && b != 0.0f) ? 1.0f : 0.0f;
+	case '|': return (a != 0.0f || b != 0.0f) ? 1.0f : 0.0f;
+	}
+
+	return 0.0f;
+}
+
+static void eval_binary(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const struct sw_node *lhs  = node->args[0];
+	const float          *a    = eval_src(ex, lhs);
+	const float          *b    = eval_src(ex, node->args[1]);
+	enum sw_base_type    base  = lhs->type.base;
+	uint32_t             size  = lhs->type.size;
+
+	switch (node->op) {
+	case '+':
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = a[i] + b[i];
+		break;
+	case '-':
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = a[i] - b[i];
+		break;
+	case '*':
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = a[i] * b[i];
+		break;
+	default:
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = binary_op(node->op, base, a[i], b[i]);
+	}
+}
+
+static void eval_assign(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const struct sw_node *lhs  = node->args[0];
+	uint32_t             size  = lhs->type.size;
+	float                *val  = stack_push(ex, size);
+
+	eval(ex, node->args[1], val);
+
+	if (node->op != '=') {
+		uint32_t sp  = ex->sp;
+		float    *cur = stack_push(ex, size);
+
+		eval(ex, lhs, cur);
+		for (uint32_t i = 0; i < size; i++)
+			val[i] = convert_val(lhs->type.base, binary_op(
+					node->op, lhs->type.base,
+					cur[i], val[i]));
+		ex->sp = sp;
+	}
+
+	store(ex, lhs, val);
+	memcpy(out, val, size * sizeof(float));
+}
+
+static void eval_incdec(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const struct sw_node *lhs   = node->args[0];
+	uint32_t             size   = lhs->type.size;
+	float                *val   = stack_push(ex, size);
+	float                delta  = node->op == '+' ? 1.0f : -1.0f;
+
+	eval(ex, lhs, val);
+	if (!node->prefix)
+		memcpy(out, val, size * sizeof(float));
+
+	for (uint32_t i = 0; i < size; i++)
+		val[i] += delta;
+	store(ex, lhs, val);
+
+	if (node->prefix)
+		memcpy(out, val, size * sizeof(float));
+}
+
+static void eval_call(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const struct sw_func *func = node->func;
+	float *frame = stack_push(ex, func->frame_size);
+	float *prev_frame;
+	float *prev_ret;
+
+	memset(frame, 0, func->frame_size * sizeof(float));
+
+	for (size_t i = 0; i < node->num_args; i++)
+		eval(ex, node->args[i], frame + func->param_offsets.array[i]);
+
+	prev_frame = ex->frame;
+	prev_ret   = ex->ret;
+	ex->frame  = frame;
+	ex->ret    = out;
+
+	memset(out, 0, func->ret.size * sizeof(float));
+	exec_stmt(ex, func->body);
+
+	ex->frame  = prev_frame;
+	ex->ret    = prev_ret;
+}
+
+static inline float saturate(float val)
+{
+	return val < 0.0f ? 0.0f : (val > 1.0f ? 1.0f : val);
+}
+
+static inline float componentwise(int id, float a, float b, float c)
+{
+	switch (id) {
+	case INTR_ABS:        return fabsf(a);
+	case INTR_ACOS:       return acosf(a);
+	case INTR_ASIN:       return asinf(a);
+	case INTR_ATAN:       return atanf(a);
+	case INTR_ATAN2:      return atan2f(a, b);
+	case INTR_CEIL:       return ceilf(a);
+	case INTR_CLAMP:      return a < b ? b : (a > c ? c : a);
+	case INTR_COS:        return cosf(a);
+	case INTR_DEGREES:    return a * (180.0f / 3.14159265358979f);
+	case INTR_EXP:        return expf(a);
+	case INTR_EXP2:       return exp2f(a);
+	case INTR_FLOOR:      return floorf(a);
+	case INTR_FMOD:       return b != 0.0f ? fmodf(a, b) : 0.0f;
+	case INTR_FRAC:       return a - floorf(a);
+	case INTR_LERP:       return a + (b - a) * c;
+	case INTR_LOG:        return logf(a);
+	case INTR_LOG2:       return log2f(a);
+	case INTR_LOG10:      return log10f(a);
+	case INTR_MAD:        return a * b + c;
+	case INTR_MAX:        return a > b ? a : b;
+	case INTR_MIN:        return a < b ? a : b;
+	case INTR_POW:        return powf(a, b);
+	case INTR_RADIANS:    return a * (3.14159265358979f / 180.0f);
+	case INTR_ROUND:      return roundf(a);
+	case INTR_RSQRT:      return 1.0f / sqrtf(a);
+	case INTR_SATURATE:   return saturate(a);
+	case INTR_SIGN:       return a > 0.0f ? 1.0f : a < 0.0f ? -1.0f : 0.0f;
+	case INTR_SIN:        return sinf(a);
+	case INTR_SMOOTHSTEP: {
+		float t = b != a ? saturate((c - a) / (b - a)) : 0.0f;
+		return t * t * (3.0f - 2.0f * t);
+	}
+	case INTR_SQRT:       return sqrtf(a);
+	case INTR_STEP:       return b >= a ? 1.0f : 0.0f;
+	case INTR_TAN:        return tanf(a);
+	case INTR_TRUNC:      return truncf(a);
+	case INTR_DDX:
+	case INTR_DDY:        return 0.0f;
+	}
+
+	return 0.0f;
+}
+
+static inline float dot_n(const float *a, const float *b, uint32_t n)
+{
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+static void eval_intrinsic(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	const float *args[3] = {NULL, NULL, NULL};
+	uint32_t    size     = node->type.size;
+	uint32_t    dim;
+	float       len;
+
+	for (size_t i = 0; i < node->num_args; i++)
+		args[i] = eval_src(ex, node->args[i]);
+
+	if (node->op <= INTR_LAST_COMPONENTWISE) {
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = componentwise(node->op,
+					args[0][i],
+					args[1] ? args[1][i] : 0.0f,
+					args[2] ? args[2][i] : 0.0f);
+		return;
+	}
+
+	dim = node->args[0]->type.dim;
+
+	switch (node->op) {
+	case INTR_DOT:
+		out[0] = dot_n(args[0], args[1], dim);
+		break;
+
+	case INTR_LENGTH:
+		out[0] = sqrtf(dot_n(args[0], args[0], dim));
+		break;
+
+	case INTR_DISTANCE:
+		len = 0.0f;
+		for (uint32_t i = 0; i < dim; i++) {
+			float d = args[0][i] - args[1][i];
+			len += d * d;
+		}
+		out[0] = sqrtf(len);
+		break;
+
+	case INTR_NORMALIZE:
+		len = sqrtf(dot_n(args[0], args[0], dim));
+		for (uint32_t i = 0; i < dim; i++)
+			out[i] = len > 0.0f ? args[0][i] / len : 0.0f;
+		break;
+
+	case INTR_CROSS:
+		out[0] = args[0][1] * args[1][2] - args[0][2] * args[1][1];
+		out[1] = args[0][2] * args[1][0] - args[0][0] * args[1][2];
+		out[2] = args[0][0] * args[1][1] - args[0][1] * args[1][0];
+		break;
+
+	case INTR_ANY:
+	case INTR_ALL:
+		out[0] = node->op == INTR_ALL ? 1.0f : 0.0f;
+		for (uint32_t i = 0; i < dim; i++) {
+			bool set = args[0][i] != 0.0f;
+			if (node->op == INTR_ANY && set)
+				out[0] = 1.0f;
+			else if (node->op == INTR_ALL && !set)
+				out[0] = 0.0f;
+		}
+		break;
+
+	case INTR_CLIP:
+		for (uint32_t i = 0; i < dim; i++)
+			if (args[0][i] < 0.0f)
+				ex->discarded = true;
+		break;
+
+	case INTR_TRANSPOSE:
+		for (uint32_t r = 0; r < dim; r++)
+			for (uint32_t c = 0; c < dim; c++)
+				out[c * dim + r] = args[0][r * dim + c];
+		break;
+
+	case INTR_MUL_VM:
+		for (uint32_t c = 0; c < dim; c++) {
+			float sum = 0.0f;
+			for (uint32_t r = 0; r < dim; r++)
+				sum += args[0][r] * args[1][r * dim + c];
+			out[c] = sum;
+		}
+		break;
+
+	case INTR_MUL_MV:
+		for (uint32_t r = 0; r < dim; r++)
+			out[r] = dot_n(args[0] + r * dim, args[1], dim);
+		break;
+
+	case INTR_MUL_MM:
+		for (uint32_t r = 0; r < dim; r++) {
+			for (uint32_t c = 0; c < dim; c++) {
+				float sum = 0.0f;
+				for (uint32_t k = 0; k < dim; k++)
+					sum += args[0][r * dim + k] *
+					       args[1][k * dim + c];
+				out[r * dim + c] = sum;
+			}
+		}
+		break;
+	}
+}
+
+static void eval_sample(struct sw_exec *ex, const struct sw_node *node,
+		float *out)
+{
+	gs_shader_t       *shader = ex->shader;
+	gs_device_t       *device = shader->device;
+	gs_samplerstate_t *ss     = NULL;
+	gs_texture_t      *tex;
+	const float       *coord;
+	int               tex_idx;
+
+	tex_idx = (int)eval_src(ex, node->args[0])[0];
+	coord   = eval_src(ex, node->args[2]);
+	tex     = shader->params.array[tex_idx].texture;
+
+	if (!tex) {
+		memset(out, 0, sizeof(float) * 4);
+		return;
+	}
+
+	if (node->op == SAMPLE_LOAD) {
+		sw_texture_load(tex, (int)coord[0], (int)coord[1], out);
+		return;
+	}
+
+	{
+		uint32_t idx = (uint32_t)eval_src(ex, node->args[1])[0];
+
+		if (shader->type == GS_SHADER_PIXEL && idx < GS_MAX_TEXTURES)
+			ss = device->cur_samplers[idx];
+		if (!ss && idx < shader->samplers.num)
+			ss = shader->samplers.array[idx];
+	}
+
+	sw_texture_sample(tex, ss, coord, out);
+}
+
+static void eval(struct sw_exec *ex, const struct sw_node *node, float *out)
+{
+	uint32_t    sp   = ex->sp;
+	uint32_t    size = node->type.size;
+	const float *src;
+
+	switch (node->kind) {
+	case NODE_CONST:
+		memcpy(out, node->values, size * sizeof(float));
+		break;
+
+	case NODE_LOCAL:
+	case NODE_GLOBAL:
+		if (!node->addressable)
+			out[0] = (float)node->offset;
+		else
+			memcpy(out, eval_ref(ex, node), size * sizeof(float));
+		break;
+
+	case NODE_SAMPLER:
+		out[0] = (float)node->offset;
+		break;
+
+	case NODE_MEMBER:
+		if (node->addressable) {
+			memcpy(out, eval_ref(ex, node), size * sizeof(float));
+		} else {
+			src = eval_src(ex, node->args[0]);
+			memcpy(out, src + node->offset, size * sizeof(float));
+		}
+		break;
+
+	case NODE_INDEX:
+		if (node->addressable) {
+			memcpy(out, eval_ref(ex, node), size * sizeof(float));
+		} else {
+			int idx;
+			src = eval_src(ex, node->args[0]);
+			idx = clamp_index(eval_src(ex, node->args[1])[0],
+					node->count);
+			memcpy(out, src + idx * node->offset,
+					size * sizeof(float));
+		}
+		break;
+
+	case NODE_SWIZZLE:
+		src = eval_src(ex, node->args[0]);
+		for (uint32_t i = 0; i < node->count; i++)
+			out[i] = src[node->swizzle[i]];
+		break;
+
+	case NODE_CONVERT:
+		eval_convert(ex, node, out);
+		break;
+
+	case NODE_CONSTRUCT:
+		eval_construct(ex, node, out);
+		break;
+
+	case NODE_UNARY:
+		src = eval_src(ex, node->args[0]);
+		for (uint32_t i = 0; i < size; i++)
+			out[i] = node->op == '-' ? -src[i] :
+				(src[i] == 0.0f ? 1.0f : 0.0f);
+		break;
+
+	case NODE_BINARY:
+		eval_binary(ex, node, out);
+		break;
+
+	case NODE_ASSIGN:
+		eval_assign(ex, node, out);
+		break;
+
+	case NODE_INCDEC:
+		eval_incdec(ex, node, out);
+		break;
+
+	case NODE_TERNARY:
+		src = eval_src(ex, node->args[0]);
+		eval(ex, node->args[src[0] != 0.0f ? 1 : 2], out);
+		break;
+
+	case NODE_CALL:
+		eval_call(ex, node, out);
+		break;
+
+	case NODE_INTRINSIC:
+		eval_intrinsic(ex, node, out);
+		break;
+
+	case NODE_SAMPLE:
+		eval_sample(ex, node, out);
+		break;
+	}
+
+	ex->sp = sp;
+}
+
+static inline bool eval_cond(struct sw_exec *ex, const struct sw_node *node)
+{
+	uint32_t sp  = ex->sp;
+	bool     val = eval_src(ex, node)[0] != 0.0f;
+
+	ex->sp = sp;
+	return val;
+}
+
+static inline void eval_discard(struct sw_exec *ex,
+		const struct sw_node *node)
+{
+	uint32_t sp = ex->sp;
+	eval_src(ex, node);
+	ex->sp = sp;
+}
+
+static enum sw_flow exec_loop(struct sw_exec *ex, const struct sw_stmt *stmt)
+{
+	if (stmt->init)
+		exec_stmt(ex, stmt->init);
+
+	for (int i = 0; i < MAX_LOOP_ITERATIONS; i++) {
+		enum sw_flow flow;
+
+		if (stmt->kind == STMT_FOR && stmt->expr &&
+		    !eval_cond(ex, stmt->expr))
+			break;
+
+		flow = exec_stmt(ex, stmt->body);
+		if (flow == FLOW_BREAK)
+			break;
+		if (flow == FLOW_RETURN)
+			return FLOW_RETURN;
+
+		if (stmt->post)
+			eval_discard(ex, stmt->post);
+
+		if (stmt->kind == STMT_DO && !eval_cond(ex, stmt->expr))
+			break;
+	}
+
+	return FLOW_NORMAL;
+}
+
+static enum sw_flow exec_single(struct sw_exec *ex,
+		const struct sw_stmt *stmt)
+{
+	switch (stmt->kind) {
+	case STMT_BLOCK:
+		return exec_stmt(ex, stmt->body);
+
+	case STMT_EXPR:
+		eval_discard(ex, stmt->expr);
+		break;
+
+	case STMT_DECL:
+		if (stmt->expr)
+			eval(ex, stmt->expr, ex->frame + stmt->offset);
+		else
+			memset(ex->frame + stmt->offset, 0,
+					stmt->size * sizeof(float));
+		break;
+
+	case STMT_IF:
+		if (eval_cond(ex, stmt->expr))
+			return exec_stmt(ex, stmt->body);
+		else if (stmt->else_body)
+			return exec_stmt(ex, stmt->else_body);
+		break;
+
+	case STMT_FOR:
+	case STMT_DO:
+		return exec_loop(ex, stmt);
+
+	case STMT_RETURN:
+		if (stmt->expr)
+			eval(ex, stmt->expr, ex->ret);
+		return FLOW_RETURN;
+
+	case STMT_BREAK:
+		return FLOW_BREAK;
+
+	case STMT_CONTINUE:
+		return FLOW_CONTINUE;
+
+	case STMT_DISCARD:
+		ex->discarded = true;
+		return FLOW_RETURN;
+	}
+
+	return FLOW_NORMAL;
+}
+
+static enum sw_flow exec_stmt(struct sw_exec *ex, const struct sw_stmt *stmt)
+{
+	for (; stmt; stmt = stmt->next) {
+		enum sw_flow flow = exec_single(ex, stmt);
+		if (flow != FLOW_NORMAL)
+			return flow;
+		if (ex->discarded)
+			return FLOW_RETURN;
+	}
+
+	return FLOW_NORMAL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct sw_exec *sw_exec_create(void)
+{
+	return bzalloc(sizeof(struct sw_exec));
+}
+
+void sw_exec_destroy(struct sw_exec *ex)
+{
+	if (ex) {
+		bfree(ex->stack);
+		bfree(ex->globals);
+		bfree(ex);
+	}
+}
+
+static void load_global(struct sw_exec *ex, const struct sw_global *global,
+		const struct gs_shader_param *param)
+{
+	const struct sw_type *type  = &global->type;
+	float                *dst   = ex->globals + global->offset;
+	size_t               count  = param->cur_value.num / sizeof(float);
+	size_t               elem   = type->matrix ? type->dim * type->dim : 1;
+
+	if (count > type->size)
+		count = type->size;
+
+	if (type->base == SW_TYPE_INT || type->base == SW_TYPE_BOOL) {
+		const int *src = (const int*)param->cur_value.array;
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (float)src[i];
+	} else {
+		memcpy(dst, param->cur_value.array, count * sizeof(float));
+	}
+
+	memset(dst + count, 0, (type->size - count) * sizeof(float));
+
+	/* matrices are uploaded column-major, as with the other backends */
+	if (type->matrix) {
+		for (size_t base = 0; base + elem <= type->size; base += elem) {
+			float *m = dst + base;
+			for (uint32_t r = 0; r < type->dim; r++) {
+				for (uint32_t c = r + 1; c < type->dim; c++) {
+					float tmp = m[r * type->dim + c];
+					m[r * type->dim + c] =
+						m[c * type->dim + r];
+					m[c * type->dim + r] = tmp;
+				}
+			}
+		}
+	}
+}
+
+void sw_exec_begin(struct sw_exec *ex, gs_shader_t *shader)
+{
+	const struct sw_program *program = shader->program;
+
+	ex->shader  = shader;
+	ex->program = program;
+
+	if (program->stack_size > ex->stack_capacity) {
+		ex->stack = brealloc(ex->stack,
+				program->stack_size * sizeof(float));
+		ex->stack_capacity = program->stack_size;
+	}
+
+	if (program->globals_size > ex->globals_capacity) {
+		ex->globals = brealloc(ex->globals,
+				program->globals_size * sizeof(float));
+		ex->globals_capacity = program->globals_size;
+	}
+
+	for (size_t i = 0; i < program->globals.num; i++) {
+		const struct sw_global *global = program->globals.array+i;
+		if (global->type.base != SW_TYPE_TEXTURE)
+			load_global(ex, global, shader->params.array+i);
+	}
+}
+
+bool sw_exec_run(struct sw_exec *ex, const float *inputs, float *outputs)
+{
+	const struct sw_program *program = ex->program;
+	const struct sw_func    *main_func = program->main;
+
+	ex->sp        = main_func->frame_size;
+	ex->frame     = ex->stack;
+	ex->ret       = outputs;
+	ex->discarded = false;
+
+	memcpy(ex->frame, inputs, program->inputs.size * sizeof(float));
+	memset(ex->frame + program->inputs.size, 0,
+			(main_func->frame_size - program->inputs.size) *
+			sizeof(float));
+	memset(outputs, 0, program->outputs.size * sizeof(float));
+
+	exec_stmt(ex, main_func->body);
+	return !ex->discarded;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/shader-parser.h>
+
+/*
+ * Shader interpreter
+ *
+ *   Compiles the HLSL-style shader text produced by the effect parser into an
+ * expression tree once, when the shader is created, and then evaluates that
+ * tree for each vertex/pixel.  All values are stored as floats: vectors and
+ * matrices are laid out as consecutive components (matrices row by row),
+ * structures as their consecutive members.
+ *
+ *   The inputs of the shader's main function and its return value are
+ * described as a list of varyings with their semantics, which is what the
+ * rasterizer uses to connect vertex buffers, vertex shader outputs and pixel
+ * shader inputs.
+ */
+
+enum sw_semantic {
+	SW_SEMANTIC_OTHER,
+	SW_SEMANTIC_POSITION,
+	SW_SEMANTIC_NORMAL,
+	SW_SEMANTIC_TANGENT,
+	SW_SEMANTIC_COLOR,
+	SW_SEMANTIC_TEXCOORD,
+	SW_SEMANTIC_TARGET
+};
+
+struct sw_varying {
+	enum sw_semantic semantic;
+	uint32_t         index;
+	uint32_t         offset;
+	uint32_t         size;
+};
+
+struct sw_io {
+	DARRAY(struct sw_varying) vars;
+	uint32_t                  size;
+};
+
+struct sw_program;
+struct sw_exec;
+
+extern struct sw_program *sw_program_create(gs_shader_t *shader,
+		struct shader_parser *sp, const char *file,
+		char **error_string);
+extern void sw_program_destroy(struct sw_program *program);
+
+extern const struct sw_io *sw_program_inputs(const struct sw_program *program);
+extern const struct sw_io *sw_program_outputs(
+		const struct sw_program *program);
+
+static inline const struct sw_varying *sw_io_find(const struct sw_io *io,
+		enum sw_semantic semantic, uint32_t index)
+{
+	for (size_t i = 0; i < io->vars.num; i++) {
+		const struct sw_varying *var = io->vars.array+i;
+		if (var->semantic == semantic && var->index == index)
+			return var;
+	}
+
+	return NULL;
+}
+
+extern struct sw_exec *sw_exec_create(void);
+extern void sw_exec_destroy(struct sw_exec *ex);
+
+/* snapshots the current parameter values of the shader; must be called
+ * before sw_exec_run whenever the shader or its parameters change */
+extern void sw_exec_begin(struct sw_exec *ex, gs_shader_t *shader);
+
+/* returns false if the invocation was discarded */
+extern bool sw_exec_run(struct sw_exec *ex, const float *inputs,
+		float *outputs);
@@ -0,0 +1,787 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "sw-subsystem.h"
+#include "sw-interp.h"
+
+/* vertex positions are snapped to 1/256th of a pixel, and edge functions are
+ * evaluated exactly in integer math so adjacent triangles never overlap or
+ * leave gaps */
+#define SUBPIXEL_BITS  8
+#define SUBPIXEL_ONE   (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF  (SUBPIXEL_ONE / 2)
+
+/* keeps edge function products well within 64 bits */
+#define MAX_COORD      2097152.0f
+
+#define MAX_COPIES     16
+#define MAX_CLIP_VERTS 12
+
+struct varying_copy {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t size;
+};
+
+struct raster_vert {
+	int64_t     x, y;
+	float       z;
+	float       inv_w;
+	const float *data;
+};
+
+struct raster {
+	gs_device_t          *device;
+	struct sw_target     target;
+
+	int                  min_x, min_y;
+	int                  max_x, max_y;
+
+	float                vp_x, vp_y;
+	float                vp_cx, vp_cy;
+
+	uint32_t             vs_size;
+	uint32_t             pos_offset;
+
+	struct varying_copy  copies[MAX_COPIES];
+	size_t               num_copies;
+	int                  ps_pos_offset;
+	int                  color_offset;
+	uint32_t             color_size;
+
+	float                *ps_in;
+	float                *ps_out;
+	uint32_t             ps_in_size;
+};
+
+/* ------------------------------------------------------------------------- */
+/* Output merger                                                             */
+
+static inline float blend_factor(enum gs_blend_type type, size_t channel,
+		const float *src, const float *dst)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:        return 0.0f;
+	case GS_BLEND_ONE:         return 1.0f;
+	case GS_BLEND_SRCCOLOR:    return src[channel];
+	case GS_BLEND_INVSRCCOLOR: return 1.0f - src[channel];
+	case GS_BLEND_SRCALPHA:    return src[3];
+	case GS_BLEND_INVSRCALPHA: return 1.0f - src[3];
+	case GS_BLEND_DSTCOLOR:    return dst[channel];
+	case GS_BLEND_INVDSTCOLOR: return 1.0f - dst[channel];
+	case GS_BLEND_DSTALPHA:    return dst[3];
+	case GS_BLEND_INVDSTALPHA: return 1.0f - dst[3];
+	case GS_BLEND_SRCALPHASAT:
+		if (channel == 3)
+			return 1.0f;
+		return src[3] < 1.0f - dst[3] ? src[3] : 1.0f - dst[3];
+	}
+
+	return 0.0f;
+}
+
+static void write_pixel(struct raster *r, int x, int y, float *color)
+{
+	gs_device_t *device = r->device;
+	uint8_t     *texel  = r->target.data +
+		(uint32_t)y * r->target.linesize +
+		(uint32_t)x * r->target.bytes_per_pixel;
+	bool        full_mask;
+	float       dst[4];
+
+	for (size_t i = 0; i < 4; i++) {
+		if (color[i] < 0.0f)
+			color[i] = 0.0f;
+		else if (color[i] > 1.0f &&
+		         r->target.format != GS_RGBA16F &&
+		         r->target.format != GS_RGBA32F &&
+		         r->target.format != GS_RG16F &&
+		         r->target.format != GS_RG32F &&
+		         r->target.format != GS_R16F &&
+		         r->target.format != GS_R32F)
+			color[i] = 1.0f;
+	}
+
+	full_mask = device->color_mask[0] && device->color_mask[1] &&
+	            device->color_mask[2] && device->color_mask[3];
+
+	if (!device->blend_enabled && full_mask) {
+		sw_write_texel(r->target.format, texel, color);
+		return;
+	}
+
+	sw_read_texel(r->target.format, texel, dst);
+
+	if (device->blend_enabled) {
+		float out[4];
+
+		for (size_t i = 0; i < 4; i++) {
+			enum gs_blend_type src_type = i == 3 ?
+				device->blend_src_a : device->blend_src_c;
+			enum gs_blend_type dst_type = i == 3 ?
+				device->blend_dest_a : device->blend_dest_c;
+
+			out[i] = color[i] * blend_factor(src_type, i, color,
+					dst) + dst[i] * blend_factor(dst_type,
+					i, color, dst);
+		}
+
+		memcpy(color, out, sizeof(out));
+	}
+
+	for (size_t i = 0; i < 4; i++)
+		if (!device->color_mask[i])
+			color[i] = dst[i];
+
+	sw_write_texel(r->target.format, texel, color);
+}
+
+static inline bool depth_test(enum gs_depth_test test, float z, float cur)
+{
+	switch (test) {
+	case GS_NEVER:    return false;
+	case GS_LESS:     return z <  cur;
+	case GS_LEQUAL:   return z <= cur;
+	case GS_EQUAL:    return z == cur;
+	case GS_GEQUAL:   return z >= cur;
+	case GS_GREATER:  return z >  cur;
+	case GS_NOTEQUAL: return z != cur;
+	case GS_ALWAYS:   return true;
+	}
+
+	return true;
+}
+
+/* interpolates the varyings with perspective-correct weights, runs the pixel
+ * shader, and writes the result */
+static void shade_pixel(struct raster *r, int x, int y,
+		const struct raster_vert **v, const float *bary)
+{
+	gs_device_t *device = r->device;
+	float       *depth  = NULL;
+	float       w[3];
+	float       z, sum;
+
+	z = bary[0] * v[0]->z + bary[1] * v[1]->z + bary[2] * v[2]->z;
+
+	if (device->depth_test_enabled && r->target.zs) {
+		gs_zstencil_t *zs = r->target.zs;
+
+		if ((uint32_t)x < zs->width && (uint32_t)y < zs->height) {
+			depth = zs->depth + (uint32_t)y * zs->width +
+				(uint32_t)x;
+			if (!depth_test(device->depth_function, z, *depth))
+				return;
+		}
+	}
+
+	w[0] = bary[0] * v[0]->inv_w;
+	w[1] = bary[1] * v[1]->inv_w;
+	w[2] = bary[2] * v[2]->inv_w;
+	sum  = w[0] + w[1] + w[2];
+	if (sum != 0.0f) {
+		w[0] /= sum;
+		w[1] /= sum;
+		w[2] /= sum;
+	}
+
+	for (size_t i = 0; i < r->num_copies; i++) {
+		const struct varying_copy *copy = r->copies + i;
+		const float *d0 = v[0]->data + copy->src;
+		const float *d1 = v[1]->data + copy->src;
+		const float *d2 = v[2]->data + copy->src;
+		float       *out = r->ps_in + copy->dst;
+
+		for (uint32_t j = 0; j < copy->size; j++)
+			out[j] = w[0] * d0[j] + w[1] * d1[j] + w[2] * d2[j];
+	}
+
+	if (r->ps_pos_offset >= 0) {
+		float *pos = r->ps_in + r->ps_pos_offset;
+		pos[0] = (float)x + 0.5f;
+		pos[1] = (float)y + 0.5f;
+		pos[2] = z;
+		pos[3] = sum != 0.0f ? 1.0f / sum : 1.0f;
+	}
+
+	if (!sw_exec_run(device->ps_exec, r->ps_in, r->ps_out))
+		return;
+
+	if (depth)
+		*depth = z;
+
+	if (r->color_offset >= 0) {
+		float color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+		memcpy(color, r->ps_out + r->color_offset,
+				r->color_size * sizeof(float));
+		write_pixel(r, x, y, color);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Triangles                                                                 */
+
+static inline int64_t edge(const struct raster_vert *a,
+		const struct raster_vert *b, int64_t px, int64_t py)
+{
+	return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+/* top and left edges include the pixels exactly on them (for clockwise
+ * triangles in y-down screen space) */
+static inline int64_t edge_bias(const struct raster_vert *a,
+		const struct raster_vert *b)
+{
+	int64_t dx = b->x - a->x;
+	int64_t dy = b->y - a->y;
+	return ((dy == 0 && dx > 0) || dy < 0) ? 0 : 1;
+}
+
+static inline int64_t fixed_floor_px(int64_t val)
+{
+	return val >> SUBPIXEL_BITS;
+}
+
+static void raster_triangle(struct raster *r, const struct raster_vert *v0,
+		const struct raster_vert *v1, const struct raster_vert *v2)
+{
+	const struct raster_vert *v[3];
+	int64_t area, bias[3];
+	int64_t min_x, min_y, max_x, max_y;
+	int     x0, y0, x1, y1;
+	float   inv_area;
+
+	area = edge(v0, v1, v2->x, v2->y);
+	if (area == 0)
+		return;
+
+	if (r->device->cur_cull_mode == GS_BACK && area < 0)
+		return;
+	if (r->device->cur_cull_mode == GS_FRONT && area > 0)
+		return;
+
+	/* always rasterize clockwise */
+	if (area < 0) {
+		const struct raster_vert *tmp = v1;
+		v1   = v2;
+		v2   = tmp;
+		area = -area;
+	}
+
+	v[0] = v0;
+	v[1] = v1;
+	v[2] = v2;
+
+	bias[0] = edge_bias(v1, v2);
+	bias[1] = edge_bias(v2, v0);
+	bias[2] = edge_bias(v0, v1);
+
+	min_x = v0->x < v1->x ? v0->x : v1->x;
+	min_x = v2->x < min_x ? v2->x : min_x;
+	max_x = v0->x > v1->x ? v0->x : v1->x;
+	max_x = v2->x > max_x ? v2->x : max_x;
+	min_y = v0->y < v1->y ? v0->y : v1->y;
+	min_y = v2->y < min_y ? v2->y : min_y;
+	max_y = v0->y > v1->y ? v0->y : v1->y;
+	max_y = v2->y > max_y ? v2->y : max_y;
+
+	x0 = (int)fixed_floor_px(min_x);
+	y0 = (int)fixed_floor_px(min_y);
+	x1 = (int)fixed_floor_px(max_x) + 1;
+	y1 = (int)fixed_floor_px(max_y) + 1;
+
+	if (x0 < r->min_x) x0 = r->min_x;
+	if (y0 < r->min_y) y0 = r->min_y;
+	if (x1 > r->max_x) x1 = r->max_x;
+	if (y1 > r->max_y) y1 = r->max_y;
+
+	inv_area = 1.0f / (float)area;
+
+	for (int y = y0; y < y1; y++) {
+		int64_t py = (int64_t)y * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		int64_t px = (int64_t)x0 * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		int64_t e0 = edge(v1, v2, px, py);
+		int64_t e1 = edge(v2, v0, px, py);
+		int64_t e2 = edge(v0, v1, px, py);
+		int64_t step0 = -(v2->y - v1->y) * SUBPIXEL_ONE;
+		int64_t step1 = -(v0->y - v2->y) * SUBPIXEL_ONE;
+		int64_t step2 = -(v1->y - v0->y) * SUBPIXEL_ONE;
+
+		for (int x = x0; x < x1; x++) {
+			if (e0 >= bias[0] && e1 >= bias[1] && e2 >= bias[2]) {
+				float bary[3];
+				bary[0] = (float)e0 * inv_area;
+				bary[1] = (float)e1 * inv_area;
+				bary[2] = 1.0f - bary[0] - bary[1];
+				shade_pixel(r, x, y, v, bary);
+			}
+
+			e0 += step0;
+			e1 += step1;
+			e2 += step2;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Lines and points                                                          */
+
+static void raster_line(struct raster *r, const struct raster_vert *v0,
+		const struct raster_vert *v1)
+{
+	const struct raster_vert *v[3] = {v0, v1, v1};
+	float x0 = (float)v0->x / SUBPIXEL_ONE;
+	float y0 = (float)v0->y / SUBPIXEL_ONE;
+	float dx = (float)v1->x / SUBPIXEL_ONE - x0;
+	float dy = (float)v1->y / SUBPIXEL_ONE - y0;
+	float len = fabsf(dx) > fabsf(dy) ? fabsf(dx) : fabsf(dy);
+	int   steps = (int)ceilf(len);
+
+	if (steps == 0)
+		steps = 1;
+
+	for (int i = 0; i < steps; i++) {
+		float t = ((float)i + 0.5f) / (float)steps;
+		int   x = (int)floorf(x0 + dx * t);
+		int   y = (int)floorf(y0 + dy * t);
+		float bary[3] = {1.0f - t, t, 0.0f};
+
+		if (x >= r->min_x && x < r->max_x &&
+		    y >= r->min_y && y < r->max_y)
+			shade_pixel(r, x, y, v, bary);
+	}
+}
+
+static void raster_point(struct raster *r, const struct raster_vert *v0)
+{
+	const struct raster_vert *v[3] = {v0, v0, v0};
+	float bary[3] = {1.0f, 0.0f, 0.0f};
+	int   x = (int)fixed_floor_px(v0->x);
+	int   y = (int)fixed_floor_px(v0->y);
+
+	if (x >= r->min_x && x < r->max_x && y >= r->min_y && y < r->max_y)
+		shade_pixel(r, x, y, v, bary);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Clipping                                                                  */
+
+static inline float clamp_coord(float val)
+{
+	if (!(val > -MAX_COORD))
+		return -MAX_COORD;
+	if (val > MAX_COORD)
+		return MAX_COORD;
+	return val;
+}
+
+static void project(struct raster *r, const float *data,
+		struct raster_vert *out)
+{
+	const float *pos   = data + r->pos_offset;
+	float       inv_w  = 1.0f / pos[3];
+	float       x, y;
+
+	x = r->vp_x + (pos[0] * inv_w + 1.0f) * 0.5f * r->vp_cx;
+	y = r->vp_y + (1.0f - pos[1] * inv_w) * 0.5f * r->vp_cy;
+
+	out->x     = (int64_t)floorf(clamp_coord(x) * SUBPIXEL_ONE + 0.5f);
+	out->y     = (int64_t)floorf(clamp_coord(y) * SUBPIXEL_ONE + 0.5f);
+	out->z     = pos[2] * inv_w;
+	out->inv_w = inv_w;
+	out->data  = data;
+}
+
+#define NUM_CLIP_PLANES 3
+
+/* distance to the w > 0, near (z >= 0) and far (z <= w) planes */
+static inline float clip_dist(const float *pos, int plane)
+{
+	switch (plane) {
+	case 0:  return pos[3] - 1e-5f;
+	case 1:  return pos[2];
+	default: return pos[3] - pos[2];
+	}
+}
+
+static inline bool needs_clip(struct raster *r, const float **verts,
+		size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		const float *pos = verts[i] + r->pos_offset;
+		for (int plane = 0; plane < NUM_CLIP_PLANES; plane++)
+			if (clip_dist(pos, plane) < 0.0f)
+				return true;
+	}
+
+	return false;
+}
+
+/* clips a polygon against the clip planes, returning the new vertex count.
+ * new vertices are allocated from the device's clip buffer */
+static size_t clip_polygon(struct raster *r, const float **verts, size_t num)
+{
+	const float *in[MAX_CLIP_VERTS];
+	float       *scratch  = r->device->clip_data.array;
+	size_t      used      = 0;
+
+	for (int plane = 0; plane < NUM_CLIP_PLANES && num; plane++) {
+		size_t out_num = 0;
+
+		memcpy(in, verts, num * sizeof(float*));
+
+		for (size_t i = 0; i < num; i++) {
+			const float *a  = in[i];
+			const float *b  = in[(i + 1) % num];
+			float       da  = clip_dist(a + r->pos_offset, plane);
+			float       db  = clip_dist(b + r->pos_offset, plane);
+
+			if (da >= 0.0f)
+				verts[out_num++] = a;
+
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float *new_vert = scratch + used * r->vs_size;
+				float t = da / (da - db);
+
+				for (uint32_t j = 0; j < r->vs_size; j++)
+					new_vert[j] = a[j] + (b[j] - a[j]) * t;
+
+				verts[out_num++] = new_vert;
+				used++;
+			}
+		}
+
+		num = out_num;
+	}
+
+	return num;
+}
+
+static void draw_triangle(struct raster *r, const float *a, const float *b,
+		const float *c)
+{
+	const float        *verts[MAX_CLIP_VERTS] = {a, b, c};
+	struct raster_vert rv[MAX_CLIP_VERTS];
+	size_t             num = 3;
+
+	if (needs_clip(r, verts, 3))
+		num = clip_polygon(r, verts, 3);
+
+	for (size_t i = 0; i < num; i++)
+		project(r, verts[i], rv + i);
+
+	for (size_t i = 2; i < num; i++)
+		raster_triangle(r, rv, rv + i - 1, rv + i);
+}
+
+static void draw_line(struct raster *r, const float *a, const float *b)
+{
+	const float        *verts[MAX_CLIP_VERTS] = {a, b};
+	struct raster_vert rv[2];
+
+	if (needs_clip(r, verts, 2))
+		return;
+
+	project(r, a, rv);
+	project(r, b, rv + 1);
+	raster_line(r, rv, rv + 1);
+}
+
+static void draw_point(struct raster *r, const float *a)
+{
+	struct raster_vert rv;
+
+	if (needs_clip(r, &a, 1))
+		return;
+
+	project(r, a, &rv);
+	raster_point(r, &rv);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Vertex processing                                                         */
+
+static void assemble_input(const struct gs_vb_data *data, size_t idx,
+		const struct sw_io *inputs, float *in)
+{
+	memset(in, 0, inputs->size * sizeof(float));
+
+	for (size_t i = 0; i < inputs->vars.num; i++) {
+		const struct sw_varying *var = inputs->vars.array+i;
+		float    src[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		uint32_t size   = var->size < 4 ? var->size : 4;
+
+		switch (var->semantic) {
+		case SW_SEMANTIC_POSITION:
+			memcpy(src, data->points[idx].ptr, sizeof(float) * 3);
+			src[3] = 1.0f;
+			break;
+
+		case SW_SEMANTIC_NORMAL:
+			if (data->normals)
+				memcpy(src, data->normals[idx].ptr,
+						sizeof(float) * 3);
+			break;
+
+		case SW_SEMANTIC_TANGENT:
+			if (data->tangents)
+				memcpy(src, data->tangents[idx].ptr,
+						sizeof(float) * 3);
+			break;
+
+		case SW_SEMANTIC_COLOR:
+			if (data->colors) {
+				uint32_t color = data->colors[idx];
+				src[0] = (float)(color         & 0xFF) / 255.0f;
+				src[1] = (float)((color >> 8)  & 0xFF) / 255.0f;
+				src[2] = (float)((color >> 16) & 0xFF) / 255.0f;
+				src[3] = (float)(color >> 24)          / 255.0f;
+			}
+			break;
+
+		case SW_SEMANTIC_TEXCOORD:
+			if (var->index < data->num_tex) {
+				const struct gs_tvertarray *tv;
+				const float *uv;
+				size_t      width;
+
+				tv    = data->tvarray + var->index;
+				width = tv->width < 4 ? tv->width : 4;
+				uv    = (const float*)tv->array +
+					idx * tv->width;
+				memcpy(src, uv, width * sizeof(float));
+			}
+			break;
+
+		case SW_SEMANTIC_OTHER:
+		case SW_SEMANTIC_TARGET:
+			break;
+		}
+
+		memcpy(in + var->offset, src, size * sizeof(float));
+	}
+}
+
+static inline uint32_t get_index(const gs_indexbuffer_t *ib, size_t i)
+{
+	if (ib->type == GS_UNSIGNED_LONG)
+		return ((const uint32_t*)ib->data)[i];
+	return ((const uint16_t*)ib->data)[i];
+}
+
+static bool process_vertices(struct raster *r, const gs_indexbuffer_t *ib,
+		uint32_t start_vert, uint32_t num_verts, uint32_t *first)
+{
+	gs_device_t             *device = r->device;
+	const struct gs_vb_data *data   = device->cur_vertex_buffer->data;
+	const struct sw_io      *inputs;
+	uint32_t                min_idx = UINT32_MAX, max_idx = 0;
+	float                   *in;
+
+	inputs = sw_program_inputs(device->cur_vertex_shader->program);
+
+	if (ib) {
+		for (uint32_t i = 0; i < num_verts; i++) {
+			uint32_t idx = get_index(ib, start_vert + i);
+			if (idx < min_idx) min_idx = idx;
+			if (idx > max_idx) max_idx = idx;
+		}
+	} else {
+		min_idx = start_vert;
+		max_idx = start_vert + num_verts - 1;
+	}
+
+	if (max_idx >= data->num) {
+		blog(LOG_ERROR, "sw_draw: vertex index out of range");
+		return false;
+	}
+
+	da_resize(device->vert_data,
+			(size_t)(max_idx - min_idx + 1) * r->vs_size);
+	da_resize(device->io_data, inputs->size);
+	in = device->io_data.array;
+
+	for (uint32_t idx = min_idx; idx <= max_idx; idx++) {
+		float *out = device->vert_data.array +
+			(size_t)(idx - min_idx) * r->vs_size;
+
+		assemble_input(data, idx, inputs, in);
+		sw_exec_run(device->vs_exec, in, out);
+	}
+
+	*first = min_idx;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool link_shaders(struct raster *r)
+{
+	gs_device_t        *device = r->device;
+	const struct sw_io *vs_out, *ps_in, *ps_out;
+	const struct sw_varying *pos, *color;
+
+	vs_out = sw_program_outputs(device->cur_vertex_shader->program);
+	ps_in  = sw_program_inputs(device->cur_pixel_shader->program);
+	ps_out = sw_program_outputs(device->cur_pixel_shader->program);
+
+	pos = sw_io_find(vs_out, SW_SEMANTIC_POSITION, 0);
+	if (!pos || pos->size < 4) {
+		blog(LOG_ERROR, "sw_draw: vertex shader does not output a "
+		                "float4 position");
+		return false;
+	}
+
+	r->vs_size       = vs_out->size;
+	r->pos_offset    = pos->offset;
+	r->ps_in_size    = ps_in->size;
+	r->ps_pos_offset = -1;
+	r->num_copies    = 0;
+
+	for (size_t i = 0; i < ps_in->vars.num; i++) {
+		const struct sw_varying *var = ps_in->vars.array+i;
+		const struct sw_varying *src;
+		struct varying_copy     *copy;
+
+		if (var->semantic == SW_SEMANTIC_POSITION) {
+			r->ps_pos_offset = (int)var->offset;
+			continue;
+		}
+
+		src = sw_io_find(vs_out, var->semantic, var->index);
+		if (!src || r->num_copies == MAX_COPIES)
+			continue;
+
+		copy = r->copies + r->num_copies++;
+		copy->src  = src->offset;
+		copy->dst  = var->offset;
+		copy->size = var->size < src->size ? var->size : src->size;
+	}
+
+	color = sw_io_find(ps_out, SW_SEMANTIC_TARGET, 0);
+	r->color_offset = color ? (int)color->offset : -1;
+	r->color_size   = color ? (color->size < 4 ? color->size : 4) : 0;
+
+	da_resize(device->clip_data, MAX_CLIP_VERTS * (size_t)r->vs_size);
+	return true;
+}
+
+static void init_bounds(struct raster *r)
+{
+	gs_device_t          *device = r->device;
+	const struct gs_rect *vp     = &device->cur_viewport;
+
+	r->vp_x  = (float)vp->x;
+	r->vp_y  = (float)vp->y;
+	r->vp_cx = (float)vp->cx;
+	r->vp_cy = (float)vp->cy;
+
+	r->min_x = vp->x > 0 ? vp->x : 0;
+	r->min_y = vp->y > 0 ? vp->y : 0;
+	r->max_x = vp->x + vp->cx;
+	r->max_y = vp->y + vp->cy;
+
+	if (r->max_x > (int)r->target.width)
+		r->max_x = (int)r->target.width;
+	if (r->max_y > (int)r->target.height)
+		r->max_y = (int)r->target.height;
+
+	if (device->scissor_enabled) {
+		const struct gs_rect *sc = &device->cur_scissor;
+
+		if (r->min_x < sc->x)         r->min_x = sc->x;
+		if (r->min_y < sc->y)         r->min_y = sc->y;
+		if (r->max_x > sc->x + sc->cx) r->max_x = sc->x + sc->cx;
+		if (r->max_y > sc->y + sc->cy) r->max_y = sc->y + sc->cy;
+	}
+}
+
+void sw_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	gs_indexbuffer_t *ib = device->cur_index_buffer;
+	struct raster    r   = {0};
+	uint32_t         first;
+	float            *verts;
+	float            *io;
+
+	r.device = device;
+
+	if (!sw_get_target(device, &r.target) || !link_shaders(&r))
+		return;
+
+	init_bounds(&r);
+	if (r.min_x >= r.max_x || r.min_y >= r.max_y || !num_verts)
+		return;
+
+	sw_exec_begin(device->vs_exec, device->cur_vertex_shader);
+	sw_exec_begin(device->ps_exec, device->cur_pixel_shader);
+
+	if (!process_vertices(&r, ib, start_vert, num_verts, &first))
+		return;
+
+	/* pixel shader inputs and outputs share a buffer */
+	da_resize(device->io_data, r.ps_in_size +
+			sw_program_outputs(device->cur_pixel_shader->program)
+			->size);
+	io      = device->io_data.array;
+	r.ps_in = io;
+	r.ps_out = io + r.ps_in_size;
+	memset(r.ps_in, 0, r.ps_in_size * sizeof(float));
+
+	verts = device->vert_data.array;
+
+#define VERT(i) (verts + (size_t)((ib ? get_index(ib, start_vert + (i)) : \
+			start_vert + (i)) - first) * r.vs_size)
+
+	switch (draw_mode) {
+	case GS_POINTS:
+		for (uint32_t i = 0; i < num_verts; i++)
+			draw_point(&r, VERT(i));
+		break;
+
+	case GS_LINES:
+		for (uint32_t i = 0; i + 1 < num_verts; i += 2)
+			draw_line(&r, VERT(i), VERT(i + 1));
+		break;
+
+	case GS_LINESTRIP:
+		for (uint32_t i = 0; i + 1 < num_verts; i++)
+			draw_line(&r, VERT(i), VERT(i + 1));
+		break;
+
+	case GS_TRIS:
+		for (uint32_t i = 0; i + 2 < num_verts; i += 3)
+			draw_triangle(&r, VERT(i), VERT(i + 1), VERT(i + 2));
+		break;
+
+	case GS_TRISTRIP:
+		/* every other triangle of a strip has reversed winding */
+		for (uint32_t i = 0; i + 2 < num_verts; i++) {
+			if (i & 1)
+				draw_triangle(&r, VERT(i + 1), VERT(i),
+						VERT(i + 2));
+			else
+				draw_triangle(&r, VERT(i), VERT(i + 1),
+						VERT(i + 2));
+		}
+		break;
+	}
+
+#undef VERT
+}
@@ -0,0 +1,871 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <graphics/matrix3.h>
+#include "sw-subsystem.h"
+#include "sw-interp.h"
+
+const char *device_get_name(void)
+{
+	return "Software";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_SOFTWARE;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_SOFTWARE";
+}
+
+bool device_enum_adapters(
+		bool (*callback)(void *param, const char *name, uint32_t id),
+		void *param)
+{
+	callback(param, "Software", 0);
+	return true;
+}
+
+void device_set_cache_path(gs_device_t *device, const char *path)
+{
+	/* shaders are parsed directly, there is nothing to cache */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(path);
+}
+
+void sw_unbind_texture(gs_device_t *device, gs_texture_t *tex)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+}
+
+static bool swapchain_init_buffers(struct gs_swap_chain *swap)
+{
+	struct gs_init_data *info = &swap->info;
+
+	if (!info->cx) info->cx = 1;
+	if (!info->cy) info->cy = 1;
+
+	if (info->format == GS_UNKNOWN ||
+	    gs_is_compressed_format(info->format))
+		info->format = GS_BGRA;
+
+	swap->target = device_texture_create(swap->device, info->cx, info->cy,
+			info->format, 1, NULL, GS_RENDER_TARGET);
+	if (!swap->target)
+		return false;
+
+	if (info->zsformat != GS_ZS_NONE) {
+		swap->zs = device_zstencil_create(swap->device,
+				info->cx, info->cy, info->zsformat);
+		if (!swap->zs)
+			return false;
+	}
+
+	return true;
+}
+
+static void swapchain_free_buffers(struct gs_swap_chain *swap)
+{
+	gs_zstencil_destroy(swap->zs);
+	gs_texture_destroy(swap->target);
+	swap->zs     = NULL;
+	swap->target = NULL;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+
+	if (!swapchain_init_buffers(swap)) {
+		blog(LOG_ERROR, "device_swapchain_create (software) failed");
+		gs_swapchain_destroy(swap);
+		return NULL;
+	}
+
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swap)
+{
+	if (!swap)
+		return;
+
+	if (swap->device->cur_swap == swap)
+		device_load_swapchain(swap->device, NULL);
+
+	swapchain_free_buffers(swap);
+	bfree(swap);
+}
+
+int device_create(gs_device_t **p_device, const struct gs_init_data *info)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+	int errorcode = GS_ERROR_FAIL;
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing software renderer...");
+
+	device->vs_exec = sw_exec_create();
+	device->ps_exec = sw_exec_create();
+
+	device->default_swap = device_swapchain_create(device, info);
+	if (!device->default_swap)
+		goto fail;
+
+	device->cur_cull_mode  = GS_BACK;
+	device->depth_function = GS_LESS;
+	device->blend_src_c    = GS_BLEND_ONE;
+	device->blend_dest_c   = GS_BLEND_ZERO;
+	device->blend_src_a    = GS_BLEND_ONE;
+	device->blend_dest_a   = GS_BLEND_ZERO;
+
+	for (size_t i = 0; i < 4; i++)
+		device->color_mask[i] = true;
+
+	matrix4_identity(&device->cur_proj);
+	matrix4_identity(&device->cur_view);
+	matrix4_identity(&device->cur_viewproj);
+
+	device_load_swapchain(device, NULL);
+	device_set_viewport(device, 0, 0,
+			device->default_swap->info.cx,
+			device->default_swap->info.cy);
+
+	*p_device = device;
+	return GS_SUCCESS;
+
+fail:
+	blog(LOG_ERROR, "device_create (software) failed");
+	device_destroy(device);
+
+	*p_device = NULL;
+	return errorcode;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (device) {
+		gs_swapchain_t *swap = device->default_swap;
+
+		device->default_swap = NULL;
+		gs_swapchain_destroy(swap);
+
+		sw_exec_destroy(device->vs_exec);
+		sw_exec_destroy(device->ps_exec);
+
+		da_free(device->vert_data);
+		da_free(device->clip_data);
+		da_free(device->io_data);
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	struct gs_swap_chain *swap = device->cur_swap;
+	bool                 bound;
+
+	if (!swap) {
+		blog(LOG_WARNING, "device_resize (software): No active swap");
+		return;
+	}
+
+	bound = device->cur_render_target == swap->target;
+
+	swapchain_free_buffers(swap);
+	swap->info.cx = cx;
+	swap->info.cy = cy;
+
+	if (!swapchain_init_buffers(swap))
+		blog(LOG_ERROR, "device_resize (software) failed");
+
+	if (bound)
+		device_set_render_target(device, NULL, NULL);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	/* TODO */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+		const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler;
+
+	sampler = bzalloc(sizeof(struct gs_sampler_state));
+	sampler->device = device;
+	sampler->ref    = 1;
+
+	sw_convert_sampler_info(sampler, info);
+	return sampler;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	struct gs_shader *shader = device->cur_pixel_shader;
+	struct gs_shader_param *param;
+
+	if (unit < 0 || unit >= GS_MAX_TEXTURES)
+		return;
+
+	if (!shader)
+		tex = NULL;
+
+	device->cur_textures[unit] = tex;
+
+	if (!shader)
+		return;
+
+	for (size_t i = 0; i < shader->params.num; i++) {
+		param = shader->params.array + i;
+		if (param->type == GS_SHADER_PARAM_TEXTURE &&
+		    param->texture_id == unit) {
+			param->texture = tex;
+			break;
+		}
+	}
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *ss, int unit)
+{
+	if (unit < 0 || unit >= GS_MAX_TEXTURES)
+		return;
+
+	/* samplers are only used by pixel shaders */
+	if (!device->cur_pixel_shader)
+		ss = NULL;
+
+	device->cur_samplers[unit] = ss;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		blog(LOG_ERROR, "device_load_vertexshader (software) failed");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+static void clear_textures(struct gs_device *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		blog(LOG_ERROR, "device_load_pixelshader (software) failed");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+	clear_textures(device);
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		bool valid = pixelshader && i < pixelshader->samplers.num;
+		device->cur_samplers[i] = valid ?
+			pixelshader->samplers.array[i] : NULL;
+	}
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+		int unit)
+{
+	/* a NULL sampler falls back to the shader's own sampler */
+	UNUSED_PARAMETER(b_3d);
+
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = NULL;
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	if (device->cur_swap &&
+	    device->cur_render_target == device->cur_swap->target)
+		return NULL;
+
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	if (device->cur_swap &&
+	    device->cur_zstencil_buffer == device->cur_swap->zs)
+		return NULL;
+
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	/* NULL targets select the current swap chain's back buffer */
+	if (!tex && device->cur_swap)
+		tex = device->cur_swap->target;
+	if (!zstencil && device->cur_swap)
+		zstencil = device->cur_swap->zs;
+
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "Texture is not a 2D texture");
+			goto fail;
+		}
+
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = 0;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_render_target (software) failed");
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (!cubetex) {
+		device_set_render_target(device, NULL, zstencil);
+		return;
+	}
+
+	if (cubetex->type != GS_TEXTURE_CUBE) {
+		blog(LOG_ERROR, "Texture is not a cube texture");
+		goto fail;
+	}
+
+	if (!cubetex->is_render_target) {
+		blog(LOG_ERROR, "Texture is not a render target");
+		goto fail;
+	}
+
+	if (side < 0 || side >= 6) {
+		blog(LOG_ERROR, "Invalid cube side: %d", side);
+		goto fail;
+	}
+
+	device->cur_render_target   = cubetex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_cube_render_target (software) failed");
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	struct gs_texture_2d *src2d = (struct gs_texture_2d*)src;
+	struct gs_texture_2d *dst2d = (struct gs_texture_2d*)dst;
+	uint32_t             nw, nh, bpp;
+
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination texture is NULL");
+		goto fail;
+	}
+
+	if (dst->type != GS_TEXTURE_2D || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source and destination textures must be 2D "
+		                "textures");
+		goto fail;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	if (gs_is_compressed_format(src->format)) {
+		blog(LOG_ERROR, "Cannot copy regions of compressed textures");
+		goto fail;
+	}
+
+	if (src_x > src2d->width || src_y > src2d->height) {
+		blog(LOG_ERROR, "Source region is out of bounds");
+		goto fail;
+	}
+
+	nw = src_w ? src_w : src2d->width  - src_x;
+	nh = src_h ? src_h : src2d->height - src_y;
+
+	if (src2d->width - src_x < nw || src2d->height - src_y < nh) {
+		blog(LOG_ERROR, "Source region is out of bounds");
+		goto fail;
+	}
+
+	if (dst2d->width < dst_x || dst2d->height < dst_y ||
+	    dst2d->width - dst_x < nw || dst2d->height - dst_y < nh) {
+		blog(LOG_ERROR, "Destination texture region is not big "
+		                "enough to hold the source region");
+		goto fail;
+	}
+
+	bpp = src->bytes_per_pixel;
+
+	for (uint32_t y = 0; y < nh; y++)
+		memmove(dst2d->data + (dst_y + y) * dst2d->linesize +
+				dst_x * bpp,
+			src2d->data + (src_y + y) * src2d->linesize +
+				src_x * bpp,
+			nw * bpp);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_copy_texture (software) failed");
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	clear_textures(device);
+}
+
+static inline bool can_render(const gs_device_t *device)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	return true;
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+
+	gs_matrix_get(&device->cur_view);
+
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+			&device->cur_proj);
+	matrix4_transpose(&device->cur_viewproj, &device->cur_viewproj);
+
+	if (vs->viewproj)
+		gs_shader_set_matrix4(vs->viewproj, &device->cur_viewproj);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	gs_effect_t            *effect = gs_get_effect();
+
+	if (!can_render(device))
+		goto fail;
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	update_viewproj_matrix(device);
+
+	if (!num_verts)
+		num_verts = ib ? (uint32_t)ib->num :
+			(uint32_t)device->cur_vertex_buffer->num;
+
+	sw_draw(device, draw_mode, start_vert, num_verts);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_draw (software) failed");
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	/* does nothing */
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swap)
+{
+	if (!swap)
+		swap = device->default_swap;
+
+	device->cur_swap = swap;
+	device_set_render_target(device, NULL, NULL);
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	struct sw_target target;
+
+	if (!sw_get_target(device, &target))
+		return;
+
+	if ((clear_flags & GS_CLEAR_COLOR) != 0) {
+		uint8_t texel[16];
+		uint8_t *row = target.data;
+		size_t  bpp  = target.bytes_per_pixel;
+
+		sw_write_texel(target.format, texel, color->ptr);
+
+		for (uint32_t x = 0; x < target.width; x++)
+			memcpy(row + x * bpp, texel, bpp);
+		for (uint32_t y = 1; y < target.height; y++)
+			memcpy(row + y * target.linesize, row,
+					target.width * bpp);
+	}
+
+	if ((clear_flags & GS_CLEAR_DEPTH) != 0 && target.zs) {
+		size_t count = (size_t)target.zs->width * target.zs->height;
+		for (size_t i = 0; i < count; i++)
+			target.zs->depth[i] = depth;
+	}
+
+	/* stencil buffers are not implemented */
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_present(gs_device_t *device)
+{
+	/* there is no window to present to */
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	/* draws complete immediately */
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->blend_enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	device->depth_test_enabled = enable;
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	device->color_mask[0] = red;
+	device->color_mask[1] = green;
+	device->color_mask[2] = blue;
+	device->color_mask[3] = alpha;
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	device->blend_src_c  = src_c;
+	device->blend_dest_c = dest_c;
+	device->blend_src_a  = src_a;
+	device->blend_dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	device->depth_function = test;
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	if (rect)
+		device->cur_scissor = *rect;
+
+	device->scissor_enabled = rect != NULL;
+}
+
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = zfar-znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =         1.0f /  fmn;
+	dst->t.z =        znear / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float tmb    = top-bottom;
+	float fmn    = zfar-znear;
+	float nearx2 = 2.0f*znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =       nearx2 /  rml;
+	dst->z.x = (left+right) / -rml;
+
+	dst->y.y =       nearx2 /  tmb;
+	dst->z.y = (bottom+top) / -tmb;
+
+	dst->z.z =         zfar /  fmn;
+	dst->t.z =   (znear*zfar) / -fmn;
+
+	dst->z.w = 1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	if (samplerstate->device)
+		for (int i = 0; i < GS_MAX_TEXTURES; i++)
+			if (samplerstate->device->cur_samplers[i] ==
+					samplerstate)
+				samplerstate->device->cur_samplers[i] = NULL;
+
+	samplerstate_release(samplerstate);
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_getdepth(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
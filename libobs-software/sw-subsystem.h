@@ -0,0 +1,244 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <util/threading.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ * Software graphics subsystem
+ *
+ *   Implements the graphics device interface entirely on the CPU so that the
+ * full video pipeline can run on machines without a GPU (build/test hosts,
+ * benchmarks).  Textures are kept in system memory in their native format,
+ * and the shaders generated by the effect parser are compiled to a small
+ * expression tree which is interpreted per vertex and per pixel (see
+ * sw-interp.h).  Rasterization follows Direct3D conventions (top-left fill
+ * rule, pixel centers at .5, 0..1 depth), and output is deterministic.
+ *
+ *   There is no real window output; swap chains only own a back buffer that
+ * can be rendered to.
+ */
+
+struct sw_program;
+struct sw_exec;
+
+struct gs_sampler_state {
+	gs_device_t          *device;
+	volatile long        ref;
+
+	struct gs_sampler_info info;
+	bool                 linear;
+	float                border_color[4];
+};
+
+static inline void samplerstate_addref(gs_samplerstate_t *ss)
+{
+	os_atomic_inc_long(&ss->ref);
+}
+
+static inline void samplerstate_release(gs_samplerstate_t *ss)
+{
+	if (os_atomic_dec_long(&ss->ref) == 0)
+		bfree(ss);
+}
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char                 *name;
+	gs_shader_t          *shader;
+	int                  texture_id;
+	int                  array_count;
+
+	struct gs_texture    *texture;
+
+	DARRAY(uint8_t)      cur_value;
+	DARRAY(uint8_t)      def_value;
+};
+
+struct gs_shader {
+	gs_device_t          *device;
+	enum gs_shader_type  type;
+
+	struct sw_program    *program;
+
+	struct gs_shader_param  *viewproj;
+	struct gs_shader_param  *world;
+
+	DARRAY(struct gs_shader_param) params;
+	DARRAY(gs_samplerstate_t*)      samplers;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	size_t               num;
+	bool                 dynamic;
+	struct gs_vb_data    *data;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	size_t               width;
+	bool                 dynamic;
+};
+
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             levels;
+	uint32_t             bytes_per_pixel;
+	bool                 is_dynamic;
+	bool                 is_render_target;
+};
+
+/* only the first mip level is stored; sampling never uses lower levels */
+struct gs_texture_2d {
+	struct gs_texture    base;
+
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_texture_cube {
+	struct gs_texture    base;
+
+	uint32_t             size;
+	uint32_t             linesize;
+	uint8_t              *data[6];
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t          *device;
+	enum gs_zstencil_format format;
+	uint32_t             width;
+	uint32_t             height;
+	float                *depth;
+};
+
+struct gs_swap_chain {
+	gs_device_t          *device;
+	struct gs_init_data  info;
+	gs_texture_t         *target;
+	gs_zstencil_t        *zs;
+};
+
+static inline uint32_t sw_get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	if (gs_is_compressed_format(format))
+		return ((width + 3) / 4) * gs_get_format_bpp(format) * 2;
+
+	return (width * gs_get_format_bpp(format) / 8 + 3) & 0xFFFFFFFC;
+}
+
+/* destination of a draw: a 2D texture or one face of a cube texture */
+struct sw_target {
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint32_t             bytes_per_pixel;
+	uint8_t              *data;
+	gs_zstencil_t        *zs;
+};
+
+struct gs_device {
+	gs_texture_t         *cur_render_target;
+	gs_zstencil_t        *cur_zstencil_buffer;
+	int                  cur_render_side;
+	gs_texture_t         *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t    *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t      *cur_vertex_buffer;
+	gs_indexbuffer_t     *cur_index_buffer;
+	gs_shader_t          *cur_vertex_shader;
+	gs_shader_t          *cur_pixel_shader;
+	gs_swapchain_t       *cur_swap;
+	gs_swapchain_t       *default_swap;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_rect       cur_viewport;
+	struct gs_rect       cur_scissor;
+	bool                 scissor_enabled;
+
+	bool                 blend_enabled;
+	bool                 depth_test_enabled;
+	enum gs_depth_test   depth_function;
+	bool                 color_mask[4];
+	enum gs_blend_type   blend_src_c;
+	enum gs_blend_type   blend_dest_c;
+	enum gs_blend_type   blend_src_a;
+	enum gs_blend_type   blend_dest_a;
+
+	struct matrix4       cur_proj;
+	struct matrix4       cur_view;
+	struct matrix4       cur_viewproj;
+
+	DARRAY(struct matrix4) proj_stack;
+
+	/* interpreter state reused between draws */
+	struct sw_exec       *vs_exec;
+	struct sw_exec       *ps_exec;
+	DARRAY(float)        vert_data;
+	DARRAY(float)        clip_data;
+	DARRAY(float)        io_data;
+};
+
+/* sw-subsystem.c */
+extern void sw_unbind_texture(gs_device_t *device, gs_texture_t *tex);
+
+/* sw-texture2d.c */
+extern void sw_upload_surface(uint8_t *dst, uint32_t linesize,
+		enum gs_color_format format, uint32_t width, uint32_t height,
+		const uint8_t *src);
+
+/* sw-texture.c */
+extern void sw_convert_sampler_info(struct gs_sampler_state *sampler,
+		const struct gs_sampler_info *info);
+extern bool sw_get_target(gs_device_t *device, struct sw_target *target);
+extern void sw_read_texel(enum gs_color_format format, const uint8_t *texel,
+		float *color);
+extern void sw_write_texel(enum gs_color_format format, uint8_t *texel,
+		const float *color);
+extern void sw_texture_sample(const gs_texture_t *tex,
+		const gs_samplerstate_t *ss, const float *coord, float *color);
+extern void sw_texture_load(const gs_texture_t *tex, int x, int y,
+		float *color);
+
+/* sw-raster.c */
+extern void sw_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts);
@@ -0,0 +1,463 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "sw-subsystem.h"
+
+/* ------------------------------------------------------------------------- */
+/* Texel formats                                                             */
+
+static inline float half_to_float(uint16_t val)
+{
+	uint32_t sign     = (uint32_t)(val & 0x8000) << 16;
+	uint32_t exponent = (val >> 10) & 0x1F;
+	uint32_t mantissa = val & 0x3FF;
+	union {uint32_t u; float f;} result;
+
+	if (exponent == 0) {
+		/* zero or subnormal */
+		float f = (float)mantissa / 16777216.0f;
+		return sign ? -f : f;
+	} else if (exponent == 31) {
+		result.u = sign | 0x7F800000 | (mantissa << 13);
+	} else {
+		result.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	return result.f;
+}
+
+static inline uint16_t float_to_half(float val)
+{
+	union {uint32_t u; float f;} in;
+	uint32_t sign;
+	int32_t  exponent;
+	uint32_t mantissa;
+
+	in.f     = val;
+	sign     = (in.u >> 16) & 0x8000;
+	exponent = (int32_t)((in.u >> 23) & 0xFF) - 112;
+	mantissa = in.u & 0x7FFFFF;
+
+	if (((in.u >> 23) & 0xFF) == 0xFF)
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7C00);
+	if (exponent <= 0) {
+		if (exponent < -10)
+			return (uint16_t)sign;
+
+		mantissa |= 0x800000;
+		return (uint16_t)(sign |
+				((mantissa >> (14 - exponent)) +
+				 ((mantissa >> (13 - exponent)) & 1)));
+	}
+
+	/* round to nearest; a carry correctly bumps the exponent */
+	return (uint16_t)(sign | ((((uint32_t)exponent << 10) |
+			(mantissa >> 13)) + ((mantissa >> 12) & 1)));
+}
+
+static inline float unorm8(uint8_t val)
+{
+	return (float)val * (1.0f / 255.0f);
+}
+
+static inline uint32_t to_unorm(float val, float max_val)
+{
+	if (!(val > 0.0f))
+		return 0;
+	if (val >= 1.0f)
+		return (uint32_t)max_val;
+	return (uint32_t)(val * max_val + 0.5f);
+}
+
+void sw_read_texel(enum gs_color_format format, const uint8_t *texel,
+		float *color)
+{
+	const uint16_t *u16 = (const uint16_t*)texel;
+	const float    *f32 = (const float*)texel;
+	uint32_t       packed;
+
+	color[0] = color[1] = color[2] = 0.0f;
+	color[3] = 1.0f;
+
+	switch (format) {
+	case GS_A8:
+		color[3] = unorm8(texel[0]);
+		break;
+	case GS_R8:
+		color[0] = unorm8(texel[0]);
+		break;
+	case GS_RGBA:
+		color[0] = unorm8(texel[0]);
+		color[1] = unorm8(texel[1]);
+		color[2] = unorm8(texel[2]);
+		color[3] = unorm8(texel[3]);
+		break;
+	case GS_BGRX:
+		color[0] = unorm8(texel[2]);
+		color[1] = unorm8(texel[1]);
+		color[2] = unorm8(texel[0]);
+		break;
+	case GS_BGRA:
+		color[0] = unorm8(texel[2]);
+		color[1] = unorm8(texel[1]);
+		color[2] = unorm8(texel[0]);
+		color[3] = unorm8(texel[3]);
+		break;
+	case GS_R10G10B10A2:
+		packed   = *(const uint32_t*)texel;
+		color[0] = (float)(packed & 0x3FF)         / 1023.0f;
+		color[1] = (float)((packed >> 10) & 0x3FF) / 1023.0f;
+		color[2] = (float)((packed >> 20) & 0x3FF) / 1023.0f;
+		color[3] = (float)(packed >> 30)           / 3.0f;
+		break;
+	case GS_RGBA16:
+		for (size_t i = 0; i < 4; i++)
+			color[i] = (float)u16[i] / 65535.0f;
+		break;
+	case GS_R16:
+		color[0] = (float)u16[0] / 65535.0f;
+		break;
+	case GS_RGBA16F:
+		for (size_t i = 0; i < 4; i++)
+			color[i] = half_to_float(u16[i]);
+		break;
+	case GS_RG16F:
+		color[1] = half_to_float(u16[1]);
+		/* fall through */
+	case GS_R16F:
+		color[0] = half_to_float(u16[0]);
+		break;
+	case GS_RGBA32F:
+		memcpy(color, f32, sizeof(float) * 4);
+		break;
+	case GS_RG32F:
+		color[1] = f32[1];
+		/* fall through */
+	case GS_R32F:
+		color[0] = f32[0];
+		break;
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		color[3] = 0.0f;
+		break;
+	}
+}
+
+void sw_write_texel(enum gs_color_format format, uint8_t *texel,
+		const float *color)
+{
+	uint16_t *u16 = (uint16_t*)texel;
+	float    *f32 = (float*)texel;
+
+	switch (format) {
+	case GS_A8:
+		texel[0] = (uint8_t)to_unorm(color[3], 255.0f);
+		break;
+	case GS_R8:
+		texel[0] = (uint8_t)to_unorm(color[0], 255.0f);
+		break;
+	case GS_RGBA:
+		for (size_t i = 0; i < 4; i++)
+			texel[i] = (uint8_t)to_unorm(color[i], 255.0f);
+		break;
+	case GS_BGRX:
+	case GS_BGRA:
+		texel[0] = (uint8_t)to_unorm(color[2], 255.0f);
+		texel[1] = (uint8_t)to_unorm(color[1], 255.0f);
+		texel[2] = (uint8_t)to_unorm(color[0], 255.0f);
+		texel[3] = format == GS_BGRX ? 0xFF :
+			(uint8_t)to_unorm(color[3], 255.0f);
+		break;
+	case GS_R10G10B10A2:
+		*(uint32_t*)texel =
+			 to_unorm(color[0], 1023.0f)        |
+			(to_unorm(color[1], 1023.0f) << 10) |
+			(to_unorm(color[2], 1023.0f) << 20) |
+			(to_unorm(color[3], 3.0f)    << 30);
+		break;
+	case GS_RGBA16:
+		for (size_t i = 0; i < 4; i++)
+			u16[i] = (uint16_t)to_unorm(color[i], 65535.0f);
+		break;
+	case GS_R16:
+		u16[0] = (uint16_t)to_unorm(color[0], 65535.0f);
+		break;
+	case GS_RGBA16F:
+		for (size_t i = 0; i < 4; i++)
+			u16[i] = float_to_half(color[i]);
+		break;
+	case GS_RG16F:
+		u16[1] = float_to_half(color[1]);
+		/* fall through */
+	case GS_R16F:
+		u16[0] = float_to_half(color[0]);
+		break;
+	case GS_RGBA32F:
+		memcpy(f32, color, sizeof(float) * 4);
+		break;
+	case GS_RG32F:
+		f32[1] = color[1];
+		/* fall through */
+	case GS_R32F:
+		f32[0] = color[0];
+		break;
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Sampling                                                                  */
+
+void sw_convert_sampler_info(struct gs_sampler_state *sampler,
+		const struct gs_sampler_info *info)
+{
+	uint32_t border = info->border_color;
+
+	sampler->info   = *info;
+	sampler->linear = info->filter != GS_FILTER_POINT &&
+	                  info->filter != GS_FILTER_MIN_MAG_POINT_MIP_LINEAR &&
+	                  info->filter != GS_FILTER_MIN_LINEAR_MAG_MIP_POINT;
+
+	sampler->border_color[0] = unorm8((uint8_t)(border));
+	sampler->border_color[1] = unorm8((uint8_t)(border >> 8));
+	sampler->border_color[2] = unorm8((uint8_t)(border >> 16));
+	sampler->border_color[3] = unorm8((uint8_t)(border >> 24));
+}
+
+/* returns -1 if the coordinate maps to the border color */
+static inline int address(int coord, int size, enum gs_address_mode mode)
+{
+	int period;
+
+	switch (mode) {
+	case GS_ADDRESS_WRAP:
+		coord %= size;
+		return coord < 0 ? coord + size : coord;
+
+	case GS_ADDRESS_MIRROR:
+		period = size * 2;
+		coord %= period;
+		if (coord < 0)
+			coord += period;
+		return coord < size ? coord : period - 1 - coord;
+
+	case GS_ADDRESS_MIRRORONCE:
+		if (coord < 0)
+			coord = -coord - 1;
+		return coord < size ? coord : size - 1;
+
+	case GS_ADDRESS_BORDER:
+		return (coord < 0 || coord >= size) ? -1 : coord;
+
+	case GS_ADDRESS_CLAMP:
+		break;
+	}
+
+	return coord < 0 ? 0 : (coord >= size ? size - 1 : coord);
+}
+
+struct sw_surface {
+	enum gs_color_format format;
+	const uint8_t        *data;
+	int                  width;
+	int                  height;
+	uint32_t             linesize;
+	uint32_t             bytes_per_pixel;
+};
+
+static inline void fetch(const struct sw_surface *surf,
+		const gs_samplerstate_t *ss, int x, int y, float *color)
+{
+	x = address(x, surf->width,  ss ? ss->info.address_u : 0);
+	y = address(y, surf->height, ss ? ss->info.address_v : 0);
+
+	if (x < 0 || y < 0) {
+		memcpy(color, ss->border_color, sizeof(float) * 4);
+		return;
+	}
+
+	sw_read_texel(surf->format, surf->data + (uint32_t)y * surf->linesize +
+			(uint32_t)x * surf->bytes_per_pixel, color);
+}
+
+static void sample_surface(const struct sw_surface *surf,
+		const gs_samplerstate_t *ss, float u, float v, float *color)
+{
+	float x = u * (float)surf->width;
+	float y = v * (float)surf->height;
+	float c[4][4];
+	float fx, fy;
+	int   x0, y0;
+
+	if (!surf->data || gs_is_compressed_format(surf->format)) {
+		memset(color, 0, sizeof(float) * 4);
+		return;
+	}
+
+	if (ss && !ss->linear) {
+		fetch(surf, ss, (int)floorf(x), (int)floorf(y), color);
+		return;
+	}
+
+	x -= 0.5f;
+	y -= 0.5f;
+	x0 = (int)floorf(x);
+	y0 = (int)floorf(y);
+	fx = x - (float)x0;
+	fy = y - (float)y0;
+
+	fetch(surf, ss, x0,     y0,     c[0]);
+	fetch(surf, ss, x0 + 1, y0,     c[1]);
+	fetch(surf, ss, x0,     y0 + 1, c[2]);
+	fetch(surf, ss, x0 + 1, y0 + 1, c[3]);
+
+	for (size_t i = 0; i < 4; i++) {
+		float top    = c[0][i] + (c[1][i] - c[0][i]) * fx;
+		float bottom = c[2][i] + (c[3][i] - c[2][i]) * fx;
+		color[i] = top + (bottom - top) * fy;
+	}
+}
+
+static void get_cube_face(const float *coord, int *face, float *u, float *v)
+{
+	float x = coord[0], y = coord[1], z = coord[2];
+	float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+	float sc, tc, ma;
+
+	if (ax >= ay && ax >= az) {
+		*face = x >= 0.0f ? 0 : 1;
+		sc    = x >= 0.0f ? -z : z;
+		tc    = -y;
+		ma    = ax;
+	} else if (ay >= az) {
+		*face = y >= 0.0f ? 2 : 3;
+		sc    = x;
+		tc    = y >= 0.0f ? z : -z;
+		ma    = ay;
+	} else {
+		*face = z >= 0.0f ? 4 : 5;
+		sc    = z >= 0.0f ? x : -x;
+		tc    = -y;
+		ma    = az;
+	}
+
+	if (ma == 0.0f)
+		ma = 1.0f;
+
+	*u = (sc / ma + 1.0f) * 0.5f;
+	*v = (tc / ma + 1.0f) * 0.5f;
+}
+
+void sw_texture_sample(const gs_texture_t *tex, const gs_samplerstate_t *ss,
+		const float *coord, float *color)
+{
+	struct sw_surface surf;
+
+	surf.format          = tex->format;
+	surf.bytes_per_pixel = tex->bytes_per_pixel;
+
+	if (tex->type == GS_TEXTURE_2D) {
+		const struct gs_texture_2d *tex2d = (const void*)tex;
+
+		surf.data     = tex2d->data;
+		surf.width    = (int)tex2d->width;
+		surf.height   = (int)tex2d->height;
+		surf.linesize = tex2d->linesize;
+		sample_surface(&surf, ss, coord[0], coord[1], color);
+
+	} else if (tex->type == GS_TEXTURE_CUBE) {
+		const struct gs_texture_cube *cube = (const void*)tex;
+		int   face;
+		float u, v;
+
+		get_cube_face(coord, &face, &u, &v);
+
+		surf.data     = cube->data[face];
+		surf.width    = (int)cube->size;
+		surf.height   = (int)cube->size;
+		surf.linesize = cube->linesize;
+		sample_surface(&surf, ss, u, v, color);
+
+	} else {
+		memset(color, 0, sizeof(float) * 4);
+	}
+}
+
+void sw_texture_load(const gs_texture_t *tex, int x, int y, float *color)
+{
+	const struct gs_texture_2d *tex2d = (const void*)tex;
+
+	if (tex->type != GS_TEXTURE_2D || !tex2d->data ||
+	    gs_is_compressed_format(tex->format) ||
+	    x < 0 || y < 0 ||
+	    (uint32_t)x >= tex2d->width || (uint32_t)y >= tex2d->height) {
+		memset(color, 0, sizeof(float) * 4);
+		return;
+	}
+
+	sw_read_texel(tex->format, tex2d->data + (uint32_t)y * tex2d->linesize +
+			(uint32_t)x * tex->bytes_per_pixel, color);
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool sw_get_target(gs_device_t *device, struct sw_target *target)
+{
+	gs_texture_t *tex = device->cur_render_target;
+
+	if (!tex)
+		return false;
+
+	target->format          = tex->format;
+	target->bytes_per_pixel = tex->bytes_per_pixel;
+	target->zs              = device->cur_zstencil_buffer;
+
+	if (tex->type == GS_TEXTURE_2D) {
+		struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+		target->width    = tex2d->width;
+		target->height   = tex2d->height;
+		target->linesize = tex2d->linesize;
+		target->data     = tex2d->data;
+
+	} else if (tex->type == GS_TEXTURE_CUBE) {
+		struct gs_texture_cube *cube = (struct gs_texture_cube*)tex;
+		int side = device->cur_render_side;
+
+		if (side < 0 || side >= 6)
+			return false;
+
+		target->width    = cube->size;
+		target->height   = cube->size;
+		target->linesize = cube->linesize;
+		target->data     = cube->data[side];
+
+	} else {
+		return false;
+	}
+
+	return target->data != NULL &&
+	       !gs_is_compressed_format(target->format);
+}
@@ -0,0 +1,162 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "sw-subsystem.h"
+
+/* copies tightly packed source rows into the (aligned) texture rows */
+void sw_upload_surface(uint8_t *dst, uint32_t linesize,
+		enum gs_color_format format, uint32_t width, uint32_t height,
+		const uint8_t *src)
+{
+	uint32_t src_linesize;
+	uint32_t rows = height;
+
+	if (gs_is_compressed_format(format)) {
+		src_linesize = linesize;
+		rows = (height + 3) / 4;
+	} else {
+		src_linesize = width * gs_get_format_bpp(format) / 8;
+	}
+
+	for (uint32_t y = 0; y < rows; y++)
+		memcpy(dst + y * linesize, src + y * src_linesize,
+				src_linesize);
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture_2d *tex;
+	uint32_t             rows;
+
+	if (!width || !height || color_format == GS_UNKNOWN) {
+		blog(LOG_ERROR, "device_texture_create (software) failed: "
+		                "invalid size or format");
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture_2d));
+	tex->base.device           = device;
+	tex->base.type             = GS_TEXTURE_2D;
+	tex->base.format           = color_format;
+	tex->base.levels           = levels;
+	tex->base.bytes_per_pixel  = gs_get_format_bpp(color_format) / 8;
+	tex->base.is_dynamic       = (flags & GS_DYNAMIC)       != 0;
+	tex->base.is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->width                 = width;
+	tex->height                = height;
+	tex->linesize              = sw_get_linesize(color_format, width);
+
+	rows = gs_is_compressed_format(color_format) ?
+		(height + 3) / 4 : height;
+	tex->data = bzalloc(tex->linesize * rows);
+
+	if (data && *data)
+		sw_upload_surface(tex->data, tex->linesize, color_format,
+				width, height, *data);
+
+	return (gs_texture_t*)tex;
+}
+
+static inline bool is_texture_2d(const gs_texture_t *tex, const char *func)
+{
+	bool is_tex2d = tex->type == GS_TEXTURE_2D;
+	if (!is_tex2d)
+		blog(LOG_ERROR, "%s (software) failed:  Not a 2D texture",
+				func);
+	return is_tex2d;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	if (!tex)
+		return;
+
+	if (!is_texture_2d(tex, "gs_texture_destroy"))
+		return;
+
+	sw_unbind_texture(tex->device, tex);
+
+	bfree(tex2d->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_width"))
+		return 0;
+
+	return tex2d->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_height"))
+		return 0;
+
+	return tex2d->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+
+	if (!is_texture_2d(tex, "gs_texture_map"))
+		goto fail;
+
+	if (!tex2d->base.is_dynamic) {
+		blog(LOG_ERROR, "Texture is not dynamic");
+		goto fail;
+	}
+
+	*ptr      = tex2d->data;
+	*linesize = tex2d->linesize;
+	return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_map (software) failed");
+	return false;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	is_texture_2d(tex, "gs_texture_unmap");
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_obj"))
+		return NULL;
+
+	return tex2d->data;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "sw-subsystem.h"
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture_cube *tex;
+	uint32_t               rows;
+	uint32_t               num_levels = levels;
+
+	if (!size || color_format == GS_UNKNOWN) {
+		blog(LOG_ERROR, "device_cubetexture_create (software) failed: "
+		                "invalid size or format");
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture_cube));
+	tex->base.device           = device;
+	tex->base.type             = GS_TEXTURE_CUBE;
+	tex->base.format           = color_format;
+	tex->base.levels           = levels;
+	tex->base.bytes_per_pixel  = gs_get_format_bpp(color_format) / 8;
+	tex->base.is_dynamic       = (flags & GS_DYNAMIC)       != 0;
+	tex->base.is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->size                  = size;
+	tex->linesize              = sw_get_linesize(color_format, size);
+
+	if (!num_levels)
+		num_levels = gs_get_total_levels(size, size);
+
+	rows = gs_is_compressed_format(color_format) ? (size + 3) / 4 : size;
+
+	/* the data array contains all mip levels of each face in order, only
+	 * the first level of each face is kept */
+	for (size_t i = 0; i < 6; i++) {
+		tex->data[i] = bzalloc(tex->linesize * rows);
+
+		if (data && data[i * num_levels])
+			sw_upload_surface(tex->data[i], tex->linesize,
+					color_format, size, size,
+					data[i * num_levels]);
+	}
+
+	return (gs_texture_t*)tex;
+}
+
+static inline bool is_texture_cube(const gs_texture_t *tex, const char *func)
+{
+	bool is_texcube = tex->type == GS_TEXTURE_CUBE;
+	if (!is_texcube)
+		blog(LOG_ERROR, "%s (software) failed:  Not a cubemap texture",
+				func);
+	return is_texcube;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *tex)
+{
+	struct gs_texture_cube *cube = (struct gs_texture_cube*)tex;
+	if (!tex)
+		return;
+
+	if (!is_texture_cube(tex, "gs_cubetexture_destroy"))
+		return;
+
+	sw_unbind_texture(tex->device, tex);
+
+	for (size_t i = 0; i < 6; i++)
+		bfree(cube->data[i]);
+	bfree(tex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	const struct gs_texture_cube *cube =
+		(const struct gs_texture_cube*)cubetex;
+
+	if (!is_texture_cube(cubetex, "gs_cubetexture_get_size"))
+		return 0;
+
+	return cube->size;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
@@ -47,6 +47,7 @@ struct calldata {
 	size_t  size;     /* size of the stack, in bytes */
 	size_t  capacity; /* capacity of the stack, in bytes */
 	uint8_t *stack;
+	bool    fixed;    /* stack is owned by the caller and cannot grow */
 };
 
 typedef struct calldata calldata_t;
@@ -58,7 +59,8 @@ static inline void calldata_init(struct calldata *data)
 
 static inline void calldata_free(struct calldata *data)
 {
-	bfree(data->stack);
+	if (!data->fixed)
+		bfree(data->stack);
 }
 
 EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
@@ -74,6 +76,21 @@ static inline void calldata_clear(struct calldata *data)
 	}
 }
 
+/*
+ * Uses a caller-supplied buffer (typically on the stack) as the parameter
+ * stack, so signals emitted at high rates can pass parameters without any
+ * heap allocation.  Parameters that do not fit in the buffer are not set.
+ */
+static inline void calldata_init_fixed(struct calldata *data, uint8_t *stack,
+		size_t size)
+{
+	data->stack    = stack;
+	data->capacity = size;
+	data->fixed    = true;
+	data->size     = 0;
+	calldata_clear(data);
+}
+
 /* ------------------------------------------------------------------------- */
 /* NOTE: 'get' functions return true only if paramter exists, and is the
  *       same type.  They return false otherwise. */
@@ -16,43 +16,73 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ *   Callback lists are copy-on-write: connecting or disconnecting builds a
+ * new list and swaps it in, so signalling never locks or allocates.  A
+ * replaced list is freed once no thread is signalling anymore, and
+ * disconnecting waits until other threads are done with the old list, so a
+ * callback is never called after signal_handler_disconnect returns (unless
+ * it is disconnected from within its own signal).
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void              *data;
-	bool              remove;
+};
+
+struct signal_callbacks {
+	size_t                 num;
+	struct signal_callback *array;
 };
 
 struct signal_info {
-	struct decl_info               func;
-	DARRAY(struct signal_callback) callbacks;
-	pthread_mutex_t                mutex;
-	bool                           signalling;
+	struct decl_info                 func;
+	struct signal_callbacks *volatile callbacks;
+	volatile long                    signalling;
+	DARRAY(struct signal_callbacks*) retired;
+	pthread_mutex_t                  mutex;
 
-	struct signal_info             *next;
+	struct signal_info *volatile     next;
 };
 
-static inline struct signal_info *signal_info_create(struct decl_info *info)
+/* signals currently being signalled by this thread */
+struct signal_emission {
+	struct signal_info     *sig;
+	struct signal_emission *prev;
+};
+
+#ifdef _MSC_VER
+static __declspec(thread) struct signal_emission *thread_emissions = NULL;
+#else
+static __thread struct signal_emission *thread_emissions = NULL;
+#endif
+
+static inline struct signal_callbacks *signal_callbacks_create(size_t num)
 {
-	pthread_mutexattr_t attr;
-	struct signal_info *si;
+	struct signal_callbacks *cbs = bmalloc(sizeof(struct signal_callbacks) +
+			sizeof(struct signal_callback) * num);
+	cbs->num   = num;
+	cbs->array = (struct signal_callback*)(cbs + 1);
+	return cbs;
+}
 
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
+static inline struct signal_callbacks *get_callbacks(struct signal_info *si)
+{
+	return os_atomic_load_ptr((void *const volatile*)&si->callbacks);
+}
 
-	si = bmalloc(sizeof(struct signal_info));
+static inline struct signal_info *signal_info_create(struct decl_info *info)
+{
+	struct signal_info *si = bzalloc(sizeof(struct signal_info));
 
-	si->func       = *info;
-	si->next       = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->func = *info;
 
-	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -66,18 +96,25 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		for (size_t i = 0; i < si->retired.num; i++)
+			bfree(si->retired.array[i]);
+
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
+		da_free(si->retired);
+		bfree(si->callbacks);
 		bfree(si);
 	}
 }
 
+/* call with the signal mutex locked */
 static inline size_t signal_get_callback_idx(struct signal_info *si,
 		signal_callback_t callback, void *data)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array+i;
+	struct signal_callbacks *cbs = si->callbacks;
+
+	for (size_t i = 0; cbs && i < cbs->num; i++) {
+		struct signal_callback *sc = cbs->array+i;
 
 		if (sc->callback == callback && sc->data == data)
 			return i;
@@ -86,23 +123,63 @@ static inline size_t signal_get_callback_idx(struct signal_info *si,
 	return DARRAY_INVALID;
 }
 
+/* call with the signal mutex locked */
+static void signal_info_publish(struct signal_info *si,
+		struct signal_callbacks *cbs)
+{
+	struct signal_callbacks *old;
+
+	old = os_atomic_exchange_ptr((void *volatile*)&si->callbacks, cbs);
+	if (old)
+		da_push_back(si->retired, &old);
+}
+
+/* call with the signal mutex locked */
+static void signal_info_reclaim(struct signal_info *si)
+{
+	/* a thread that starts signalling after this check is guaranteed to
+	 * see the currently published list */
+	if (os_atomic_load_long(&si->signalling) != 0)
+		return;
+
+	for (size_t i = 0; i < si->retired.num; i++)
+		bfree(si->retired.array[i]);
+	da_resize(si->retired, 0);
+}
+
+/* waits for other threads to finish signalling with replaced lists */
+static void signal_info_synchronize(struct signal_info *si)
+{
+	struct signal_emission *emission = thread_emissions;
+	long own = 0;
+
+	for (; emission != NULL; emission = emission->prev)
+		if (emission->sig == si)
+			own++;
+
+	while (os_atomic_load_long(&si->signalling) > own)
+		os_sleep_ms(0);
+}
+
 struct signal_handler {
-	struct signal_info *first;
-	pthread_mutex_t    mutex;
+	struct signal_info *volatile first;
+	pthread_mutex_t              mutex;
 };
 
+/* signals are never removed, so the list can be walked without locking */
 static struct signal_info *getsignal(signal_handler_t *handler,
 		const char *name, struct signal_info **p_last)
 {
 	struct signal_info *signal, *last= NULL;
 
-	signal = handler->first;
+	signal = os_atomic_load_ptr((void *const volatile*)&handler->first);
 	while (signal != NULL) {
 		if (strcmp(signal->func.name, name) == 0)
 			break;
 
 		last = signal;
-		signal = signal->next;
+		signal = os_atomic_load_ptr(
+				(void *const volatile*)&signal->next);
 	}
 
 	if (p_last)
@@ -162,9 +239,11 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	} else {
 		sig = signal_info_create(&func);
 		if (!last)
-			handler->first = sig;
+			os_atomic_exchange_ptr((void *volatile*)&handler->first,
+					sig);
 		else
-			last->next = sig;
+			os_atomic_exchange_ptr((void *volatile*)&last->next,
+					sig);
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -172,20 +251,26 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	return success;
 }
 
+signal_info_t *signal_handler_get_signal(signal_handler_t *handler,
+		const char *signal)
+{
+	if (!handler || !signal)
+		return NULL;
+
+	return getsignal(handler, signal, NULL);
+}
+
 void signal_handler_connect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false};
-	size_t idx;
+	struct signal_callbacks *cbs;
+	struct signal_info *sig;
+	size_t num;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal(handler, signal, NULL);
 	if (!sig) {
 		blog(LOG_WARNING, "signal_handler_connect: "
 		                  "signal '%s' not found", signal);
@@ -196,72 +281,95 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
-	
-	pthread_mutex_unlock(&sig->mutex);
-}
-
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-		const char *name)
-{
-	struct signal_info *sig;
+	if (signal_get_callback_idx(sig, callback, data) == DARRAY_INVALID) {
+		num = sig->callbacks ? sig->callbacks->num : 0;
 
-	if (!handler)
-		return NULL;
+		cbs = signal_callbacks_create(num + 1);
+		if (num)
+			memcpy(cbs->array, sig->callbacks->array,
+					sizeof(struct signal_callback) * num);
+		cbs->array[num].callback = callback;
+		cbs->array[num].data     = data;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
+		signal_info_publish(sig, cbs);
+		signal_info_reclaim(sig);
+	}
 
-	return sig;
+	pthread_mutex_unlock(&sig->mutex);
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	size_t idx;
+	struct signal_callbacks *cbs = NULL;
+	struct signal_info *sig;
+	size_t idx, num;
+
+	if (!handler)
+		return;
 
+	sig = getsignal(handler, signal, NULL);
 	if (!sig)
 		return;
 
 	pthread_mutex_lock(&sig->mutex);
 
 	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling)
-			sig->callbacks.array[idx].remove = true;
-		else
-			da_erase(sig->callbacks, idx);
+	if (idx == DARRAY_INVALID) {
+		pthread_mutex_unlock(&sig->mutex);
+		return;
+	}
+
+	num = sig->callbacks->num - 1;
+	if (num) {
+		struct signal_callback *old = sig->callbacks->array;
+
+		cbs = signal_callbacks_create(num);
+		memcpy(cbs->array, old, sizeof(struct signal_callback) * idx);
+		memcpy(cbs->array + idx, old + idx + 1,
+				sizeof(struct signal_callback) * (num - idx));
 	}
-	
+
+	signal_info_publish(sig, cbs);
+
+	pthread_mutex_unlock(&sig->mutex);
+
+	/* callbacks may connect or disconnect themselves, so wait without
+	 * holding the mutex */
+	signal_info_synchronize(sig);
+
+	pthread_mutex_lock(&sig->mutex);
+	signal_info_reclaim(sig);
 	pthread_mutex_unlock(&sig->mutex);
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal,
-		calldata_t *params)
+void signal_emit(signal_info_t *sig, calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_emission emission;
+	struct signal_callbacks *cbs;
 
-	if (!sig)
+	if (!sig || !get_callbacks(sig))
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	emission.sig  = sig;
+	emission.prev = thread_emissions;
+	thread_emissions = &emission;
+
+	os_atomic_inc_long(&sig->signalling);
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array+i;
+	cbs = get_callbacks(sig);
+	for (size_t i = 0; cbs && i < cbs->num; i++) {
+		struct signal_callback *cb = cbs->array+i;
 		cb->callback(cb->data, params);
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array+i-1;
-		if (cb->remove)
-			da_erase(sig->callbacks, i-1);
-	}
+	os_atomic_dec_long(&sig->signalling);
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	thread_emissions = emission.prev;
+}
+
+void signal_handler_signal(signal_handler_t *handler, const char *signal,
+		calldata_t *params)
+{
+	signal_emit(signal_handler_get_signal(handler, signal), params);
 }
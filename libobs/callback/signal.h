@@ -32,7 +32,9 @@ extern "C" {
  */
 
 struct signal_handler;
+struct signal_info;
 typedef struct signal_handler signal_handler_t;
+typedef struct signal_info signal_info_t;
 typedef void (*signal_callback_t)(void*, calldata_t*);
 
 EXPORT signal_handler_t *signal_handler_create(void);
@@ -63,6 +65,17 @@ EXPORT void signal_handler_disconnect(signal_handler_t *handler,
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params);
 
+/*
+ * Resolves a signal by name once, so that signals emitted at a high rate do
+ * not have to be looked up every time.  The returned signal stays valid for
+ * the lifetime of the handler.
+ */
+EXPORT signal_info_t *signal_handler_get_signal(signal_handler_t *handler,
+		const char *signal);
+
+/* Signals a resolved signal.  Never locks or allocates. */
+EXPORT void signal_emit(signal_info_t *signal, calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,482 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/platform.h"
+#include "../util/dstr.h"
+#include "effect.h"
+#include "effect-cache.h"
+
+#define EFFECT_CACHE_MAGIC 0x5846424F /* "OBFX" */
+
+static char *cache_path = NULL;
+
+void gs_set_cache_path(const char *path)
+{
+	bfree(cache_path);
+	cache_path = (path && *path) ? bstrdup(path) : NULL;
+}
+
+const char *effect_cache_get_path(void)
+{
+	return cache_path;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* 64bit FNV-1a */
+static inline uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+static inline uint64_t hash_str(uint64_t hash, const char *str)
+{
+	return str ? hash_data(hash, str, strlen(str) + 1) : hash;
+}
+
+extern const char *gs_preprocessor_name(void);
+
+static uint64_t get_effect_key(const char *effect_string)
+{
+	uint64_t key = 0xCBF29CE484222325ULL;
+	uint32_t version = EFFECT_CACHE_VERSION;
+
+	key = hash_data(key, &version, sizeof(version));
+	key = hash_str(key, gs_get_device_name());
+	key = hash_str(key, gs_preprocessor_name());
+	key = hash_str(key, effect_string);
+	return key;
+}
+
+static void get_entry_path(struct dstr *path, uint64_t key)
+{
+	dstr_copy(path, cache_path);
+	dstr_replace(path, "\\", "/");
+	if (dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+
+	dstr_catf(path, "%016llX.effect", (unsigned long long)key);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct cache_reader {
+	const uint8_t *data;
+	size_t        size;
+	size_t        pos;
+	bool          error;
+};
+
+static inline const void *read_data(struct cache_reader *r, size_t size)
+{
+	const void *data;
+
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	data = r->data + r->pos;
+	r->pos += size;
+	return data;
+}
+
+static inline uint32_t read_u32(struct cache_reader *r)
+{
+	const uint8_t *data = read_data(r, 4);
+	if (!data)
+		return 0;
+
+	return (uint32_t)data[0]         | ((uint32_t)data[1] << 8) |
+	       ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint64_t read_u64(struct cache_reader *r)
+{
+	uint64_t low = read_u32(r);
+	return low | ((uint64_t)read_u32(r) << 32);
+}
+
+static char *read_str(struct cache_reader *r)
+{
+	size_t     len  = read_u32(r);
+	const char *str = read_data(r, len);
+
+	return str ? bstrdup_n(str, len) : NULL;
+}
+
+static bool read_param(struct cache_reader *r, gs_effect_t *effect,
+		struct gs_effect_param *param)
+{
+	const void *default_val;
+	size_t     default_size;
+
+	param->name    = read_str(r);
+	param->type    = (enum gs_shader_param_type)read_u32(r);
+	param->section = EFFECT_PARAM;
+	param->effect  = effect;
+
+	default_size = read_u32(r);
+	default_val  = read_data(r, default_size);
+	if (!param->name || r->error)
+		return false;
+
+	da_push_back_array(param->default_val, default_val, default_size);
+
+	if (strcmp(param->name, "ViewProj") == 0)
+		effect->view_proj = param;
+	else if (strcmp(param->name, "World") == 0)
+		effect->world = param;
+
+	return true;
+}
+
+static bool read_pass_shader(struct cache_reader *r, gs_effect_t *effect,
+		struct gs_effect_technique *tech, struct gs_effect_pass *pass,
+		size_t pass_idx, enum gs_shader_type type)
+{
+	struct dstr location = {0};
+	char        *shader_str;
+	gs_shader_t *shader;
+	struct darray *pass_params;
+	size_t      num_params;
+	bool        success = true;
+
+	shader_str = read_str(r);
+	num_params = read_u32(r);
+	if (!shader_str || r->error || num_params > r->size - r->pos) {
+		bfree(shader_str);
+		return false;
+	}
+
+	dstr_printf(&location, "%s (%s shader, technique %s, pass %u)",
+			effect->effect_path,
+			type == GS_SHADER_VERTEX ? "Vertex" : "Pixel",
+			tech->name, (unsigned int)pass_idx);
+
+	if (type == GS_SHADER_VERTEX) {
+		pass->vertshader = gs_vertexshader_create(shader_str,
+				location.array, NULL);
+		shader      = pass->vertshader;
+		pass_params = &pass->vertshader_params.da;
+	} else {
+		pass->pixelshader = gs_pixelshader_create(shader_str,
+				location.array, NULL);
+		shader      = pass->pixelshader;
+		pass_params = &pass->pixelshader_params.da;
+	}
+
+	dstr_free(&location);
+	bfree(shader_str);
+
+	if (!shader)
+		return false;
+
+	darray_resize(sizeof(struct pass_shaderparam), pass_params,
+			num_params);
+
+	for (size_t i = 0; i < num_params; i++) {
+		struct pass_shaderparam *param;
+		char *name = read_str(r);
+
+		if (!name) {
+			success = false;
+			break;
+		}
+
+		param = darray_item(sizeof(struct pass_shaderparam),
+				pass_params, i);
+		param->eparam = gs_effect_get_param_by_name(effect, name);
+		param->sparam = gs_shader_get_param_by_name(shader, name);
+		bfree(name);
+
+		if (!param->sparam) {
+			success = false;
+			break;
+		}
+	}
+
+	return success;
+}
+
+static bool read_technique(struct cache_reader *r, gs_effect_t *effect,
+		struct gs_effect_technique *tech)
+{
+	size_t num_passes;
+
+	tech->name    = read_str(r);
+	tech->section = EFFECT_TECHNIQUE;
+	tech->effect  = effect;
+
+	num_passes = read_u32(r);
+	if (!tech->name || r->error || num_passes > r->size - r->pos)
+		return false;
+
+	da_resize(tech->passes, num_passes);
+
+	for (size_t i = 0; i < num_passes; i++) {
+		struct gs_effect_pass *pass = tech->passes.array + i;
+
+		pass->name    = read_str(r);
+		pass->section = EFFECT_PASS;
+		if (!pass->name)
+			return false;
+
+		if (!read_pass_shader(r, effect, tech, pass, i,
+					GS_SHADER_VERTEX))
+			return false;
+		if (!read_pass_shader(r, effect, tech, pass, i,
+					GS_SHADER_PIXEL))
+			return false;
+	}
+
+	return true;
+}
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE    *f = os_fopen(path, "rb");
+	uint8_t *data = NULL;
+	int64_t file_size;
+
+	if (!f)
+		return NULL;
+
+	file_size = os_fgetsize(f);
+	if (file_size > 0) {
+		data = bmalloc((size_t)file_size);
+		if (fread(data, 1, (size_t)file_size, f) != (size_t)file_size) {
+			bfree(data);
+			data = NULL;
+		}
+	}
+
+	fclose(f);
+	*size = (size_t)file_size;
+	return data;
+}
+
+static inline uint64_t hash_file(const char *path, bool *success)
+{
+	size_t  size;
+	uint8_t *data = read_file(path, &size);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	*success = data != NULL;
+	if (data) {
+		hash = hash_data(hash, data, size);
+		bfree(data);
+	}
+
+	return hash;
+}
+
+/* the effect string is part of the key, but included files are not, so the
+ * entry lists them with a hash of their contents at the time it was saved */
+static bool check_includes(struct cache_reader *r)
+{
+	size_t num = read_u32(r);
+
+	if (r->error || num > r->size - r->pos)
+		return false;
+
+	for (size_t i = 0; i < num; i++) {
+		char     *file = read_str(r);
+		uint64_t hash  = read_u64(r);
+		bool     found = false;
+
+		if (file && hash_file(file, &found) != hash)
+			found = false;
+
+		bfree(file);
+		if (!found || r->error)
+			return false;
+	}
+
+	return true;
+}
+
+static bool read_effect(struct cache_reader *r, gs_effect_t *effect,
+		uint64_t key)
+{
+	size_t num;
+
+	if (read_u32(r) != EFFECT_CACHE_MAGIC ||
+	    read_u32(r) != EFFECT_CACHE_VERSION ||
+	    read_u64(r) != key)
+		return false;
+
+	if (!check_includes(r))
+		return false;
+
+	/* the counts are validated against the data size before allocating
+	 * anything, in case the file is corrupted */
+	num = read_u32(r);
+	if (r->error || num > r->size - r->pos)
+		return false;
+
+	da_resize(effect->params, num);
+	for (size_t i = 0; i < num; i++) {
+		if (!read_param(r, effect, effect->params.array + i))
+			return false;
+	}
+
+	num = read_u32(r);
+	if (r->error || num > r->size - r->pos)
+		return false;
+
+	da_resize(effect->techniques, num);
+	for (size_t i = 0; i < num; i++) {
+		if (!read_technique(r, effect, effect->techniques.array + i))
+			return false;
+	}
+
+	return !r->error && r->pos == r->size;
+}
+
+static void reset_effect(gs_effect_t *effect)
+{
+	size_t i;
+
+	for (i = 0; i < effect->params.num; i++)
+		effect_param_free(effect->params.array+i);
+	for (i = 0; i < effect->techniques.num; i++)
+		effect_technique_free(effect->techniques.array+i);
+
+	da_free(effect->params);
+	da_free(effect->techniques);
+	effect->view_proj = NULL;
+	effect->world     = NULL;
+}
+
+bool effect_cache_load(gs_effect_t *effect, const char *effect_string)
+{
+	struct cache_reader reader = {0};
+	struct dstr         path   = {0};
+	uint8_t             *data;
+	uint64_t            key;
+	bool                success;
+
+	if (!cache_path || !effect->effect_path)
+		return false;
+
+	key = get_effect_key(effect_string);
+	get_entry_path(&path, key);
+
+	data = read_file(path.array, &reader.size);
+	if (!data) {
+		dstr_free(&path);
+		return false;
+	}
+
+	reader.data = data;
+	success = read_effect(&reader, effect, key);
+	if (!success) {
+		blog(LOG_DEBUG, "effect_cache_load: Discarding invalid cache "
+		                "entry for '%s'", effect->effect_path);
+		reset_effect(effect);
+		os_unlink(path.array);
+	}
+
+	bfree(data);
+	dstr_free(&path);
+	return success;
+}
+
+static bool write_file(const char *path, const void *data, size_t size)
+{
+	FILE *f = os_fopen(path, "wb");
+	bool success;
+
+	if (!f)
+		return false;
+
+	success = fwrite(data, 1, size, f) == size;
+	success = (fclose(f) == 0) && success;
+	return success;
+}
+
+static bool write_includes(struct serializer *s,
+		const struct cf_preprocessor *pp)
+{
+	s_wl32(s, (uint32_t)pp->dependencies.num);
+
+	for (size_t i = 0; i < pp->dependencies.num; i++) {
+		const char *file = pp->dependencies.array[i].file;
+		bool     success;
+		uint64_t hash = hash_file(file, &success);
+
+		if (!success)
+			return false;
+
+		effect_cache_write_str(s, file);
+		s_wl64(s, hash);
+	}
+
+	return true;
+}
+
+void effect_cache_save(const char *effect_string,
+		const struct cf_preprocessor *pp,
+		struct array_output_data *data)
+{
+	struct array_output_data header_data;
+	struct serializer        header;
+	struct dstr              path     = {0};
+	struct dstr              tmp_path = {0};
+	uint64_t                 key;
+
+	if (!cache_path)
+		return;
+
+	key = get_effect_key(effect_string);
+	get_entry_path(&path, key);
+	dstr_printf(&tmp_path, "%s.tmp", path.array);
+
+	/* prepend the header so the entry can be written in one go */
+	array_output_serializer_init(&header, &header_data);
+	s_wl32(&header, EFFECT_CACHE_MAGIC);
+	s_wl32(&header, EFFECT_CACHE_VERSION);
+	s_wl64(&header, key);
+	if (!write_includes(&header, pp))
+		goto exit;
+
+	da_push_back_array(header_data.bytes,
+			data->bytes.array, data->bytes.num);
+
+	/* write to a temporary file first so that a partially written entry
+	 * can never be loaded */
+	if (write_file(tmp_path.array, header_data.bytes.array,
+				header_data.bytes.num)) {
+		if (os_rename(tmp_path.array, path.array) != 0)
+			os_unlink(tmp_path.array);
+	} else {
+		os_unlink(tmp_path.array);
+	}
+
+exit:
+	array_output_serializer_free(&header_data);
+	dstr_free(&tmp_path);
+	dstr_free(&path);
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/serializer.h"
+#include "../util/array-serializer.h"
+#include "../util/cf-lexer.h"
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Effect cache
+ *
+ *   Stores the compiled description of an effect (parameters, techniques,
+ * passes and the generated shader strings of each pass) on disk, so the next
+ * time the same effect is loaded it does not have to be lexed and parsed
+ * again.  Cache entries are keyed on a hash of the effect text and the
+ * graphics device, so modified effects automatically miss the cache.  Each
+ * entry also lists the files the effect included with a hash of their
+ * contents, and is discarded if any of them changed.
+ *
+ *   While an effect is being compiled, the effect parser writes its output to
+ * a serializer (see effect_parser::cache), which is then saved to disk if
+ * compilation succeeded.
+ */
+
+#define EFFECT_CACHE_VERSION 2
+
+extern const char *effect_cache_get_path(void);
+
+extern bool effect_cache_load(gs_effect_t *effect, const char *effect_string);
+extern void effect_cache_save(const char *effect_string,
+		const struct cf_preprocessor *pp,
+		struct array_output_data *data);
+
+static inline void effect_cache_write_str(struct serializer *s,
+		const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	s_wl32(s, (uint32_t)len);
+	s_write(s, str, len);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,6 +19,7 @@
 #include "../util/platform.h"
 #include "effect-parser.h"
 #include "effect.h"
+#include "effect-cache.h"
 
 void ep_free(struct effect_parser *ep)
 {
@@ -1327,6 +1328,11 @@ static void ep_compile_param(struct effect_parser *ep, size_t idx)
 		ep->effect->view_proj = param;
 	else if (strcmp(param_in->name, "World") == 0)
 		ep->effect->world = param;
+
+	effect_cache_write_str(ep->cache, param->name);
+	s_wl32(ep->cache, (uint32_t)param->type);
+	s_wl32(ep->cache, (uint32_t)param->default_val.num);
+	s_write(ep->cache, param->default_val.array, param->default_val.num);
 }
 
 static bool ep_compile_pass_shaderparams(struct effect_parser *ep,
@@ -1359,6 +1365,21 @@ static bool ep_compile_pass_shaderparams(struct effect_parser *ep,
 	return true;
 }
 
+static void ep_write_cached_shader(struct effect_parser *ep,
+		struct dstr *shader_str, struct darray *used_params)
+{
+	struct dstr *param_names = used_params->array;
+
+	if (!ep->cache)
+		return;
+
+	effect_cache_write_str(ep->cache, shader_str->array);
+	s_wl32(ep->cache, (uint32_t)used_params->num);
+
+	for (size_t i = 0; i < used_params->num; i++)
+		effect_cache_write_str(ep->cache, param_names[i].array);
+}
+
 static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 		struct gs_effect_technique *tech,
 		struct gs_effect_pass *pass, struct ep_pass *pass_in,
@@ -1389,6 +1410,7 @@ static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 	if (type == GS_SHADER_VERTEX) {
 		ep_makeshaderstring(ep, &shader_str,
 				&pass_in->vertex_program.da, &used_params);
+		ep_write_cached_shader(ep, &shader_str, &used_params);
 
 		pass->vertshader = gs_vertexshader_create(shader_str.array,
 				location.array, NULL);
@@ -1398,6 +1420,7 @@ static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 	} else if (type == GS_SHADER_PIXEL) {
 		ep_makeshaderstring(ep, &shader_str,
 				&pass_in->fragment_program.da, &used_params);
+		ep_write_cached_shader(ep, &shader_str, &used_params);
 
 		pass->pixelshader = gs_pixelshader_create(shader_str.array,
 				location.array, NULL);
@@ -1443,6 +1466,8 @@ static bool ep_compile_pass(struct effect_parser *ep,
 	pass->name = bstrdup(pass_in->name);
 	pass->section = EFFECT_PASS;
 
+	effect_cache_write_str(ep->cache, pass->name);
+
 	if (!ep_compile_pass_shader(ep, tech, pass, pass_in, idx,
 				GS_SHADER_VERTEX))
 		success = false;
@@ -1470,6 +1495,9 @@ static inline bool ep_compile_technique(struct effect_parser *ep, size_t idx)
 
 	da_resize(tech->passes, tech_in->passes.num);
 
+	effect_cache_write_str(ep->cache, tech->name);
+	s_wl32(ep->cache, (uint32_t)tech->passes.num);
+
 	for (i = 0; i < tech->passes.num; i++) {
 		if (!ep_compile_pass(ep, tech, tech_in, i))
 			success = false;
@@ -1488,8 +1516,11 @@ static bool ep_compile(struct effect_parser *ep)
 	da_resize(ep->effect->params, ep->params.num);
 	da_resize(ep->effect->techniques, ep->techniques.num);
 
+	s_wl32(ep->cache, (uint32_t)ep->params.num);
 	for (i = 0; i < ep->params.num; i++)
 		ep_compile_param(ep, i);
+
+	s_wl32(ep->cache, (uint32_t)ep->techniques.num);
 	for (i = 0; i < ep->techniques.num; i++) {
 		if (!ep_compile_technique(ep, i))
 			success = false;
@@ -256,6 +256,9 @@ struct effect_parser {
 	DARRAY(struct cf_token) tokens;
 	struct gs_effect_pass *cur_pass;
 
+	/* if set, the compiled effect is written here for the effect cache */
+	struct serializer *cache;
+
 	struct cf_parser cfp;
 };
 
@@ -270,6 +273,7 @@ static inline void ep_init(struct effect_parser *ep)
 	da_init(ep->tokens);
 
 	ep->cur_pass = NULL;
+	ep->cache    = NULL;
 	cf_parser_init(&ep->cfp);
 }
 
@@ -5,6 +5,11 @@
 #include <libswscale/swscale.h>
 
 #include "../obs-ffmpeg-compat.h"
+#include "../util/threading.h"
+
+/* images can be decoded from any thread, and codec open/close is not
+ * thread safe without a lock manager */
+static pthread_mutex_t codec_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 struct ffmpeg_image {
 	const char         *file;
@@ -39,7 +44,9 @@ static bool ffmpeg_image_open_decoder_context(struct ffmpeg_image *info)
 		return false;
 	}
 
+	pthread_mutex_lock(&codec_mutex);
 	ret = avcodec_open2(info->decoder_ctx, info->decoder, NULL);
+	pthread_mutex_unlock(&codec_mutex);
 	if (ret < 0) {
 		blog(LOG_WARNING, "Failed to open video codec for file '%s': "
 		                  "%s", info->file, av_err2str(ret));
@@ -51,7 +58,9 @@ static bool ffmpeg_image_open_decoder_context(struct ffmpeg_image *info)
 
 static void ffmpeg_image_free(struct ffmpeg_image *info)
 {
+	pthread_mutex_lock(&codec_mutex);
 	avcodec_close(info->decoder_ctx);
+	pthread_mutex_unlock(&codec_mutex);
 	avformat_close_input(&info->fmt_ctx);
 }
 
@@ -201,21 +210,25 @@ static inline enum gs_color_format convert_format(enum AVPixelFormat format)
 	return GS_BGRX;
 }
 
-gs_texture_t *gs_texture_create_from_file(const char *file)
+uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx, uint32_t *cy)
 {
 	struct ffmpeg_image image;
-	gs_texture_t           *tex = NULL;
+	uint8_t             *data = NULL;
 
 	if (ffmpeg_image_init(&image, file)) {
-		uint8_t *data = malloc(image.cx * image.cy * 4);
+		data = bmalloc(image.cx * image.cy * 4);
+
 		if (ffmpeg_image_decode(&image, data, image.cx * 4)) {
-			tex = gs_texture_create(image.cx, image.cy,
-					convert_format(image.format),
-					1, (const uint8_t**)&data, 0);
+			*format = convert_format(image.format);
+			*cx     = (uint32_t)image.cx;
+			*cy     = (uint32_t)image.cy;
+		} else {
+			bfree(data);
+			data = NULL;
 		}
 
 		ffmpeg_image_free(&image);
-		free(data);
 	}
-	return tex;
+	return data;
 }
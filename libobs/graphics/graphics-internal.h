@@ -29,6 +29,7 @@ struct gs_exports {
 	bool (*device_enum_adapters)(
 			bool (*callback)(void*, const char*, uint32_t),
 			void*);
+	void (*device_set_cache_path)(gs_device_t *device, const char *path);
 	const char *(*device_preprocessor_name)(void);
 	int (*device_create)(gs_device_t **device,
 			const struct gs_init_data *data);
@@ -27,6 +27,7 @@
 #include "axisang.h"
 #include "effect-parser.h"
 #include "effect.h"
+#include "effect-cache.h"
 
 #ifdef _MSC_VER
 static __declspec(thread) graphics_t *thread_graphics = NULL;
@@ -166,6 +167,10 @@ int gs_create(graphics_t **pgraphics, const char *module,
 	if (errcode != GS_SUCCESS)
 		goto error;
 
+	if (effect_cache_get_path() && graphics->exports.device_set_cache_path)
+		graphics->exports.device_set_cache_path(graphics->device,
+				effect_cache_get_path());
+
 	if (!graphics_init(graphics)) {
 		errcode = GS_ERROR_FAIL;
 		goto error;
@@ -711,12 +716,23 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 
 	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
 	struct effect_parser parser;
+	struct array_output_data cache_data;
+	struct serializer cache;
 	bool success;
 
 	effect->graphics = thread_graphics;
 	effect->effect_path = bstrdup(filename);
 
 	ep_init(&parser);
+
+	if (effect_cache_load(effect, effect_string))
+		goto cached;
+
+	if (effect->effect_path && effect_cache_get_path()) {
+		array_output_serializer_init(&cache, &cache_data);
+		parser.cache = &cache;
+	}
+
 	success = ep_parse(&parser, effect, effect_string, filename);
 	if (!success) {
 		if (error_string)
@@ -726,6 +742,14 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 		effect = NULL;
 	}
 
+	if (parser.cache) {
+		if (success)
+			effect_cache_save(effect_string, &parser.cfp.pp,
+					&cache_data);
+		array_output_serializer_free(&cache_data);
+	}
+
+cached:
 	if (effect) {
 		pthread_mutex_lock(&thread_graphics->effect_mutex);
 
@@ -786,6 +810,27 @@ gs_shader_t *gs_pixelshader_create_from_file(const char *file,
 	return shader;
 }
 
+gs_texture_t *gs_texture_create_from_file(const char *file)
+{
+	enum gs_color_format format;
+	uint32_t             cx;
+	uint32_t             cy;
+	uint8_t              *data;
+	gs_texture_t         *tex = NULL;
+
+	if (!thread_graphics || !file)
+		return NULL;
+
+	data = gs_create_texture_file_data(file, &format, &cx, &cy);
+	if (data) {
+		tex = gs_texture_create(cx, cy, format, 1,
+				(const uint8_t**)&data, 0);
+		bfree(data);
+	}
+
+	return tex;
+}
+
 static inline void assign_sprite_rect(float *start, float *end, float size,
 		bool flip)
 {
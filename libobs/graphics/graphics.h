@@ -444,6 +444,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_SOFTWARE    3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -451,6 +452,13 @@ EXPORT void gs_enum_adapters(
 		bool (*callback)(void *param, const char *name, uint32_t id),
 		void *param);
 
+/**
+ * Sets the directory used to cache compiled effects and shader programs
+ * between sessions.  Must be called before the graphics subsystem is created.
+ * If not set (or set to NULL), nothing is cached on disk.
+ */
+EXPORT void gs_set_cache_path(const char *path);
+
 EXPORT int gs_create(graphics_t **graphics, const char *module,
 		const struct gs_init_data *data);
 EXPORT void gs_destroy(graphics_t *graphics);
@@ -503,6 +511,17 @@ EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
 
 EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 
+/**
+ * Decodes an image file to system memory.  Does not require the graphics
+ * context, so it can be used to load images from other threads before
+ * uploading them with gs_texture_create.
+ *
+ * @return  Tightly packed pixel data (cx * 4 bytes per line), or NULL on
+ *          failure.  Free with bfree.
+ */
+EXPORT uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx, uint32_t *cy);
+
 #define GS_FLIP_U (1<<0)
 #define GS_FLIP_V (1<<1)
 
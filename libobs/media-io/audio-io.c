@@ -49,7 +49,6 @@ struct audio_line {
 	struct audio_output        *audio;
 	struct circlebuf           buffers[MAX_AV_PLANES];
 	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -58,6 +57,10 @@ struct audio_line {
 	/* specifies which mixes this line applies to via bits */
 	uint32_t                   mixers;
 
+	/* bytes of audio placed, and bytes written to place them */
+	uint64_t                   bytes;
+	uint64_t                   copied_bytes;
+
 	/* states whether this line is still being used.  if not, then when the
 	 * buffer is depleted, it's destroyed */
 	bool                       alive;
@@ -68,10 +71,14 @@ struct audio_line {
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
-	}
+
+	if (line->bytes)
+		blog(LOG_DEBUG, "audio line '%s': %.2f copies per sample",
+				line->name,
+				(double)line->copied_bytes /
+				(double)line->bytes);
 
 	pthread_mutex_destroy(&line->mutex);
 	bfree(line->name);
@@ -692,40 +699,54 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
-/* TODO: optimize these two functions */
-static inline void mul_vol_float(float *array, float volume, size_t count)
+static inline void copy_vol_float(float *dst, const float *src, float volume,
+		size_t count)
 {
 	for (size_t i = 0; i < count; i++)
-		array[i] *= volume;
+		dst[i] = src[i] * volume;
 }
 
+/* applies the volume while writing straight into the line buffers */
 static void audio_line_place_data_pos(struct audio_line *line,
 		const struct audio_data *data, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
 	size_t total_size = data->frames * line->audio->block_size;
+	bool   is_float;
+
+	switch (line->audio->info.format) {
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		is_float = true;
+		break;
+	default:
+		blog(LOG_ERROR, "audio_line_place_data_pos: "
+		                "Unsupported or unknown format");
+		is_float = false;
+		break;
+	}
 
 	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
-
-		uint8_t *array = line->volume_buffers[i].array;
-
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float((float*)array, data->volume, total_num);
-			break;
-		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-			                "Unsupported or unknown format");
-			break;
+		const uint8_t *in = data->data[i];
+		void   *ptrs[2];
+		size_t sizes[2];
+
+		circlebuf_place_ptrs(&line->buffers[i], position, total_size,
+				ptrs, sizes);
+
+		for (size_t j = 0; j < 2 && sizes[j]; j++) {
+			if (is_float)
+				copy_vol_float(ptrs[j], (const float*)in,
+						data->volume,
+						sizes[j] / sizeof(float));
+			else
+				memcpy(ptrs[j], in, sizes[j]);
+
+			line->copied_bytes += sizes[j];
+			in += sizes[j];
 		}
-
-		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
 	}
+
+	line->bytes += total_size * line->audio->planes;
 }
 
 static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
@@ -0,0 +1,188 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <xmmintrin.h>
+#include <string.h>
+
+#include "audio-meter.h"
+
+#define HISTORY_SIZE (AUDIO_METER_TAPS - 1)
+#define CHUNK_SIZE   256
+
+/* ITU-R BS.1770-4 annex 2 interpolation filter, one row per phase */
+static const float true_peak_coeffs[4][AUDIO_METER_TAPS] = {
+	{ 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,
+	  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+	  0.9721679687500f, -0.1022949218750f,  0.0476074218750f,
+	 -0.0266113281250f,  0.0148925781250f, -0.0083007812500f},
+	{-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,
+	  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+	  0.7797851562500f, -0.2003173828125f,  0.1015625000000f,
+	 -0.0582275390625f,  0.0330810546875f, -0.0189208984375f},
+	{-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,
+	  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+	  0.4650878906250f, -0.1665039062500f,  0.0891113281250f,
+	 -0.0517578125000f,  0.0292968750000f, -0.0291748046875f},
+	{-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,
+	  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+	  0.1373291015625f, -0.0594482421875f,  0.0332031250000f,
+	 -0.0196533203125f,  0.0109863281250f,  0.0017089843750f}
+};
+
+static inline __m128 abs_ps(__m128 val)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), val);
+}
+
+static inline float hmax_ps(__m128 val)
+{
+	val = _mm_max_ps(val, _mm_movehl_ps(val, val));
+	val = _mm_max_ss(val, _mm_shuffle_ps(val, val, 1));
+	return _mm_cvtss_f32(val);
+}
+
+static inline float hsum_ps(__m128 val)
+{
+	val = _mm_add_ps(val, _mm_movehl_ps(val, val));
+	val = _mm_add_ss(val, _mm_shuffle_ps(val, val, 1));
+	return _mm_cvtss_f32(val);
+}
+
+/* 'in' points to the first new sample, preceded by HISTORY_SIZE samples */
+static inline void meter_chunk(const float *in, size_t frames,
+		__m128 *sum, __m128 *peak, __m128 *true_peak)
+{
+	size_t i = 0;
+
+	/* four output samples at a time, with independent accumulators for
+	 * each phase of the interpolation filter */
+	for (; i + 4 <= frames; i += 4) {
+		__m128 val = _mm_loadu_ps(in + i);
+		__m128 out0 = _mm_setzero_ps();
+		__m128 out1 = _mm_setzero_ps();
+		__m128 out2 = _mm_setzero_ps();
+		__m128 out3 = _mm_setzero_ps();
+
+		*sum  = _mm_add_ps(*sum, _mm_mul_ps(val, val));
+		*peak = _mm_max_ps(*peak, abs_ps(val));
+
+		/* phases 0/3 and 1/2 are mirrored, so the same taps are
+		 * applied with the samples in reverse order */
+		for (size_t k = 0; k < AUDIO_METER_TAPS / 2; k++) {
+			const size_t r = AUDIO_METER_TAPS - 1 - k;
+			__m128 x  = _mm_loadu_ps(in + i - k);
+			__m128 xr = _mm_loadu_ps(in + i - r);
+			__m128 c0 = _mm_set1_ps(true_peak_coeffs[0][k]);
+			__m128 c1 = _mm_set1_ps(true_peak_coeffs[1][k]);
+
+			out0 = _mm_add_ps(out0, _mm_add_ps(_mm_mul_ps(x, c0),
+					_mm_mul_ps(xr, _mm_set1_ps(
+						true_peak_coeffs[0][r]))));
+			out1 = _mm_add_ps(out1, _mm_add_ps(_mm_mul_ps(x, c1),
+					_mm_mul_ps(xr, _mm_set1_ps(
+						true_peak_coeffs[1][r]))));
+			out2 = _mm_add_ps(out2, _mm_add_ps(_mm_mul_ps(xr, c1),
+					_mm_mul_ps(x, _mm_set1_ps(
+						true_peak_coeffs[1][r]))));
+			out3 = _mm_add_ps(out3, _mm_add_ps(_mm_mul_ps(xr, c0),
+					_mm_mul_ps(x, _mm_set1_ps(
+						true_peak_coeffs[0][r]))));
+		}
+
+		out0 = _mm_max_ps(abs_ps(out0), abs_ps(out1));
+		out2 = _mm_max_ps(abs_ps(out2), abs_ps(out3));
+		*true_peak = _mm_max_ps(*true_peak, _mm_max_ps(out0, out2));
+	}
+
+	for (; i < frames; i++) {
+		__m128 val = _mm_load_ss(in + i);
+		__m128 out = _mm_setzero_ps();
+
+		*sum  = _mm_add_ss(*sum, _mm_mul_ss(val, val));
+		*peak = _mm_max_ss(*peak, abs_ps(val));
+
+		for (size_t k = 0; k < AUDIO_METER_TAPS; k++) {
+			__m128 coeffs = _mm_setr_ps(true_peak_coeffs[0][k],
+					true_peak_coeffs[1][k],
+					true_peak_coeffs[2][k],
+					true_peak_coeffs[3][k]);
+			out = _mm_add_ps(out, _mm_mul_ps(coeffs,
+					_mm_set1_ps(*(in + i - k))));
+		}
+
+		*true_peak = _mm_max_ps(*true_peak, abs_ps(out));
+	}
+}
+
+static void meter_channel(float *history, const float *data, size_t frames,
+		float *sum_out, float *peak_out, float *true_peak_out)
+{
+	float  buf[HISTORY_SIZE + CHUNK_SIZE];
+	float  max_peak, max_true_peak;
+	__m128 sum       = _mm_setzero_ps();
+	__m128 peak      = _mm_setzero_ps();
+	__m128 true_peak = _mm_setzero_ps();
+
+	memcpy(buf, history, sizeof(float) * HISTORY_SIZE);
+
+	while (frames) {
+		size_t count = (frames > CHUNK_SIZE) ? CHUNK_SIZE : frames;
+
+		memcpy(buf + HISTORY_SIZE, data, sizeof(float) * count);
+		meter_chunk(buf + HISTORY_SIZE, count, &sum, &peak,
+				&true_peak);
+		memmove(buf, buf + count, sizeof(float) * HISTORY_SIZE);
+
+		data   += count;
+		frames -= count;
+	}
+
+	memcpy(history, buf, sizeof(float) * HISTORY_SIZE);
+
+	max_peak      = hmax_ps(peak);
+	max_true_peak = hmax_ps(true_peak);
+
+	*sum_out += hsum_ps(sum);
+	if (max_peak > *peak_out)
+		*peak_out = max_peak;
+	if (max_true_peak > *true_peak_out)
+		*true_peak_out = max_true_peak;
+}
+
+void audio_meter_reset(struct audio_meter *meter)
+{
+	memset(meter, 0, sizeof(struct audio_meter));
+}
+
+void audio_meter_process(struct audio_meter *meter,
+		struct audio_meter_levels *levels, float *const *data,
+		size_t channels, size_t frames)
+{
+	if (channels > MAX_AV_PLANES)
+		channels = MAX_AV_PLANES;
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		if (!data[ch])
+			break;
+
+		meter_channel(meter->history[ch], data[ch], frames,
+				&levels->sum[ch], &levels->peak[ch],
+				&levels->true_peak[ch]);
+	}
+
+	levels->frames += frames;
+}
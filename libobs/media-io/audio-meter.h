@@ -0,0 +1,67 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string.h>
+#include "../util/c99defs.h"
+#include "media-io-defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Audio level metering
+ *
+ *   Computes the per-channel sum of squares (for RMS), sample peak and
+ * 4x oversampled true peak (ITU-R BS.1770-4) of planar float audio in a
+ * single vectorized pass.
+ */
+
+#define AUDIO_METER_TAPS 12
+
+struct audio_meter {
+	/* last input samples of each channel, for the true peak filter */
+	float history[MAX_AV_PLANES][AUDIO_METER_TAPS - 1];
+};
+
+struct audio_meter_levels {
+	size_t   frames;
+	float    sum[MAX_AV_PLANES];
+	float    peak[MAX_AV_PLANES];
+	float    true_peak[MAX_AV_PLANES];
+};
+
+static inline void audio_meter_levels_clear(struct audio_meter_levels *levels)
+{
+	memset(levels, 0, sizeof(struct audio_meter_levels));
+}
+
+EXPORT void audio_meter_reset(struct audio_meter *meter);
+
+/*
+ * Adds the levels of the given audio to 'levels'.  Peaks are absolute
+ * sample values, 'sum' is the sum of squares of each channel.
+ */
+EXPORT void audio_meter_process(struct audio_meter *meter,
+		struct audio_meter_levels *levels, float *const *data,
+		size_t channels, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -21,6 +21,8 @@
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
+#include <limits.h>
+#include <math.h>
 
 struct audio_resampler {
 	struct SwrContext   *context;
@@ -77,8 +79,64 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
-audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
-		const struct resample_info *src)
+/* swr_build_matrix was added in FFmpeg 3.2 */
+#if LIBSWRESAMPLE_VERSION_INT >= AV_VERSION_INT(2, 3, 100)
+/* same defaults swresample uses for its own matrix */
+static inline bool build_remix_matrix(struct audio_resampler *rs,
+		double *remix, int in_ch, int out_ch)
+{
+	UNUSED_PARAMETER(out_ch);
+	return swr_build_matrix(rs->input_layout, rs->output_layout,
+			M_SQRT1_2, M_SQRT1_2, 0.0, INT_MAX, 1.0,
+			remix, in_ch, AV_MATRIX_ENCODING_NONE, NULL) >= 0;
+}
+#else
+/* older versions: every output channel is the plain average of the input
+ * channels */
+static inline bool build_remix_matrix(struct audio_resampler *rs,
+		double *remix, int in_ch, int out_ch)
+{
+	for (int out = 0; out < out_ch; out++) {
+		for (int in = 0; in < in_ch; in++)
+			remix[out * in_ch + in] = 1.0 / (double)in_ch;
+	}
+
+	UNUSED_PARAMETER(rs);
+	return true;
+}
+#endif
+
+/*
+ * Folds the mono downmix into the remix matrix: every output channel gets the
+ * average of the output channels the regular remix would produce.
+ */
+static bool set_mono_matrix(struct audio_resampler *rs)
+{
+	double remix[MAX_AV_PLANES * MAX_AV_PLANES];
+	double mono[MAX_AV_PLANES * MAX_AV_PLANES];
+	int in_ch = av_get_channel_layout_nb_channels(rs->input_layout);
+	int out_ch = (int)rs->output_ch;
+
+	if (in_ch <= 0 || in_ch > MAX_AV_PLANES || out_ch > MAX_AV_PLANES)
+		return false;
+
+	if (!build_remix_matrix(rs, remix, in_ch, out_ch))
+		return false;
+
+	for (int in = 0; in < in_ch; in++) {
+		double sum = 0.0;
+
+		for (int out = 0; out < out_ch; out++)
+			sum += remix[out * in_ch + in];
+		for (int out = 0; out < out_ch; out++)
+			mono[out * in_ch + in] = sum / (double)out_ch;
+	}
+
+	return swr_set_matrix(rs->context, mono, in_ch) == 0;
+}
+
+static audio_resampler_t *resampler_create(const struct resample_info *dst,
+		const struct resample_info *src, bool mono)
 {
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
@@ -105,6 +163,12 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 		return NULL;
 	}
 
+	if (mono && !set_mono_matrix(rs)) {
+		blog(LOG_ERROR, "Failed to set mono downmix matrix");
+		audio_resampler_destroy(rs);
+		return NULL;
+	}
+
 	errcode = swr_init(rs->context);
 	if (errcode != 0) {
 		blog(LOG_ERROR, "avresample_open failed: error code %d",
@@ -116,6 +180,18 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	return rs;
 }
 
+audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
+		const struct resample_info *src)
+{
+	return resampler_create(dst, src, false);
+}
+
+audio_resampler_t *audio_resampler_create_mono(const struct resample_info *dst,
+		const struct resample_info *src)
+{
+	return resampler_create(dst, src, true);
+}
+
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
@@ -128,6 +204,43 @@ void audio_resampler_destroy(audio_resampler_t *rs)
 	}
 }
 
+uint32_t audio_resampler_get_max_frames(audio_resampler_t *rs,
+		uint32_t in_frames)
+{
+	int64_t delay;
+
+	if (!rs) return 0;
+
+	delay = swr_get_delay(rs->context, rs->input_freq);
+	return (uint32_t)av_rescale_rnd(
+			delay + (int64_t)in_frames,
+			(int64_t)rs->output_freq, (int64_t)rs->input_freq,
+			AV_ROUND_UP);
+}
+
+bool audio_resampler_resample_into(audio_resampler_t *rs,
+		uint8_t *const output[], uint32_t max_frames,
+		uint32_t *out_frames, uint64_t *ts_offset,
+		const uint8_t *const input[], uint32_t in_frames)
+{
+	int ret;
+
+	if (!rs) return false;
+
+	*ts_offset = (uint64_t)swr_get_delay(rs->context, 1000000000);
+
+	ret = swr_convert(rs->context, (uint8_t**)output, (int)max_frames,
+			(const uint8_t**)input, in_frames);
+
+	if (ret < 0) {
+		blog(LOG_ERROR, "swr_convert failed: %d", ret);
+		return false;
+	}
+
+	*out_frames = (uint32_t)ret;
+	return true;
+}
+
 bool audio_resampler_resample(audio_resampler_t *rs,
 		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
 		 const uint8_t *const input[], uint32_t in_frames)
@@ -137,11 +250,7 @@ bool audio_resampler_resample(audio_resampler_t *rs,
 	struct SwrContext *context = rs->context;
 	int ret;
 
-	int64_t delay = swr_get_delay(context, rs->input_freq);
-	int estimated = (int)av_rescale_rnd(
-			delay + (int64_t)in_frames,
-			(int64_t)rs->output_freq, (int64_t)rs->input_freq,
-			AV_ROUND_UP);
+	int estimated = (int)audio_resampler_get_max_frames(rs, in_frames);
 
 	*ts_offset = (uint64_t)swr_get_delay(context, 1000000000);
 
@@ -35,12 +35,32 @@ struct resample_info {
 
 EXPORT audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 		const struct resample_info *src);
+/*
+ * Creates a resampler that also downmixes to mono: every output channel
+ * carries the same mono signal.
+ */
+EXPORT audio_resampler_t *audio_resampler_create_mono(
+		const struct resample_info *dst,
+		const struct resample_info *src);
 EXPORT void audio_resampler_destroy(audio_resampler_t *resampler);
 
 EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
 		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
 		 const uint8_t *const input[], uint32_t in_frames);
 
+/* maximum number of frames the next resample call can output */
+EXPORT uint32_t audio_resampler_get_max_frames(audio_resampler_t *resampler,
+		uint32_t in_frames);
+
+/*
+ * Resamples into caller-owned planes with room for at least max_frames
+ * frames, instead of the internal buffer.
+ */
+EXPORT bool audio_resampler_resample_into(audio_resampler_t *resampler,
+		uint8_t *const output[], uint32_t max_frames,
+		uint32_t *out_frames, uint64_t *ts_offset,
+		const uint8_t *const input[], uint32_t in_frames);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,16 +19,37 @@
 
 #include "../util/base.h"
 #include "../util/bmem.h"
+#include "../util/darray.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #include <libavformat/avformat.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
+/* large enough that reads and writes go to the disk in big sequential
+ * chunks rather than in the 32k pieces avio uses by default */
+#define IO_BUFFER_SIZE (4 * 1024 * 1024)
+
+#define DEFAULT_WORKERS 2
+
 struct media_remux_job {
 	int64_t in_size;
 	AVFormatContext *ifmt_ctx, *ofmt_ctx;
+
+	/* input, either mapped or read through a large buffer */
+	const uint8_t *in_map;
+	size_t in_map_size;
+	FILE *in_file;
+	int64_t in_pos;
+	AVIOContext *in_io;
+
+	FILE *out_file;
+	AVIOContext *out_io;
+
+	bool cancelled;
+	struct media_remux_stats stats;
 };
 
 static inline void init_size(media_remux_job_t job, const char *in_filename)
@@ -43,9 +64,154 @@ static inline void init_size(media_remux_job_t job, const char *in_filename)
 	job->in_size = st.st_size;
 }
 
+/* ------------------------------------------------------------------------- */
+/* input/output through custom avio contexts                                 */
+
+static int read_mapped(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	int64_t left = (int64_t)job->in_map_size - job->in_pos;
+
+	if (left <= 0)
+		return AVERROR_EOF;
+	if (buf_size > left)
+		buf_size = (int)left;
+
+	memcpy(buf, job->in_map + job->in_pos, buf_size);
+	job->in_pos += buf_size;
+	job->stats.in_bytes += buf_size;
+	return buf_size;
+}
+
+static int read_file(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	size_t size = fread(buf, 1, buf_size, job->in_file);
+
+	if (!size)
+		return AVERROR_EOF;
+
+	job->in_pos += size;
+	job->stats.in_bytes += size;
+	return (int)size;
+}
+
+static int64_t seek_input(void *opaque, int64_t offset, int whence)
+{
+	media_remux_job_t job = opaque;
+
+	whence &= ~AVSEEK_FORCE;
+
+	if (whence == AVSEEK_SIZE)
+		return job->in_size;
+	if (whence == SEEK_CUR)
+		offset += job->in_pos;
+	else if (whence == SEEK_END)
+		offset += job->in_size;
+
+	if (offset < 0 || offset > job->in_size)
+		return -1;
+	if (job->in_file && os_fseeki64(job->in_file, offset, SEEK_SET) != 0)
+		return -1;
+
+	job->in_pos = offset;
+	return offset;
+}
+
+static int write_file(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	size_t size = fwrite(buf, 1, buf_size, job->out_file);
+
+	job->stats.out_bytes += size;
+	return size == (size_t)buf_size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t seek_output(void *opaque, int64_t offset, int whence)
+{
+	media_remux_job_t job = opaque;
+
+	whence &= ~AVSEEK_FORCE;
+	if (whence == AVSEEK_SIZE)
+		return -1;
+
+	if (os_fseeki64(job->out_file, offset, whence) != 0)
+		return -1;
+	return os_ftelli64(job->out_file);
+}
+
+static AVIOContext *create_io(media_remux_job_t job, bool write,
+		int (*rw)(void*, uint8_t*, int),
+		int64_t (*seek)(void*, int64_t, int))
+{
+	uint8_t *buffer = av_malloc(IO_BUFFER_SIZE);
+	AVIOContext *io;
+
+	if (!buffer)
+		return NULL;
+
+	io = avio_alloc_context(buffer, IO_BUFFER_SIZE, write, job,
+			write ? NULL : rw, write ? rw : NULL, seek);
+	if (!io)
+		av_free(buffer);
+	return io;
+}
+
+static void free_io(AVIOContext **io)
+{
+	if (*io) {
+		av_freep(&(*io)->buffer);
+		av_freep(io);
+	}
+}
+
+/* multi-gigabyte recordings can only be mapped in a 64 bit address space,
+ * otherwise the input is read through the io buffer */
+static inline bool map_input(media_remux_job_t job, const char *in_filename)
+{
+	if (sizeof(size_t) < 8 && job->in_size > 0x40000000LL)
+		return false;
+
+	job->in_map = os_map_file(in_filename, &job->in_map_size);
+	return job->in_map != NULL;
+}
+
+static inline bool open_input_io(media_remux_job_t job,
+		const char *in_filename)
+{
+	if (map_input(job, in_filename)) {
+		job->in_io = create_io(job, false, read_mapped, seek_input);
+	} else {
+		job->in_file = os_fopen(in_filename, "rb");
+		if (!job->in_file)
+			return false;
+
+		job->in_io = create_io(job, false, read_file, seek_input);
+	}
+
+	return job->in_io != NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline bool init_input(media_remux_job_t job, const char *in_filename)
 {
-	int ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
+	int ret;
+
+	if (!open_input_io(job, in_filename)) {
+		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
+				in_filename);
+		return false;
+	}
+
+	job->ifmt_ctx = avformat_alloc_context();
+	if (!job->ifmt_ctx)
+		return false;
+
+	job->ifmt_ctx->pb = job->in_io;
+	job->ifmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
 				in_filename);
@@ -103,13 +269,18 @@ static inline bool init_output(media_remux_job_t job, const char *out_filename)
 #endif
 
 	if (!(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-		ret = avio_open(&job->ofmt_ctx->pb, out_filename,
-				AVIO_FLAG_WRITE);
-		if (ret < 0) {
+		job->out_file = os_fopen(out_filename, "wb");
+		if (job->out_file)
+			job->out_io = create_io(job, true, write_file,
+					seek_output);
+
+		if (!job->out_io) {
 			blog(LOG_ERROR, "media_remux: Failed to open output"
 					" file '%s'", out_filename);
 			return false;
 		}
+
+		job->ofmt_ctx->pb = job->out_io;
 	}
 
 	return true;
@@ -161,13 +332,46 @@ static inline void process_packet(AVPacket *pkt,
 
 }
 
+/*
+ * Packets are written as they are read for as long as they come in dts
+ * order, which is the case for anything OBS recorded.  Only if the input
+ * turns out not to be ordered is the rest of it sent through ffmpeg's
+ * interleaving queue.
+ */
+static inline bool in_order(media_remux_job_t job, const AVPacket *pkt,
+		const AVStream *in_stream, int64_t *last_dts)
+{
+	int64_t dts;
+
+	if (job->stats.interleaved)
+		return false;
+
+	if (pkt->dts != AV_NOPTS_VALUE) {
+		dts = av_rescale_q(pkt->dts, in_stream->time_base,
+				AV_TIME_BASE_Q);
+		if (dts >= *last_dts) {
+			*last_dts = dts;
+			return true;
+		}
+	}
+
+	blog(LOG_INFO, "media_remux: Input packets are not in order, "
+			"interleaving");
+	job->stats.interleaved = true;
+	return false;
+}
+
 static inline int process_packets(media_remux_job_t job,
 		media_remux_progress_callback callback, void *data)
 {
+	int64_t last_dts = INT64_MIN;
 	AVPacket pkt;
 
 	int ret, throttle = 0;
 	for (;;) {
+		AVStream *in_stream, *out_stream;
+		bool ordered;
+
 		ret = av_read_frame(job->ifmt_ctx, &pkt);
 		if (ret < 0) {
 			if (ret != AVERROR_EOF)
@@ -178,17 +382,30 @@ static inline int process_packets(media_remux_job_t job,
 		}
 
 		if (callback != NULL && throttle++ > 10) {
-			float progress = pkt.pos / (float)job->in_size * 100.f;
-			if (!callback(data, progress))
+			float progress = job->in_pos / (float)job->in_size *
+				100.f;
+			if (!callback(data, progress)) {
+				job->cancelled = true;
+				av_free_packet(&pkt);
 				break;
+			}
 			throttle = 0;
 		}
 
-		process_packet(&pkt, job->ifmt_ctx->streams[pkt.stream_index],
-				job->ofmt_ctx->streams[pkt.stream_index]);
+		in_stream  = job->ifmt_ctx->streams[pkt.stream_index];
+		out_stream = job->ofmt_ctx->streams[pkt.stream_index];
+
+		ordered    = in_order(job, &pkt, in_stream, &last_dts);
+
+		process_packet(&pkt, in_stream, out_stream);
+
+		if (ordered)
+			ret = av_write_frame(job->ofmt_ctx, &pkt);
+		else
+			ret = av_interleaved_write_frame(job->ofmt_ctx, &pkt);
 
-		ret = av_interleaved_write_frame(job->ofmt_ctx, &pkt);
 		av_free_packet(&pkt);
+		job->stats.packets++;
 
 		if (ret < 0) {
 			blog(LOG_ERROR, "media_remux: Error muxing packet: %s",
@@ -203,12 +420,15 @@ static inline int process_packets(media_remux_job_t job,
 bool media_remux_job_process(media_remux_job_t job,
 		media_remux_progress_callback callback, void *data)
 {
+	uint64_t start_time;
 	int ret;
 	bool success = false;
 
 	if (!job)
 		return success;
 
+	start_time = os_gettime_ns();
+
 	ret = avformat_write_header(job->ofmt_ctx, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Error opening output file: %s",
@@ -220,7 +440,7 @@ bool media_remux_job_process(media_remux_job_t job,
 		callback(data, 0.f);
 
 	ret = process_packets(job, callback, data);
-	success = ret >= 0 || ret == AVERROR_EOF;
+	success = !job->cancelled && (ret >= 0 || ret == AVERROR_EOF);
 
 	ret = av_write_trailer(job->ofmt_ctx);
 	if (ret < 0) {
@@ -229,23 +449,392 @@ bool media_remux_job_process(media_remux_job_t job,
 		success = false;
 	}
 
+	if (job->out_io)
+		avio_flush(job->out_io);
+
+	job->stats.time_ns = os_gettime_ns() - start_time;
+
 	if (callback != NULL)
 		callback(data, 100.f);
 
 	return success;
 }
 
+void media_remux_job_get_stats(media_remux_job_t job,
+		struct media_remux_stats *stats)
+{
+	if (job && stats)
+		*stats = job->stats;
+}
+
 void media_remux_job_destroy(media_remux_job_t job)
 {
 	if (!job)
 		return;
 
 	avformat_close_input(&job->ifmt_ctx);
+	avformat_free_context(job->ofmt_ctx);
 
-	if (job->ofmt_ctx && !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE))
-		avio_close(job->ofmt_ctx->pb);
+	free_io(&job->in_io);
+	free_io(&job->out_io);
 
-	avformat_free_context(job->ofmt_ctx);
+	if (job->in_file)
+		fclose(job->in_file);
+	if (job->out_file)
+		fclose(job->out_file);
+	os_unmap_file(job->in_map, job->in_map_size);
 
 	bfree(job);
 }
+
+/* ------------------------------------------------------------------------- */
+
+struct remux_entry {
+	size_t                     id;
+	char                       *in_filename;
+	char                       *out_filename;
+	struct media_remux_service *service;
+
+	struct media_remux_status  status;
+	float                      last_progress;
+	bool                       cancel;
+};
+
+struct media_remux_service {
+	pthread_mutex_t              mutex;
+	DARRAY(struct remux_entry*)  entries;
+	size_t                       next_pending;
+	size_t                       unfinished;
+	bool                         stopping;
+
+	os_sem_t                     *queue_sem;
+	os_event_t                   *idle_event;
+	DARRAY(pthread_t)            workers;
+
+	media_remux_status_callback  *callback;
+	void                         *data;
+};
+
+static void notify(struct remux_entry *entry)
+{
+	struct media_remux_service *service = entry->service;
+	struct media_remux_status status;
+
+	if (!service->callback)
+		return;
+
+	pthread_mutex_lock(&service->mutex);
+	status = entry->status;
+	pthread_mutex_unlock(&service->mutex);
+
+	service->callback(service->data, entry->id, &status);
+}
+
+static bool entry_progress(void *data, float percent)
+{
+	struct remux_entry *entry = data;
+	struct media_remux_service *service = entry->service;
+	bool changed, cancel;
+
+	pthread_mutex_lock(&service->mutex);
+	entry->status.progress = percent;
+	changed = percent - entry->last_progress >= 0.1f ||
+		percent < entry->last_progress;
+	if (changed)
+		entry->last_progress = percent;
+	cancel = entry->cancel;
+	pthread_mutex_unlock(&service->mutex);
+
+	if (changed)
+		notify(entry);
+	return !cancel;
+}
+
+static void log_entry(const struct remux_entry *entry)
+{
+	const struct media_remux_stats *stats = &entry->status.stats;
+	double seconds = (double)stats->time_ns / 1000000000.0;
+	double mb = (double)stats->in_bytes / (1024.0 * 1024.0);
+
+	blog(LOG_INFO, "media_remux: Remuxed '%s' to '%s', "
+			"%.1f MB in %.2f seconds (%.1f MB/s)%s",
+			entry->in_filename, entry->out_filename,
+			mb, seconds, seconds > 0.0 ? mb / seconds : 0.0,
+			stats->interleaved ? ", interleaved" : "");
+}
+
+static void run_entry(struct remux_entry *entry)
+{
+	struct media_remux_service *service = entry->service;
+	struct media_remux_stats stats = {0};
+	media_remux_job_t job;
+	bool created, cancelled, success = false;
+
+	created = media_remux_job_create(&job, entry->in_filename,
+			entry->out_filename);
+	if (created) {
+		success = media_remux_job_process(job, entry_progress, entry);
+		media_remux_job_get_stats(job, &stats);
+		media_remux_job_destroy(job);
+	}
+
+	pthread_mutex_lock(&service->mutex);
+	cancelled = entry->cancel;
+	entry->status.stats = stats;
+	if (success)
+		entry->status.state = MEDIA_REMUX_SUCCEEDED;
+	else if (cancelled)
+		entry->status.state = MEDIA_REMUX_CANCELLED;
+	else
+		entry->status.state = MEDIA_REMUX_FAILED;
+	pthread_mutex_unlock(&service->mutex);
+
+	if (success)
+		log_entry(entry);
+	else if (created)
+		os_unlink(entry->out_filename);
+
+	if (!success && !cancelled)
+		blog(LOG_WARNING, "media_remux: Failed to remux '%s'",
+				entry->in_filename);
+}
+
+static void finish_entry(struct media_remux_service *service)
+{
+	if (--service->unfinished == 0)
+		os_event_signal(service->idle_event);
+}
+
+static struct remux_entry *next_entry(struct media_remux_service *service)
+{
+	while (service->next_pending < service->entries.num) {
+		struct remux_entry *entry =
+			service->entries.array[service->next_pending++];
+
+		if (entry->status.state == MEDIA_REMUX_PENDING) {
+			entry->status.state = MEDIA_REMUX_RUNNING;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void *remux_worker(void *data)
+{
+	struct media_remux_service *service = data;
+
+	os_set_thread_name("media-remux: worker");
+
+	while (os_sem_wait(service->queue_sem) == 0) {
+		struct remux_entry *entry;
+		bool stopping;
+
+		pthread_mutex_lock(&service->mutex);
+		entry = next_entry(service);
+		stopping = service->stopping;
+		pthread_mutex_unlock(&service->mutex);
+
+		if (!entry) {
+			if (stopping)
+				break;
+			continue;
+		}
+
+		notify(entry);
+		run_entry(entry);
+		notify(entry);
+
+		pthread_mutex_lock(&service->mutex);
+		finish_entry(service);
+		pthread_mutex_unlock(&service->mutex);
+	}
+
+	return NULL;
+}
+
+media_remux_service_t media_remux_service_create(size_t workers,
+		media_remux_status_callback callback, void *data)
+{
+	struct media_remux_service *service;
+
+	service = bzalloc(sizeof(struct media_remux_service));
+	service->callback = callback;
+	service->data     = data;
+
+	if (pthread_mutex_init(&service->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&service->queue_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&service->idle_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	os_event_signal(service->idle_event);
+
+	if (!workers)
+		workers = DEFAULT_WORKERS;
+
+	/* before the workers start creating jobs in parallel */
+	av_register_all();
+
+	for (size_t i = 0; i < workers; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, remux_worker, service) != 0)
+			break;
+		da_push_back(service->workers, &thread);
+	}
+
+	if (!service->workers.num) {
+		blog(LOG_ERROR, "media_remux: Failed to create workers");
+		media_remux_service_destroy(service);
+		return NULL;
+	}
+
+	return service;
+
+fail:
+	os_sem_destroy(service->queue_sem);
+	pthread_mutex_destroy(&service->mutex);
+fail_mutex:
+	bfree(service);
+	return NULL;
+}
+
+void media_remux_service_destroy(media_remux_service_t service)
+{
+	if (!service)
+		return;
+
+	media_remux_service_cancel_all(service);
+
+	pthread_mutex_lock(&service->mutex);
+	service->stopping = true;
+	pthread_mutex_unlock(&service->mutex);
+
+	for (size_t i = 0; i < service->workers.num; i++)
+		os_sem_post(service->queue_sem);
+	for (size_t i = 0; i < service->workers.num; i++)
+		pthread_join(service->workers.array[i], NULL);
+
+	for (size_t i = 0; i < service->entries.num; i++) {
+		struct remux_entry *entry = service->entries.array[i];
+		bfree(entry->in_filename);
+		bfree(entry->out_filename);
+		bfree(entry);
+	}
+
+	da_free(service->entries);
+	da_free(service->workers);
+	os_event_destroy(service->idle_event);
+	os_sem_destroy(service->queue_sem);
+	pthread_mutex_destroy(&service->mutex);
+	bfree(service);
+}
+
+size_t media_remux_service_add(media_remux_service_t service,
+		const char *in_filename, const char *out_filename)
+{
+	struct remux_entry *entry;
+
+	if (!service || !in_filename || !out_filename)
+		return 0;
+
+	entry = bzalloc(sizeof(struct remux_entry));
+	entry->in_filename  = bstrdup(in_filename);
+	entry->out_filename = bstrdup(out_filename);
+	entry->service      = service;
+
+	pthread_mutex_lock(&service->mutex);
+	entry->id = service->entries.num + 1;
+	da_push_back(service->entries, &entry);
+
+	if (service->unfinished++ == 0)
+		os_event_reset(service->idle_event);
+	pthread_mutex_unlock(&service->mutex);
+
+	notify(entry);
+	os_sem_post(service->queue_sem);
+	return entry->id;
+}
+
+static inline struct remux_entry *get_entry(
+		struct media_remux_service *service, size_t id)
+{
+	return (id && id <= service->entries.num) ?
+		service->entries.array[id - 1] : NULL;
+}
+
+static bool cancel_entry(struct media_remux_service *service,
+		struct remux_entry *entry)
+{
+	bool was_pending, was_running;
+
+	pthread_mutex_lock(&service->mutex);
+	was_pending = entry->status.state == MEDIA_REMUX_PENDING;
+	was_running = entry->status.state == MEDIA_REMUX_RUNNING;
+	if (was_pending || was_running)
+		entry->cancel = true;
+	if (was_pending) {
+		entry->status.state = MEDIA_REMUX_CANCELLED;
+		finish_entry(service);
+	}
+	pthread_mutex_unlock(&service->mutex);
+
+	/* running jobs are stopped at their next progress update */
+	if (was_pending)
+		notify(entry);
+	return was_pending || was_running;
+}
+
+bool media_remux_service_cancel(media_remux_service_t service, size_t id)
+{
+	struct remux_entry *entry;
+
+	if (!service)
+		return false;
+
+	pthread_mutex_lock(&service->mutex);
+	entry = get_entry(service, id);
+	pthread_mutex_unlock(&service->mutex);
+
+	return entry ? cancel_entry(service, entry) : false;
+}
+
+void media_remux_service_cancel_all(media_remux_service_t service)
+{
+	size_t num;
+
+	if (!service)
+		return;
+
+	pthread_mutex_lock(&service->mutex);
+	num = service->entries.num;
+	pthread_mutex_unlock(&service->mutex);
+
+	for (size_t id = 1; id <= num; id++)
+		media_remux_service_cancel(service, id);
+}
+
+bool media_remux_service_get_status(media_remux_service_t service,
+		size_t id, struct media_remux_status *status)
+{
+	struct remux_entry *entry;
+
+	if (!service || !status)
+		return false;
+
+	pthread_mutex_lock(&service->mutex);
+	entry = get_entry(service, id);
+	if (entry)
+		*status = entry->status;
+	pthread_mutex_unlock(&service->mutex);
+
+	return entry != NULL;
+}
+
+void media_remux_service_wait(media_remux_service_t service)
+{
+	if (service)
+		os_event_wait(service->idle_event);
+}
@@ -24,16 +24,83 @@ typedef struct media_remux_job *media_remux_job_t;
 
 typedef bool (media_remux_progress_callback)(void *data, float percent);
 
+struct media_remux_stats {
+	uint64_t in_bytes;
+	uint64_t out_bytes;
+	uint64_t packets;
+	uint64_t time_ns;
+
+	/** Input was not in dts order and went through the interleaving
+	 * queue */
+	bool     interleaved;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 EXPORT bool media_remux_job_create(media_remux_job_t *job,
 		const char *in_filename, const char *out_filename);
+
+/** Returns false on failure, or if the callback returned false */
 EXPORT bool media_remux_job_process(media_remux_job_t job,
 		media_remux_progress_callback callback, void *data);
+EXPORT void media_remux_job_get_stats(media_remux_job_t job,
+		struct media_remux_stats *stats);
 EXPORT void media_remux_job_destroy(media_remux_job_t job);
 
+/* ------------------------------------------------------------------------- */
+/* Remux service, runs a queue of remux jobs on a pool of worker threads    */
+
+enum media_remux_state {
+	MEDIA_REMUX_PENDING,
+	MEDIA_REMUX_RUNNING,
+	MEDIA_REMUX_SUCCEEDED,
+	MEDIA_REMUX_FAILED,
+	MEDIA_REMUX_CANCELLED
+};
+
+struct media_remux_status {
+	enum media_remux_state   state;
+	float                    progress;
+	struct media_remux_stats stats;
+};
+
+struct media_remux_service;
+typedef struct media_remux_service *media_remux_service_t;
+
+/**
+ * Called from the worker threads when the progress or the state of a job
+ * changes.
+ */
+typedef void (media_remux_status_callback)(void *data, size_t id,
+		const struct media_remux_status *status);
+
+/** Creates a remux service, 0 workers uses the default (2) */
+EXPORT media_remux_service_t media_remux_service_create(size_t workers,
+		media_remux_status_callback callback, void *data);
+
+/** Cancels all jobs and waits for the workers to finish */
+EXPORT void media_remux_service_destroy(media_remux_service_t service);
+
+/** Queues a job and returns its id, which is never 0 */
+EXPORT size_t media_remux_service_add(media_remux_service_t service,
+		const char *in_filename, const char *out_filename);
+
+/**
+ * Cancels a pending or running job.  The partially written output file of
+ * a cancelled or failed job is deleted.
+ */
+EXPORT bool media_remux_service_cancel(media_remux_service_t service,
+		size_t id);
+EXPORT void media_remux_service_cancel_all(media_remux_service_t service);
+
+EXPORT bool media_remux_service_get_status(media_remux_service_t service,
+		size_t id, struct media_remux_status *status);
+
+/** Waits until all queued jobs are finished */
+EXPORT void media_remux_service_wait(media_remux_service_t service);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,7 @@
 #include "video-io.h"
 #include "video-frame.h"
 #include "video-scaler.h"
+#include "video-pyramid.h"
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
@@ -32,11 +33,15 @@
 struct cached_frame_info {
 	struct video_data frame;
 	int count;
+
+	/* number of pyramid levels built from this frame */
+	size_t pyramid_levels;
 };
 
 struct video_input {
 	struct video_scale_info   conversion;
 	video_scaler_t            *scaler;
+	size_t                    level;
 	struct video_frame        frame[MAX_CONVERT_BUFFERS];
 	int                       cur_frame;
 
@@ -68,6 +73,10 @@ struct video_output {
 	pthread_mutex_t            input_mutex;
 	DARRAY(struct video_input) inputs;
 
+	/* multi-rendition mode, protected by input_mutex */
+	struct video_pyramid       *pyramid;
+	size_t                     pyramid_levels;
+
 	size_t                     available_frames;
 	size_t                     first_added;
 	size_t                     last_added;
@@ -76,11 +85,14 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+static inline bool scale_video_output(struct video_output *video,
+		struct video_input *input, struct video_data *data)
 {
 	bool success = true;
 
+	if (input->level)
+		video_pyramid_get_frame(video->pyramid, input->level, data);
+
 	if (input->scaler) {
 		struct video_frame *frame;
 
@@ -124,11 +136,18 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	/* duplicated frames reuse the pyramid built the first time */
+	if (frame_info->pyramid_levels < video->pyramid_levels) {
+		video_pyramid_build(video->pyramid, &frame_info->frame,
+				video->pyramid_levels);
+		frame_info->pyramid_levels = video->pyramid_levels;
+	}
+
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array+i;
 		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
+		if (scale_video_output(video, input, &frame))
 			input->callback(input->param, &frame);
 	}
 
@@ -201,6 +220,27 @@ static inline void init_cache(struct video_output *video)
 	video->available_frames = video->info.cache_size;
 }
 
+static void free_pyramid(struct video_output *video)
+{
+	size_t levels = video_pyramid_num_levels(video->pyramid);
+
+	for (size_t i = 1; i < levels; i++) {
+		uint32_t width, height;
+
+		video_pyramid_get_size(video->pyramid, i, &width, &height);
+		blog(LOG_INFO, "video-io: rendition %ux%u: %u frames, average "
+				"scale time %.3f ms", width, height,
+				video_pyramid_get_scaled_frames(
+					video->pyramid, i),
+				(double)video_pyramid_get_scale_time(
+					video->pyramid, i) / 1000000.0);
+	}
+
+	video_pyramid_destroy(video->pyramid);
+	video->pyramid        = NULL;
+	video->pyramid_levels = 0;
+}
+
 int video_output_open(video_t **video, struct video_output_info *info)
 {
 	struct video_output *out;
@@ -253,6 +293,8 @@ void video_output_close(video_t *video)
 		video_input_free(&video->inputs.array[i]);
 	da_free(video->inputs);
 
+	free_pyramid(video);
+
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame*)&video->cache[i]);
 
@@ -278,14 +320,25 @@ static size_t video_get_input_idx(const video_t *video,
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
-	if (input->conversion.width  != video->info.width ||
-	    input->conversion.height != video->info.height ||
-	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+	};
+
+	/* scale from the smallest pyramid level that is large enough */
+	input->level = 0;
+	if (video->pyramid && input->conversion.format == video->info.format) {
+		input->level = video_pyramid_find_level(video->pyramid,
+				input->conversion.width,
+				input->conversion.height);
+		video_pyramid_get_size(video->pyramid, input->level,
+				&from.width, &from.height);
+	}
+
+	if (input->conversion.width  != from.width ||
+	    input->conversion.height != from.height ||
+	    input->conversion.format != from.format) {
 
 		int ret = video_scaler_create(&input->scaler,
 				&input->conversion, &from,
@@ -311,6 +364,20 @@ static inline bool video_input_init(struct video_input *input,
 	return true;
 }
 
+/* only the levels up to the largest one in use are built */
+static void update_pyramid_levels(struct video_output *video)
+{
+	size_t levels = 0;
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		size_t level = video->inputs.array[i].level;
+		if (level + 1 > levels)
+			levels = level + 1;
+	}
+
+	video->pyramid_levels = levels > 1 ? levels : 0;
+}
+
 bool video_output_connect(video_t *video,
 		const struct video_scale_info *conversion,
 		void (*callback)(void *param, struct video_data *frame),
@@ -344,8 +411,10 @@ bool video_output_connect(video_t *video,
 			input.conversion.height = video->info.height;
 
 		success = video_input_init(&input, video);
-		if (success)
+		if (success) {
 			da_push_back(video->inputs, &input);
+			update_pyramid_levels(video);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -366,6 +435,7 @@ void video_output_disconnect(video_t *video,
 	if (idx != DARRAY_INVALID) {
 		video_input_free(video->inputs.array+idx);
 		da_erase(video->inputs, idx);
+		update_pyramid_levels(video);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -406,6 +476,10 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		cfi->frame.timestamp = timestamp;
 		cfi->count = count;
 
+		/* the slot gets a new frame, so its pyramid has to be built
+		 * again; only duplicates (count > 1) reuse it */
+		cfi->pyramid_levels = 0;
+
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
 		locked = true;
@@ -488,3 +562,88 @@ uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
 }
+
+bool video_output_set_multi_rendition(video_t *video, bool enable)
+{
+	bool success = true;
+
+	if (!video)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (enable == (video->pyramid != NULL))
+		goto exit;
+
+	if (enable) {
+		video->pyramid = video_pyramid_create(video->info.format,
+				video->info.width, video->info.height);
+		if (!video->pyramid) {
+			blog(LOG_WARNING, "video-io: multi-rendition mode is "
+			                  "not supported for this format");
+			success = false;
+			goto exit;
+		}
+	} else {
+		free_pyramid(video);
+	}
+
+	/* levels may still be marked as built from a previous pyramid */
+	pthread_mutex_lock(&video->data_mutex);
+	for (size_t i = 0; i < video->info.cache_size; i++)
+		video->cache[i].pyramid_levels = 0;
+	pthread_mutex_unlock(&video->data_mutex);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array+i;
+
+		video_input_free(input);
+		input->scaler = NULL;
+
+		if (!video_input_init(input, video)) {
+			video_input_free(input);
+			da_erase(video->inputs, i--);
+		}
+	}
+
+	update_pyramid_levels(video);
+
+exit:
+	pthread_mutex_unlock(&video->input_mutex);
+	return success;
+}
+
+size_t video_output_get_rendition_count(const video_t *video)
+{
+	size_t count;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock((pthread_mutex_t*)&video->input_mutex);
+	count = video_pyramid_num_levels(video->pyramid);
+	pthread_mutex_unlock((pthread_mutex_t*)&video->input_mutex);
+
+	return count;
+}
+
+bool video_output_get_rendition(const video_t *video, size_t idx,
+		uint32_t *width, uint32_t *height, uint64_t *scale_time_ns)
+{
+	bool success = false;
+
+	if (!video)
+		return false;
+
+	pthread_mutex_lock((pthread_mutex_t*)&video->input_mutex);
+
+	if (idx < video_pyramid_num_levels(video->pyramid)) {
+		video_pyramid_get_size(video->pyramid, idx, width, height);
+		*scale_time_ns = video_pyramid_get_scale_time(video->pyramid,
+				idx);
+		success = true;
+	}
+
+	pthread_mutex_unlock((pthread_mutex_t*)&video->input_mutex);
+	return success;
+}
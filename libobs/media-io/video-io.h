@@ -177,6 +177,21 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/**
+ * Multi-rendition mode: builds a downscale pyramid (full resolution, 1080p,
+ * 720p and 480p) once per frame.  Inputs with the output format scale from
+ * the smallest level that is large enough, or use a level directly if it
+ * matches their size, instead of scaling the full resolution frame each.
+ */
+EXPORT bool video_output_set_multi_rendition(video_t *video, bool enable);
+
+/** Returns the number of pyramid levels, 0 if multi-rendition is off */
+EXPORT size_t video_output_get_rendition_count(const video_t *video);
+
+/** Gets the size and average scale time of a pyramid level */
+EXPORT bool video_output_get_rendition(const video_t *video, size_t idx,
+		uint32_t *width, uint32_t *height, uint64_t *scale_time_ns);
+
 
 #ifdef __cplusplus
 }
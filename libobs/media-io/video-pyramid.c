@@ -0,0 +1,508 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <emmintrin.h>
+#include "../util/bmem.h"
+#include "../util/platform.h"
+
+#include "video-frame.h"
+#include "video-pyramid.h"
+
+#define MAX_PYRAMID_PLANES 3
+
+/* 8 bit fixed point weights */
+#define FRAC_BITS 8
+#define FRAC_ONE  (1 << FRAC_BITS)
+
+static const uint32_t level_heights[VIDEO_PYRAMID_MAX_LEVELS - 1] = {
+	1080, 720, 480
+};
+
+struct plane_scale {
+	uint32_t src_width;
+	uint32_t src_height;
+	uint32_t dst_width;
+	uint32_t dst_height;
+	uint32_t pixel_size;
+
+	uint32_t *x_pos;
+	uint16_t *x_frac;
+	uint32_t *y_pos;
+	uint16_t *y_frac;
+};
+
+struct pyramid_level {
+	uint32_t           width;
+	uint32_t           height;
+	struct video_frame frame;
+
+	struct plane_scale planes[MAX_PYRAMID_PLANES];
+	size_t             num_planes;
+
+	uint64_t           scale_time;
+	uint32_t           scaled_frames;
+};
+
+struct video_pyramid {
+	enum video_format    format;
+	struct pyramid_level levels[VIDEO_PYRAMID_MAX_LEVELS];
+	size_t               num_levels;
+
+	/* vertically filtered source line */
+	uint8_t              *line;
+};
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Maps destination pixels to the two nearest source pixels, with pixel
+ * centers aligned.  The second pixel always exists, so the scale functions
+ * never have to check for the edge.
+ */
+static void init_positions(uint32_t *pos, uint16_t *frac, uint32_t dst_size,
+		uint32_t src_size)
+{
+	double scale = (double)src_size / (double)dst_size;
+
+	for (uint32_t i = 0; i < dst_size; i++) {
+		double src = ((double)i + 0.5) * scale - 0.5;
+		uint32_t p;
+		uint32_t f;
+
+		if (src < 0.0)
+			src = 0.0;
+
+		p = (uint32_t)src;
+		f = (uint32_t)((src - (double)p) * FRAC_ONE + 0.5);
+
+		if (f == FRAC_ONE) {
+			p++;
+			f = 0;
+		}
+		if (p >= src_size - 1) {
+			p = src_size - 2;
+			f = FRAC_ONE;
+		}
+
+		pos[i]  = p;
+		frac[i] = (uint16_t)f;
+	}
+}
+
+static void plane_scale_init(struct plane_scale *scale,
+		uint32_t src_width, uint32_t src_height,
+		uint32_t dst_width, uint32_t dst_height, uint32_t pixel_size)
+{
+	scale->src_width  = src_width;
+	scale->src_height = src_height;
+	scale->dst_width  = dst_width;
+	scale->dst_height = dst_height;
+	scale->pixel_size = pixel_size;
+
+	scale->x_pos  = bmalloc(dst_width  * sizeof(uint32_t));
+	scale->x_frac = bmalloc(dst_width  * sizeof(uint16_t));
+	scale->y_pos  = bmalloc(dst_height * sizeof(uint32_t));
+	scale->y_frac = bmalloc(dst_height * sizeof(uint16_t));
+
+	init_positions(scale->x_pos, scale->x_frac, dst_width, src_width);
+	init_positions(scale->y_pos, scale->y_frac, dst_height, src_height);
+}
+
+static void plane_scale_free(struct plane_scale *scale)
+{
+	bfree(scale->x_pos);
+	bfree(scale->x_frac);
+	bfree(scale->y_pos);
+	bfree(scale->y_frac);
+}
+
+/* blends two source lines, 16 bytes at a time */
+static void blend_lines(uint8_t *out, const uint8_t *line0,
+		const uint8_t *line1, size_t size, uint16_t frac)
+{
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128i w0    = _mm_set1_epi16((short)(FRAC_ONE - frac));
+	const __m128i w1    = _mm_set1_epi16((short)frac);
+	const __m128i round = _mm_set1_epi16(FRAC_ONE / 2);
+	size_t x = 0;
+
+	for (; x + 16 <= size; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(line0 + x));
+		__m128i b = _mm_loadu_si128((const __m128i*)(line1 + x));
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0);
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0);
+		__m128i b_lo, b_hi;
+
+		b_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1);
+		b_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1);
+		lo   = _mm_add_epi16(lo, b_lo);
+		hi   = _mm_add_epi16(hi, b_hi);
+
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), FRAC_BITS);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), FRAC_BITS);
+
+		_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+	}
+
+	for (; x < size; x++)
+		out[x] = (uint8_t)((line0[x] * (FRAC_ONE - frac) +
+				line1[x] * frac + FRAC_ONE / 2) >> FRAC_BITS);
+}
+
+static inline uint8_t lerp(const uint8_t *p, size_t next, uint16_t frac)
+{
+	return (uint8_t)((p[0] * (FRAC_ONE - frac) + p[next] * frac +
+			FRAC_ONE / 2) >> FRAC_BITS);
+}
+
+/* blends eight pairs of 16 bit samples with eight 16 bit weights */
+static inline __m128i lerp8(__m128i a, __m128i b, __m128i frac)
+{
+	const __m128i one   = _mm_set1_epi16(FRAC_ONE);
+	const __m128i round = _mm_set1_epi16(FRAC_ONE / 2);
+	__m128i val;
+
+	val = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(one, frac)),
+			_mm_mullo_epi16(b, frac));
+	return _mm_srli_epi16(_mm_add_epi16(val, round), FRAC_BITS);
+}
+
+/*
+ * Halving: every output is the average of two whole input pixels, so the
+ * even and odd pixels are separated with masks and shuffles and averaged,
+ * 16 input bytes at a time.
+ */
+static size_t halve_line(uint8_t *out, const uint8_t *line, size_t out_size,
+		uint32_t pixel_size)
+{
+	const __m128i mask = _mm_set1_epi16(0xFF);
+	size_t x = 0;
+
+	if (pixel_size == 2) {
+		for (; x + 8 <= out_size; x += 8) {
+			__m128i v = _mm_loadu_si128(
+					(const __m128i*)(line + x * 2));
+
+			/* even pairs to the low half, odd to the high */
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+			v = _mm_avg_epu8(v, _mm_srli_si128(v, 8));
+
+			_mm_storel_epi64((__m128i*)(out + x), v);
+		}
+	} else {
+		for (; x + 16 <= out_size; x += 16) {
+			__m128i v0 = _mm_loadu_si128(
+					(const __m128i*)(line + x * 2));
+			__m128i v1 = _mm_loadu_si128(
+					(const __m128i*)(line + x * 2 + 16));
+
+			v0 = _mm_avg_epu16(_mm_and_si128(v0, mask),
+					_mm_srli_epi16(v0, 8));
+			v1 = _mm_avg_epu16(_mm_and_si128(v1, mask),
+					_mm_srli_epi16(v1, 8));
+
+			_mm_storeu_si128((__m128i*)(out + x),
+					_mm_packus_epi16(v0, v1));
+		}
+	}
+
+	return x;
+}
+
+/*
+ * Any other ratio: the two taps of each output are gathered into vectors,
+ * then blended with the precomputed weights eight output bytes at a time.
+ */
+static size_t scale_line(const struct plane_scale *scale, uint8_t *out,
+		const uint8_t *line, size_t out_size)
+{
+	const uint32_t *pos  = scale->x_pos;
+	const uint16_t *frac = scale->x_frac;
+	size_t x = 0;
+
+	if (scale->pixel_size == 2) {
+		for (; x + 8 <= out_size; x += 8) {
+			const uint8_t *p0 = line + pos[x / 2]     * 2;
+			const uint8_t *p1 = line + pos[x / 2 + 1] * 2;
+			const uint8_t *p2 = line + pos[x / 2 + 2] * 2;
+			const uint8_t *p3 = line + pos[x / 2 + 3] * 2;
+			const uint16_t *f = frac + x / 2;
+			__m128i a, b, w;
+
+			a = _mm_setr_epi16(p0[0], p0[1], p1[0], p1[1],
+					p2[0], p2[1], p3[0], p3[1]);
+			b = _mm_setr_epi16(p0[2], p0[3], p1[2], p1[3],
+					p2[2], p2[3], p3[2], p3[3]);
+			w = _mm_setr_epi16(f[0], f[0], f[1], f[1],
+					f[2], f[2], f[3], f[3]);
+
+			a = lerp8(a, b, w);
+			_mm_storel_epi64((__m128i*)(out + x),
+					_mm_packus_epi16(a, a));
+		}
+	} else {
+		for (; x + 8 <= out_size; x += 8) {
+			const uint32_t *p = pos + x;
+			__m128i a, b, w;
+
+			a = _mm_setr_epi16(
+					line[p[0]], line[p[1]],
+					line[p[2]], line[p[3]],
+					line[p[4]], line[p[5]],
+					line[p[6]], line[p[7]]);
+			b = _mm_setr_epi16(
+					line[p[0] + 1], line[p[1] + 1],
+					line[p[2] + 1], line[p[3] + 1],
+					line[p[4] + 1], line[p[5] + 1],
+					line[p[6] + 1], line[p[7] + 1]);
+			w = _mm_loadu_si128((const __m128i*)(frac + x));
+
+			a = lerp8(a, b, w);
+			_mm_storel_epi64((__m128i*)(out + x),
+					_mm_packus_epi16(a, a));
+		}
+	}
+
+	return x;
+}
+
+static void scale_plane(const struct plane_scale *scale,
+		uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize, uint8_t *temp)
+{
+	size_t line_size = scale->src_width * scale->pixel_size;
+	size_t out_size  = scale->dst_width * scale->pixel_size;
+	bool   halve     = scale->src_width == scale->dst_width * 2;
+
+	for (uint32_t y = 0; y < scale->dst_height; y++) {
+		const uint8_t *line0 = src + scale->y_pos[y] * src_linesize;
+		const uint8_t *line  = line0;
+		uint8_t *out = dst + y * dst_linesize;
+		size_t x;
+
+		if (scale->y_frac[y]) {
+			blend_lines(temp, line0, line0 + src_linesize,
+					line_size, scale->y_frac[y]);
+			line = temp;
+		}
+
+		x = halve ?
+			halve_line(out, line, out_size, scale->pixel_size) :
+			scale_line(scale, out, line, out_size);
+
+		/* remaining bytes of the line */
+		if (scale->pixel_size == 2) {
+			for (; x < out_size; x += 2) {
+				const uint8_t *p = line + scale->x_pos[x/2] * 2;
+				uint16_t frac = scale->x_frac[x/2];
+
+				out[x]     = lerp(p,     2, frac);
+				out[x + 1] = lerp(p + 1, 2, frac);
+			}
+		} else {
+			for (; x < out_size; x++)
+				out[x] = lerp(line + scale->x_pos[x], 1,
+						scale->x_frac[x]);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool video_pyramid_format_supported(enum video_format format)
+{
+	return format == VIDEO_FORMAT_I420 ||
+	       format == VIDEO_FORMAT_NV12 ||
+	       format == VIDEO_FORMAT_I444;
+}
+
+static void init_level_planes(struct video_pyramid *pyramid,
+		struct pyramid_level *level, const struct pyramid_level *prev)
+{
+	uint32_t sw = prev->width,  sh = prev->height;
+	uint32_t dw = level->width, dh = level->height;
+
+	plane_scale_init(&level->planes[0], sw, sh, dw, dh, 1);
+
+	switch (pyramid->format) {
+	case VIDEO_FORMAT_I420:
+		plane_scale_init(&level->planes[1], sw/2, sh/2, dw/2, dh/2, 1);
+		plane_scale_init(&level->planes[2], sw/2, sh/2, dw/2, dh/2, 1);
+		level->num_planes = 3;
+		break;
+	case VIDEO_FORMAT_NV12:
+		plane_scale_init(&level->planes[1], sw/2, sh/2, dw/2, dh/2, 2);
+		level->num_planes = 2;
+		break;
+	default:
+		plane_scale_init(&level->planes[1], sw, sh, dw, dh, 1);
+		plane_scale_init(&level->planes[2], sw, sh, dw, dh, 1);
+		level->num_planes = 3;
+	}
+}
+
+struct video_pyramid *video_pyramid_create(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct video_pyramid *pyramid;
+
+	if (!video_pyramid_format_supported(format) || width < 4 || height < 4)
+		return NULL;
+
+	pyramid = bzalloc(sizeof(struct video_pyramid));
+	pyramid->format           = format;
+	pyramid->levels[0].width  = width;
+	pyramid->levels[0].height = height;
+	pyramid->num_levels       = 1;
+
+	for (size_t i = 0; i < VIDEO_PYRAMID_MAX_LEVELS - 1; i++) {
+		struct pyramid_level *prev = pyramid->levels +
+			(pyramid->num_levels - 1);
+		struct pyramid_level *level = prev + 1;
+		uint32_t level_height = level_heights[i];
+		uint32_t level_width;
+
+		if (level_height >= prev->height)
+			continue;
+
+		/* keep the aspect ratio, rounded to an even width */
+		level_width = (uint32_t)(((uint64_t)width * level_height +
+				height) / (height * 2)) * 2;
+		if (level_width < 4 || level_width > prev->width)
+			continue;
+
+		level->width  = level_width;
+		level->height = level_height;
+		video_frame_init(&level->frame, format, level_width,
+				level_height);
+		init_level_planes(pyramid, level, prev);
+
+		pyramid->num_levels++;
+	}
+
+	/* no plane has more bytes per line than the luma plane */
+	pyramid->line = bmalloc(width);
+	return pyramid;
+}
+
+void video_pyramid_destroy(struct video_pyramid *pyramid)
+{
+	if (!pyramid)
+		return;
+
+	for (size_t i = 1; i < pyramid->num_levels; i++) {
+		struct pyramid_level *level = pyramid->levels + i;
+
+		for (size_t j = 0; j < level->num_planes; j++)
+			plane_scale_free(level->planes + j);
+		video_frame_free(&level->frame);
+	}
+
+	bfree(pyramid->line);
+	bfree(pyramid);
+}
+
+size_t video_pyramid_num_levels(const struct video_pyramid *pyramid)
+{
+	return pyramid ? pyramid->num_levels : 0;
+}
+
+size_t video_pyramid_find_level(const struct video_pyramid *pyramid,
+		uint32_t width, uint32_t height)
+{
+	size_t idx = 0;
+
+	for (size_t i = 1; i < pyramid->num_levels; i++) {
+		const struct pyramid_level *level = pyramid->levels + i;
+
+		if (level->width < width || level->height < height)
+			break;
+		idx = i;
+	}
+
+	return idx;
+}
+
+void video_pyramid_get_size(const struct video_pyramid *pyramid,
+		size_t level, uint32_t *width, uint32_t *height)
+{
+	*width  = pyramid->levels[level].width;
+	*height = pyramid->levels[level].height;
+}
+
+uint64_t video_pyramid_get_scale_time(const struct video_pyramid *pyramid,
+		size_t level)
+{
+	const struct pyramid_level *l = pyramid->levels + level;
+	return l->scaled_frames ? l->scale_time / l->scaled_frames : 0;
+}
+
+uint32_t video_pyramid_get_scaled_frames(const struct video_pyramid *pyramid,
+		size_t level)
+{
+	return pyramid->levels[level].scaled_frames;
+}
+
+void video_pyramid_build(struct video_pyramid *pyramid,
+		const struct video_data *frame, size_t num_levels)
+{
+	const uint8_t *src[MAX_PYRAMID_PLANES];
+	const uint32_t *src_linesize = frame->linesize;
+
+	if (num_levels > pyramid->num_levels)
+		num_levels = pyramid->num_levels;
+
+	for (size_t i = 0; i < MAX_PYRAMID_PLANES; i++)
+		src[i] = frame->data[i];
+
+	for (size_t i = 1; i < num_levels; i++) {
+		struct pyramid_level *level = pyramid->levels + i;
+		uint64_t start_time = os_gettime_ns();
+
+		for (size_t j = 0; j < level->num_planes; j++)
+			scale_plane(level->planes + j,
+					level->frame.data[j],
+					level->frame.linesize[j],
+					src[j], src_linesize[j],
+					pyramid->line);
+
+		level->scale_time += os_gettime_ns() - start_time;
+		level->scaled_frames++;
+
+		for (size_t j = 0; j < MAX_PYRAMID_PLANES; j++)
+			src[j] = level->frame.data[j];
+		src_linesize = level->frame.linesize;
+	}
+}
+
+void video_pyramid_get_frame(const struct video_pyramid *pyramid,
+		size_t level, struct video_data *frame)
+{
+	const struct video_frame *level_frame;
+
+	if (!level)
+		return;
+
+	level_frame = &pyramid->levels[level].frame;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i]     = level_frame->data[i];
+		frame->linesize[i] = level_frame->linesize[i];
+	}
+}
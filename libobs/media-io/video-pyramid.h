@@ -0,0 +1,70 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Downscale pyramid for multi-rendition output
+ *
+ *   Level 0 is the full resolution frame, the other levels are 1080p, 720p
+ * and 480p (whichever are smaller than the output), each scaled from the
+ * previous level.  Only planar YUV formats are supported.
+ */
+
+#define VIDEO_PYRAMID_MAX_LEVELS 4
+
+struct video_pyramid;
+
+extern bool video_pyramid_format_supported(enum video_format format);
+
+extern struct video_pyramid *video_pyramid_create(enum video_format format,
+		uint32_t width, uint32_t height);
+extern void video_pyramid_destroy(struct video_pyramid *pyramid);
+
+extern size_t video_pyramid_num_levels(const struct video_pyramid *pyramid);
+
+/* returns the smallest level that is at least the specified size */
+extern size_t video_pyramid_find_level(const struct video_pyramid *pyramid,
+		uint32_t width, uint32_t height);
+
+extern void video_pyramid_get_size(const struct video_pyramid *pyramid,
+		size_t level, uint32_t *width, uint32_t *height);
+
+/* average time spent scaling to the level, in nanoseconds */
+extern uint64_t video_pyramid_get_scale_time(
+		const struct video_pyramid *pyramid, size_t level);
+extern uint32_t video_pyramid_get_scaled_frames(
+		const struct video_pyramid *pyramid, size_t level);
+
+/* scales the frame down to levels 1 through num_levels-1 */
+extern void video_pyramid_build(struct video_pyramid *pyramid,
+		const struct video_data *frame, size_t num_levels);
+
+/* replaces the planes of the frame with the planes of the level */
+extern void video_pyramid_get_frame(const struct video_pyramid *pyramid,
+		size_t level, struct video_data *frame);
+
+#ifdef __cplusplus
+}
+#endif
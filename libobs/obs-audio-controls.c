@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "util/threading.h"
 #include "util/bmem.h"
+#include "media-io/audio-meter.h"
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -49,28 +50,52 @@ struct obs_fader {
 struct obs_volmeter {
 	pthread_mutex_t        mutex;
 	signal_handler_t       *signals;
+	signal_info_t          *levels_signal;
+	signal_info_t          *channel_levels_signal;
 	obs_fader_conversion_t pos_to_db;
 	obs_fader_conversion_t db_to_pos;
 	obs_source_t           *source;
 	enum obs_fader_type    type;
-	float                  cur_db;
 
 	unsigned int           channels;
 	unsigned int           update_ms;
-	unsigned int           update_frames;
 	unsigned int           peakhold_ms;
-	unsigned int           peakhold_frames;
 
+	/* read by the audio path without locking */
+	volatile long          update_frames;
+	volatile long          peakhold_frames;
+
+	/* only accessed by the audio path */
 	unsigned int           peakhold_count;
 	unsigned int           ival_frames;
-	float                  ival_sum;
-	float                  ival_max;
+	struct audio_meter     meter;
+	struct audio_meter_levels ival_levels;
+	struct obs_volmeter_channel_levels channel_levels;
 
 	float                  vol_peak;
 	float                  vol_mag;
 	float                  vol_max;
 };
 
+struct audio_tap_packet {
+	struct audio_data      audio;
+	bool                   muted;
+	uint32_t               capacity;
+};
+
+struct obs_audio_tap_queue {
+	struct audio_tap_packet *packets;
+	size_t                 size;
+	size_t                 planes;
+	size_t                 block_size;
+
+	/* packet counters, head is written by the producer and tail by the
+	 * consumer */
+	volatile long          head;
+	volatile long          tail;
+	uint64_t               dropped;
+};
+
 static const char *fader_signals[] = {
 	"void volume_changed(ptr fader, float db)",
 	NULL
@@ -79,6 +104,7 @@ static const char *fader_signals[] = {
 static const char *volmeter_signals[] = {
 	"void levels_updated(ptr volmeter, float level, "
 			"float magnitude, float peak, bool muted)",
+	"void channel_levels_updated(ptr volmeter, ptr levels, bool muted)",
 	NULL
 };
 
@@ -215,14 +241,14 @@ static void signal_volume_changed(signal_handler_t *sh,
 	calldata_free(&data);
 }
 
-static void signal_levels_updated(signal_handler_t *sh,
-		struct obs_volmeter *volmeter,
+static void signal_levels_updated(struct obs_volmeter *volmeter,
 		const float level, const float magnitude, const float peak,
 		bool muted)
 {
 	struct calldata data;
+	uint8_t stack[256];
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
 	calldata_set_ptr  (&data, "volmeter",  volmeter);
 	calldata_set_float(&data, "level",     level);
@@ -230,9 +256,22 @@ static void signal_levels_updated(signal_handler_t *sh,
 	calldata_set_float(&data, "peak",      peak);
 	calldata_set_bool (&data, "muted",     muted);
 
-	signal_handler_signal(sh, "levels_updated", &data);
+	signal_emit(volmeter->levels_signal, &data);
+}
 
-	calldata_free(&data);
+static void signal_channel_levels_updated(struct obs_volmeter *volmeter,
+		const struct obs_volmeter_channel_levels *levels, bool muted)
+{
+	struct calldata data;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&data, stack, sizeof(stack));
+
+	calldata_set_ptr (&data, "volmeter", volmeter);
+	calldata_set_ptr (&data, "levels",   (void*)levels);
+	calldata_set_bool(&data, "muted",    muted);
+
+	signal_emit(volmeter->channel_levels_signal, &data);
 }
 
 static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
@@ -257,18 +296,6 @@ static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
 	signal_volume_changed(sh, fader, db);
 }
 
-static void volmeter_source_volume_changed(void *vptr, calldata_t *calldata)
-{
-	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
-
-	pthread_mutex_lock(&volmeter->mutex);
-
-	float mul = (float) calldata_float(calldata, "volume");
-	volmeter->cur_db = mul_to_db(mul);
-
-	pthread_mutex_unlock(&volmeter->mutex);
-}
-
 static void fader_source_destroyed(void *vptr, calldata_t *calldata)
 {
 	UNUSED_PARAMETER(calldata);
@@ -285,28 +312,6 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-/* TODO: Separate for individual channels */
-static void volmeter_sum_and_max(float *data[MAX_AV_PLANES], size_t frames,
-		float *sum, float *max)
-{
-	float s  = *sum;
-	float m  = *max;
-
-	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
-		if (!data[plane])
-			break;
-
-		for (float *c = data[plane]; c < data[plane] + frames; ++c) {
-			const float pow = *c * *c;
-			s += pow;
-			m  = (m > pow) ? m : pow;
-		}
-	}
-
-	*sum = s;
-	*max = m;
-}
-
 /**
  * @todo The IIR low pass filter has a different behavior depending on the
  *       update interval and sample rate, it should be replaced with something
@@ -314,10 +319,28 @@ static void volmeter_sum_and_max(float *data[MAX_AV_PLANES], size_t frames,
  */
 static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 {
+	struct audio_meter_levels *ival = &volmeter->ival_levels;
+	struct obs_volmeter_channel_levels *channel = &volmeter->channel_levels;
 	const unsigned int samples = volmeter->ival_frames * volmeter->channels;
 	const float alpha    = 0.15f;
-	const float ival_max = sqrtf(volmeter->ival_max);
-	const float ival_rms = sqrtf(volmeter->ival_sum / (float)samples);
+	float ival_sum       = 0.0f;
+	float ival_max       = 0.0f;
+	float ival_rms;
+
+	for (size_t ch = 0; ch < volmeter->channels; ch++) {
+		ival_sum += ival->sum[ch];
+		if (ival->peak[ch] > ival_max)
+			ival_max = ival->peak[ch];
+
+		channel->magnitude[ch] = sqrtf(ival->sum[ch] /
+				(float)volmeter->ival_frames);
+		channel->peak[ch]      = ival->peak[ch];
+		channel->true_peak[ch] = ival->true_peak[ch] > ival->peak[ch] ?
+			ival->true_peak[ch] : ival->peak[ch];
+	}
+
+	channel->channels = volmeter->channels;
+	ival_rms = sqrtf(ival_sum / (float)samples);
 
 	if (ival_max > volmeter->vol_max) {
 		volmeter->vol_max = ival_max;
@@ -326,8 +349,11 @@ static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 				(1.0f - alpha) * ival_max;
 	}
 
+	const unsigned int peakhold_frames =
+		(unsigned int)os_atomic_load_long(&volmeter->peakhold_frames);
+
 	if (volmeter->vol_max > volmeter->vol_peak ||
-			volmeter->peakhold_count > volmeter->peakhold_frames) {
+			volmeter->peakhold_count > peakhold_frames) {
 		volmeter->vol_peak       = volmeter->vol_max;
 		volmeter->peakhold_count = 0;
 	} else {
@@ -339,29 +365,33 @@ static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 
 	/* reset interval data */
 	volmeter->ival_frames = 0;
-	volmeter->ival_sum    = 0.0f;
-	volmeter->ival_max    = 0.0f;
+	audio_meter_levels_clear(&volmeter->ival_levels);
 }
 
 static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
-		struct audio_data *data)
+		const struct audio_data *data)
 {
 	bool updated   = false;
 	size_t frames  = 0;
 	size_t left    = data->frames;
 	float *adata[MAX_AV_PLANES];
+	const unsigned int update_frames =
+		(unsigned int)os_atomic_load_long(&volmeter->update_frames);
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		adata[i] = (float*)data->data[i];
 
+	/* the interval may have been shortened in the meantime */
+	if (volmeter->ival_frames > update_frames)
+		volmeter->ival_frames = update_frames;
+
 	while (left) {
-		frames  = (volmeter->ival_frames + left >
-				volmeter->update_frames)
-			? volmeter->update_frames - volmeter->ival_frames
+		frames  = (volmeter->ival_frames + left > update_frames)
+			? update_frames - volmeter->ival_frames
 			: left;
 
-		volmeter_sum_and_max(adata, frames, &volmeter->ival_sum,
-				&volmeter->ival_max);
+		audio_meter_process(&volmeter->meter, &volmeter->ival_levels,
+				adata, volmeter->channels, frames);
 
 		volmeter->ival_frames += (unsigned int)frames;
 		left                  -= frames;
@@ -373,7 +403,7 @@ static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
 		}
 
 		/* break if we did not reach the end of the interval */
-		if (volmeter->ival_frames != volmeter->update_frames)
+		if (volmeter->ival_frames != update_frames)
 			break;
 
 		volmeter_calc_ival_levels(volmeter);
@@ -383,33 +413,36 @@ static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
 	return updated;
 }
 
-static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
+/* audio tap, the interval data is only touched here so no locking needed */
+static void volmeter_source_data_received(void *vptr, obs_source_t *source,
+		const struct audio_data *data, bool muted)
 {
 	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
-	bool updated = false;
+	struct obs_volmeter_channel_levels levels;
 	float mul, level, mag, peak;
-	signal_handler_t *sh;
 
-	pthread_mutex_lock(&volmeter->mutex);
+	if (!volmeter_process_audio_data(volmeter, data))
+		return;
 
-	struct audio_data *data = calldata_ptr(calldata, "data");
-	updated = volmeter_process_audio_data(volmeter, data);
+	mul   = obs_source_get_volume(source);
 
-	if (updated) {
-		mul   = db_to_mul(volmeter->cur_db);
+	level = volmeter->db_to_pos(mul_to_db(volmeter->vol_max * mul));
+	mag   = volmeter->db_to_pos(mul_to_db(volmeter->vol_mag * mul));
+	peak  = volmeter->db_to_pos(mul_to_db(volmeter->vol_peak * mul));
 
-		level = volmeter->db_to_pos(mul_to_db(volmeter->vol_max * mul));
-		mag   = volmeter->db_to_pos(mul_to_db(volmeter->vol_mag * mul));
-		peak  = volmeter->db_to_pos(
-				mul_to_db(volmeter->vol_peak * mul));
-		sh    = volmeter->signals;
-	}
+	signal_levels_updated(volmeter, level, mag, peak, muted);
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	levels.channels = volmeter->channel_levels.channels;
+	for (size_t ch = 0; ch < levels.channels; ch++) {
+		const struct obs_volmeter_channel_levels *ival =
+			&volmeter->channel_levels;
+
+		levels.magnitude[ch] = mul_to_db(ival->magnitude[ch] * mul);
+		levels.peak[ch]      = mul_to_db(ival->peak[ch] * mul);
+		levels.true_peak[ch] = mul_to_db(ival->true_peak[ch] * mul);
+	}
 
-	if (updated)
-		signal_levels_updated(sh, volmeter, level, mag, peak,
-				calldata_bool(calldata, "muted"));
+	signal_channel_levels_updated(volmeter, &levels, muted);
 }
 
 static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
@@ -417,9 +450,10 @@ static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
 	audio_t *audio            = obs_get_audio();
 	const unsigned int sr     = audio_output_get_sample_rate(audio);
 
-	volmeter->channels        = (uint32_t)audio_output_get_channels(audio);
-	volmeter->update_frames   = volmeter->update_ms * sr / 1000;
-	volmeter->peakhold_frames = volmeter->peakhold_ms * sr / 1000;
+	os_atomic_set_long(&volmeter->update_frames,
+			(long)(volmeter->update_ms * sr / 1000));
+	os_atomic_set_long(&volmeter->peakhold_frames,
+			(long)(volmeter->peakhold_ms * sr / 1000));
 }
 
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
@@ -632,6 +666,12 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 	if (!signal_handler_add_array(volmeter->signals, volmeter_signals))
 		goto fail;
 
+	/* both are emitted for every audio packet, so look them up once */
+	volmeter->levels_signal = signal_handler_get_signal(
+			volmeter->signals, "levels_updated");
+	volmeter->channel_levels_signal = signal_handler_get_signal(
+			volmeter->signals, "channel_levels_updated");
+
 	/* set conversion functions */
 	switch(type) {
 	case OBS_FADER_CUBIC:
@@ -650,7 +690,9 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 		break;
 	}
-	volmeter->type = type;
+	volmeter->type     = type;
+	volmeter->channels =
+		(unsigned int)audio_output_get_channels(obs_get_audio());
 
 	obs_volmeter_set_update_interval(volmeter, 50);
 	obs_volmeter_set_peak_hold(volmeter, 1500);
@@ -685,15 +727,13 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 	pthread_mutex_lock(&volmeter->mutex);
 
 	sh = obs_source_get_signal_handler(source);
-	signal_handler_connect(sh, "volume",
-			volmeter_source_volume_changed, volmeter);
-	signal_handler_connect(sh, "audio_data",
-			volmeter_source_data_received, volmeter);
 	signal_handler_connect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
+	audio_meter_reset(&volmeter->meter);
+	obs_source_add_audio_tap(source, volmeter_source_data_received,
+			volmeter, 0);
 
 	volmeter->source = source;
-	volmeter->cur_db = mul_to_db(obs_source_get_volume(source));
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
@@ -713,9 +753,7 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 		goto exit;
 
 	sh = obs_source_get_signal_handler(volmeter->source);
-	signal_handler_disconnect(sh, "volume",
-			volmeter_source_volume_changed, volmeter);
-	signal_handler_disconnect(sh, "audio_data",
+	obs_source_remove_audio_tap(volmeter->source,
 			volmeter_source_data_received, volmeter);
 	signal_handler_disconnect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
@@ -777,3 +815,110 @@ unsigned int obs_volmeter_get_peak_hold(obs_volmeter_t *volmeter)
 
 	return peakhold;
 }
+
+obs_audio_tap_queue_t *obs_audio_tap_queue_create(size_t packets)
+{
+	struct obs_audio_tap_queue *queue;
+	audio_t *audio = obs_get_audio();
+
+	if (!audio || !packets)
+		return NULL;
+
+	queue = bzalloc(sizeof(struct obs_audio_tap_queue));
+	queue->size       = packets;
+	queue->packets    = bzalloc(sizeof(struct audio_tap_packet) * packets);
+	queue->planes     = audio_output_get_planes(audio);
+	queue->block_size = audio_output_get_block_size(audio);
+
+	return queue;
+}
+
+void obs_audio_tap_queue_destroy(obs_audio_tap_queue_t *queue)
+{
+	if (!queue)
+		return;
+
+	if (queue->dropped)
+		blog(LOG_DEBUG, "audio tap queue dropped %llu packets",
+				(unsigned long long)queue->dropped);
+
+	for (size_t i = 0; i < queue->size; i++)
+		bfree(queue->packets[i].audio.data[0]);
+
+	bfree(queue->packets);
+	bfree(queue);
+}
+
+static void audio_tap_packet_reserve(struct obs_audio_tap_queue *queue,
+		struct audio_tap_packet *packet, uint32_t frames)
+{
+	size_t plane_size = queue->block_size * frames;
+	uint8_t *data;
+
+	/* grows rarely, packets are usually the same size */
+	bfree(packet->audio.data[0]);
+	data = bmalloc(plane_size * queue->planes);
+
+	for (size_t i = 0; i < queue->planes; i++)
+		packet->audio.data[i] = data + plane_size * i;
+	packet->capacity = frames;
+}
+
+void obs_audio_tap_queue_push(void *param, obs_source_t *source,
+		const struct audio_data *audio, bool muted)
+{
+	struct obs_audio_tap_queue *queue = param;
+	struct audio_tap_packet *packet;
+	long head = queue->head;
+	long tail = os_atomic_load_long(&queue->tail);
+
+	if ((unsigned long)head - (unsigned long)tail >= queue->size) {
+		queue->dropped++;
+		return;
+	}
+
+	packet = queue->packets + (unsigned long)head % queue->size;
+	if (audio->frames > packet->capacity)
+		audio_tap_packet_reserve(queue, packet, audio->frames);
+
+	for (size_t i = 0; i < queue->planes; i++)
+		memcpy(packet->audio.data[i], audio->data[i],
+				queue->block_size * audio->frames);
+
+	packet->audio.frames    = audio->frames;
+	packet->audio.timestamp = audio->timestamp;
+	packet->audio.volume    = audio->volume;
+	packet->muted           = muted;
+
+	os_atomic_set_long(&queue->head, (long)((unsigned long)head + 1));
+
+	UNUSED_PARAMETER(source);
+}
+
+const struct audio_data *obs_audio_tap_queue_peek(
+		obs_audio_tap_queue_t *queue, bool *muted)
+{
+	struct audio_tap_packet *packet;
+	long head;
+
+	if (!queue)
+		return NULL;
+
+	head = os_atomic_load_long(&queue->head);
+	if (head == queue->tail)
+		return NULL;
+
+	packet = queue->packets + (unsigned long)queue->tail % queue->size;
+	if (muted)
+		*muted = packet->muted;
+	return &packet->audio;
+}
+
+void obs_audio_tap_queue_pop(obs_audio_tap_queue_t *queue)
+{
+	if (!queue || os_atomic_load_long(&queue->head) == queue->tail)
+		return;
+
+	os_atomic_set_long(&queue->tail,
+			(long)((unsigned long)queue->tail + 1));
+}
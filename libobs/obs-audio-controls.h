@@ -161,6 +161,23 @@ EXPORT void obs_fader_detach_source(obs_fader_t *fader);
  */
 EXPORT signal_handler_t *obs_fader_get_signal_handler(obs_fader_t *fader);
 
+/**
+ * @brief Per-channel levels of a volume meter update interval
+ *
+ * Passed as "levels" with the channel_levels_updated signal of the volume
+ * meter.  All levels are in dB and include the source volume.
+ */
+struct obs_volmeter_channel_levels {
+	/** number of valid channels */
+	size_t channels;
+	/** RMS level of each channel */
+	float  magnitude[MAX_AV_PLANES];
+	/** sample peak of each channel */
+	float  peak[MAX_AV_PLANES];
+	/** 4x oversampled true peak of each channel (ITU-R BS.1770) */
+	float  true_peak[MAX_AV_PLANES];
+};
+
 /**
  * @brief Create a volume meter
  * @param type the mapping type to use for the volume meter
@@ -251,6 +268,51 @@ EXPORT void obs_volmeter_set_peak_hold(obs_volmeter_t *volmeter,
  */
 EXPORT unsigned int obs_volmeter_get_peak_hold(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Create an audio tap queue
+ *
+ * The queue is a lock-free single producer, single consumer queue that moves
+ * audio packets from the audio path of a source to a consumer thread (for
+ * example an analyzer), which polls it at its own rate.  Add it to a
+ * source with obs_source_add_audio_tap(source, obs_audio_tap_queue_push,
+ * queue, n).  Packets are dropped if the consumer falls behind.
+ *
+ * @param packets maximum number of queued packets
+ * @return new audio tap queue
+ */
+EXPORT obs_audio_tap_queue_t *obs_audio_tap_queue_create(size_t packets);
+
+/**
+ * @brief Destroy an audio tap queue
+ *
+ * Remove the tap from the source before destroying the queue.
+ * @param queue pointer to the queue
+ */
+EXPORT void obs_audio_tap_queue_destroy(obs_audio_tap_queue_t *queue);
+
+/**
+ * @brief Audio tap callback that copies packets into the queue
+ * @param queue pointer to the queue
+ */
+EXPORT void obs_audio_tap_queue_push(void *queue, obs_source_t *source,
+		const struct audio_data *audio, bool muted);
+
+/**
+ * @brief Get the oldest queued packet without removing it
+ * @param queue pointer to the queue
+ * @param muted receives whether the source was muted, can be NULL
+ * @return the packet, or NULL if the queue is empty.  The data stays valid
+ *         until obs_audio_tap_queue_pop is called.
+ */
+EXPORT const struct audio_data *obs_audio_tap_queue_peek(
+		obs_audio_tap_queue_t *queue, bool *muted);
+
+/**
+ * @brief Remove the oldest queued packet
+ * @param queue pointer to the queue
+ */
+EXPORT void obs_audio_tap_queue_pop(obs_audio_tap_queue_t *queue);
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,10 +44,68 @@ bool obs_avc_keyframe(const uint8_t *data, size_t size)
 	return false;
 }
 
-/* NOTE: I noticed that FFmpeg does some unusual special handling of certain
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <emmintrin.h>
+
+static inline int first_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return (int)idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/* Tests 16 positions at a time for {0, 0, 1}.  Most blocks of compressed
+ * video have no zero byte at all, so those are skipped after one compare. */
+static const uint8_t *find_startcode_internal(const uint8_t *p,
+		const uint8_t *end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one  = _mm_set1_epi8(1);
+
+	for (; end - p >= 18; p += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)p);
+		__m128i b, c, match;
+		int     mask;
+
+		match = _mm_cmpeq_epi8(a, zero);
+		if (!_mm_movemask_epi8(match))
+			continue;
+
+		b = _mm_loadu_si128((const __m128i*)(p + 1));
+		c = _mm_loadu_si128((const __m128i*)(p + 2));
+
+		match = _mm_and_si128(match, _mm_cmpeq_epi8(b, zero));
+		match = _mm_and_si128(match, _mm_cmpeq_epi8(c, one));
+		mask  = _mm_movemask_epi8(match);
+		if (mask)
+			return p + first_bit((unsigned int)mask);
+	}
+
+	for (; end - p >= 3; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+	}
+
+	return end;
+}
+
+#else
+
+/* (used where SSE2 is not available)
+ *
+ * NOTE: I noticed that FFmpeg does some unusual special handling of certain
  * scenarios that I was unaware of, so instead of just searching for {0, 0, 1}
  * we'll just use the code from FFmpeg - http://www.ffmpeg.org/ */
-static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p,
+static const uint8_t *find_startcode_internal(const uint8_t *p,
 		const uint8_t *end)
 {
 	const uint8_t *a = p + 4 - ((intptr_t)p & 3);
@@ -85,23 +143,15 @@ static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p,
 	return end + 3;
 }
 
+#endif
+
 const uint8_t *obs_avc_find_startcode(const uint8_t *p, const uint8_t *end)
 {
-	const uint8_t *out= ff_avc_find_startcode_internal(p, end);
+	const uint8_t *out= find_startcode_internal(p, end);
 	if (p < out && out < end && !out[-1]) out--;
 	return out;
 }
 
-static inline int get_drop_priority(int priority)
-{
-	switch (priority) {
-	case OBS_NAL_PRIORITY_DISPOSABLE: return OBS_NAL_PRIORITY_DISPOSABLE;
-	case OBS_NAL_PRIORITY_LOW:        return OBS_NAL_PRIORITY_LOW;
-	}
-
-	return OBS_NAL_PRIORITY_HIGHEST;
-}
-
 static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 		size_t size, bool *is_keyframe, int *priority)
 {
@@ -138,15 +188,143 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 	struct array_output_data output;
 	struct serializer s;
 
-	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
+	/* already length prefixed, with keyframe and priority set by the
+	 * encoder, so there is nothing to scan */
+	if (src->avcc) {
+		avc_packet->data          = bmemdup(src->data, src->size);
+		avc_packet->drop_priority =
+			obs_avc_drop_priority(avc_packet->priority);
+		return;
+	}
+
+	array_output_serializer_init(&s, &output);
+
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			&avc_packet->priority);
 
 	avc_packet->data          = output.bytes.array;
 	avc_packet->size          = output.bytes.num;
-	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
+	avc_packet->drop_priority = obs_avc_drop_priority(avc_packet->priority);
+	avc_packet->avcc          = true;
+}
+
+static inline uint32_t read_nal_size(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+}
+
+static inline void add_nal(struct obs_avc_nal_index *index,
+		const uint8_t *data, const uint8_t *nal, size_t size)
+{
+	struct obs_avc_nal *entry = da_push_back_new(index->nals);
+	entry->offset  = nal - data;
+	entry->size    = size;
+	entry->type    = nal[0] & 0x1F;
+	entry->ref_idc = nal[0] >> 5;
+
+	if (entry->type == OBS_NAL_SLICE_IDR || entry->type == OBS_NAL_SLICE) {
+		index->keyframe = (entry->type == OBS_NAL_SLICE_IDR);
+		index->priority = entry->ref_idc;
+	}
+}
+
+static bool index_avcc(struct obs_avc_nal_index *index, const uint8_t *data,
+		size_t size)
+{
+	const uint8_t *nal = data;
+	const uint8_t *end = data + size;
+
+	while (nal < end) {
+		uint32_t nal_size;
+
+		if (end - nal < 4)
+			return false;
+
+		nal_size = read_nal_size(nal);
+		nal += 4;
+
+		if ((size_t)(end - nal) < nal_size)
+			return false;
+
+		if (nal_size)
+			add_nal(index, data, nal, nal_size);
+		nal += nal_size;
+	}
+
+	return true;
+}
+
+static void index_annexb(struct obs_avc_nal_index *index, const uint8_t *data,
+		size_t size)
+{
+	const uint8_t *nal_start, *nal_end;
+	const uint8_t *end = data + size;
+
+	nal_start = obs_avc_find_startcode(data, end);
+	while (true) {
+		while (nal_start < end && !*(nal_start++));
+
+		if (nal_start == end)
+			break;
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		add_nal(index, data, nal_start, nal_end - nal_start);
+		nal_start = nal_end;
+	}
+}
+
+void obs_avc_nal_index_init(struct obs_avc_nal_index *index)
+{
+	da_init(index->nals);
+	index->keyframe = false;
+	index->priority = OBS_NAL_PRIORITY_DISPOSABLE;
+}
+
+bool obs_avc_nal_index_build(struct obs_avc_nal_index *index,
+		const uint8_t *data, size_t size, bool avcc)
+{
+	da_resize(index->nals, 0);
+	index->keyframe = false;
+	index->priority = OBS_NAL_PRIORITY_DISPOSABLE;
+
+	if (avcc)
+		return index_avcc(index, data, size);
+
+	index_annexb(index, data, size);
+	return true;
+}
+
+void obs_avc_nal_index_free(struct obs_avc_nal_index *index)
+{
+	da_free(index->nals);
+}
+
+bool obs_avc_to_annexb(uint8_t *data, size_t size)
+{
+	uint8_t *end = data + size;
+
+	while (data < end) {
+		uint32_t nal_size;
+
+		if (end - data < 4)
+			return false;
+
+		nal_size = read_nal_size(data);
+
+		if ((size_t)(end - data) - 4 < nal_size)
+			return false;
+
+		data[0] = 0;
+		data[1] = 0;
+		data[2] = 0;
+		data[3] = 1;
+		data += 4 + nal_size;
+	}
+
+	return true;
 }
 
 static inline bool has_start_code(const uint8_t *data)
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "util/c99defs.h"
+#include "util/darray.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,6 +49,16 @@ enum {
 
 /* Helpers for parsing AVC NAL units.  */
 
+static inline int obs_avc_drop_priority(int priority)
+{
+	switch (priority) {
+	case OBS_NAL_PRIORITY_DISPOSABLE: return OBS_NAL_PRIORITY_DISPOSABLE;
+	case OBS_NAL_PRIORITY_LOW:        return OBS_NAL_PRIORITY_LOW;
+	}
+
+	return OBS_NAL_PRIORITY_HIGHEST;
+}
+
 EXPORT bool obs_avc_keyframe(const uint8_t *data, size_t size);
 EXPORT const uint8_t *obs_avc_find_startcode(const uint8_t *p,
 		const uint8_t *end);
@@ -56,6 +67,41 @@ EXPORT void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 EXPORT size_t obs_parse_avc_header(uint8_t **header, const uint8_t *data,
 		size_t size);
 
+/** Location of a NAL unit within a packet */
+struct obs_avc_nal {
+	size_t offset;   /**< Offset of the NAL header byte */
+	size_t size;     /**< Size, without the start code or size prefix */
+	int    type;     /**< OBS_NAL_* type */
+	int    ref_idc;  /**< Reference priority, OBS_NAL_PRIORITY_* */
+};
+
+/**
+ * All NAL units of a packet, found in a single pass so the data does not have
+ * to be searched again for each thing that needs to be known about it.
+ * Offsets are used so the index stays valid for copies of the data.  Keep
+ * one index per stream to reuse its array between packets.
+ */
+struct obs_avc_nal_index {
+	DARRAY(struct obs_avc_nal) nals;
+
+	bool   keyframe;  /**< Contains an IDR slice */
+	int    priority;  /**< Reference priority of the slices */
+};
+
+EXPORT void obs_avc_nal_index_init(struct obs_avc_nal_index *index);
+
+/**
+ * Indexes the NAL units of AVC data, which uses either start codes or 4 byte
+ * size prefixes (avcc).  Returns false if size prefixed data is truncated.
+ */
+EXPORT bool obs_avc_nal_index_build(struct obs_avc_nal_index *index,
+		const uint8_t *data, size_t size, bool avcc);
+EXPORT void obs_avc_nal_index_free(struct obs_avc_nal_index *index);
+
+/** Replaces the 4 byte size prefixes of length prefixed NAL units with start
+ * codes in place.  Returns false if the sizes do not add up to the data. */
+EXPORT bool obs_avc_to_annexb(uint8_t *data, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,12 +42,14 @@ struct obs_data_item {
 
 struct obs_data {
 	volatile long        ref;
+	volatile long        change_id;
 	char                 *json;
 	struct obs_data_item *first_item;
 };
 
 struct obs_data_array {
 	volatile long        ref;
+	volatile long        change_id;
 	DARRAY(obs_data_t*)   objects;
 };
 
@@ -62,6 +64,21 @@ struct obs_data_number {
 /* ------------------------------------------------------------------------- */
 /* Item structure, designed to be one allocation only */
 
+/* every change takes a new id, so the newest id in a data tree only ever
+ * increases, even when an object is replaced by an older one */
+static volatile long last_change_id = 0;
+
+static inline void mark_changed(volatile long *change_id)
+{
+	os_atomic_set_long(change_id, os_atomic_inc_long(&last_change_id));
+}
+
+static inline void data_changed(struct obs_data *data)
+{
+	if (data)
+		mark_changed(&data->change_id);
+}
+
 static inline size_t get_align_size(size_t size)
 {
 	const size_t alignment = base_get_alignment();
@@ -683,6 +700,54 @@ const char *obs_data_get_json(obs_data_t *data)
 	return data->json;
 }
 
+static long array_change_id(obs_data_array_t *array);
+
+long obs_data_get_change_id(obs_data_t *data)
+{
+	obs_data_item_t *item;
+	long id;
+
+	if (!data)
+		return 0;
+
+	id = os_atomic_load_long(&data->change_id);
+
+	for (item = data->first_item; item; item = item->next) {
+		long item_id = 0;
+
+		if (!item->data_size)
+			continue;
+
+		if (item->type == OBS_DATA_OBJECT)
+			item_id = obs_data_get_change_id(get_item_obj(item));
+		else if (item->type == OBS_DATA_ARRAY)
+			item_id = array_change_id(get_item_array(item));
+
+		if (item_id > id)
+			id = item_id;
+	}
+
+	return id;
+}
+
+static long array_change_id(obs_data_array_t *array)
+{
+	long id;
+
+	if (!array)
+		return 0;
+
+	id = os_atomic_load_long(&array->change_id);
+
+	for (size_t i = 0; i < array->objects.num; i++) {
+		long obj_id = obs_data_get_change_id(array->objects.array[i]);
+		if (obj_id > id)
+			id = obj_id;
+	}
+
+	return id;
+}
+
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data) return NULL;
@@ -706,6 +771,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 {
 	obs_data_item_t *new_item = NULL;
 
+	data_changed(data ? data : (*item ? (*item)->parent : NULL));
+
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 				default_data, autoselect_data);
@@ -877,6 +944,7 @@ void obs_data_erase(obs_data_t *data, const char *name)
 	struct obs_data_item *item = get_item(data, name);
 
 	if (item) {
+		data_changed(data);
 		obs_data_item_detach(item);
 		obs_data_item_release(&item);
 	}
@@ -917,6 +985,7 @@ void obs_data_clear(obs_data_t *target)
 	if (!target)
 		return;
 
+	data_changed(target);
 	item = target->first_item;
 
 	while (item) {
@@ -1220,6 +1289,7 @@ size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
 		return 0;
 
 	os_atomic_inc_long(&obj->ref);
+	mark_changed(&array->change_id);
 	return da_push_back(array->objects, &obj);
 }
 
@@ -1229,12 +1299,14 @@ void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
 		return;
 
 	os_atomic_inc_long(&obj->ref);
+	mark_changed(&array->change_id);
 	da_insert(array->objects, idx, &obj);
 }
 
 void obs_data_array_erase(obs_data_array_t *array, size_t idx)
 {
 	if (array) {
+		mark_changed(&array->change_id);
 		obs_data_release(array->objects.array[idx]);
 		da_erase(array->objects, idx);
 	}
@@ -1298,6 +1370,7 @@ void obs_data_item_unset_user_value(obs_data_item_t *item)
 
 	void *old_non_user_data = get_default_data_ptr(item);
 
+	data_changed(item->parent);
 	item_data_release(item);
 	item->data_size = 0;
 	item->data_len = 0;
@@ -1315,6 +1388,7 @@ void obs_data_item_unset_default_value(obs_data_item_t *item)
 
 	void *old_autoselect_data = get_autoselect_data_ptr(item);
 
+	data_changed(item->parent);
 	item_default_data_release(item);
 	item->default_size = 0;
 	item->default_len = 0;
@@ -1330,6 +1404,7 @@ void obs_data_item_unset_autoselect_value(obs_data_item_t *item)
 	if (!item || !item->autoselect_size)
 		return;
 
+	data_changed(item->parent);
 	item_autoselect_data_release(item);
 	item->autoselect_size = 0;
 }
@@ -1389,6 +1464,7 @@ void obs_data_item_release(obs_data_item_t **item)
 void obs_data_item_remove(obs_data_item_t **item)
 {
 	if (item && *item) {
+		data_changed((*item)->parent);
 		obs_data_item_detach(*item);
 		obs_data_item_release(item);
 	}
@@ -67,6 +67,13 @@ EXPORT void obs_data_release(obs_data_t *data);
 
 EXPORT const char *obs_data_get_json(obs_data_t *data);
 
+/**
+ * Returns an id that changes whenever a value of the data, or of any object
+ * or array stored in it, is set or removed.  Ids only ever increase, so
+ * comparing two of them tells whether the data was modified in between.
+ */
+EXPORT long obs_data_get_change_id(obs_data_t *data);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
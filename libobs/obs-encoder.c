@@ -18,16 +18,32 @@
 #include "obs.h"
 #include "obs-internal.h"
 
-struct obs_encoder_info *find_encoder(const char *id)
+static struct obs_encoder_info *find_loaded_encoder(const char *id)
 {
+	struct obs_encoder_info *found = NULL;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
 	for (size_t i = 0; i < obs->encoder_types.num; i++) {
-		struct obs_encoder_info *info = obs->encoder_types.array+i;
+		struct obs_encoder_info *info = obs->encoder_types.array[i];
 
-		if (strcmp(info->id, id) == 0)
-			return info;
+		if (strcmp(info->id, id) == 0) {
+			found = info;
+			break;
+		}
 	}
 
-	return NULL;
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
+}
+
+struct obs_encoder_info *find_encoder(const char *id)
+{
+	struct obs_encoder_info *info = find_loaded_encoder(id);
+
+	if (!info && obs_load_deferred_module(OBS_MODULE_ENCODERS, id))
+		info = find_loaded_encoder(id);
+	return info;
 }
 
 const char *obs_encoder_get_display_name(const char *id)
@@ -83,7 +99,8 @@ static struct obs_encoder *create_encoder(const char *id,
 
 	obs_context_data_insert(&encoder->context,
 			&obs->data.encoders_mutex,
-			&obs->data.first_encoder);
+			&obs->data.first_encoder,
+			&obs->data.encoders_index);
 
 	blog(LOG_INFO, "encoder '%s' (%s) created", name, id);
 	return encoder;
@@ -404,7 +421,10 @@ void obs_encoder_start(obs_encoder_t *encoder,
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
 
 	if (first) {
-		encoder->cur_pts = 0;
+		encoder->cur_pts        = 0;
+		encoder->encode_time_ns = 0;
+		encoder->encode_lag_ns  = 0;
+		encoder->overloaded     = false;
 		add_connection(encoder);
 	}
 }
@@ -538,6 +558,32 @@ bool obs_encoder_active(const obs_encoder_t *encoder)
 	return encoder ? encoder->active : false;
 }
 
+static inline uint64_t frame_interval_ns(const struct obs_encoder *encoder)
+{
+	return encoder->timebase_den ?
+		(uint64_t)encoder->timebase_num * 1000000000ULL /
+		encoder->timebase_den : 0;
+}
+
+float obs_encoder_get_load(const obs_encoder_t *encoder)
+{
+	uint64_t interval;
+
+	if (!encoder || encoder->info.type != OBS_ENCODER_VIDEO)
+		return 0.0f;
+
+	interval = frame_interval_ns(encoder);
+	return interval ?
+		(float)((double)encoder->encode_time_ns / (double)interval) :
+		0.0f;
+}
+
+uint64_t obs_encoder_get_lag_ns(const obs_encoder_t *encoder)
+{
+	return (encoder && encoder->info.type == OBS_ENCODER_VIDEO) ?
+		encoder->encode_lag_ns : 0;
+}
+
 static inline bool get_sei(const struct obs_encoder *encoder,
 		uint8_t **sei, size_t *size)
 {
@@ -600,19 +646,68 @@ static void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+#define ENCODE_TIME_SMOOTHING 16
+
+/* overload hysteresis, in percent of the frame interval */
+#define OVERLOAD_START        100
+#define OVERLOAD_END          75
+
+static void update_encode_time(struct obs_encoder *encoder, uint64_t time)
+{
+	uint64_t interval = frame_interval_ns(encoder);
+	int64_t  avg      = (int64_t)encoder->encode_time_ns;
+
+	if (!avg)
+		avg = (int64_t)time;
+	else
+		avg += ((int64_t)time - avg) / ENCODE_TIME_SMOOTHING;
+	encoder->encode_time_ns = (uint64_t)avg;
+
+	if (time > interval)
+		encoder->encode_lag_ns += time - interval;
+	else if (encoder->encode_lag_ns > interval - time)
+		encoder->encode_lag_ns -= interval - time;
+	else
+		encoder->encode_lag_ns = 0;
+
+	if (!encoder->overloaded &&
+	    encoder->encode_time_ns * 100 >= interval * OVERLOAD_START) {
+		encoder->overloaded = true;
+		blog(LOG_WARNING, "Encoder '%s' is overloaded: average encode "
+				"time %.2f ms, frame interval %.2f ms",
+				encoder->context.name,
+				(double)encoder->encode_time_ns / 1000000.0,
+				(double)interval / 1000000.0);
+
+	} else if (encoder->overloaded &&
+	           encoder->encode_time_ns * 100 < interval * OVERLOAD_END) {
+		encoder->overloaded = false;
+		blog(LOG_INFO, "Encoder '%s' is no longer overloaded: average "
+				"encode time %.2f ms",
+				encoder->context.name,
+				(double)encoder->encode_time_ns / 1000000.0);
+	}
+}
+
 static inline void do_encode(struct obs_encoder *encoder,
 		struct encoder_frame *frame)
 {
 	struct encoder_packet pkt = {0};
 	bool received = false;
 	bool success;
+	uint64_t start_time;
 
 	pkt.timebase_num = encoder->timebase_num;
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
+	/* only the encoder itself is timed, not the outputs the packets are
+	 * sent to below */
+	start_time = os_gettime_ns();
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 			&received);
+	if (encoder->info.type == OBS_ENCODER_VIDEO)
+		update_encode_time(encoder, os_gettime_ns() - start_time);
 	if (!success) {
 		full_stop(encoder);
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
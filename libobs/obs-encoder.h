@@ -77,6 +77,14 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t         *encoder;
+
+	/**
+	 * AVC video only: NAL units are prefixed with their 4 byte big endian
+	 * size instead of start codes, so outputs that need that form can
+	 * use the data as is.  Keyframe and priority must be set by the
+	 * encoder, as they will not be parsed from the data.
+	 */
+	bool                  avcc;
 };
 
 /** Encoder input frame */
@@ -93,6 +93,20 @@ static void hotkey_signal(const char *signal, obs_hotkey_t *hotkey)
 static inline void fixup_pointers(void);
 static inline void load_bindings(obs_hotkey_t *hotkey, obs_data_array_t *data);
 
+/* source hotkey bindings are saved with the source, which stays alive while
+ * its hotkeys are registered */
+static void bindings_changed(obs_hotkey_t *hotkey)
+{
+	if (hotkey->registerer_type == OBS_HOTKEY_REGISTERER_SOURCE &&
+	    hotkey->registerer) {
+		obs_weak_source_t *weak = hotkey->registerer;
+		if (weak->source)
+			obs_source_mark_dirty(weak->source);
+	}
+
+	hotkey_signal("hotkey_bindings_changed", hotkey);
+}
+
 static inline void context_add_hotkey(struct obs_context_data *context,
 		obs_hotkey_id id)
 {
@@ -620,7 +634,7 @@ static inline void load_bindings(obs_hotkey_t *hotkey, obs_data_array_t *data)
 		obs_data_release(item);
 	}
 
-	hotkey_signal("hotkey_bindings_changed", hotkey);
+	bindings_changed(hotkey);
 }
 
 static inline void remove_bindings(obs_hotkey_id id);
@@ -639,7 +653,7 @@ void obs_hotkey_load_bindings(obs_hotkey_id id,
 		for (size_t i = 0; i < num; i++)
 			create_binding(hotkey, combinations[i]);
 
-		hotkey_signal("hotkey_bindings_changed", hotkey);
+		bindings_changed(hotkey);
 	}
 	unlock();
 }
@@ -50,6 +50,17 @@ struct draw_callback {
 /* ------------------------------------------------------------------------- */
 /* modules */
 
+/* kinds of type ids a module registers, as recorded in the manifest */
+enum obs_module_types {
+	OBS_MODULE_INPUTS,
+	OBS_MODULE_FILTERS,
+	OBS_MODULE_TRANSITIONS,
+	OBS_MODULE_OUTPUTS,
+	OBS_MODULE_ENCODERS,
+	OBS_MODULE_SERVICES,
+	OBS_MODULE_TYPE_COUNT
+};
+
 struct obs_module {
 	const char *file;
 	char *bin_path;
@@ -57,6 +68,15 @@ struct obs_module {
 	void *module;
 	bool loaded;
 
+	/* not opened yet, loaded on first use of one of its types */
+	bool deferred;
+	/* has to be loaded at startup (registers UI, or nothing at all) */
+	bool eager;
+	DARRAY(char*) types[OBS_MODULE_TYPE_COUNT];
+
+	uint64_t open_time;
+	uint64_t load_time;
+
 	bool        (*load)(void);
 	void        (*unload)(void);
 	void        (*set_locale)(const char *locale);
@@ -72,6 +92,12 @@ struct obs_module {
 
 extern void free_module(struct obs_module *mod);
 
+/* opens and loads the deferred module providing the type, if any */
+extern bool obs_load_deferred_module(enum obs_module_types kind,
+		const char *id);
+/* loads all deferred modules, for type enumeration */
+extern void obs_load_deferred_modules(void);
+
 struct obs_module_path {
 	char *bin;
 	char *data;
@@ -246,11 +272,34 @@ struct obs_core_audio {
 	float                           present_volume;
 };
 
+/*
+ * Name index of contexts
+ *
+ *   Chained hash table of the contexts by name, kept up to date by
+ * obs_context_data_insert/remove/setname.  Lookups only take the read lock.
+ * Chains are kept in the order the contexts were added (oldest or newest
+ * first), so with duplicate names a lookup finds the same context the list
+ * it indexes would, renamed or not.
+ */
+struct obs_context_index {
+	pthread_rwlock_t                rwlock;
+	struct obs_context_data         **buckets;
+	size_t                          num_buckets;
+	size_t                          count;
+	uint64_t                        next_order;
+	bool                            newest_first;
+};
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	pthread_mutex_t                 user_sources_mutex;
 	DARRAY(struct obs_source*)      user_sources;
 
+	struct obs_context_index        user_sources_index;
+	struct obs_context_index        outputs_index;
+	struct obs_context_index        encoders_index;
+	struct obs_context_index        services_index;
+
 	struct obs_source               *first_source;
 	struct obs_display              *first_display;
 	struct obs_output               *first_output;
@@ -269,6 +318,9 @@ struct obs_core_data {
 
 	long long                       unnamed_index;
 
+	/* changes whenever a source is renamed, scenes save item names */
+	volatile long                   source_names_gen;
+
 	volatile bool                   valid;
 };
 
@@ -310,15 +362,24 @@ struct obs_core_hotkeys {
 struct obs_core {
 	struct obs_module               *first_module;
 	DARRAY(struct obs_module_path)  module_paths;
-
-	DARRAY(struct obs_source_info)  input_types;
-	DARRAY(struct obs_source_info)  filter_types;
-	DARRAY(struct obs_source_info)  transition_types;
-	DARRAY(struct obs_output_info)  output_types;
-	DARRAY(struct obs_encoder_info) encoder_types;
-	DARRAY(struct obs_service_info) service_types;
-	DARRAY(struct obs_modal_ui)     modal_ui_callbacks;
-	DARRAY(struct obs_modeless_ui)  modeless_ui_callbacks;
+	char                            *module_manifest_path;
+	pthread_mutex_t                 module_mutex;
+	struct obs_module               *loading_module;
+	volatile long                   deferred_modules;
+
+	/* deferred modules can register types from any thread, so the type
+	 * arrays are only accessed with types_rwlock held.  each type is
+	 * allocated separately so pointers to it stay valid when an array
+	 * grows */
+	pthread_rwlock_t                types_rwlock;
+	DARRAY(struct obs_source_info*)  input_types;
+	DARRAY(struct obs_source_info*)  filter_types;
+	DARRAY(struct obs_source_info*)  transition_types;
+	DARRAY(struct obs_output_info*)  output_types;
+	DARRAY(struct obs_encoder_info*) encoder_types;
+	DARRAY(struct obs_service_info*) service_types;
+	DARRAY(struct obs_modal_ui*)     modal_ui_callbacks;
+	DARRAY(struct obs_modeless_ui*)  modeless_ui_callbacks;
 
 	signal_handler_t                *signals;
 	proc_handler_t                  *procs;
@@ -358,8 +419,24 @@ struct obs_context_data {
 	pthread_mutex_t                 *mutex;
 	struct obs_context_data         *next;
 	struct obs_context_data         **prev_next;
+
+	struct obs_context_index        *index;
+	struct obs_context_data         *hash_next;
+	uint32_t                        name_hash;
+	uint64_t                        index_order;
 };
 
+extern bool obs_context_index_init(struct obs_context_index *index,
+		bool newest_first);
+extern void obs_context_index_free(struct obs_context_index *index);
+extern void obs_context_index_add(struct obs_context_index *index,
+		struct obs_context_data *context);
+extern void obs_context_index_remove(struct obs_context_data *context);
+
+/* the read lock of the index must be held */
+extern struct obs_context_data *obs_context_index_find(
+		struct obs_context_index *index, const char *name);
+
 extern bool obs_context_data_init(
 		struct obs_context_data *context,
 		obs_data_t              *settings,
@@ -368,7 +445,8 @@ extern bool obs_context_data_init(
 extern void obs_context_data_free(struct obs_context_data *context);
 
 extern void obs_context_data_insert(struct obs_context_data *context,
-		pthread_mutex_t *mutex, void *first);
+		pthread_mutex_t *mutex, void *first,
+		struct obs_context_index *index);
 extern void obs_context_data_remove(struct obs_context_data *context);
 
 extern void obs_context_data_setname(struct obs_context_data *context,
@@ -426,6 +504,13 @@ struct async_frame {
 	bool used;
 };
 
+struct obs_audio_tap {
+	obs_source_audio_tap_t callback;
+	void                   *param;
+	uint32_t               decimation;
+	uint32_t               count;
+};
+
 struct obs_weak_source {
 	struct obs_weak_ref ref;
 	struct obs_source *source;
@@ -476,10 +561,16 @@ struct obs_source {
 	bool                            muted;
 	struct resample_info            sample_info;
 	audio_resampler_t               *resampler;
+	bool                            resample_mono;
 	audio_line_t                    *audio_line;
 	pthread_mutex_t                 audio_mutex;
 	struct obs_audio_data           audio_data;
 	size_t                          audio_storage_size;
+	/* bytes of processed audio, and bytes written to produce them */
+	uint64_t                        audio_bytes;
+	uint64_t                        audio_copied_bytes;
+	signal_info_t                   *audio_data_signal;
+	DARRAY(struct obs_audio_tap)    audio_taps;
 	float                           base_volume;
 	float                           user_volume;
 	float                           present_volume;
@@ -531,6 +622,15 @@ struct obs_source {
 	uint64_t                        push_to_mute_stop_time;
 	uint64_t                        push_to_talk_delay;
 	uint64_t                        push_to_talk_stop_time;
+
+	/* JSON of the source as of the last obs_save_sources_json call, valid
+	 * as long as save_gen, the change id of the settings of the source and
+	 * its filters (and for scenes the source names) are unchanged */
+	volatile long                   save_gen;
+	long                            save_json_gen;
+	long                            save_json_names_gen;
+	long                            save_json_settings_id;
+	char                            *save_json;
 };
 
 extern const struct obs_source_info *find_source(struct darray *list,
@@ -543,6 +643,14 @@ extern bool obs_source_init(struct obs_source *source,
 
 extern void obs_source_destroy(struct obs_source *source);
 
+/* invalidates the cached save data, filters are saved with their parent */
+static inline void obs_source_mark_dirty(struct obs_source *source)
+{
+	os_atomic_inc_long(&source->save_gen);
+	if (source->filter_parent)
+		os_atomic_inc_long(&source->filter_parent->save_gen);
+}
+
 enum view_type {
 	MAIN_VIEW,
 	AUX_VIEW
@@ -551,6 +659,8 @@ enum view_type {
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_video_render_culled(obs_source_t *source);
+extern bool obs_source_opaque(const obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 		obs_source_t *target);
 
@@ -657,6 +767,14 @@ struct obs_encoder {
 
 	int64_t                         cur_pts;
 
+	/* video encode timing, only touched by the video thread.
+	 * encode_time_ns is a moving average of the time spent in the encode
+	 * callback, encode_lag_ns how far encoding has fallen behind the
+	 * frame interval */
+	uint64_t                        encode_time_ns;
+	uint64_t                        encode_lag_ns;
+	bool                            overloaded;
+
 	struct circlebuf                audio_input_buffer[MAX_AV_PLANES];
 	uint8_t                         *audio_output_buffer[MAX_AV_PLANES];
 
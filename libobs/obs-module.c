@@ -24,6 +24,17 @@
 
 extern const char *get_module_extension(void);
 
+#define MODULE_OPEN_THREADS 4
+
+static const char *manifest_type_names[OBS_MODULE_TYPE_COUNT] = {
+	"inputs",
+	"filters",
+	"transitions",
+	"outputs",
+	"encoders",
+	"services"
+};
+
 static inline int req_func_not_found(const char *name, const char *path)
 {
 	blog(LOG_ERROR, "Required module function '%s' in module '%s' not "
@@ -56,49 +67,107 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	return MODULE_SUCCESS;
 }
 
-int obs_open_module(obs_module_t **module, const char *path,
+static void set_module_paths(struct obs_module *mod, const char *path,
 		const char *data_path)
 {
-	struct obs_module mod = {0};
-	int errorcode;
+	mod->bin_path  = bstrdup(path);
+	mod->file      = strrchr(mod->bin_path, '/');
+	mod->file      = (!mod->file) ? mod->bin_path : (mod->file + 1);
+	mod->data_path = bstrdup(data_path);
+}
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
+static inline void free_module_types(struct obs_module *mod)
+{
+	for (size_t kind = 0; kind < OBS_MODULE_TYPE_COUNT; kind++) {
+		for (size_t i = 0; i < mod->types[kind].num; i++)
+			bfree(mod->types[kind].array[i]);
+		da_free(mod->types[kind]);
+	}
+}
+
+/* opens the module image and loads its locale, safe to call in parallel */
+static int open_module_image(struct obs_module *mod)
+{
+	uint64_t start = os_gettime_ns();
+	int errorcode;
 
-	mod.module = os_dlopen(path);
-	if (!mod.module) {
-		blog(LOG_WARNING, "Module '%s' not found", path);
+	mod->module = os_dlopen(mod->bin_path);
+	if (!mod->module) {
+		blog(LOG_WARNING, "Module '%s' not found", mod->bin_path);
 		return MODULE_FILE_NOT_FOUND;
 	}
 
-	errorcode = load_module_exports(&mod, path);
+	errorcode = load_module_exports(mod, mod->bin_path);
 	if (errorcode != MODULE_SUCCESS)
 		return errorcode;
 
-	mod.bin_path  = bstrdup(path);
-	mod.file      = strrchr(mod.bin_path, '/');
-	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
-	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
+	mod->set_pointer(mod);
+
+	if (mod->set_locale)
+		mod->set_locale(obs->locale);
+
+	mod->open_time = os_gettime_ns() - start;
+	return MODULE_SUCCESS;
+}
 
-	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
-	mod.set_pointer(*module);
+static inline void link_module(struct obs_module *mod)
+{
+	pthread_mutex_lock(&obs->module_mutex);
+	mod->next = obs->first_module;
+	obs->first_module = mod;
+	pthread_mutex_unlock(&obs->module_mutex);
+}
 
-	if (mod.set_locale)
-		mod.set_locale(obs->locale);
+int obs_open_module(obs_module_t **module, const char *path,
+		const char *data_path)
+{
+	struct obs_module *mod;
+	int errorcode;
 
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	mod = bzalloc(sizeof(struct obs_module));
+	set_module_paths(mod, path, data_path);
+
+	errorcode = open_module_image(mod);
+	if (errorcode != MODULE_SUCCESS) {
+		bfree(mod->bin_path);
+		bfree(mod->data_path);
+		bfree(mod);
+		return errorcode;
+	}
+
+	link_module(mod);
+	*module = mod;
 	return MODULE_SUCCESS;
 }
 
 bool obs_init_module(obs_module_t *module)
 {
-	if (!module || !obs)
+	struct obs_module *prev_loading;
+	uint64_t start;
+
+	if (!module || !obs || !module->module)
 		return false;
 	if (module->loaded)
 		return true;
 
+	pthread_mutex_lock(&obs->module_mutex);
+
+	/* the registration functions record the types in the module */
+	free_module_types(module);
+	module->eager = false;
+	prev_loading = obs->loading_module;
+	obs->loading_module = module;
+
+	start = os_gettime_ns();
 	module->loaded = module->load();
+	module->load_time = os_gettime_ns() - start;
+
+	obs->loading_module = prev_loading;
+	pthread_mutex_unlock(&obs->module_mutex);
+
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'",
 				module->file);
@@ -164,25 +233,380 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
+void obs_set_module_manifest_path(const char *path)
+{
+	if (!obs) return;
+
+	bfree(obs->module_manifest_path);
+	obs->module_manifest_path = path ? bstrdup(path) : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* module manifest */
+
+static obs_data_t *load_manifest(void)
+{
+	obs_data_t *manifest;
+	char *json;
+
+	if (!obs->module_manifest_path)
+		return NULL;
+
+	json = os_quick_read_utf8_file(obs->module_manifest_path);
+	if (!json)
+		return NULL;
+
+	manifest = obs_data_create_from_json(json);
+	bfree(json);
+
+	if (manifest && obs_data_get_int(manifest, "version") !=
+			(long long)LIBOBS_API_VER) {
+		obs_data_release(manifest);
+		manifest = NULL;
+	}
+
+	return manifest;
+}
+
+static obs_data_t *find_manifest_entry(obs_data_array_t *modules,
+		const char *bin_path)
+{
+	size_t count = obs_data_array_count(modules);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *entry = obs_data_array_item(modules, i);
+
+		if (strcmp(obs_data_get_string(entry, "file"), bin_path) == 0)
+			return entry;
+
+		obs_data_release(entry);
+	}
+
+	return NULL;
+}
+
+/* the entry is valid if the module binary has not changed since */
+static bool read_manifest_entry(struct obs_module *mod, obs_data_t *entry)
+{
+	bool has_types = false;
+
+	if (!entry || obs_data_get_bool(entry, "eager"))
+		return false;
+	if (strcmp(obs_data_get_string(entry, "data"), mod->data_path) != 0)
+		return false;
+	if (obs_data_get_int(entry, "mtime") !=
+			(long long)os_get_file_mtime(mod->bin_path))
+		return false;
+
+	for (size_t kind = 0; kind < OBS_MODULE_TYPE_COUNT; kind++) {
+		obs_data_array_t *ids = obs_data_get_array(entry,
+				manifest_type_names[kind]);
+		size_t count = obs_data_array_count(ids);
+
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *item = obs_data_array_item(ids, i);
+			char *id = bstrdup(obs_data_get_string(item, "id"));
+
+			da_push_back(mod->types[kind], &id);
+			obs_data_release(item);
+			has_types = true;
+		}
+
+		obs_data_array_release(ids);
+	}
+
+	return has_types;
+}
+
+static obs_data_t *create_manifest_entry(const struct obs_module *mod)
+{
+	obs_data_t *entry = obs_data_create();
+	bool has_types = false;
+
+	obs_data_set_string(entry, "file", mod->bin_path);
+	obs_data_set_string(entry, "data", mod->data_path);
+	obs_data_set_int(entry, "mtime",
+			(long long)os_get_file_mtime(mod->bin_path));
+
+	for (size_t kind = 0; kind < OBS_MODULE_TYPE_COUNT; kind++) {
+		obs_data_array_t *ids;
+
+		if (!mod->types[kind].num)
+			continue;
+
+		ids = obs_data_array_create();
+
+		for (size_t i = 0; i < mod->types[kind].num; i++) {
+			obs_data_t *item = obs_data_create();
+			obs_data_set_string(item, "id",
+					mod->types[kind].array[i]);
+			obs_data_array_push_back(ids, item);
+			obs_data_release(item);
+		}
+
+		obs_data_set_array(entry, manifest_type_names[kind], ids);
+		obs_data_array_release(ids);
+		has_types = true;
+	}
+
+	/* modules without types can only be found by loading them */
+	obs_data_set_bool(entry, "eager", mod->eager || !has_types ||
+			(!mod->loaded && !mod->deferred));
+	return entry;
+}
+
+static void save_manifest(void)
+{
+	obs_data_t       *manifest;
+	obs_data_array_t *modules;
+	const char       *json;
+
+	if (!obs->module_manifest_path)
+		return;
+
+	manifest = obs_data_create();
+	modules  = obs_data_array_create();
+
+	for (struct obs_module *mod = obs->first_module; mod; mod = mod->next) {
+		obs_data_t *entry = create_manifest_entry(mod);
+		obs_data_array_push_back(modules, entry);
+		obs_data_release(entry);
+	}
+
+	obs_data_set_int(manifest, "version", (long long)LIBOBS_API_VER);
+	obs_data_set_array(manifest, "modules", modules);
+
+	json = obs_data_get_json(manifest);
+	if (!json || !os_quick_write_utf8_file_safe(
+				obs->module_manifest_path, json, strlen(json),
+				false, "tmp"))
+		blog(LOG_WARNING, "Failed to save module manifest '%s'",
+				obs->module_manifest_path);
+
+	obs_data_array_release(modules);
+	obs_data_release(manifest);
+}
+
+/* ------------------------------------------------------------------------- */
+/* module loading */
+
+struct module_load_list {
+	obs_data_array_t              *manifest;
+	DARRAY(struct obs_module*)    open;
+	DARRAY(int)                   results;
+	volatile long                 next;
+};
+
+static bool module_opened(const char *bin_path)
+{
+	for (struct obs_module *mod = obs->first_module; mod; mod = mod->next) {
+		if (strcmp(mod->bin_path, bin_path) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 static void load_all_callback(void *param, const struct obs_module_info *info)
 {
-	obs_module_t *module;
+	struct module_load_list *list = param;
+	struct obs_module *mod;
+	obs_data_t *entry = NULL;
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
-	if (code != MODULE_SUCCESS) {
-		blog(LOG_DEBUG, "Failed to load module file '%s': %d",
-				info->bin_path, code);
+	if (module_opened(info->bin_path))
 		return;
+
+	mod = bzalloc(sizeof(struct obs_module));
+	set_module_paths(mod, info->bin_path, info->data_path);
+
+	if (list->manifest)
+		entry = find_manifest_entry(list->manifest, info->bin_path);
+
+	if (read_manifest_entry(mod, entry)) {
+		mod->deferred = true;
+		os_atomic_inc_long(&obs->deferred_modules);
+		link_module(mod);
+	} else {
+		free_module_types(mod);
+		da_push_back(list->open, &mod);
 	}
 
-	obs_init_module(module);
+	obs_data_release(entry);
+}
+
+static void *open_modules_thread(void *param)
+{
+	struct module_load_list *list = param;
+	long idx;
+
+	while ((idx = os_atomic_inc_long(&list->next) - 1) <
+			(long)list->open.num)
+		list->results.array[idx] =
+			open_module_image(list->open.array[idx]);
 
-	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+/*
+ * dlopen and locale parsing are independent for each module, so they are
+ * spread over a few threads.  obs_module_load runs on the calling thread,
+ * in discovery order, since modules may expect to be loaded there.
+ */
+static void open_modules(struct module_load_list *list)
+{
+	pthread_t threads[MODULE_OPEN_THREADS];
+	size_t    num_threads = 0;
+
+	da_resize(list->results, list->open.num);
+
+	for (size_t i = 0; i < MODULE_OPEN_THREADS; i++) {
+		if (i >= list->open.num)
+			break;
+		if (pthread_create(&threads[num_threads], NULL,
+					open_modules_thread, list) == 0)
+			num_threads++;
+	}
+
+	/* still works without threads, just slower */
+	open_modules_thread(list);
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+static void log_module_times(uint64_t total)
+{
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Module load times:");
+
+	for (struct obs_module *mod = obs->first_module; mod; mod = mod->next) {
+		if (mod->deferred)
+			blog(LOG_INFO, "    %s: deferred", mod->file);
+		else
+			blog(LOG_INFO, "    %s: open %.2f ms, load %.2f ms",
+					mod->file, ns_to_ms(mod->open_time),
+					ns_to_ms(mod->load_time));
+	}
+
+	blog(LOG_INFO, "Total: %.2f ms (%ld deferred)", ns_to_ms(total),
+			os_atomic_load_long(&obs->deferred_modules));
+	blog(LOG_INFO, "---------------------------------");
 }
 
 void obs_load_all_modules(void)
 {
-	obs_find_modules(load_all_callback, NULL);
+	struct module_load_list list = {0};
+	obs_data_t *manifest;
+	uint64_t start = os_gettime_ns();
+
+	if (!obs)
+		return;
+
+	manifest = load_manifest();
+	if (manifest)
+		list.manifest = obs_data_get_array(manifest, "modules");
+
+	obs_find_modules(load_all_callback, &list);
+	open_modules(&list);
+
+	for (size_t i = 0; i < list.open.num; i++) {
+		struct obs_module *mod = list.open.array[i];
+		int code = list.results.array[i];
+
+		if (code != MODULE_SUCCESS) {
+			blog(LOG_DEBUG, "Failed to load module file '%s': %d",
+					mod->bin_path, code);
+			bfree(mod->bin_path);
+			bfree(mod->data_path);
+			bfree(mod);
+			continue;
+		}
+
+		link_module(mod);
+		obs_init_module(mod);
+	}
+
+	log_module_times(os_gettime_ns() - start);
+	save_manifest();
+
+	da_free(list.open);
+	da_free(list.results);
+	obs_data_array_release(list.manifest);
+	obs_data_release(manifest);
+}
+
+static bool load_deferred(struct obs_module *mod)
+{
+	int code;
+
+	mod->deferred = false;
+	os_atomic_dec_long(&obs->deferred_modules);
+
+	code = open_module_image(mod);
+	if (code != MODULE_SUCCESS) {
+		blog(LOG_WARNING, "Failed to open deferred module '%s': %d",
+				mod->file, code);
+		return false;
+	}
+
+	if (!obs_init_module(mod))
+		return false;
+
+	blog(LOG_INFO, "Loaded deferred module '%s' (open %.2f ms, "
+	               "load %.2f ms)", mod->file,
+	               ns_to_ms(mod->open_time), ns_to_ms(mod->load_time));
+	return true;
+}
+
+static bool module_has_type(const struct obs_module *mod,
+		enum obs_module_types kind, const char *id)
+{
+	for (size_t i = 0; i < mod->types[kind].num; i++) {
+		if (strcmp(mod->types[kind].array[i], id) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool obs_load_deferred_module(enum obs_module_types kind, const char *id)
+{
+	bool success = false;
+
+	if (!obs || !id || !os_atomic_load_long(&obs->deferred_modules))
+		return false;
+
+	pthread_mutex_lock(&obs->module_mutex);
+
+	for (struct obs_module *mod = obs->first_module; mod; mod = mod->next) {
+		if (mod->deferred && module_has_type(mod, kind, id)) {
+			success = load_deferred(mod);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&obs->module_mutex);
+	return success;
+}
+
+void obs_load_deferred_modules(void)
+{
+	if (!obs || !os_atomic_load_long(&obs->deferred_modules))
+		return;
+
+	pthread_mutex_lock(&obs->module_mutex);
+
+	for (struct obs_module *mod = obs->first_module; mod; mod = mod->next) {
+		if (mod->deferred)
+			load_deferred(mod);
+	}
+
+	pthread_mutex_unlock(&obs->module_mutex);
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
@@ -339,11 +763,15 @@ void obs_enum_modules(obs_enum_module_callback_t callback, void *param)
 	if (!obs)
 		return;
 
+	pthread_mutex_lock(&obs->module_mutex);
+
 	module = obs->first_module;
 	while (module) {
 		callback(param, module);
 		module = module->next;
 	}
+
+	pthread_mutex_unlock(&obs->module_mutex);
 }
 
 void free_module(struct obs_module *mod)
@@ -363,6 +791,7 @@ void free_module(struct obs_module *mod)
 		/* os_dlclose(mod->module); */
 	}
 
+	free_module_types(mod);
 	bfree(mod->bin_path);
 	bfree(mod->data_path);
 	bfree(mod);
@@ -416,17 +845,39 @@ cleanup:
 
 #define REGISTER_OBS_DEF(size_var, structure, dest, info)                 \
 	do {                                                              \
-		struct structure data = {0};                              \
+		struct structure *data;                                   \
 		if (!size_var) {                                          \
 			blog(LOG_ERROR, "Tried to register " #structure   \
 			               " outside of obs_module_load");    \
 			return;                                           \
 		}                                                         \
                                                                           \
-		memcpy(&data, info, size_var);                            \
+		data = bzalloc(sizeof(struct structure));                 \
+		memcpy(data, info, size_var);                             \
+                                                                          \
+		pthread_rwlock_wrlock(&obs->types_rwlock);                \
 		da_push_back(dest, &data);                                \
+		pthread_rwlock_unlock(&obs->types_rwlock);                \
 	} while (false)
 
+static inline void record_type(enum obs_module_types kind, const char *id)
+{
+	struct obs_module *mod = obs->loading_module;
+	char *dup;
+
+	if (!mod)
+		return;
+
+	dup = bstrdup(id);
+	da_push_back(mod->types[kind], &dup);
+}
+
+static inline void record_ui(void)
+{
+	if (obs->loading_module)
+		obs->loading_module->eager = true;
+}
+
 #define CHECK_REQUIRED_VAL(info, val, func) \
 	do { \
 		if (!info->val) {\
@@ -439,15 +890,19 @@ cleanup:
 
 void obs_register_source_s(const struct obs_source_info *info, size_t size)
 {
-	struct obs_source_info data = {0};
+	struct obs_source_info *data;
 	struct darray *array;
+	enum obs_module_types kind;
 
 	if (info->type == OBS_SOURCE_TYPE_INPUT) {
 		array = &obs->input_types.da;
+		kind  = OBS_MODULE_INPUTS;
 	} else if (info->type == OBS_SOURCE_TYPE_FILTER) {
 		array = &obs->filter_types.da;
+		kind  = OBS_MODULE_FILTERS;
 	} else if (info->type == OBS_SOURCE_TYPE_TRANSITION) {
 		array = &obs->transition_types.da;
+		kind  = OBS_MODULE_TRANSITIONS;
 	} else {
 		blog(LOG_ERROR, "Tried to register unknown source type: %u",
 				info->type);
@@ -471,15 +926,20 @@ void obs_register_source_s(const struct obs_source_info *info, size_t size)
 		CHECK_REQUIRED_VAL(info, get_height, obs_register_source);
 	}
 
-	memcpy(&data, info, size);
+	data = bzalloc(sizeof(struct obs_source_info));
+	memcpy(data, info, size);
 
 	/* mark audio-only filters as an async filter categorically */
-	if (data.type == OBS_SOURCE_TYPE_FILTER) {
-		if ((data.output_flags & OBS_SOURCE_VIDEO) == 0)
-			data.output_flags |= OBS_SOURCE_ASYNC;
+	if (data->type == OBS_SOURCE_TYPE_FILTER) {
+		if ((data->output_flags & OBS_SOURCE_VIDEO) == 0)
+			data->output_flags |= OBS_SOURCE_ASYNC;
 	}
 
-	darray_push_back(sizeof(struct obs_source_info), array, &data);
+	pthread_rwlock_wrlock(&obs->types_rwlock);
+	darray_push_back(sizeof(struct obs_source_info*), array, &data);
+	pthread_rwlock_unlock(&obs->types_rwlock);
+
+	record_type(kind, info->id);
 }
 
 void obs_register_output_s(const struct obs_output_info *info, size_t size)
@@ -509,6 +969,7 @@ void obs_register_output_s(const struct obs_output_info *info, size_t size)
 	}
 
 	REGISTER_OBS_DEF(size, obs_output_info, obs->output_types, info);
+	record_type(OBS_MODULE_OUTPUTS, info->id);
 }
 
 void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
@@ -528,6 +989,7 @@ void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 		CHECK_REQUIRED_VAL(info, get_frame_size, obs_register_encoder);
 
 	REGISTER_OBS_DEF(size, obs_encoder_info, obs->encoder_types, info);
+	record_type(OBS_MODULE_ENCODERS, info->id);
 }
 
 void obs_register_service_s(const struct obs_service_info *info, size_t size)
@@ -543,6 +1005,7 @@ void obs_register_service_s(const struct obs_service_info *info, size_t size)
 	CHECK_REQUIRED_VAL(info, destroy,  obs_register_service);
 
 	REGISTER_OBS_DEF(size, obs_service_info, obs->service_types, info);
+	record_type(OBS_MODULE_SERVICES, info->id);
 }
 
 void obs_regsiter_modal_ui_s(const struct obs_modal_ui *info, size_t size)
@@ -552,6 +1015,7 @@ void obs_regsiter_modal_ui_s(const struct obs_modal_ui *info, size_t size)
 	CHECK_REQUIRED_VAL(info, exec,   obs_regsiter_modal_ui);
 
 	REGISTER_OBS_DEF(size, obs_modal_ui, obs->modal_ui_callbacks, info);
+	record_ui();
 }
 
 void obs_regsiter_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
@@ -562,4 +1026,5 @@ void obs_regsiter_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
 
 	REGISTER_OBS_DEF(size, obs_modeless_ui, obs->modeless_ui_callbacks,
 			info);
+	record_ui();
 }
@@ -22,14 +22,30 @@
 
 static inline void signal_stop(struct obs_output *output, int code);
 
+static const struct obs_output_info *find_loaded_output(const char *id)
+{
+	const struct obs_output_info *found = NULL;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	for (size_t i = 0; i < obs->output_types.num; i++) {
+		if (strcmp(obs->output_types.array[i]->id, id) == 0) {
+			found = obs->output_types.array[i];
+			break;
+		}
+	}
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
+}
+
 const struct obs_output_info *find_output(const char *id)
 {
-	size_t i;
-	for (i = 0; i < obs->output_types.num; i++)
-		if (strcmp(obs->output_types.array[i].id, id) == 0)
-			return obs->output_types.array+i;
+	const struct obs_output_info *info = find_loaded_output(id);
 
-	return NULL;
+	if (!info && obs_load_deferred_module(OBS_MODULE_OUTPUTS, id))
+		info = find_loaded_output(id);
+	return info;
 }
 
 const char *obs_output_get_display_name(const char *id)
@@ -101,7 +117,8 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 
 	obs_context_data_insert(&output->context,
 			&obs->data.outputs_mutex,
-			&obs->data.first_output);
+			&obs->data.first_output,
+			&obs->data.outputs_index);
 
 	blog(LOG_INFO, "output '%s' (%s) created", name, id);
 	return output;
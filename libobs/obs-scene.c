@@ -54,6 +54,9 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 	struct obs_scene *scene = bmalloc(sizeof(struct obs_scene));
 	scene->source     = source;
 	scene->first_item = NULL;
+	scene->cull_flags = OBS_SCENE_CULL_DEFAULT;
+	memset(&scene->cull_stats, 0, sizeof(scene->cull_stats));
+	da_init(scene->occluders);
 
 	signal_handler_add_array(obs_source_get_signal_handler(source),
 			obs_scene_signals);
@@ -100,6 +103,7 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 	pthread_mutex_destroy(&scene->mutex);
+	da_free(scene->occluders);
 	bfree(scene);
 }
 
@@ -222,6 +226,26 @@ static void calculate_bounds_data(struct obs_scene_item *item,
 			(int)-width_diff, (int)-height_diff);
 }
 
+static inline bool close_to_zero(float val)
+{
+	return fabsf(val) < EPSILON;
+}
+
+static void update_screen_bounds(struct obs_scene_item *item,
+		uint32_t width, uint32_t height)
+{
+	const struct matrix4 *m = &item->draw_transform;
+	struct bounds b;
+
+	vec3_zero(&b.min);
+	vec3_set(&b.max, (float)width, (float)height, 0.0f);
+	bounds_transform(&item->screen_bounds, &b, m);
+
+	item->axis_aligned =
+		(close_to_zero(m->x.y) && close_to_zero(m->y.x)) ||
+		(close_to_zero(m->x.x) && close_to_zero(m->y.y));
+}
+
 static void update_item_transform(struct obs_scene_item *item)
 {
 	uint32_t        width         = obs_source_get_width(item->source);
@@ -280,6 +304,8 @@ static void update_item_transform(struct obs_scene_item *item)
 
 	/* ----------------------- */
 
+	update_screen_bounds(item, width, height);
+
 	item->last_width  = width;
 	item->last_height = height;
 
@@ -298,17 +324,113 @@ static inline bool source_size_changed(struct obs_scene_item *item)
 	return item->last_width != width || item->last_height != height;
 }
 
+static inline void clip_bounds(struct bounds *dst, const struct bounds *b,
+		const struct bounds *clip)
+{
+	vec3_max(&dst->min, &b->min, &clip->min);
+	vec3_min(&dst->max, &b->max, &clip->max);
+}
+
+static bool item_occluded(struct obs_scene *scene,
+		const struct bounds *item_bounds)
+{
+	for (size_t i = 0; i < scene->occluders.num; i++) {
+		if (bounds_inside(scene->occluders.array + i, item_bounds))
+			return true;
+	}
+
+	return false;
+}
+
+static void add_occluder(struct obs_scene *scene,
+		const struct obs_scene_item *item)
+{
+	struct bounds *occluder;
+
+	if (!item->axis_aligned || !obs_source_opaque(item->source))
+		return;
+
+	/* only count pixels that are fully covered */
+	occluder = da_push_back_new(scene->occluders);
+	vec3_set(&occluder->min,
+			ceilf(item->screen_bounds.min.x),
+			ceilf(item->screen_bounds.min.y), 0.0f);
+	vec3_set(&occluder->max,
+			floorf(item->screen_bounds.max.x),
+			floorf(item->screen_bounds.max.y), 0.0f);
+}
+
+/* walks the items from top to bottom and marks every item that would not
+ * contribute any pixels to the scene */
+static void cull_items(struct obs_scene *scene,
+		struct obs_scene_item *last_item)
+{
+	uint32_t              flags = scene->cull_flags;
+	bool                  offscreen, occluded;
+	struct obs_scene_item *item = last_item;
+	struct bounds         canvas;
+
+	offscreen = (flags & OBS_SCENE_CULL_OFFSCREEN) != 0;
+	occluded  = (flags & OBS_SCENE_CULL_OCCLUDED) != 0;
+
+	vec3_zero(&canvas.min);
+	vec3_set(&canvas.max, (float)obs->video.base_width,
+			(float)obs->video.base_height, 0.0f);
+
+	scene->occluders.num = 0;
+
+	while (item) {
+		struct bounds visible_bounds;
+
+		item->culled = false;
+
+		if (!item->visible) {
+			item = item->prev;
+			continue;
+		}
+
+		if (offscreen) {
+			if (!bounds_intersects(&canvas, &item->screen_bounds,
+						0.0f)) {
+				item->culled = true;
+				scene->cull_stats.culled_offscreen++;
+				item = item->prev;
+				continue;
+			}
+
+			clip_bounds(&visible_bounds, &item->screen_bounds,
+					&canvas);
+		} else {
+			visible_bounds = item->screen_bounds;
+		}
+
+		if (occluded) {
+			if (item_occluded(scene, &visible_bounds)) {
+				item->culled = true;
+				scene->cull_stats.culled_occluded++;
+				item = item->prev;
+				continue;
+			}
+
+			add_occluder(scene, item);
+		}
+
+		item = item->prev;
+	}
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	struct obs_scene_item *last_item = NULL;
+	bool cull;
 
 	pthread_mutex_lock(&scene->mutex);
 
-	item = scene->first_item;
+	memset(&scene->cull_stats, 0, sizeof(scene->cull_stats));
 
-	gs_blend_state_push();
-	gs_reset_blend_state();
+	item = scene->first_item;
 
 	while (item) {
 		if (obs_source_removed(item->source)) {
@@ -322,11 +444,33 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->visible) {
+		last_item = item;
+		item = item->next;
+	}
+
+	cull = (scene->cull_flags &
+		(OBS_SCENE_CULL_OFFSCREEN | OBS_SCENE_CULL_OCCLUDED)) != 0;
+	if (cull)
+		cull_items(scene, last_item);
+
+	item = scene->first_item;
+
+	gs_blend_state_push();
+	gs_reset_blend_state();
+
+	while (item) {
+		if (item->visible && cull && item->culled) {
+			if ((scene->cull_flags &
+			     OBS_SCENE_CULL_ASYNC_UPLOAD) == 0)
+				obs_source_video_render_culled(item->source);
+
+		} else if (item->visible) {
 			gs_matrix_push();
 			gs_matrix_mul(&item->draw_transform);
 			obs_source_video_render(item->source);
 			gs_matrix_pop();
+
+			scene->cull_stats.rendered++;
 		}
 
 		item = item->next;
@@ -503,6 +647,41 @@ obs_scene_t *obs_scene_from_source(const obs_source_t *source)
 	return source->context.data;
 }
 
+void obs_scene_set_cull_flags(obs_scene_t *scene, uint32_t flags)
+{
+	if (!scene)
+		return;
+
+	pthread_mutex_lock(&scene->mutex);
+	scene->cull_flags = flags;
+	pthread_mutex_unlock(&scene->mutex);
+}
+
+uint32_t obs_scene_get_cull_flags(obs_scene_t *scene)
+{
+	uint32_t flags;
+
+	if (!scene)
+		return 0;
+
+	pthread_mutex_lock(&scene->mutex);
+	flags = scene->cull_flags;
+	pthread_mutex_unlock(&scene->mutex);
+
+	return flags;
+}
+
+void obs_scene_get_cull_stats(obs_scene_t *scene,
+		struct obs_scene_cull_stats *stats)
+{
+	if (!scene || !stats)
+		return;
+
+	pthread_mutex_lock(&scene->mutex);
+	*stats = scene->cull_stats;
+	pthread_mutex_unlock(&scene->mutex);
+}
+
 obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
 {
 	struct obs_scene_item *item;
@@ -678,6 +857,7 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 
 	pthread_mutex_unlock(&scene->mutex);
 
+	obs_source_mark_dirty(scene->source);
 	init_hotkeys(scene, item, obs_source_get_name(source));
 
 	calldata_set_ptr(&params, "scene", scene);
@@ -743,6 +923,8 @@ void obs_sceneitem_remove(obs_sceneitem_t *item)
 
 	pthread_mutex_unlock(&scene->mutex);
 
+	obs_source_mark_dirty(scene->source);
+
 	obs_sceneitem_release(item);
 }
 
@@ -779,11 +961,19 @@ bool obs_sceneitem_selected(const obs_sceneitem_t *item)
 	return item ? item->selected : false;
 }
 
+/* the transform is saved with the scene */
+static inline void transform_changed(struct obs_scene_item *item)
+{
+	update_item_transform(item);
+	if (item->parent)
+		obs_source_mark_dirty(item->parent->source);
+}
+
 void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
 {
 	if (item) {
 		vec2_copy(&item->pos, pos);
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -791,7 +981,7 @@ void obs_sceneitem_set_rot(obs_sceneitem_t *item, float rot)
 {
 	if (item) {
 		item->rot = rot;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -799,7 +989,7 @@ void obs_sceneitem_set_scale(obs_sceneitem_t *item, const struct vec2 *scale)
 {
 	if (item) {
 		vec2_copy(&item->scale, scale);
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -807,7 +997,7 @@ void obs_sceneitem_set_alignment(obs_sceneitem_t *item, uint32_t alignment)
 {
 	if (item) {
 		item->align = alignment;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -863,6 +1053,7 @@ void obs_sceneitem_set_order(obs_sceneitem_t *item,
 		attach_sceneitem(scene, item, NULL);
 	}
 
+	obs_source_mark_dirty(scene->source);
 	signal_reorder(item);
 
 	pthread_mutex_unlock(&scene->mutex);
@@ -895,6 +1086,7 @@ void obs_sceneitem_set_order_position(obs_sceneitem_t *item,
 		attach_sceneitem(scene, item, next);
 	}
 
+	obs_source_mark_dirty(scene->source);
 	signal_reorder(item);
 
 	pthread_mutex_unlock(&scene->mutex);
@@ -906,7 +1098,7 @@ void obs_sceneitem_set_bounds_type(obs_sceneitem_t *item,
 {
 	if (item) {
 		item->bounds_type = type;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -915,7 +1107,7 @@ void obs_sceneitem_set_bounds_alignment(obs_sceneitem_t *item,
 {
 	if (item) {
 		item->bounds_align = alignment;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -923,7 +1115,7 @@ void obs_sceneitem_set_bounds(obs_sceneitem_t *item, const struct vec2 *bounds)
 {
 	if (item) {
 		item->bounds = *bounds;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -990,7 +1182,7 @@ void obs_sceneitem_set_info(obs_sceneitem_t *item,
 		item->bounds_type  = info->bounds_type;
 		item->bounds_align = info->bounds_alignment;
 		item->bounds       = info->bounds;
-		update_item_transform(item);
+		transform_changed(item);
 	}
 }
 
@@ -1025,6 +1217,8 @@ void obs_sceneitem_set_visible(obs_sceneitem_t *item, bool visible)
 	if (!item->parent)
 		return;
 
+	obs_source_mark_dirty(item->parent->source);
+
 	calldata_set_ptr(&cd, "scene", item->parent);
 	calldata_set_ptr(&cd, "item", item);
 	calldata_set_bool(&cd, "visible", visible);
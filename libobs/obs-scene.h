@@ -20,6 +20,7 @@
 #include "obs.h"
 #include "obs-internal.h"
 #include "graphics/matrix4.h"
+#include "graphics/bounds.h"
 
 /* how obs scene! */
 
@@ -45,6 +46,13 @@ struct obs_scene_item {
 	struct matrix4        box_transform;
 	struct matrix4        draw_transform;
 
+	/* screen-space (scene canvas) bounding box of the drawn item, used for
+	 * culling.  axis_aligned is set if the item is not rotated at an
+	 * angle, in which case the box exactly matches the drawn area */
+	struct bounds         screen_bounds;
+	bool                  axis_aligned;
+	bool                  culled;
+
 	enum obs_bounds_type  bounds_type;
 	uint32_t              bounds_align;
 	struct vec2           bounds;
@@ -61,4 +69,9 @@ struct obs_scene {
 
 	pthread_mutex_t       mutex;
 	struct obs_scene_item *first_item;
+
+	/* culling state, only accessed with the mutex held */
+	uint32_t              cull_flags;
+	DARRAY(struct bounds) occluders;
+	struct obs_scene_cull_stats cull_stats;
 };
@@ -17,14 +17,30 @@
 
 #include "obs-internal.h"
 
+static const struct obs_service_info *find_loaded_service(const char *id)
+{
+	const struct obs_service_info *found = NULL;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	for (size_t i = 0; i < obs->service_types.num; i++) {
+		if (strcmp(obs->service_types.array[i]->id, id) == 0) {
+			found = obs->service_types.array[i];
+			break;
+		}
+	}
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
+}
+
 const struct obs_service_info *find_service(const char *id)
 {
-	size_t i;
-	for (i = 0; i < obs->service_types.num; i++)
-		if (strcmp(obs->service_types.array[i].id, id) == 0)
-			return obs->service_types.array+i;
+	const struct obs_service_info *info = find_loaded_service(id);
 
-	return NULL;
+	if (!info && obs_load_deferred_module(OBS_MODULE_SERVICES, id))
+		info = find_loaded_service(id);
+	return info;
 }
 
 const char *obs_service_get_display_name(const char *id)
@@ -66,7 +82,8 @@ obs_service_t *obs_service_create(const char *id, const char *name,
 
 	obs_context_data_insert(&service->context,
 			&obs->data.services_mutex,
-			&obs->data.first_service);
+			&obs->data.first_service,
+			&obs->data.services_index);
 
 	blog(LOG_INFO, "service '%s' (%s) created", name, id);
 	return service;
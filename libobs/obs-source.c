@@ -36,38 +36,52 @@ static inline bool source_valid(const struct obs_source *source)
 
 const struct obs_source_info *find_source(struct darray *list, const char *id)
 {
-	size_t i;
-	struct obs_source_info *array = list->array;
+	struct obs_source_info *found = NULL;
+	struct obs_source_info **array;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+	array = list->array;
 
-	for (i = 0; i < list->num; i++) {
-		struct obs_source_info *info = array+i;
-		if (strcmp(info->id, id) == 0)
-			return info;
+	for (size_t i = 0; i < list->num; i++) {
+		if (strcmp(array[i]->id, id) == 0) {
+			found = array[i];
+			break;
+		}
 	}
 
-	return NULL;
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 static const struct obs_source_info *get_source_info(enum obs_source_type type,
 		const char *id)
 {
+	const struct obs_source_info *info;
+	enum obs_module_types kind = OBS_MODULE_INPUTS;
 	struct darray *list = NULL;
 
 	switch (type) {
 	case OBS_SOURCE_TYPE_INPUT:
 		list = &obs->input_types.da;
+		kind = OBS_MODULE_INPUTS;
 		break;
 
 	case OBS_SOURCE_TYPE_FILTER:
 		list = &obs->filter_types.da;
+		kind = OBS_MODULE_FILTERS;
 		break;
 
 	case OBS_SOURCE_TYPE_TRANSITION:
 		list = &obs->transition_types.da;
+		kind = OBS_MODULE_TRANSITIONS;
 		break;
 	}
 
-	return find_source(list, id);
+	info = find_source(list, id);
+	if (!info && obs_load_deferred_module(kind, id))
+		info = find_source(list, id);
+
+	return info;
 }
 
 static const char *source_signals[] = {
@@ -104,8 +118,12 @@ bool obs_source_init_context(struct obs_source *source,
 				hotkey_data))
 		return false;
 
-	return signal_handler_add_array(source->context.signals,
-			source_signals);
+	if (!signal_handler_add_array(source->context.signals, source_signals))
+		return false;
+
+	source->audio_data_signal = signal_handler_get_signal(
+			source->context.signals, "audio_data");
+	return true;
 }
 
 const char *obs_source_get_display_name(enum obs_source_type type,
@@ -155,7 +173,7 @@ bool obs_source_init(struct obs_source *source,
 
 	obs_context_data_insert(&source->context,
 			&obs->data.sources_mutex,
-			&obs->data.first_source);
+			&obs->data.first_source, NULL);
 	return true;
 }
 
@@ -377,12 +395,19 @@ void obs_source_destroy(struct obs_source *source)
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
 
+	if (source->audio_bytes)
+		blog(LOG_DEBUG, "source '%s': %.2f audio copies per sample",
+				source->context.name,
+				(double)source->audio_copied_bytes /
+				(double)source->audio_bytes);
+
 	audio_line_destroy(source->audio_line);
 	audio_resampler_destroy(source->resampler);
 
 	da_free(source->async_cache);
 	da_free(source->async_frames);
 	da_free(source->filters);
+	da_free(source->audio_taps);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
@@ -391,6 +416,7 @@ void obs_source_destroy(struct obs_source *source)
 	if (source->owns_info_id)
 		bfree((void*)source->info.id);
 
+	bfree(source->save_json);
 	bfree(source);
 }
 
@@ -493,6 +519,7 @@ void obs_source_remove(obs_source_t *source)
 	exists = (id != DARRAY_INVALID);
 	if (exists) {
 		da_erase(data->user_sources, id);
+		obs_context_index_remove(&source->context);
 		obs_source_release(source);
 	}
 
@@ -585,6 +612,8 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
+	obs_source_mark_dirty(source);
+
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		source->defer_update = true;
 	} else if (source->context.data && source->info.update) {
@@ -868,16 +897,31 @@ static void source_signal_audio_data(obs_source_t *source,
 		struct audio_data *in, bool muted)
 {
 	struct calldata data;
+	uint8_t stack[128];
 
-	calldata_init(&data);
+	/* emitted for every audio packet, so avoid lookups and allocations */
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_ptr(&data, "data",   in);
 	calldata_set_bool(&data, "muted", muted);
 
-	signal_handler_signal(source->context.signals, "audio_data", &data);
+	signal_emit(source->audio_data_signal, &data);
+}
 
-	calldata_free(&data);
+/* called with the audio mutex locked */
+static inline void source_call_audio_taps(obs_source_t *source,
+		const struct audio_data *in, bool muted)
+{
+	for (size_t i = 0; i < source->audio_taps.num; i++) {
+		struct obs_audio_tap *tap = source->audio_taps.array+i;
+
+		if (++tap->count < tap->decimation)
+			continue;
+
+		tap->count = 0;
+		tap->callback(tap->param, source, in, muted);
+	}
 }
 
 static inline uint64_t uint64_diff(uint64_t ts1, uint64_t ts2)
@@ -941,6 +985,7 @@ static void source_output_audio_line(obs_source_t *source,
 		in.volume = 0.0f;
 
 	audio_line_output(source->audio_line, &in);
+	source_call_audio_taps(source, &in, muted);
 	source_signal_audio_data(source, &in, muted);
 }
 
@@ -1325,7 +1370,7 @@ static void obs_source_draw_async_texture(struct obs_source *source)
 static inline struct obs_source_frame *filter_async_video(obs_source_t *source,
 		struct obs_source_frame *in);
 
-static void obs_source_render_async_video(obs_source_t *source)
+static bool obs_source_update_async_video(obs_source_t *source)
 {
 	if (!source->async_rendered) {
 		struct obs_source_frame *frame = obs_source_get_frame(source);
@@ -1340,18 +1385,61 @@ static void obs_source_render_async_video(obs_source_t *source)
 			source->timing_set = true;
 
 			if (!set_async_texture_size(source, frame))
-				return;
+				return false;
 			if (!update_async_texture(source, frame))
-				return;
+				return false;
 		}
 
 		obs_source_release_frame(source, frame);
 	}
 
+	return true;
+}
+
+static void obs_source_render_async_video(obs_source_t *source)
+{
+	if (!obs_source_update_async_video(source))
+		return;
+
 	if (source->async_texture && source->async_active)
 		obs_source_draw_async_texture(source);
 }
 
+static inline bool is_async_video_source(const obs_source_t *source)
+{
+	return !source->info.video_render && !source->filter_target &&
+		(source->info.output_flags & OBS_SOURCE_ASYNC) != 0;
+}
+
+void obs_source_video_render_culled(obs_source_t *source)
+{
+	if (!source || !source->context.data || !source->enabled)
+		return;
+
+	/* keeps the async texture current so the source doesn't show a stale
+	 * frame the moment it becomes visible again */
+	if (is_async_video_source(source))
+		obs_source_update_async_video(source);
+}
+
+bool obs_source_opaque(const obs_source_t *source)
+{
+	enum video_format format;
+
+	if (!source || !source->context.data || !source->enabled)
+		return false;
+	if (source->filters.num)
+		return false;
+
+	if (is_async_video_source(source)) {
+		format = source->async_format;
+		return source->async_texture && source->async_active &&
+			(format_is_yuv(format) || format == VIDEO_FORMAT_BGRX);
+	}
+
+	return (source->info.output_flags & OBS_SOURCE_OPAQUE) != 0;
+}
+
 static inline void obs_source_render_filters(obs_source_t *source)
 {
 	source->rendering_filter = true;
@@ -1542,6 +1630,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
 
@@ -1574,6 +1664,8 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
 
@@ -1689,8 +1781,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_mark_dirty(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -1929,8 +2023,14 @@ static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 	return in;
 }
 
+static inline bool force_mono(const obs_source_t *source)
+{
+	return (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0 &&
+		audio_output_get_channels(obs->audio.audio) != 1;
+}
+
 static inline void reset_resampler(obs_source_t *source,
-		const struct obs_source_audio *audio)
+		const struct obs_source_audio *audio, bool mono)
 {
 	const struct audio_output_info *obs_info;
 	struct resample_info output_info;
@@ -1944,107 +2044,119 @@ static inline void reset_resampler(obs_source_t *source,
 	source->sample_info.format          = audio->format;
 	source->sample_info.samples_per_sec = audio->samples_per_sec;
 	source->sample_info.speakers        = audio->speakers;
+	source->resample_mono               = mono;
 
 	audio_resampler_destroy(source->resampler);
 	source->resampler = NULL;
 
-	if (source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
+	if (!mono &&
+	    source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
 	    source->sample_info.format          == obs_info->format          &&
 	    source->sample_info.speakers        == obs_info->speakers) {
 		source->audio_failed = false;
 		return;
 	}
 
-	source->resampler = audio_resampler_create(&output_info,
-			&source->sample_info);
+	/* the mono downmix is part of the remix matrix, so forced mono
+	 * costs nothing on top of the conversion */
+	source->resampler = mono ?
+		audio_resampler_create_mono(&output_info,
+				&source->sample_info) :
+		audio_resampler_create(&output_info, &source->sample_info);
 
 	source->audio_failed = source->resampler == NULL;
 	if (source->resampler == NULL)
 		blog(LOG_ERROR, "creation of resampler failed");
 }
 
+static void ensure_audio_storage(obs_source_t *source, size_t size)
+{
+	size_t planes = audio_output_get_planes(obs->audio.audio);
+
+	if (source->audio_storage_size >= size)
+		return;
+
+	for (size_t i = 0; i < planes; i++) {
+		bfree(source->audio_data.data[i]);
+		source->audio_data.data[i] = bmalloc(size);
+	}
+
+	source->audio_storage_size = size;
+}
+
 static void copy_audio_data(obs_source_t *source,
 		const uint8_t *const data[], uint32_t frames, uint64_t ts)
 {
 	size_t planes    = audio_output_get_planes(obs->audio.audio);
 	size_t blocksize = audio_output_get_block_size(obs->audio.audio);
 	size_t size      = (size_t)frames * blocksize;
-	bool   resize    = source->audio_storage_size < size;
+
+	ensure_audio_storage(source, size);
 
 	source->audio_data.frames    = frames;
 	source->audio_data.timestamp = ts;
 
-	for (size_t i = 0; i < planes; i++) {
-		/* ensure audio storage capacity */
-		if (resize) {
-			bfree(source->audio_data.data[i]);
-			source->audio_data.data[i] = bmalloc(size);
-		}
-
+	for (size_t i = 0; i < planes; i++)
 		memcpy(source->audio_data.data[i], data[i], size);
-	}
 
-	if (resize)
-		source->audio_storage_size = size;
+	source->audio_copied_bytes += size * planes;
 }
 
-/* TODO: SSE optimization */
-static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
+/* resamples straight into the source's audio storage */
+static bool resample_audio_data(obs_source_t *source,
+		const struct obs_source_audio *audio)
 {
-	size_t channels = audio_output_get_channels(obs->audio.audio);
-	const float channels_i = 1.0f / (float)channels;
-	float **data = (float**)source->audio_data.data;
+	size_t   planes    = audio_output_get_planes(obs->audio.audio);
+	size_t   blocksize = audio_output_get_block_size(obs->audio.audio);
+	uint32_t max_frames;
+	uint32_t frames;
+	uint64_t offset;
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[0][frame] += data[channel][frame];
-	}
+	max_frames = audio_resampler_get_max_frames(source->resampler,
+			audio->frames);
+	ensure_audio_storage(source, (size_t)max_frames * blocksize);
 
-	for (uint32_t frame = 0; frame < frames; frame++)
-		data[0][frame] *= channels_i;
+	if (!audio_resampler_resample_into(source->resampler,
+				source->audio_data.data, max_frames,
+				&frames, &offset,
+				audio->data, audio->frames))
+		return false;
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[channel][frame] = data[0][frame];
-	}
+	source->audio_data.frames    = frames;
+	source->audio_data.timestamp = audio->timestamp - offset;
+
+	/* the conversion (and mono downmix) is the only pass over the data */
+	source->audio_copied_bytes += (uint64_t)frames * blocksize * planes;
+	return true;
 }
 
 /* resamples/remixes new audio to the designated main audio output format */
-static void process_audio(obs_source_t *source,
+static bool process_audio(obs_source_t *source,
 		const struct obs_source_audio *audio)
 {
-	uint32_t frames = audio->frames;
-	bool mono_output;
+	bool mono = force_mono(source);
 
 	if (source->sample_info.samples_per_sec != audio->samples_per_sec ||
 	    source->sample_info.format          != audio->format          ||
-	    source->sample_info.speakers        != audio->speakers)
-		reset_resampler(source, audio);
+	    source->sample_info.speakers        != audio->speakers        ||
+	    source->resample_mono               != mono)
+		reset_resampler(source, audio, mono);
 
 	if (source->audio_failed)
-		return;
+		return false;
 
 	if (source->resampler) {
-		uint8_t  *output[MAX_AV_PLANES];
-		uint64_t offset;
-
-		memset(output, 0, sizeof(output));
-
-		audio_resampler_resample(source->resampler,
-				output, &frames, &offset,
-				audio->data, audio->frames);
-
-		copy_audio_data(source, (const uint8_t *const *)output, frames,
-				audio->timestamp - offset);
+		if (!resample_audio_data(source, audio))
+			return false;
 	} else {
 		copy_audio_data(source, audio->data, audio->frames,
 				audio->timestamp);
 	}
 
-	mono_output = audio_output_get_channels(obs->audio.audio) == 1;
-
-	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
-		downmix_to_mono_planar(source, frames);
+	source->audio_bytes += (uint64_t)source->audio_data.frames *
+		audio_output_get_block_size(obs->audio.audio) *
+		audio_output_get_planes(obs->audio.audio);
+	return true;
 }
 
 void obs_source_output_audio(obs_source_t *source,
@@ -2055,7 +2167,8 @@ void obs_source_output_audio(obs_source_t *source,
 	if (!source || !audio)
 		return;
 
-	process_audio(source, audio);
+	if (!process_audio(source, audio))
+		return;
 
 	pthread_mutex_lock(&source->filter_mutex);
 	output = filter_async_audio(source, &source->audio_data);
@@ -2268,6 +2381,9 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
 
+		obs_source_mark_dirty(source);
+		os_atomic_inc_long(&obs->data.source_names_gen);
+
 		calldata_init(&data);
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_string(&data, "new_name", source->context.name);
@@ -2467,6 +2583,7 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		calldata_free(&data);
 
 		source->user_volume = volume;
+		obs_source_mark_dirty(source);
 	}
 }
 
@@ -2485,6 +2602,53 @@ void obs_source_set_present_volume(obs_source_t *source, float volume)
 		source->present_volume = volume;
 }
 
+static inline size_t find_audio_tap(obs_source_t *source,
+		obs_source_audio_tap_t callback, void *param)
+{
+	for (size_t i = 0; i < source->audio_taps.num; i++) {
+		struct obs_audio_tap *tap = source->audio_taps.array+i;
+
+		if (tap->callback == callback && tap->param == param)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+void obs_source_add_audio_tap(obs_source_t *source,
+		obs_source_audio_tap_t callback, void *param,
+		uint32_t decimation)
+{
+	struct obs_audio_tap tap = {callback, param, decimation, 0};
+
+	if (!source || !callback)
+		return;
+
+	pthread_mutex_lock(&source->audio_mutex);
+
+	if (find_audio_tap(source, callback, param) == DARRAY_INVALID)
+		da_push_back(source->audio_taps, &tap);
+
+	pthread_mutex_unlock(&source->audio_mutex);
+}
+
+void obs_source_remove_audio_tap(obs_source_t *source,
+		obs_source_audio_tap_t callback, void *param)
+{
+	size_t idx;
+
+	if (!source)
+		return;
+
+	pthread_mutex_lock(&source->audio_mutex);
+
+	idx = find_audio_tap(source, callback, param);
+	if (idx != DARRAY_INVALID)
+		da_erase(source->audio_taps, idx);
+
+	pthread_mutex_unlock(&source->audio_mutex);
+}
+
 float obs_source_get_volume(const obs_source_t *source)
 {
 	return source ? source->user_volume : 0.0f;
@@ -2508,6 +2672,8 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 
 		source->sync_offset = calldata_int(&data, "offset");
 		calldata_free(&data);
+
+		obs_source_mark_dirty(source);
 	}
 }
 
@@ -2650,6 +2816,7 @@ void obs_source_set_flags(obs_source_t *source, uint32_t flags)
 
 	if (flags != source->flags) {
 		source->flags = flags;
+		obs_source_mark_dirty(source);
 		signal_flags_updated(source);
 	}
 }
@@ -2687,6 +2854,7 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 	calldata_free(&data);
 
 	audio_line_set_mixers(source->audio_line, mixers);
+	obs_source_mark_dirty(source);
 }
 
 uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
@@ -2896,6 +3064,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_source_mark_dirty(source);
 
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_bool(&data, "enabled", enabled);
@@ -2918,6 +3087,7 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 		return;
 
 	source->muted = muted;
+	obs_source_mark_dirty(source);
 
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_bool(&data, "muted", muted);
@@ -2975,6 +3145,7 @@ void obs_source_enable_push_to_mute(obs_source_t *source, bool enabled)
 				enabled ? "enabled" : "disabled");
 
 	source->push_to_mute_enabled = enabled;
+	obs_source_mark_dirty(source);
 
 	if (changed)
 		source_signal_push_to_changed(source, "push_to_mute_changed",
@@ -3000,6 +3171,7 @@ void obs_source_set_push_to_mute_delay(obs_source_t *source, uint64_t delay)
 
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_mute_delay = delay;
+	obs_source_mark_dirty(source);
 
 	source_signal_push_to_delay(source, "push_to_mute_delay", delay);
 	pthread_mutex_unlock(&source->audio_mutex);
@@ -3029,6 +3201,7 @@ void obs_source_enable_push_to_talk(obs_source_t *source, bool enabled)
 				enabled ? "enabled" : "disabled");
 
 	source->push_to_talk_enabled = enabled;
+	obs_source_mark_dirty(source);
 
 	if (changed)
 		source_signal_push_to_changed(source, "push_to_talk_changed",
@@ -3054,6 +3227,7 @@ void obs_source_set_push_to_talk_delay(obs_source_t *source, uint64_t delay)
 
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_talk_delay = delay;
+	obs_source_mark_dirty(source);
 
 	source_signal_push_to_delay(source, "push_to_talk_delay", delay);
 	pthread_mutex_unlock(&source->audio_mutex);
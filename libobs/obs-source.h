@@ -103,6 +103,15 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_INTERACTION (1<<5)
 
+/**
+ * Source always draws fully opaque pixels over its entire width/height.
+ *
+ * Scenes use this to skip rendering of items that are completely covered by
+ * an opaque item above them.  Async video sources do not need to specify
+ * this; their opacity is determined automatically from the frame format.
+ */
+#define OBS_SOURCE_OPAQUE      (1<<6)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
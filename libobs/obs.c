@@ -527,6 +527,16 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->services_mutex, &attr) != 0)
 		goto fail;
+	/* user sources are an array searched from the start, the others are
+	 * lists with new contexts at the front */
+	if (!obs_context_index_init(&data->user_sources_index, false))
+		goto fail;
+	if (!obs_context_index_init(&data->outputs_index, true))
+		goto fail;
+	if (!obs_context_index_init(&data->encoders_index, true))
+		goto fail;
+	if (!obs_context_index_init(&data->services_index, true))
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
@@ -590,6 +600,10 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
+	obs_context_index_free(&data->user_sources_index);
+	obs_context_index_free(&data->outputs_index);
+	obs_context_index_free(&data->encoders_index);
+	obs_context_index_free(&data->services_index);
 }
 
 static const char *obs_signals[] = {
@@ -710,12 +724,38 @@ extern const struct obs_source_info scene_info;
 
 extern void log_system_info(void);
 
+static bool obs_init_modules(void)
+{
+	pthread_mutexattr_t attr;
+	bool success = false;
+
+	pthread_mutex_init_value(&obs->module_mutex);
+
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		goto fail;
+	if (pthread_mutex_init(&obs->module_mutex, &attr) != 0)
+		goto fail;
+	if (pthread_rwlock_init(&obs->types_rwlock, NULL) != 0)
+		goto fail;
+
+	success = true;
+
+fail:
+	pthread_mutexattr_destroy(&attr);
+	return success;
+}
+
 static bool obs_init(const char *locale)
 {
 	obs = bzalloc(sizeof(struct obs_core));
 
 	log_system_info();
 
+	if (!obs_init_modules())
+		return false;
+
 	if (!obs_init_data())
 		return false;
 	if (!obs_init_handlers())
@@ -753,6 +793,17 @@ bool obs_startup(const char *locale)
 	return success;
 }
 
+/* every registered type is allocated separately */
+static void free_types(struct darray *types)
+{
+	void **array = types->array;
+
+	for (size_t i = 0; i < types->num; i++)
+		bfree(array[i]);
+
+	darray_free(types);
+}
+
 void obs_shutdown(void)
 {
 	struct obs_module *module;
@@ -760,14 +811,14 @@ void obs_shutdown(void)
 	if (!obs)
 		return;
 
-	da_free(obs->input_types);
-	da_free(obs->filter_types);
-	da_free(obs->encoder_types);
-	da_free(obs->transition_types);
-	da_free(obs->output_types);
-	da_free(obs->service_types);
-	da_free(obs->modal_ui_callbacks);
-	da_free(obs->modeless_ui_callbacks);
+	free_types(&obs->input_types.da);
+	free_types(&obs->filter_types.da);
+	free_types(&obs->encoder_types.da);
+	free_types(&obs->transition_types.da);
+	free_types(&obs->output_types.da);
+	free_types(&obs->service_types.da);
+	free_types(&obs->modal_ui_callbacks.da);
+	free_types(&obs->modeless_ui_callbacks.da);
 
 	stop_video();
 	stop_hotkeys();
@@ -791,6 +842,9 @@ void obs_shutdown(void)
 	for (size_t i = 0; i < obs->module_paths.num; i++)
 		free_module_path(obs->module_paths.array+i);
 	da_free(obs->module_paths);
+	bfree(obs->module_manifest_path);
+	pthread_mutex_destroy(&obs->module_mutex);
+	pthread_rwlock_destroy(&obs->types_rwlock);
 
 	bfree(obs->locale);
 	bfree(obs);
@@ -817,6 +871,8 @@ void obs_set_locale(const char *locale)
 		bfree(obs->locale);
 	obs->locale = bstrdup(locale);
 
+	pthread_mutex_lock(&obs->module_mutex);
+
 	module = obs->first_module;
 	while (module) {
 		if (module->set_locale)
@@ -824,6 +880,8 @@ void obs_set_locale(const char *locale)
 
 		module = module->next;
 	}
+
+	pthread_mutex_unlock(&obs->module_mutex);
 }
 
 const char *obs_get_locale(void)
@@ -964,62 +1022,116 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 
 bool obs_enum_input_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->input_types.num)
-		return false;
-	*id = obs->input_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->input_types.num;
+	if (found)
+		*id = obs->input_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 bool obs_enum_filter_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->filter_types.num)
-		return false;
-	*id = obs->filter_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->filter_types.num;
+	if (found)
+		*id = obs->filter_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 bool obs_enum_transition_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->transition_types.num)
-		return false;
-	*id = obs->transition_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->transition_types.num;
+	if (found)
+		*id = obs->transition_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 bool obs_enum_output_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->output_types.num)
-		return false;
-	*id = obs->output_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->output_types.num;
+	if (found)
+		*id = obs->output_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 bool obs_enum_encoder_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->encoder_types.num)
-		return false;
-	*id = obs->encoder_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->encoder_types.num;
+	if (found)
+		*id = obs->encoder_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 bool obs_enum_service_types(size_t idx, const char **id)
 {
+	bool found;
+
 	if (!obs) return false;
 
-	if (idx >= obs->service_types.num)
-		return false;
-	*id = obs->service_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules();
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
+	found = idx < obs->service_types.num;
+	if (found)
+		*id = obs->service_types.array[idx]->id;
+
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 void obs_enter_graphics(void)
@@ -1048,32 +1160,47 @@ video_t *obs_get_video(void)
 static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
 {
+	struct obs_modal_ui *found = NULL;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
 	for (size_t i = 0; i < obs->modal_ui_callbacks.num; i++) {
-		struct obs_modal_ui *callback = obs->modal_ui_callbacks.array+i;
+		struct obs_modal_ui *callback;
+		callback = obs->modal_ui_callbacks.array[i];
 
 		if (strcmp(callback->id,     id)     == 0 &&
 		    strcmp(callback->task,   task)   == 0 &&
-		    strcmp(callback->target, target) == 0)
-			return callback;
+		    strcmp(callback->target, target) == 0) {
+			found = callback;
+			break;
+		}
 	}
 
-	return NULL;
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 static inline struct obs_modeless_ui *get_modeless_ui_callback(const char *id,
 		const char *task, const char *target)
 {
+	struct obs_modeless_ui *found = NULL;
+
+	pthread_rwlock_rdlock(&obs->types_rwlock);
+
 	for (size_t i = 0; i < obs->modeless_ui_callbacks.num; i++) {
 		struct obs_modeless_ui *callback;
-		callback = obs->modeless_ui_callbacks.array+i;
+		callback = obs->modeless_ui_callbacks.array[i];
 
 		if (strcmp(callback->id,     id)     == 0 &&
 		    strcmp(callback->task,   task)   == 0 &&
-		    strcmp(callback->target, target) == 0)
-			return callback;
+		    strcmp(callback->target, target) == 0) {
+			found = callback;
+			break;
+		}
 	}
 
-	return NULL;
+	pthread_rwlock_unlock(&obs->types_rwlock);
+	return found;
 }
 
 int obs_exec_ui(const char *name, const char *task, const char *target,
@@ -1113,6 +1240,7 @@ bool obs_add_source(obs_source_t *source)
 
 	pthread_mutex_lock(&obs->data.sources_mutex);
 	da_push_back(obs->data.user_sources, &source);
+	obs_context_index_add(&obs->data.user_sources_index, &source->context);
 	obs_source_addref(source);
 	pthread_mutex_unlock(&obs->data.sources_mutex);
 
@@ -1227,45 +1355,36 @@ void obs_enum_services(bool (*enum_proc)(void*, obs_service_t*), void *param)
 
 obs_source_t *obs_get_source_by_name(const char *name)
 {
-	struct obs_core_data *data = &obs->data;
-	struct obs_source *source = NULL;
-	size_t i;
+	struct obs_context_index *index;
+	struct obs_source *source;
 
-	if (!obs) return NULL;
+	if (!obs || !name) return NULL;
 
-	pthread_mutex_lock(&data->user_sources_mutex);
+	index = &obs->data.user_sources_index;
+	pthread_rwlock_rdlock(&index->rwlock);
 
-	for (i = 0; i < data->user_sources.num; i++) {
-		struct obs_source *cur_source = data->user_sources.array[i];
-		if (strcmp(cur_source->context.name, name) == 0) {
-			source = cur_source;
-			obs_source_addref(source);
-			break;
-		}
-	}
+	source = (struct obs_source*)obs_context_index_find(index, name);
+	obs_source_addref(source);
 
-	pthread_mutex_unlock(&data->user_sources_mutex);
+	pthread_rwlock_unlock(&index->rwlock);
 	return source;
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
-		pthread_mutex_t *mutex, void *(*addref)(void*))
+static inline void *get_context_by_name(struct obs_context_index *index,
+		const char *name, void *(*addref)(void*))
 {
-	struct obs_context_data **first = vfirst;
 	struct obs_context_data *context;
 
-	pthread_mutex_lock(mutex);
+	if (!name)
+		return NULL;
 
-	context = *first;
-	while (context) {
-		if (strcmp(context->name, name) == 0) {
-			context = addref(context);
-			break;
-		}
-		context = context->next;
-	}
+	pthread_rwlock_rdlock(&index->rwlock);
 
-	pthread_mutex_unlock(mutex);
+	context = obs_context_index_find(index, name);
+	if (context)
+		context = addref(context);
+
+	pthread_rwlock_unlock(&index->rwlock);
 	return context;
 }
 
@@ -1292,22 +1411,22 @@ static inline void *obs_id_(void *data)
 obs_output_t *obs_get_output_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_output, name,
-			&obs->data.outputs_mutex, obs_output_addref_safe_);
+	return get_context_by_name(&obs->data.outputs_index, name,
+			obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_encoder, name,
-			&obs->data.encoders_mutex, obs_encoder_addref_safe_);
+	return get_context_by_name(&obs->data.encoders_index, name,
+			obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
 	if (!obs) return NULL;
-	return get_context_by_name(&obs->data.first_service, name,
-			&obs->data.services_mutex, obs_service_addref_safe_);
+	return get_context_by_name(&obs->data.services_index, name,
+			obs_service_addref_safe_);
 }
 
 gs_effect_t *obs_get_default_effect(void)
@@ -1627,6 +1746,106 @@ obs_data_array_t *obs_save_sources(void)
 	return array;
 }
 
+/*
+ * Settings can be changed through obs_source_get_settings without an update,
+ * so their change id is checked as well.  Returns whether the source or one
+ * of its filters saves data of its own, which can't be checked for changes.
+ * Scenes save their items, which are covered by save_gen and the names.
+ */
+static bool get_save_state(obs_source_t *source, long *settings_id)
+{
+	bool is_scene = strcmp(source->info.id, scene_info.id) == 0;
+	bool custom_save = !is_scene && source->info.save != NULL;
+	long id = obs_data_get_change_id(source->context.settings);
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		long filter_id = obs_data_get_change_id(
+				filter->context.settings);
+
+		if (filter_id > id)
+			id = filter_id;
+		if (filter->info.save)
+			custom_save = true;
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	*settings_id = id;
+	return custom_save;
+}
+
+static inline bool save_json_valid(obs_source_t *source, long gen,
+		long names_gen, long settings_id, bool custom_save)
+{
+	if (!source->save_json || custom_save)
+		return false;
+
+	if (source->save_json_gen         != gen ||
+	    source->save_json_settings_id != settings_id)
+		return false;
+
+	/* scenes save the names of their items */
+	if (strcmp(source->info.id, scene_info.id) == 0)
+		return source->save_json_names_gen == names_gen;
+
+	return true;
+}
+
+static const char *get_save_json(obs_source_t *source)
+{
+	long gen       = os_atomic_load_long(&source->save_gen);
+	long names_gen = os_atomic_load_long(&obs->data.source_names_gen);
+	long settings_id;
+	bool custom_save = get_save_state(source, &settings_id);
+
+	if (!save_json_valid(source, gen, names_gen, settings_id,
+				custom_save)) {
+		obs_data_t *data = obs_save_source(source);
+
+		bfree(source->save_json);
+		source->save_json = bstrdup(obs_data_get_json(data));
+
+		source->save_json_gen         = gen;
+		source->save_json_names_gen   = names_gen;
+		source->save_json_settings_id = settings_id;
+
+		obs_data_release(data);
+	}
+
+	return source->save_json;
+}
+
+char *obs_save_sources_json(void)
+{
+	struct dstr json = {0};
+	size_t i;
+
+	if (!obs) return NULL;
+
+	dstr_copy(&json, "[");
+
+	pthread_mutex_lock(&obs->data.user_sources_mutex);
+
+	for (i = 0; i < obs->data.user_sources.num; i++) {
+		obs_source_t *source = obs->data.user_sources.array[i];
+		const char *source_json = get_save_json(source);
+
+		if (!source_json)
+			continue;
+
+		dstr_cat(&json, json.len > 1 ? ",\n" : "\n");
+		dstr_cat(&json, source_json);
+	}
+
+	pthread_mutex_unlock(&obs->data.user_sources_mutex);
+
+	dstr_cat(&json, "\n]");
+	return json.array;
+}
+
 /* ensures that names are never blank */
 static inline char *dup_name(const char *name)
 {
@@ -1699,8 +1918,160 @@ void obs_context_data_free(struct obs_context_data *context)
 	memset(context, 0, sizeof(*context));
 }
 
+static inline uint32_t hash_context_name(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+bool obs_context_index_init(struct obs_context_index *index,
+		bool newest_first)
+{
+	memset(index, 0, sizeof(struct obs_context_index));
+	index->newest_first = newest_first;
+	return pthread_rwlock_init(&index->rwlock, NULL) == 0;
+}
+
+void obs_context_index_free(struct obs_context_index *index)
+{
+	pthread_rwlock_destroy(&index->rwlock);
+	bfree(index->buckets);
+	memset(index, 0, sizeof(struct obs_context_index));
+}
+
+static inline bool index_comes_before(struct obs_context_index *index,
+		const struct obs_context_data *a,
+		const struct obs_context_data *b)
+{
+	return index->newest_first ?
+		a->index_order > b->index_order :
+		a->index_order < b->index_order;
+}
+
+/* links at the position given by the order the context was added in, so
+ * relinking after a rename does not change which duplicate is found */
+static inline void index_link(struct obs_context_index *index,
+		struct obs_context_data *context)
+{
+	struct obs_context_data **link;
+
+	link = index->buckets + (context->name_hash &
+			(index->num_buckets - 1));
+
+	while (*link && index_comes_before(index, *link, context))
+		link = &(*link)->hash_next;
+
+	context->hash_next = *link;
+	*link = context;
+}
+
+static void index_unlink(struct obs_context_index *index,
+		struct obs_context_data *context)
+{
+	struct obs_context_data **link;
+
+	link = index->buckets + (context->name_hash &
+			(index->num_buckets - 1));
+
+	while (*link) {
+		if (*link == context) {
+			*link = context->hash_next;
+			break;
+		}
+		link = &(*link)->hash_next;
+	}
+
+	context->hash_next = NULL;
+}
+
+/* keeps the chains at an average length of one or less */
+static void index_grow(struct obs_context_index *index)
+{
+	struct obs_context_data **old_buckets = index->buckets;
+	size_t old_num = index->num_buckets;
+
+	index->num_buckets = old_num ? old_num * 2 : 64;
+	index->buckets = bzalloc(index->num_buckets * sizeof(void*));
+
+	for (size_t i = 0; i < old_num; i++) {
+		struct obs_context_data *context = old_buckets[i];
+
+		while (context) {
+			struct obs_context_data *next = context->hash_next;
+			index_link(index, context);
+			context = next;
+		}
+	}
+
+	bfree(old_buckets);
+}
+
+void obs_context_index_add(struct obs_context_index *index,
+		struct obs_context_data *context)
+{
+	if (!index || !context || context->index)
+		return;
+
+	pthread_rwlock_wrlock(&index->rwlock);
+
+	if (index->count + 1 > index->num_buckets)
+		index_grow(index);
+
+	context->name_hash = hash_context_name(context->name);
+	context->index_order = index->next_order++;
+	context->index = index;
+	index_link(index, context);
+	index->count++;
+
+	pthread_rwlock_unlock(&index->rwlock);
+}
+
+void obs_context_index_remove(struct obs_context_data *context)
+{
+	struct obs_context_index *index = context ? context->index : NULL;
+
+	if (!index)
+		return;
+
+	pthread_rwlock_wrlock(&index->rwlock);
+
+	index_unlink(index, context);
+	index->count--;
+	context->index = NULL;
+
+	pthread_rwlock_unlock(&index->rwlock);
+}
+
+struct obs_context_data *obs_context_index_find(
+		struct obs_context_index *index, const char *name)
+{
+	uint32_t hash = hash_context_name(name);
+	struct obs_context_data *context;
+
+	if (!index->buckets)
+		return NULL;
+
+	context = index->buckets[hash & (index->num_buckets - 1)];
+	while (context) {
+		if (context->name_hash == hash &&
+		    strcmp(context->name, name) == 0)
+			return context;
+
+		context = context->hash_next;
+	}
+
+	return NULL;
+}
+
 void obs_context_data_insert(struct obs_context_data *context,
-		pthread_mutex_t *mutex, void *pfirst)
+		pthread_mutex_t *mutex, void *pfirst,
+		struct obs_context_index *index)
 {
 	struct obs_context_data **first = pfirst;
 
@@ -1717,10 +2088,14 @@ void obs_context_data_insert(struct obs_context_data *context,
 	if (context->next)
 		context->next->prev_next = &context->next;
 	pthread_mutex_unlock(mutex);
+
+	obs_context_index_add(index, context);
 }
 
 void obs_context_data_remove(struct obs_context_data *context)
 {
+	obs_context_index_remove(context);
+
 	if (context && context->mutex) {
 		pthread_mutex_lock(context->mutex);
 		if (context->prev_next)
@@ -1736,13 +2111,31 @@ void obs_context_data_remove(struct obs_context_data *context)
 void obs_context_data_setname(struct obs_context_data *context,
 		const char *name)
 {
+	struct obs_context_index *index = context->index;
+
+	/* the name is part of the key, so it can only change while no lookup
+	 * is walking the index */
+	if (index)
+		pthread_rwlock_wrlock(&index->rwlock);
+
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
+	if (index)
+		index_unlink(index, context);
+
 	if (context->name)
 		da_push_back(context->rename_cache, &context->name);
 	context->name = dup_name(name);
 
+	if (index) {
+		context->name_hash = hash_context_name(context->name);
+		index_link(index, context);
+	}
+
 	pthread_mutex_unlock(&context->rename_cache_mutex);
+
+	if (index)
+		pthread_rwlock_unlock(&index->rwlock);
 }
 
 void obs_preview_set_enabled(bool enable)
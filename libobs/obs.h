@@ -49,6 +49,7 @@ struct obs_service;
 struct obs_module;
 struct obs_fader;
 struct obs_volmeter;
+struct obs_audio_tap_queue;
 
 typedef struct obs_display    obs_display_t;
 typedef struct obs_view       obs_view_t;
@@ -61,6 +62,7 @@ typedef struct obs_service    obs_service_t;
 typedef struct obs_module     obs_module_t;
 typedef struct obs_fader      obs_fader_t;
 typedef struct obs_volmeter   obs_volmeter_t;
+typedef struct obs_audio_tap_queue obs_audio_tap_queue_t;
 
 typedef struct obs_weak_source  obs_weak_source_t;
 typedef struct obs_weak_output  obs_weak_output_t;
@@ -142,6 +144,33 @@ struct obs_transform_info {
 	struct vec2          bounds;
 };
 
+/**
+ * Scene culling flags.
+ *
+ * Used with obs_scene_set_cull_flags to control which scene items are skipped
+ * while rendering a scene.
+ */
+/** Skip items that are completely outside of the scene canvas */
+#define OBS_SCENE_CULL_OFFSCREEN    (1<<0)
+/** Skip items that are completely covered by an opaque item above them */
+#define OBS_SCENE_CULL_OCCLUDED     (1<<1)
+/**
+ * Also skip the async texture upload of culled async video sources.  Saves
+ * the upload cost, but a source may show one stale frame when it becomes
+ * visible again.
+ */
+#define OBS_SCENE_CULL_ASYNC_UPLOAD (1<<2)
+
+#define OBS_SCENE_CULL_DEFAULT \
+	(OBS_SCENE_CULL_OFFSCREEN | OBS_SCENE_CULL_OCCLUDED)
+
+/** Scene item culling statistics of the last rendered frame */
+struct obs_scene_cull_stats {
+	uint32_t rendered;
+	uint32_t culled_offscreen;
+	uint32_t culled_occluded;
+};
+
 /**
  * Video initialization structure
  */
@@ -189,7 +218,8 @@ struct obs_audio_info {
 
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
- * audio data
+ * audio data.  The data is in the planar float format of the audio output,
+ * each plane is 32-byte aligned, and it may be modified in place.
  */
 struct obs_audio_data {
 	uint8_t             *data[MAX_AV_PLANES];
@@ -359,7 +389,20 @@ EXPORT const char *obs_get_module_data_path(obs_module_t *module);
  */
 EXPORT void obs_add_module_path(const char *bin, const char *data);
 
-/** Automatically loads all modules from module paths (convenience function) */
+/**
+ * Sets the file used to cache the types registered by each module.
+ *
+ * When set, obs_load_all_modules does not load modules whose binary is
+ * unchanged since the cache was written; they are loaded on first use of one
+ * of their types instead.
+ */
+EXPORT void obs_set_module_manifest_path(const char *path);
+
+/**
+ * Automatically loads all modules from module paths (convenience function).
+ * Module images are opened in parallel and the load time of each module is
+ * logged.
+ */
 EXPORT void obs_load_all_modules(void);
 
 struct obs_module_info {
@@ -567,6 +610,12 @@ EXPORT void obs_load_sources(obs_data_array_t *array);
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
+/**
+ * Saves sources to a JSON array, free with bfree.  Only sources that changed
+ * since the last call are serialized again, the text of the others is reused.
+ */
+EXPORT char *obs_save_sources_json(void);
+
 EXPORT void obs_preview_set_enabled(bool enable);
 EXPORT bool obs_preview_enabled(void);
 
@@ -779,6 +828,33 @@ EXPORT void obs_source_set_sync_offset(obs_source_t *source, int64_t offset);
 /** Gets the audio sync offset (in nanoseconds) for a source */
 EXPORT int64_t obs_source_get_sync_offset(const obs_source_t *source);
 
+/**
+ * Audio tap callback.  Called from the audio path of the source with the
+ * final audio of each packet (after filters, in the output format), so it
+ * must return quickly and must not add or remove taps.  Heavy processing
+ * should be moved to another thread, for example with an
+ * obs_audio_tap_queue.
+ */
+typedef void (*obs_source_audio_tap_t)(void *param, obs_source_t *source,
+		const struct audio_data *audio, bool muted);
+
+/**
+ * Adds an audio tap to a source.
+ *
+ * @param  decimation  Only every Nth packet is passed to the tap (0 or 1 to
+ *                     receive every packet)
+ */
+EXPORT void obs_source_add_audio_tap(obs_source_t *source,
+		obs_source_audio_tap_t callback, void *param,
+		uint32_t decimation);
+
+/**
+ * Removes an audio tap from a source.  The tap is not called anymore once
+ * this returns.
+ */
+EXPORT void obs_source_remove_audio_tap(obs_source_t *source,
+		obs_source_audio_tap_t callback, void *param);
+
 /** Enumerates child sources used by this source */
 EXPORT void obs_source_enum_sources(obs_source_t *source,
 		obs_source_enum_proc_t enum_callback,
@@ -1032,6 +1108,14 @@ EXPORT void obs_scene_enum_items(obs_scene_t *scene,
 		bool (*callback)(obs_scene_t*, obs_sceneitem_t*, void*),
 		void *param);
 
+/** Sets the culling flags of a scene (OBS_SCENE_CULL_*) */
+EXPORT void obs_scene_set_cull_flags(obs_scene_t *scene, uint32_t flags);
+EXPORT uint32_t obs_scene_get_cull_flags(obs_scene_t *scene);
+
+/** Gets the scene item culling statistics of the last rendered frame */
+EXPORT void obs_scene_get_cull_stats(obs_scene_t *scene,
+		struct obs_scene_cull_stats *stats);
+
 /** Adds/creates a new scene item for a source */
 EXPORT obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source);
 
@@ -1437,6 +1521,19 @@ EXPORT audio_t *obs_encoder_audio(const obs_encoder_t *encoder);
 /** Returns true if encoder is active, false otherwise */
 EXPORT bool obs_encoder_active(const obs_encoder_t *encoder);
 
+/**
+ * Returns the average time a video encoder spends encoding a frame relative
+ * to the frame interval.  Values at or above 1.0 mean the encoder cannot
+ * keep up and frames are being skipped.
+ */
+EXPORT float obs_encoder_get_load(const obs_encoder_t *encoder);
+
+/**
+ * Returns how far (in nanoseconds) a video encoder has fallen behind the
+ * frame interval, accumulated over frames that took too long to encode.
+ */
+EXPORT uint64_t obs_encoder_get_lag_ns(const obs_encoder_t *encoder);
+
 /** Duplicates an encoder packet */
 EXPORT void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 		const struct encoder_packet *src);
@@ -116,9 +116,13 @@ static inline void circlebuf_upsize(struct circlebuf *cb, size_t size)
 	cb->end_pos = new_end_pos;
 }
 
-/** Overwrites data at a specific point in the buffer (relative).  */
-static inline void circlebuf_place(struct circlebuf *cb, size_t position,
-		const void *data, size_t size)
+/**
+ * Makes room for data at a specific point in the buffer (relative) and
+ * returns the one or two regions it occupies, so it can be written in place.
+ * The second region is NULL if the data does not wrap around.
+ */
+static inline void circlebuf_place_ptrs(struct circlebuf *cb, size_t position,
+		size_t size, void *ptrs[2], size_t sizes[2])
 {
 	size_t end_point = position + size;
 	size_t data_end_pos;
@@ -130,19 +134,35 @@ static inline void circlebuf_place(struct circlebuf *cb, size_t position,
 	if (position >= cb->capacity)
 		position -= cb->capacity;
 
+	ptrs[0] = (uint8_t*)cb->data + position;
+
 	data_end_pos = position + size;
 	if (data_end_pos > cb->capacity) {
-		size_t back_size = data_end_pos - cb->capacity;
-		size_t loop_size = size - back_size;
-
-		if (back_size)
-			memcpy((uint8_t*)cb->data + position, data, loop_size);
-		memcpy(cb->data, (uint8_t*)data + loop_size, back_size);
+		sizes[0] = cb->capacity - position;
+		sizes[1] = size - sizes[0];
+		ptrs[1]  = cb->data;
 	} else {
-		memcpy((uint8_t*)cb->data + position, data, size);
+		sizes[0] = size;
+		sizes[1] = 0;
+		ptrs[1]  = NULL;
 	}
 }
 
+/** Overwrites data at a specific point in the buffer (relative).  */
+static inline void circlebuf_place(struct circlebuf *cb, size_t position,
+		const void *data, size_t size)
+{
+	void   *ptrs[2];
+	size_t sizes[2];
+
+	circlebuf_place_ptrs(cb, position, size, ptrs, sizes);
+
+	if (sizes[0])
+		memcpy(ptrs[0], data, sizes[0]);
+	if (sizes[1])
+		memcpy(ptrs[1], (const uint8_t*)data + sizes[0], sizes[1]);
+}
+
 static inline void circlebuf_push_back(struct circlebuf *cb, const void *data,
 		size_t size)
 {
@@ -199,6 +219,22 @@ static inline void circlebuf_pop_front(struct circlebuf *cb, void *data,
 		cb->start_pos -= cb->capacity;
 }
 
+/**
+ * Returns a pointer to the data at a relative position.  Only valid when the
+ * buffer is used with fixed size elements, so an element never wraps around.
+ */
+static inline void *circlebuf_data(struct circlebuf *cb, size_t idx)
+{
+	size_t offset = cb->start_pos + idx;
+
+	if (idx >= cb->size)
+		return NULL;
+	if (offset >= cb->capacity)
+		offset -= cb->capacity;
+
+	return (uint8_t*)cb->data + offset;
+}
+
 #ifdef __cplusplus
 }
 #endif
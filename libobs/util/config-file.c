@@ -16,7 +16,9 @@
 
 #include <stdio.h>
 #include <wchar.h>
+#include <ctype.h>
 #include "config-file.h"
+#include "threading.h"
 #include "platform.h"
 #include "base.h"
 #include "bmem.h"
@@ -24,6 +26,11 @@
 #include "lexer.h"
 #include "dstr.h"
 
+/* time without further save requests before a deferred save is written */
+#define SAVE_DELAY_MS     1000
+/* longest time a deferred save can be postponed by further requests */
+#define SAVE_MAX_DELAY_NS (5000ULL * 1000000ULL)
+
 struct config_item {
 	char *name;
 	char *value;
@@ -52,12 +59,214 @@ static inline void config_section_free(struct config_section *section)
 	bfree(section->name);
 }
 
+/*
+ * Hash index of the sections and items of a section array
+ *
+ *   Every section and every item has a slot, keyed by a case-insensitive hash
+ * of the section name (and the item name for items).  Slots refer to the
+ * array indices rather than pointers because the arrays are reallocated as
+ * they grow; sections and items are never removed, so the indices stay valid.
+ * For duplicate names only the first section or item is indexed, which is
+ * the one the linear search found.
+ */
+struct config_slot {
+	uint32_t hash;
+	uint32_t section; /* index + 1, 0 for an empty slot */
+	uint32_t item;    /* index + 1, 0 for a section slot */
+};
+
+struct config_index {
+	struct config_slot *slots;
+	size_t mask;
+	size_t count;
+};
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
+	struct config_index sections_index;
+	struct config_index defaults_index;
+
+	/* user values changed since the last save.  once the save thread is
+	 * running it is only cleared with save_mutex held, and the thread sets
+	 * it again when a write fails */
+	bool dirty;
+
+	/* deferred saves, the thread is started on the first request */
+	pthread_mutex_t save_mutex;
+	os_event_t *save_event;
+	pthread_t save_thread;
+	bool save_thread_active;
+	volatile bool save_exiting;
+	struct dstr pending;
+	bool save_pending;
 };
 
+#define HASH_INIT  2166136261U
+#define HASH_PRIME 16777619U
+
+static inline uint32_t hash_name(uint32_t hash, const char *name)
+{
+	while (*name) {
+		hash ^= (uint8_t)toupper((unsigned char)*(name++));
+		hash *= HASH_PRIME;
+	}
+
+	return hash;
+}
+
+static inline uint32_t hash_section(const char *section)
+{
+	return hash_name(HASH_INIT, section);
+}
+
+static inline uint32_t hash_item(uint32_t section_hash, const char *name)
+{
+	/* separator, so that "ab"/"c" and "a"/"bc" do not always collide */
+	return hash_name((section_hash ^ 0xFF) * HASH_PRIME, name);
+}
+
+static inline struct config_section *get_section(
+		const struct darray *sections, uint32_t idx)
+{
+	return (struct config_section*)sections->array + idx;
+}
+
+static inline struct config_item *get_item(
+		const struct config_section *section, uint32_t idx)
+{
+	return (struct config_item*)section->items.array + idx;
+}
+
+static struct config_section *index_find_section(
+		const struct darray *sections,
+		const struct config_index *index, const char *section)
+{
+	uint32_t hash = hash_section(section);
+	size_t pos;
+
+	if (!index->slots)
+		return NULL;
+
+	for (pos = hash & index->mask; index->slots[pos].section;
+			pos = (pos + 1) & index->mask) {
+		const struct config_slot *slot = index->slots + pos;
+		struct config_section *sec;
+
+		if (slot->hash != hash || slot->item)
+			continue;
+
+		sec = get_section(sections, slot->section - 1);
+		if (astrcmpi(sec->name, section) == 0)
+			return sec;
+	}
+
+	return NULL;
+}
+
+static struct config_item *index_find_item(const struct darray *sections,
+		const struct config_index *index, const char *section,
+		const char *name)
+{
+	uint32_t hash = hash_item(hash_section(section), name);
+	size_t pos;
+
+	if (!index->slots)
+		return NULL;
+
+	for (pos = hash & index->mask; index->slots[pos].section;
+			pos = (pos + 1) & index->mask) {
+		const struct config_slot *slot = index->slots + pos;
+		struct config_section *sec;
+		struct config_item *item;
+
+		if (slot->hash != hash || !slot->item)
+			continue;
+
+		sec = get_section(sections, slot->section - 1);
+		if (astrcmpi(sec->name, section) != 0)
+			continue;
+
+		item = get_item(sec, slot->item - 1);
+		if (astrcmpi(item->name, name) == 0)
+			return item;
+	}
+
+	return NULL;
+}
+
+static void index_add_slot(struct config_index *index,
+		const struct config_slot *new_slot)
+{
+	size_t pos = new_slot->hash & index->mask;
+
+	while (index->slots[pos].section)
+		pos = (pos + 1) & index->mask;
+
+	index->slots[pos] = *new_slot;
+	index->count++;
+}
+
+static void index_insert(struct config_index *index, uint32_t hash,
+		size_t section, size_t item)
+{
+	struct config_slot slot = {hash, (uint32_t)section + 1, (uint32_t)item};
+
+	/* keep the load factor at or below one half */
+	if (!index->slots || (index->count + 1) * 2 > index->mask + 1) {
+		struct config_slot *old_slots = index->slots;
+		size_t old_size = old_slots ? index->mask + 1 : 0;
+		size_t size = old_size ? old_size * 2 : 64;
+		size_t i;
+
+		index->slots = bzalloc(size * sizeof(struct config_slot));
+		index->mask  = size - 1;
+		index->count = 0;
+
+		for (i = 0; i < old_size; i++) {
+			if (old_slots[i].section)
+				index_add_slot(index, old_slots + i);
+		}
+
+		bfree(old_slots);
+	}
+
+	index_add_slot(index, &slot);
+}
+
+static inline void index_free(struct config_index *index)
+{
+	bfree(index->slots);
+	memset(index, 0, sizeof(struct config_index));
+}
+
+static void index_build(struct config_index *index,
+		const struct darray *sections)
+{
+	size_t i, j;
+
+	index_free(index);
+
+	for (i = 0; i < sections->num; i++) {
+		struct config_section *sec = get_section(sections, (uint32_t)i);
+		uint32_t sec_hash = hash_section(sec->name);
+
+		if (index_find_section(sections, index, sec->name) == NULL)
+			index_insert(index, sec_hash, i, 0);
+
+		for (j = 0; j < sec->items.num; j++) {
+			struct config_item *item = get_item(sec, (uint32_t)j);
+
+			if (!index_find_item(sections, index, sec->name,
+						item->name))
+				index_insert(index,
+						hash_item(sec_hash, item->name),
+						i, j + 1);
+		}
+	}
+}
+
 config_t *config_create(const char *file)
 {
 	struct config_data *config;
@@ -255,6 +464,8 @@ int config_open(config_t **config, const char *file,
 	if (errorcode != CONFIG_SUCCESS) {
 		config_close(*config);
 		*config = NULL;
+	} else {
+		index_build(&(*config)->sections_index, &(*config)->sections);
 	}
 
 	return errorcode;
@@ -278,72 +489,258 @@ int config_open_string(config_t **config, const char *str)
 	parse_config_data(&(*config)->sections, &lex);
 	lexer_free(&lex);
 
+	index_build(&(*config)->sections_index, &(*config)->sections);
 	return CONFIG_SUCCESS;
 }
 
 int config_open_defaults(config_t *config, const char *file)
 {
+	int errorcode;
+
 	if (!config)
 		return CONFIG_ERROR;
 
-	return config_parse_file(&config->defaults, file, false);
+	errorcode = config_parse_file(&config->defaults, file, false);
+	index_build(&config->defaults_index, &config->defaults);
+	return errorcode;
 }
 
-int config_save(config_t *config)
+static void config_serialize(config_t *config, struct dstr *str)
 {
-	FILE *f;
-	struct dstr str, tmp;
+	struct dstr tmp;
 	size_t i, j;
 
-	if (!config)
-		return CONFIG_ERROR;
-	if (!config->file)
-		return CONFIG_ERROR;
-
-	dstr_init(&str);
 	dstr_init(&tmp);
 
-	f = os_fopen(config->file, "wb");
-	if (!f)
-		return CONFIG_FILENOTFOUND;
+#ifdef _WIN32
+	dstr_cat(str, "\xEF\xBB\xBF");
+#endif
 
 	for (i = 0; i < config->sections.num; i++) {
 		struct config_section *section = darray_item(
 				sizeof(struct config_section),
 				&config->sections, i);
 
-		if (i) dstr_cat(&str, "\n");
+		if (i) dstr_cat(str, "\n");
 
-		dstr_cat(&str, "[");
-		dstr_cat(&str, section->name);
-		dstr_cat(&str, "]\n");
+		dstr_cat(str, "[");
+		dstr_cat(str, section->name);
+		dstr_cat(str, "]\n");
 
 		for (j = 0; j < section->items.num; j++) {
 			struct config_item *item = darray_item(
 					sizeof(struct config_item),
 					&section->items, j);
 
-			dstr_copy(&tmp, item->value ? item->value : "");
-			dstr_replace(&tmp, "\\", "\\\\");
-			dstr_replace(&tmp, "\r", "\\r");
-			dstr_replace(&tmp, "\n", "\\n");
+			const char *value = item->value ? item->value : "";
+
+			dstr_cat(str, item->name);
+			dstr_cat(str, "=");
+
+			if (strpbrk(value, "\\\r\n")) {
+				dstr_copy(&tmp, value);
+				dstr_replace(&tmp, "\\", "\\\\");
+				dstr_replace(&tmp, "\r", "\\r");
+				dstr_replace(&tmp, "\n", "\\n");
+				dstr_cat_dstr(str, &tmp);
+			} else {
+				dstr_cat(str, value);
+			}
 
-			dstr_cat(&str, item->name);
-			dstr_cat(&str, "=");
-			dstr_cat(&str, tmp.array);
-			dstr_cat(&str, "\n");
+			dstr_cat(str, "\n");
 		}
 	}
 
-#ifdef _WIN32
-	fwrite("\xEF\xBB\xBF", 1, 3, f);
-#endif
-	fwrite(str.array, 1, str.len, f);
-	fclose(f);
-
 	dstr_free(&tmp);
+}
+
+/*
+ * Writes to a temporary file first and renames it over the config file, so
+ * the file is never left truncated if the program dies while saving.
+ */
+static int config_write_file(const char *file, const struct dstr *str)
+{
+	struct dstr temp_file;
+	bool success = false;
+	FILE *f;
+
+	dstr_init_copy(&temp_file, file);
+	dstr_cat(&temp_file, ".tmp");
+
+	f = os_fopen(temp_file.array, "wb");
+	if (!f) {
+		dstr_free(&temp_file);
+		return CONFIG_FILENOTFOUND;
+	}
+
+	if (str->len)
+		success = fwrite(str->array, 1, str->len, f) == str->len;
+	else
+		success = true;
+	success = fclose(f) == 0 && success;
+
+	if (success)
+		success = os_rename(temp_file.array, file) == 0;
+	if (!success)
+		os_unlink(temp_file.array);
+
+	dstr_free(&temp_file);
+	return success ? CONFIG_SUCCESS : CONFIG_ERROR;
+}
+
+int config_save(config_t *config)
+{
+	struct dstr str;
+	int errorcode;
+
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
+
+	dstr_init(&str);
+	config_serialize(config, &str);
+
+	/* supersedes any deferred save that has not been written yet */
+	if (config->save_thread_active) {
+		pthread_mutex_lock(&config->save_mutex);
+		config->save_pending = false;
+		errorcode = config_write_file(config->file, &str);
+		if (errorcode == CONFIG_SUCCESS)
+			config->dirty = false;
+		pthread_mutex_unlock(&config->save_mutex);
+	} else {
+		errorcode = config_write_file(config->file, &str);
+		if (errorcode == CONFIG_SUCCESS)
+			config->dirty = false;
+	}
+
 	dstr_free(&str);
+	return errorcode;
+}
+
+static void write_pending_save(config_t *config)
+{
+	pthread_mutex_lock(&config->save_mutex);
+
+	if (config->save_pending) {
+		int errorcode = config_write_file(config->file,
+				&config->pending);
+		if (errorcode != CONFIG_SUCCESS) {
+			blog(LOG_WARNING, "config_save_deferred: Failed to "
+			                  "save '%s': %d", config->file,
+			                  errorcode);
+
+			/* so the next save tries again */
+			config->dirty = true;
+		}
+		config->save_pending = false;
+	}
+
+	pthread_mutex_unlock(&config->save_mutex);
+}
+
+static void *save_thread(void *data)
+{
+	config_t *config = data;
+
+	os_set_thread_name("config-file: save thread");
+
+	while (os_event_wait(config->save_event) == 0) {
+		uint64_t first_request = os_gettime_ns();
+
+		if (config->save_exiting)
+			break;
+
+		/* coalesce requests until they stop for a while */
+		while (os_event_timedwait(config->save_event,
+					SAVE_DELAY_MS) == 0) {
+			if (config->save_exiting ||
+			    os_gettime_ns() - first_request >=
+			    SAVE_MAX_DELAY_NS)
+				break;
+		}
 
+		if (config->save_exiting)
+			break;
+
+		write_pending_save(config);
+	}
+
+	return NULL;
+}
+
+static bool start_save_thread(config_t *config)
+{
+	if (pthread_mutex_init(&config->save_mutex, NULL) != 0)
+		return false;
+
+	if (os_event_init(&config->save_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	if (pthread_create(&config->save_thread, NULL, save_thread,
+				config) != 0)
+		goto fail;
+
+	config->save_thread_active = true;
+	return true;
+
+fail:
+	os_event_destroy(config->save_event);
+	config->save_event = NULL;
+	pthread_mutex_destroy(&config->save_mutex);
+	return false;
+}
+
+static void stop_save_thread(config_t *config)
+{
+	config->save_exiting = true;
+	os_event_signal(config->save_event);
+	pthread_join(config->save_thread, NULL);
+
+	/* flush the last request instead of waiting out the delay */
+	write_pending_save(config);
+
+	os_event_destroy(config->save_event);
+	pthread_mutex_destroy(&config->save_mutex);
+	dstr_free(&config->pending);
+	config->save_thread_active = false;
+}
+
+int config_save_deferred(config_t *config)
+{
+	struct dstr str;
+
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
+
+	if (!config->save_thread_active) {
+		if (!config->dirty)
+			return CONFIG_SUCCESS;
+		if (!start_save_thread(config))
+			return config_save(config);
+	}
+
+	pthread_mutex_lock(&config->save_mutex);
+
+	if (!config->dirty) {
+		pthread_mutex_unlock(&config->save_mutex);
+		return CONFIG_SUCCESS;
+	}
+
+	dstr_init(&str);
+	config_serialize(config, &str);
+
+	dstr_free(&config->pending);
+	config->pending = str;
+	config->save_pending = true;
+	config->dirty = false;
+
+	pthread_mutex_unlock(&config->save_mutex);
+
+	os_event_signal(config->save_event);
 	return CONFIG_SUCCESS;
 }
 
@@ -354,6 +751,9 @@ void config_close(config_t *config)
 
 	if (!config) return;
 
+	if (config->save_thread_active)
+		stop_save_thread(config);
+
 	defaults = config->defaults.array;
 	sections = config->sections.array;
 
@@ -362,6 +762,8 @@ void config_close(config_t *config)
 	for (i = 0; i < config->sections.num; i++)
 		config_section_free(sections+i);
 
+	index_free(&config->defaults_index);
+	index_free(&config->sections_index);
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
 	bfree(config->file);
@@ -386,67 +788,64 @@ const char *config_get_section(config_t *config, size_t idx)
 	return section->name;
 }
 
-static const struct config_item *config_find_item(const struct darray *sections,
+static inline const struct config_item *config_find_item(
+		const struct darray *sections,
+		const struct config_index *index,
 		const char *section, const char *name)
 {
-	size_t i, j;
-
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
-
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item = darray_item(
-						sizeof(struct config_item),
-						&sec->items, j);
-
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
-	}
-
-	return NULL;
+	return index_find_item(sections, index, section, name);
 }
 
-static void config_set_item(struct darray *sections, const char *section,
+/* returns true if the value of the item was changed */
+static bool config_set_item(struct darray *sections,
+		struct config_index *index, const char *section,
 		const char *name, char *value)
 {
-	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
+	struct config_section *sec;
 	struct config_item *item;
-	size_t i, j;
-
-	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array+i;
-		struct config_item *items = cur_sec->items.array;
-
-		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items+j;
-
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					return;
-				}
-			}
-
-			sec = cur_sec;
-			break;
-		}
+	size_t sec_idx;
+	bool changed;
+
+	item = index_find_item(sections, index, section, name);
+	if (item) {
+		changed = !item->value || strcmp(item->value, value) != 0;
+		bfree(item->value);
+		item->value = value;
+		return changed;
 	}
 
+	sec = index_find_section(sections, index, section);
 	if (!sec) {
 		sec = darray_push_back_new(sizeof(struct config_section),
 				sections);
 		sec->name = bstrdup(section);
+		index_insert(index, hash_section(section),
+				sections->num - 1, 0);
 	}
 
+	sec_idx = sec - (struct config_section*)sections->array;
+
 	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
 	item->name  = bstrdup(name);
 	item->value = value;
+	index_insert(index, hash_item(hash_section(section), name), sec_idx,
+			sec->items.num);
+	return true;
+}
+
+static inline void config_set_user_item(config_t *config,
+		const char *section, const char *name, char *value)
+{
+	if (config_set_item(&config->sections, &config->sections_index,
+				section, name, value))
+		config->dirty = true;
+}
+
+static inline void config_set_default_item(config_t *config,
+		const char *section, const char *name, char *value)
+{
+	config_set_item(&config->defaults, &config->defaults_index,
+			section, name, value);
 }
 
 void config_set_string(config_t *config, const char *section,
@@ -454,7 +853,7 @@ void config_set_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->sections, section, name, bstrdup(value));
+	config_set_user_item(config, section, name, bstrdup(value));
 }
 
 void config_set_int(config_t *config, const char *section,
@@ -463,7 +862,7 @@ void config_set_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->sections, section, name, str.array);
+	config_set_user_item(config, section, name, str.array);
 }
 
 void config_set_uint(config_t *config, const char *section,
@@ -472,14 +871,14 @@ void config_set_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->sections, section, name, str.array);
+	config_set_user_item(config, section, name, str.array);
 }
 
 void config_set_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->sections, section, name, str);
+	config_set_user_item(config, section, name, str);
 }
 
 void config_set_double(config_t *config, const char *section,
@@ -487,7 +886,7 @@ void config_set_double(config_t *config, const char *section,
 {
 	char *str = bzalloc(64);
 	os_dtostr(value, str, 64);
-	config_set_item(&config->sections, section, name, str);
+	config_set_user_item(config, section, name, str);
 }
 
 void config_set_default_string(config_t *config, const char *section,
@@ -495,7 +894,7 @@ void config_set_default_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->defaults, section, name, bstrdup(value));
+	config_set_default_item(config, section, name, bstrdup(value));
 }
 
 void config_set_default_int(config_t *config, const char *section,
@@ -504,7 +903,7 @@ void config_set_default_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_default_item(config, section, name, str.array);
 }
 
 void config_set_default_uint(config_t *config, const char *section,
@@ -513,14 +912,14 @@ void config_set_default_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_default_item(config, section, name, str.array);
 }
 
 void config_set_default_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->defaults, section, name, str);
+	config_set_default_item(config, section, name, str);
 }
 
 void config_set_default_double(config_t *config, const char *section,
@@ -529,16 +928,17 @@ void config_set_default_double(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%g", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_default_item(config, section, name, str.array);
 }
 
 const char *config_get_string(const config_t *config, const char *section,
 		const char *name)
 {
 	const struct config_item *item = config_find_item(&config->sections,
-			section, name);
+			&config->sections_index, section, name);
 	if (!item)
-		item = config_find_item(&config->defaults, section, name);
+		item = config_find_item(&config->defaults,
+				&config->defaults_index, section, name);
 	if (!item)
 		return NULL;
 
@@ -613,7 +1013,8 @@ const char *config_get_default_string(const config_t *config,
 {
 	const struct config_item *item;
 
-	item = config_find_item(&config->defaults, section, name);
+	item = config_find_item(&config->defaults,
+			&config->defaults_index, section, name);
 	if (!item)
 		return NULL;
 
@@ -664,12 +1065,14 @@ double config_get_default_double(const config_t *config, const char *section,
 bool config_has_user_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->sections, section, name) != NULL;
+	return config_find_item(&config->sections,
+			&config->sections_index, section, name) != NULL;
 }
 
 bool config_has_default_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->defaults, section, name) != NULL;
+	return config_find_item(&config->defaults,
+			&config->defaults_index, section, name) != NULL;
 }
 
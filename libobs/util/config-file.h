@@ -46,6 +46,14 @@ EXPORT int config_open(config_t **config, const char *file,
 		enum config_open_type open_type);
 EXPORT int config_open_string(config_t **config, const char *str);
 EXPORT int config_save(config_t *config);
+
+/*
+ * Saves in the background: the values are captured now, but the file is only
+ * written once no further save has been requested for a moment, so a burst of
+ * changes results in a single write.  Does nothing if no value changed since
+ * the last save.  Pending saves are written by config_close.
+ */
+EXPORT int config_save_deferred(config_t *config);
 EXPORT void config_close(config_t *config);
 
 EXPORT size_t config_num_sections(config_t *config);
@@ -17,6 +17,8 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <dlfcn.h>
@@ -182,6 +184,15 @@ bool os_file_exists(const char *path)
 	return access(path, F_OK) == 0;
 }
 
+int64_t os_get_file_mtime(const char *path)
+{
+	struct stat stat_info;
+	if (stat(path, &stat_info) != 0)
+		return -1;
+
+	return (int64_t)stat_info.st_mtime;
+}
+
 struct os_dir {
 	const char       *path;
 	DIR              *dir;
@@ -295,6 +306,11 @@ int os_unlink(const char *path)
 	return unlink(path);
 }
 
+int os_rename(const char *old_path, const char *new_path)
+{
+	return rename(old_path, new_path);
+}
+
 int os_mkdir(const char *path)
 {
 	if (mkdir(path, 0777) == 0)
@@ -303,6 +319,38 @@ int os_mkdir(const char *path)
 	return (errno == EEXIST) ? MKDIR_EXISTS : MKDIR_ERROR;
 }
 
+const void *os_map_file(const char *path, size_t *size)
+{
+	struct stat stat_info;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &stat_info) != 0 || stat_info.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)stat_info.st_size, PROT_READ, MAP_SHARED,
+			fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t)stat_info.st_size;
+	return data;
+}
+
+void os_unmap_file(const void *data, size_t size)
+{
+	if (data)
+		munmap((void*)data, size);
+}
+
 #if !defined(__APPLE__)
 os_performance_token_t *os_request_high_performance(const char *reason)
 {
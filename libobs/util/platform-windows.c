@@ -242,6 +242,31 @@ bool os_file_exists(const char *path)
 	return hFind != INVALID_HANDLE_VALUE;
 }
 
+/* FILETIME counts 100ns intervals since 1601 */
+#define FILETIME_UNIX_EPOCH 116444736000000000LL
+
+int64_t os_get_file_mtime(const char *path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attribs;
+	wchar_t *path_utf16;
+	ULARGE_INTEGER time;
+	BOOL success;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &path_utf16))
+		return -1;
+
+	success = GetFileAttributesExW(path_utf16, GetFileExInfoStandard,
+			&attribs);
+	bfree(path_utf16);
+
+	if (!success)
+		return -1;
+
+	time.LowPart  = attribs.ftLastWriteTime.dwLowDateTime;
+	time.HighPart = attribs.ftLastWriteTime.dwHighDateTime;
+	return ((int64_t)time.QuadPart - FILETIME_UNIX_EPOCH) / 10000000;
+}
+
 struct os_dir {
 	HANDLE           handle;
 	WIN32_FIND_DATA  wfd;
@@ -395,6 +420,70 @@ int os_unlink(const char *path)
 	return success ? 0 : -1;
 }
 
+int os_rename(const char *old_path, const char *new_path)
+{
+	wchar_t *old_path_utf16 = NULL;
+	wchar_t *new_path_utf16 = NULL;
+	bool success = false;
+
+	os_utf8_to_wcs_ptr(old_path, 0, &old_path_utf16);
+	os_utf8_to_wcs_ptr(new_path, 0, &new_path_utf16);
+
+	if (old_path_utf16 && new_path_utf16)
+		success = !!MoveFileExW(old_path_utf16, new_path_utf16,
+				MOVEFILE_REPLACE_EXISTING);
+
+	bfree(old_path_utf16);
+	bfree(new_path_utf16);
+
+	return success ? 0 : -1;
+}
+
+const void *os_map_file(const char *path, size_t *size)
+{
+	LARGE_INTEGER file_size;
+	wchar_t *path_utf16;
+	HANDLE file;
+	HANDLE mapping = NULL;
+	const void *data = NULL;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &path_utf16))
+		return NULL;
+
+	file = CreateFileW(path_utf16, GENERIC_READ, FILE_SHARE_READ |
+			FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	bfree(path_utf16);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+		goto exit;
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		goto exit;
+
+	/* the view keeps the mapping alive */
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data)
+		*size = (size_t)file_size.QuadPart;
+
+exit:
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+	return data;
+}
+
+void os_unmap_file(const void *data, size_t size)
+{
+	if (data)
+		UnmapViewOfFile(data);
+
+	UNUSED_PARAMETER(size);
+}
+
 int os_mkdir(const char *path)
 {
 	wchar_t *path_utf16;
@@ -236,6 +236,42 @@ bool os_quick_write_utf8_file(const char *path, const char *str, size_t len,
 	return true;
 }
 
+bool os_quick_write_utf8_file_safe(const char *path, const char *str,
+		size_t len, bool marker, const char *temp_ext)
+{
+	struct dstr temp_path = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!temp_ext || !*temp_ext)
+		return false;
+
+	dstr_copy(&temp_path, path);
+	if (*temp_ext != '.')
+		dstr_cat(&temp_path, ".");
+	dstr_cat(&temp_path, temp_ext);
+
+	f = os_fopen(temp_path.array, "wb");
+	if (!f)
+		goto cleanup;
+
+	success = true;
+	if (marker)
+		success = fwrite("\xEF\xBB\xBF", 1, 3, f) == 3;
+	if (len && success)
+		success = fwrite(str, 1, len, f) == len;
+	success = fclose(f) == 0 && success;
+
+	if (success)
+		success = os_rename(temp_path.array, path) == 0;
+	if (!success)
+		os_unlink(temp_path.array);
+
+cleanup:
+	dstr_free(&temp_path);
+	return success;
+}
+
 size_t os_mbs_to_wcs(const char *str, size_t len, wchar_t *dst, size_t dst_size)
 {
 	size_t out_len;
@@ -44,6 +44,9 @@ EXPORT size_t os_fread_utf8(FILE *file, char **pstr);
 EXPORT char *os_quick_read_utf8_file(const char *path);
 EXPORT bool os_quick_write_utf8_file(const char *path, const char *str,
 		size_t len, bool marker);
+/** Writes to path + temp_ext first and then replaces the file with it */
+EXPORT bool os_quick_write_utf8_file_safe(const char *path, const char *str,
+		size_t len, bool marker, const char *temp_ext);
 EXPORT char *os_quick_read_mbs_file(const char *path);
 EXPORT bool os_quick_write_mbs_file(const char *path, const char *str,
 		size_t len);
@@ -98,6 +101,10 @@ EXPORT char *os_get_config_path_ptr(const char *name);
 
 EXPORT bool os_file_exists(const char *path);
 
+/** Returns the last modification time of a file in seconds since the
+ * epoch, or -1 if the file could not be queried. */
+EXPORT int64_t os_get_file_mtime(const char *path);
+
 struct os_dir;
 typedef struct os_dir os_dir_t;
 
@@ -128,6 +135,7 @@ EXPORT int os_glob(const char *pattern, int flags, os_glob_t **pglob);
 EXPORT void os_globfree(os_glob_t *pglob);
 
 EXPORT int os_unlink(const char *path);
+EXPORT int os_rename(const char *old_path, const char *new_path);
 
 #define MKDIR_EXISTS   1
 #define MKDIR_SUCCESS  0
@@ -135,6 +143,10 @@ EXPORT int os_unlink(const char *path);
 
 EXPORT int os_mkdir(const char *path);
 
+/** Maps a whole file read-only into memory, returns NULL on failure */
+EXPORT const void *os_map_file(const char *path, size_t *size);
+EXPORT void os_unmap_file(const void *data, size_t size);
+
 #ifdef _MSC_VER
 #define strtoll _strtoi64
 #if _MSC_VER < 1900
@@ -14,11 +14,16 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "darray.h"
 #include "dstr.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
 
+#define TABLE_VERSION      1
+#define TABLE_EXTENSION    ".lookup"
+#define MAX_DISPLACEMENT   (1 << 16)
+
 /* ------------------------------------------------------------------------- */
 
 struct text_leaf {
@@ -97,11 +102,78 @@ static struct text_node *text_node_byname(struct text_node *node,
 
 /* ------------------------------------------------------------------------- */
 
+/*
+ * Compiled string table, as stored in the cache directory:
+ *
+ *   struct table_header header;
+ *   uint32_t            displacements[buckets];
+ *   struct table_entry  entries[count];
+ *   char                pool[pool_size];
+ *
+ * Keys are placed with a minimal perfect hash (hash and displace): the
+ * unseeded hash of a key selects a bucket, and the bucket's displacement is
+ * the seed that gives the key's entry.  Offsets are relative to the pool.
+ */
+struct table_header {
+	char     magic[4];
+	uint32_t version;
+	int64_t  mtime;
+	uint32_t count;
+	uint32_t buckets;
+	uint32_t pool_size;
+	uint32_t source;
+};
+
+struct table_entry {
+	uint32_t key;
+	uint32_t value;
+};
+
+static const char table_magic[4] = {'O', 'B', 'S', 'L'};
+
+/* case-insensitive, like the lookups */
+static inline uint32_t table_hash(const char *str, uint32_t seed)
+{
+	uint32_t hash = 2166136261U ^ (seed * 0x9E3779B9U);
+
+	while (*str) {
+		char ch = *(str++);
+		if (ch >= 'A' && ch <= 'Z')
+			ch += 0x20;
+
+		hash ^= (uint8_t)ch;
+		hash *= 16777619U;
+	}
+
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6DU;
+	hash ^= hash >> 12;
+	return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* each added file is a layer; later layers override earlier ones */
+struct lookup_layer {
+	/* parsed text */
+	struct text_node           *top;
+
+	/* mapped compiled table */
+	const void                 *map;
+	size_t                     map_size;
+	const struct table_header  *header;
+	const uint32_t             *displacements;
+	const struct table_entry   *entries;
+	const char                 *pool;
+};
+
 struct text_lookup {
 	struct dstr language;
-	struct text_node *top;
+	DARRAY(struct lookup_layer) layers;
 };
 
+static char cache_dir[512];
+
 static void lookup_createsubnode(const char *lookup_val,
 		struct text_leaf *leaf, struct text_node *node)
 {
@@ -291,8 +363,7 @@ static char *convert_string(const char *str, size_t len)
 	return out.array;
 }
 
-static void lookup_addfiledata(struct text_lookup *lookup,
-		const char *file_data)
+static void lookup_addfiledata(struct text_node *top, const char *file_data)
 {
 	struct lexer lex;
 	struct strref name, value;
@@ -322,7 +393,7 @@ getval:
 		leaf->lookup = bstrdup_n(name.array,  name.len);
 		leaf->value  = convert_string(value.array, value.len);
 
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		lookup_addstring(leaf->lookup, leaf, top);
 
 		if (!lookup_goto_nextline(&lex))
 			break;
@@ -358,21 +429,8 @@ static inline bool lookup_getstring(const char *lookup_val,
 
 /* ------------------------------------------------------------------------- */
 
-lookup_t *text_lookup_create(const char *path)
-{
-	struct text_lookup *lookup = bzalloc(sizeof(struct text_lookup));
-
-	if (!text_lookup_add(lookup, path)) {
-		bfree(lookup);
-		lookup = NULL;
-	}
-
-	return lookup;
-}
-
-bool text_lookup_add(lookup_t *lookup, const char *path)
+static bool read_lookup_file(const char *path, struct dstr *file_str)
 {
-	struct dstr file_str;
 	char *temp = NULL;
 	FILE *file;
 
@@ -381,28 +439,421 @@ bool text_lookup_add(lookup_t *lookup, const char *path)
 		return false;
 
 	os_fread_utf8(file, &temp);
-	dstr_init_move_array(&file_str, temp);
+	dstr_init_move_array(file_str, temp);
 	fclose(file);
 
-	if (!file_str.array)
+	if (!file_str->array)
 		return false;
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
+	dstr_replace(file_str, "\r", " ");
+	return true;
+}
+
+static bool add_text_layer(struct text_lookup *lookup, const char *path)
+{
+	struct lookup_layer *layer = NULL;
+	struct dstr file_str;
+
+	if (!read_lookup_file(path, &file_str))
+		return false;
+
+	/* consecutive text files share a tree */
+	if (lookup->layers.num)
+		layer = da_end(lookup->layers);
+
+	if (!layer || !layer->top) {
+		layer = da_push_back_new(lookup->layers);
+		layer->top = bzalloc(sizeof(struct text_node));
+	}
 
-	dstr_replace(&file_str, "\r", " ");
-	lookup_addfiledata(lookup, file_str.array);
+	lookup_addfiledata(layer->top, file_str.array);
 	dstr_free(&file_str);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void get_table_path(struct dstr *table_path, const char *path)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	char     name[32];
+
+	for (const char *ch = path; *ch; ch++) {
+		hash ^= (uint8_t)*ch;
+		hash *= 1099511628211ULL;
+	}
+
+	snprintf(name, sizeof(name), "/%016llx", (unsigned long long)hash);
+
+	dstr_copy(table_path, cache_dir);
+	dstr_cat(table_path, name);
+	dstr_cat(table_path, TABLE_EXTENSION);
+}
+
+static inline bool offset_valid(const struct table_header *header,
+		uint32_t offset)
+{
+	return offset < header->pool_size;
+}
+
+static bool map_table(struct lookup_layer *layer, const char *table_path,
+		const char *path, int64_t mtime)
+{
+	const struct table_header *header;
+	const uint8_t *data;
+	size_t size = 0;
+	size_t expected;
+
+	data = os_map_file(table_path, &size);
+	if (!data)
+		return false;
+
+	header = (const struct table_header*)data;
+	if (size < sizeof(*header) ||
+	    memcmp(header->magic, table_magic, sizeof(table_magic)) != 0 ||
+	    header->version != TABLE_VERSION ||
+	    header->mtime   != mtime ||
+	    header->buckets == 0)
+		goto fail;
+
+	expected = sizeof(*header) +
+		sizeof(uint32_t) * (size_t)header->buckets +
+		sizeof(struct table_entry) * (size_t)header->count +
+		(size_t)header->pool_size;
+
+	if (size != expected || !header->pool_size ||
+	    !offset_valid(header, header->source))
+		goto fail;
+
+	layer->map           = data;
+	layer->map_size      = size;
+	layer->header        = header;
+	layer->displacements = (const uint32_t*)(header + 1);
+	layer->entries       = (const struct table_entry*)
+		(layer->displacements + header->buckets);
+	layer->pool          = (const char*)(layer->entries + header->count);
+
+	/* the pool must be terminated for the string compares to be safe */
+	if (layer->pool[header->pool_size - 1] != 0 ||
+	    strcmp(layer->pool + header->source, path) != 0)
+		goto fail;
+
+	for (uint32_t i = 0; i < header->count; i++) {
+		if (!offset_valid(header, layer->entries[i].key) ||
+		    !offset_valid(header, layer->entries[i].value))
+			goto fail;
+	}
 
 	return true;
+
+fail:
+	os_unmap_file(data, size);
+	memset(layer, 0, sizeof(*layer));
+	return false;
+}
+
+static void collect_leaves(struct text_node *node, struct darray *leaves)
+{
+	for (; node; node = node->next) {
+		if (node->leaf)
+			darray_push_back(sizeof(struct text_leaf*), leaves,
+					&node->leaf);
+
+		collect_leaves(node->first_subnode, leaves);
+	}
+}
+
+struct bucket_size {
+	uint32_t bucket;
+	uint32_t size;
+};
+
+static int cmp_bucket_size(const void *a, const void *b)
+{
+	const struct bucket_size *bs_a = a;
+	const struct bucket_size *bs_b = b;
+
+	if (bs_a->size != bs_b->size)
+		return (bs_a->size > bs_b->size) ? -1 : 1;
+	return (bs_a->bucket < bs_b->bucket) ? -1 : 1;
+}
+
+/*
+ * Finds the displacement of each bucket, largest buckets first.  'slots'
+ * receives the leaf index of each entry.
+ */
+static bool build_perfect_hash(struct text_leaf **leaves, uint32_t count,
+		uint32_t *displacements, uint32_t *slots)
+{
+	struct bucket_size *sizes = bzalloc(sizeof(*sizes) * count);
+	uint32_t *first    = bzalloc(sizeof(uint32_t) * (count + 1));
+	uint32_t *order    = bmalloc(sizeof(uint32_t) * count);
+	uint32_t *tried    = bzalloc(sizeof(uint32_t) * count);
+	uint32_t *hashes   = bmalloc(sizeof(uint32_t) * count);
+	uint32_t attempt   = 0;
+	bool     success   = true;
+
+	/* group the keys by bucket */
+	for (uint32_t i = 0; i < count; i++) {
+		hashes[i] = table_hash(leaves[i]->lookup, 0) % count;
+		first[hashes[i] + 1]++;
+		sizes[i].bucket = i;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		sizes[i].size = first[i + 1];
+		first[i + 1] += first[i];
+	}
+	memset(tried, 0, sizeof(uint32_t) * count);
+	for (uint32_t i = 0; i < count; i++)
+		order[first[hashes[i]] + tried[hashes[i]]++] = i;
+
+	qsort(sizes, count, sizeof(*sizes), cmp_bucket_size);
+
+	memset(tried, 0, sizeof(uint32_t) * count);
+	for (uint32_t i = 0; i < count; i++)
+		slots[i] = UINT32_MAX;
+
+	for (uint32_t i = 0; i < count && sizes[i].size; i++) {
+		const uint32_t *keys = order + first[sizes[i].bucket];
+		uint32_t num = sizes[i].size;
+		uint32_t d;
+
+		for (d = 1; d < MAX_DISPLACEMENT; d++) {
+			uint32_t k;
+
+			attempt++;
+			/* 'tried' marks the slots this attempt would take */
+			for (k = 0; k < num; k++) {
+				uint32_t slot = table_hash(
+						leaves[keys[k]]->lookup, d) %
+					count;
+
+				if (slots[slot] != UINT32_MAX ||
+				    tried[slot] == attempt)
+					break;
+
+				tried[slot] = attempt;
+				hashes[keys[k]] = slot;
+			}
+
+			if (k == num)
+				break;
+		}
+
+		if (d == MAX_DISPLACEMENT) {
+			success = false;
+			break;
+		}
+
+		displacements[sizes[i].bucket] = d;
+		for (uint32_t k = 0; k < num; k++)
+			slots[hashes[keys[k]]] = keys[k];
+	}
+
+	bfree(sizes);
+	bfree(first);
+	bfree(order);
+	bfree(tried);
+	bfree(hashes);
+	return success;
+}
+
+static inline uint32_t add_pool_string(struct darray *pool, const char *str)
+{
+	uint32_t offset = (uint32_t)pool->num;
+	darray_push_back_array(1, pool, str, strlen(str) + 1);
+	return offset;
+}
+
+static bool write_table(const char *table_path, const char *path,
+		int64_t mtime, struct text_leaf **leaves, uint32_t count,
+		const uint32_t *displacements, const uint32_t *slots)
+{
+	struct table_header header = {{0}};
+	struct table_entry  *entries;
+	DARRAY(char)        pool;
+	struct dstr         temp_path = {0};
+	FILE                *file;
+	bool                success = false;
+
+	da_init(pool);
+	entries = bzalloc(sizeof(struct table_entry) * (count ? count : 1));
+
+	header.source = add_pool_string(&pool.da, path);
+	for (uint32_t i = 0; i < count; i++) {
+		struct text_leaf *leaf = leaves[slots[i]];
+		entries[i].key   = add_pool_string(&pool.da, leaf->lookup);
+		entries[i].value = add_pool_string(&pool.da, leaf->value);
+	}
+
+	memcpy(header.magic, table_magic, sizeof(table_magic));
+	header.version   = TABLE_VERSION;
+	header.mtime     = mtime;
+	header.count     = count;
+	header.buckets   = count ? count : 1;
+	header.pool_size = (uint32_t)pool.num;
+
+	/* written to a temporary file first so readers never map a partial
+	 * table */
+	dstr_printf(&temp_path, "%s.%llu.tmp", table_path,
+			(unsigned long long)os_gettime_ns());
+
+	file = os_fopen(temp_path.array, "wb");
+	if (!file)
+		goto exit;
+
+	success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(displacements, sizeof(uint32_t), header.buckets,
+				file) == header.buckets &&
+		(!count || fwrite(entries, sizeof(struct table_entry), count,
+				file) == count) &&
+		fwrite(pool.array, 1, pool.num, file) == pool.num;
+
+	success = (fclose(file) == 0) && success;
+	if (success)
+		success = os_rename(temp_path.array, table_path) == 0;
+	if (!success)
+		os_unlink(temp_path.array);
+
+exit:
+	dstr_free(&temp_path);
+	bfree(entries);
+	da_free(pool);
+	return success;
+}
+
+static bool compile_table(const char *table_path, const char *path,
+		int64_t mtime)
+{
+	struct text_node *top = bzalloc(sizeof(struct text_node));
+	DARRAY(struct text_leaf*) leaves;
+	struct dstr file_str;
+	uint32_t *displacements = NULL;
+	uint32_t *slots = NULL;
+	uint32_t count;
+	bool success = false;
+
+	da_init(leaves);
+
+	if (!read_lookup_file(path, &file_str))
+		goto exit;
+
+	lookup_addfiledata(top, file_str.array);
+	dstr_free(&file_str);
+
+	collect_leaves(top, &leaves.da);
+	count = (uint32_t)leaves.num;
+
+	displacements = bzalloc(sizeof(uint32_t) * (count ? count : 1));
+	slots         = bzalloc(sizeof(uint32_t) * (count ? count : 1));
+
+	if (count && !build_perfect_hash(leaves.array, count, displacements,
+				slots))
+		goto exit;
+
+	success = write_table(table_path, path, mtime, leaves.array, count,
+			displacements, slots);
+
+exit:
+	bfree(displacements);
+	bfree(slots);
+	da_free(leaves);
+	text_node_destroy(top);
+	return success;
+}
+
+static bool add_compiled_layer(struct text_lookup *lookup, const char *path)
+{
+	struct lookup_layer layer = {0};
+	struct dstr table_path = {0};
+	int64_t mtime = os_get_file_mtime(path);
+	bool success = false;
+
+	if (mtime < 0)
+		return false;
+
+	get_table_path(&table_path, path);
+
+	/* regenerated whenever the text file changes */
+	if (!map_table(&layer, table_path.array, path, mtime)) {
+		if (!compile_table(table_path.array, path, mtime))
+			goto exit;
+		if (!map_table(&layer, table_path.array, path, mtime))
+			goto exit;
+	}
+
+	da_push_back(lookup->layers, &layer);
+	success = true;
+
+exit:
+	dstr_free(&table_path);
+	return success;
+}
+
+static bool table_getstring(const struct lookup_layer *layer,
+		const char *lookup_val, const char **out)
+{
+	const struct table_header *header = layer->header;
+	const struct table_entry *entry;
+	uint32_t bucket;
+
+	if (!header->count)
+		return false;
+
+	bucket = table_hash(lookup_val, 0) % header->buckets;
+	entry  = layer->entries + table_hash(lookup_val,
+			layer->displacements[bucket]) % header->count;
+
+	if (astrcmpi(layer->pool + entry->key, lookup_val) != 0)
+		return false;
+
+	*out = layer->pool + entry->value;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void text_lookup_set_cache_dir(const char *dir)
+{
+	if (dir && strlen(dir) < sizeof(cache_dir))
+		strcpy(cache_dir, dir);
+	else
+		cache_dir[0] = 0;
+}
+
+lookup_t *text_lookup_create(const char *path)
+{
+	struct text_lookup *lookup = bzalloc(sizeof(struct text_lookup));
+
+	if (!text_lookup_add(lookup, path)) {
+		bfree(lookup);
+		lookup = NULL;
+	}
+
+	return lookup;
+}
+
+bool text_lookup_add(lookup_t *lookup, const char *path)
+{
+	if (cache_dir[0] && add_compiled_layer(lookup, path))
+		return true;
+
+	return add_text_layer(lookup, path);
 }
 
 void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
 		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
 
+		for (size_t i = 0; i < lookup->layers.num; i++) {
+			struct lookup_layer *layer = lookup->layers.array + i;
+
+			text_node_destroy(layer->top);
+			os_unmap_file(layer->map, layer->map_size);
+		}
+
+		da_free(lookup->layers);
 		bfree(lookup);
 	}
 }
@@ -410,7 +861,18 @@ void text_lookup_destroy(lookup_t *lookup)
 bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 		const char **out)
 {
-	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
+	if (!lookup)
+		return false;
+
+	for (size_t i = lookup->layers.num; i > 0; i--) {
+		struct lookup_layer *layer = lookup->layers.array + (i - 1);
+		bool found = layer->top ?
+			lookup_getstring(lookup_val, out, layer->top) :
+			table_getstring(layer, lookup_val, out);
+
+		if (found)
+			return true;
+	}
+
 	return false;
 }
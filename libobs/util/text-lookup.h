@@ -20,8 +20,9 @@
  * Text Lookup interface
  *
  *   Used for storing and looking up localized strings.  Stores locazation
- * strings in a radix/trie tree to efficiently look up associated strings via a
- * unique string identifier name.
+ * strings in a radix/trie tree, or in memory mapped perfect hash tables
+ * compiled from the text files, to efficiently look up associated strings
+ * via a unique string identifier name.
  */
 
 #include "c99defs.h"
@@ -35,6 +36,15 @@ struct text_lookup;
 typedef struct text_lookup lookup_t;
 
 /* functions */
+
+/*
+ * Sets the directory used to cache compiled string tables.  Each text file
+ * is compiled to a hashed table once (and again whenever its modification
+ * time changes), and the table is memory mapped instead of parsing the text
+ * file.  Without a cache directory, text files are always parsed.
+ */
+EXPORT void text_lookup_set_cache_dir(const char *dir);
+
 EXPORT lookup_t *text_lookup_create(const char *path);
 EXPORT bool text_lookup_add(lookup_t *lookup, const char *path);
 EXPORT void text_lookup_destroy(lookup_t *lookup);
@@ -261,6 +261,26 @@ bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
 	return __sync_bool_compare_and_swap(val, old_val, new_val);
 }
 
+long os_atomic_load_long(const volatile long *val)
+{
+	return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	__atomic_store_n(val, new_val, __ATOMIC_SEQ_CST);
+}
+
+void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
 void os_set_thread_name(const char *name)
 {
 #if defined(__APPLE__)
@@ -181,6 +181,27 @@ bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
 	return InterlockedCompareExchange(val, new_val, old_val) == old_val;
 }
 
+long os_atomic_load_long(const volatile long *val)
+{
+	return InterlockedOr((volatile long*)val, 0);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	InterlockedExchange(val, new_val);
+}
+
+void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return InterlockedCompareExchangePointer((void *volatile*)ptr,
+			NULL, NULL);
+}
+
+void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return InterlockedExchangePointer(ptr, val);
+}
+
 #define VC_EXCEPTION 0x406D1388
 
 #pragma pack(push,8)
@@ -76,6 +76,12 @@ EXPORT long os_atomic_dec_long(volatile long *val);
 EXPORT bool os_atomic_compare_swap_long(volatile long *val,
 		long old_val, long new_val);
 
+/* full barrier loads/stores, for lock-free readers of shared data */
+EXPORT long os_atomic_load_long(const volatile long *val);
+EXPORT void os_atomic_set_long(volatile long *val, long new_val);
+EXPORT void *os_atomic_load_ptr(void *const volatile *ptr);
+EXPORT void *os_atomic_exchange_ptr(void *volatile *ptr, void *val);
+
 EXPORT void os_set_thread_name(const char *name);
 
 
@@ -255,6 +255,17 @@ static bool MakeUserDirs()
 	if (!do_mkdir(path))
 		return false;
 
+	if (os_get_config_path(path, sizeof(path), "obs-studio/cache") <= 0)
+		return false;
+	if (!do_mkdir(path))
+		return false;
+
+	if (os_get_config_path(path, sizeof(path),
+				"obs-studio/cache/locale") <= 0)
+		return false;
+	if (!do_mkdir(path))
+		return false;
+
 #ifdef _WIN32
 	if (os_get_config_path(path, sizeof(path), "obs-studio/crashes") <= 0)
 		return false;
@@ -291,6 +302,11 @@ bool OBSApp::InitLocale()
 
 	locale = lang;
 
+	char cachePath[512];
+	if (os_get_config_path(cachePath, sizeof(cachePath),
+				"obs-studio/cache/locale") > 0)
+		text_lookup_set_cache_dir(cachePath);
+
 	string englishPath;
 	if (!GetDataFilePath("locale/" DEFAULT_LANG ".ini", englishPath)) {
 		OBSErrorBox(NULL, "Failed to find locale/" DEFAULT_LANG ".ini");
@@ -76,6 +76,16 @@ static void AddExtraModulePaths()
 	obs_add_module_path((path + "/bin").c_str(), (path + "/data").c_str());
 }
 
+static void SetModuleManifestPath()
+{
+	char path[512];
+	int ret = os_get_config_path(path, sizeof(path),
+			"obs-studio/cache/module-manifest.json");
+
+	if (ret > 0)
+		obs_set_module_manifest_path(path);
+}
+
 static QList<QKeySequence> DeleteKeys;
 
 OBSBasic::OBSBasic(QWidget *parent)
@@ -203,7 +213,6 @@ static void SaveAudioDevice(const char *name, int channel, obs_data_t *parent)
 static obs_data_t *GenerateSaveData()
 {
 	obs_data_t       *saveData     = obs_data_create();
-	obs_data_array_t *sourcesArray = obs_save_sources();
 	obs_source_t     *currentScene = obs_get_output_source(0);
 	const char       *sceneName   = obs_source_get_name(currentScene);
 
@@ -214,13 +223,47 @@ static obs_data_t *GenerateSaveData()
 	SaveAudioDevice(AUX_AUDIO_3,     5, saveData);
 
 	obs_data_set_string(saveData, "current_scene", sceneName);
-	obs_data_set_array(saveData, "sources", sourcesArray);
-	obs_data_array_release(sourcesArray);
 	obs_source_release(currentScene);
 
 	return saveData;
 }
 
+/* The source array comes from libobs as JSON text (which only re-serializes
+ * sources that changed), so it is spliced into the top level object rather
+ * than added to the save data. */
+static string GenerateSaveJson()
+{
+	obs_data_t *saveData = GenerateSaveData();
+	const char *jsonData = obs_data_get_json(saveData);
+	char       *sources  = obs_save_sources_json();
+	string     json      = jsonData ? jsonData : "{}";
+
+	size_t end = json.rfind('}');
+	if (sources && end != string::npos) {
+		json.erase(end);
+		while (!json.empty() && isspace((unsigned char)json.back()))
+			json.pop_back();
+
+		if (json.back() != '{')
+			json += ",";
+		json += "\n    \"sources\": ";
+		json += sources;
+		json += "\n}";
+	}
+
+	bfree(sources);
+	obs_data_release(saveData);
+	return json;
+}
+
+static void WriteSaveFile(string file, string json)
+{
+	if (!os_quick_write_utf8_file_safe(file.c_str(), json.c_str(),
+				json.size(), false, "tmp"))
+		blog(LOG_ERROR, "Could not save scene data to %s",
+				file.c_str());
+}
+
 void OBSBasic::copyActionsDynamicProperties()
 {
 	// Themes need the QAction dynamic properties
@@ -255,19 +298,13 @@ void OBSBasic::ClearVolumeControls()
 
 void OBSBasic::Save(const char *file)
 {
-	obs_data_t *saveData  = GenerateSaveData();
-	const char *jsonData = obs_data_get_json(saveData);
+	string json = GenerateSaveJson();
 
-	if (!!jsonData) {
-		/* TODO: maybe a message box here? */
-		bool success = os_quick_write_utf8_file(file, jsonData,
-				strlen(jsonData), false);
-		if (!success)
-			blog(LOG_ERROR, "Could not save scene data to %s",
-					file);
-	}
+	/* writes happen in order, one at a time */
+	if (saveThread.joinable())
+		saveThread.join();
 
-	obs_data_release(saveData);
+	saveThread = std::thread(WriteSaveFile, string(file), move(json));
 }
 
 static void LoadAudioDevice(const char *name, int channel, obs_data_t *parent)
@@ -527,6 +564,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "709");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 			"Partial");
+	config_set_default_bool  (basicConfig, "Video", "MultiRendition",
+			false);
 
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
@@ -638,6 +677,11 @@ void OBSBasic::OBSInit()
 	if (!ResetAudio())
 		throw "Failed to initialize audio";
 
+	char cachePath[512];
+	if (os_get_config_path(cachePath, sizeof(cachePath),
+				"obs-studio/cache") > 0)
+		gs_set_cache_path(cachePath);
+
 	ret = ResetVideo();
 
 	switch (ret) {
@@ -658,6 +702,7 @@ void OBSBasic::OBSInit()
 	InitHotkeys();
 
 	AddExtraModulePaths();
+	SetModuleManifestPath();
 	obs_load_all_modules();
 
 	ResetOutputs();
@@ -825,6 +870,9 @@ OBSBasic::~OBSBasic()
 {
 	bool previewEnabled = obs_preview_enabled();
 
+	if (saveThread.joinable())
+		saveThread.join();
+
 	/* XXX: any obs data must be released before calling obs_shutdown.
 	 * currently, we can't automate this with C++ RAII because of the
 	 * delicate nature of obs_shutdown needing to be freed before the UI
@@ -1737,9 +1785,16 @@ int OBSBasic::ResetVideo()
 		}
 	}
 
-	if (ret == OBS_VIDEO_SUCCESS)
+	if (ret == OBS_VIDEO_SUCCESS) {
 		obs_add_draw_callback(OBSBasic::RenderMain, this);
 
+		/* scale outputs below the output resolution from a shared
+		 * downscale pyramid */
+		if (config_get_bool(basicConfig, "Video", "MultiRendition"))
+			video_output_set_multi_rendition(obs_get_video(),
+					true);
+	}
+
 	return ret;
 }
 
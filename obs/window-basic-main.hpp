@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <thread>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -69,6 +70,7 @@ private:
 	bool loaded = false;
 
 	QPointer<QTimer> saveTimer;
+	std::thread saveThread;
 
 	QPointer<QThread> updateCheckThread;
 	QPointer<QThread> logUploadThread;
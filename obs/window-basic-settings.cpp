@@ -2084,8 +2084,8 @@ void OBSBasicSettings::SaveSettings()
 	if (videoChanged || advancedChanged)
 		main->ResetVideo();
 
-	config_save(main->Config());
-	config_save(GetGlobalConfig());
+	config_save_deferred(main->Config());
+	config_save_deferred(GetGlobalConfig());
 }
 
 bool OBSBasicSettings::QueryChanges()
@@ -0,0 +1,247 @@
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "image-cache.h"
+
+#define LOADER_THREADS 2
+
+struct cached_image {
+	char          *file;
+	int64_t       mtime;
+	long          refs;
+
+	/* only accessed inside the graphics context once queued */
+	gs_texture_t  *tex;
+	uint32_t      cx;
+	uint32_t      cy;
+};
+
+struct image_cache {
+	pthread_mutex_t               mutex;
+	DARRAY(struct cached_image*)  images;
+	DARRAY(struct cached_image*)  queue;
+
+	os_sem_t                      *queue_sem;
+	pthread_t                     threads[LOADER_THREADS];
+	size_t                        num_threads;
+	bool                          exiting;
+};
+
+static struct image_cache cache;
+
+static void cached_image_destroy(struct cached_image *image)
+{
+	if (image->tex) {
+		obs_enter_graphics();
+		gs_texture_destroy(image->tex);
+		obs_leave_graphics();
+	}
+
+	bfree(image->file);
+	bfree(image);
+}
+
+/* call with the cache mutex locked */
+static struct cached_image *pop_queued_image(void)
+{
+	struct cached_image *image;
+
+	if (!cache.queue.num)
+		return NULL;
+
+	image = cache.queue.array[0];
+	da_erase(cache.queue, 0);
+
+	/* the loader holds its own reference while decoding */
+	image->refs++;
+	return image;
+}
+
+static void load_image(struct cached_image *image)
+{
+	enum gs_color_format format;
+	uint32_t             cx, cy;
+	uint8_t              *data;
+	uint64_t             start = os_gettime_ns();
+
+	data = gs_create_texture_file_data(image->file, &format, &cx, &cy);
+	if (!data) {
+		blog(LOG_WARNING, "[image_source] failed to load texture '%s'",
+				image->file);
+		return;
+	}
+
+	obs_enter_graphics();
+	image->tex = gs_texture_create(cx, cy, format, 1,
+			(const uint8_t**)&data, 0);
+	if (image->tex) {
+		image->cx = cx;
+		image->cy = cy;
+	}
+	obs_leave_graphics();
+
+	bfree(data);
+
+	blog(LOG_DEBUG, "[image_source] loaded '%s' (%ux%u) in %llu ms",
+			image->file, cx, cy,
+			(os_gettime_ns() - start) / 1000000ULL);
+}
+
+static void *image_loader_thread(void *unused)
+{
+	os_set_thread_name("image-source: loader thread");
+
+	while (os_sem_wait(cache.queue_sem) == 0) {
+		struct cached_image *image;
+
+		pthread_mutex_lock(&cache.mutex);
+		image = cache.exiting ? NULL : pop_queued_image();
+		pthread_mutex_unlock(&cache.mutex);
+
+		if (!image) {
+			if (cache.exiting)
+				break;
+			continue;
+		}
+
+		load_image(image);
+		image_cache_release(image);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+void image_cache_init(void)
+{
+	pthread_mutex_init_value(&cache.mutex);
+	if (pthread_mutex_init(&cache.mutex, NULL) != 0)
+		return;
+	if (os_sem_init(&cache.queue_sem, 0) != 0)
+		return;
+
+	for (size_t i = 0; i < LOADER_THREADS; i++) {
+		if (pthread_create(&cache.threads[cache.num_threads], NULL,
+					image_loader_thread, NULL) == 0)
+			cache.num_threads++;
+	}
+
+	if (!cache.num_threads)
+		blog(LOG_WARNING, "[image_source] failed to create loader "
+		                  "threads, images will load synchronously");
+}
+
+void image_cache_free(void)
+{
+	pthread_mutex_lock(&cache.mutex);
+	cache.exiting = true;
+	pthread_mutex_unlock(&cache.mutex);
+
+	for (size_t i = 0; i < cache.num_threads; i++)
+		os_sem_post(cache.queue_sem);
+	for (size_t i = 0; i < cache.num_threads; i++)
+		pthread_join(cache.threads[i], NULL);
+
+	/* all sources are destroyed by now, so nothing should be left */
+	for (size_t i = 0; i < cache.images.num; i++)
+		cached_image_destroy(cache.images.array[i]);
+
+	da_free(cache.images);
+	da_free(cache.queue);
+	os_sem_destroy(cache.queue_sem);
+	pthread_mutex_destroy(&cache.mutex);
+	memset(&cache, 0, sizeof(cache));
+}
+
+/* call with the cache mutex locked */
+static struct cached_image *find_image(const char *file, int64_t mtime)
+{
+	for (size_t i = 0; i < cache.images.num; i++) {
+		struct cached_image *image = cache.images.array[i];
+
+		if (strcmp(image->file, file) != 0)
+			continue;
+
+		if (image->mtime == mtime)
+			return image;
+
+		/* the file changed; existing users keep the old image, but
+		 * new users get a fresh load */
+		da_erase(cache.images, i);
+		return NULL;
+	}
+
+	return NULL;
+}
+
+struct cached_image *image_cache_acquire(const char *file)
+{
+	struct cached_image *image;
+	int64_t             mtime;
+	bool                threaded;
+
+	if (!file || !*file)
+		return NULL;
+
+	mtime = os_get_file_mtime(file);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	image = find_image(file, mtime);
+	if (image) {
+		image->refs++;
+		pthread_mutex_unlock(&cache.mutex);
+		return image;
+	}
+
+	image = bzalloc(sizeof(struct cached_image));
+	image->file  = bstrdup(file);
+	image->mtime = mtime;
+	image->refs  = 1;
+	da_push_back(cache.images, &image);
+
+	threaded = cache.num_threads != 0;
+	if (threaded)
+		da_push_back(cache.queue, &image);
+
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (threaded)
+		os_sem_post(cache.queue_sem);
+	else
+		load_image(image);
+
+	return image;
+}
+
+void image_cache_release(struct cached_image *image)
+{
+	bool destroy;
+
+	if (!image)
+		return;
+
+	pthread_mutex_lock(&cache.mutex);
+
+	destroy = --image->refs == 0;
+	if (destroy) {
+		da_erase_item(cache.images, &image);
+		da_erase_item(cache.queue, &image);
+	}
+
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (destroy)
+		cached_image_destroy(image);
+}
+
+gs_texture_t *cached_image_get_texture(const struct cached_image *image,
+		uint32_t *cx, uint32_t *cy)
+{
+	if (!image || !image->tex)
+		return NULL;
+
+	*cx = image->cx;
+	*cy = image->cy;
+	return image->tex;
+}
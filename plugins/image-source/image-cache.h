@@ -0,0 +1,31 @@
+#pragma once
+
+#include <obs-module.h>
+
+/*
+ * Process-wide cache of image textures shared between image sources.
+ *
+ *   Entries are keyed by file path and modification time and are reference
+ * counted.  Files are read and decoded on a small pool of loader threads;
+ * only the final texture upload happens inside the graphics context, so
+ * large images no longer stall rendering while they load.
+ */
+
+struct cached_image;
+
+extern void image_cache_init(void);
+extern void image_cache_free(void);
+
+/**
+ * Returns a new reference to the image for the file, queueing it to be
+ * loaded in the background if it is not already cached.
+ */
+extern struct cached_image *image_cache_acquire(const char *file);
+extern void image_cache_release(struct cached_image *image);
+
+/**
+ * Returns the texture of the image, or NULL if it is still loading or
+ * failed to load.  Must be called inside the graphics context.
+ */
+extern gs_texture_t *cached_image_get_texture(const struct cached_image *image,
+		uint32_t *cx, uint32_t *cy);
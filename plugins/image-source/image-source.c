@@ -1,4 +1,5 @@
 #include <obs-module.h>
+#include "image-cache.h"
 
 #define blog(log_level, format, ...) \
 	blog(log_level, "[image_source: '%s'] " format, \
@@ -17,7 +18,7 @@ struct image_source {
 	char         *file;
 	bool         persistent;
 
-	gs_texture_t *tex;
+	struct cached_image *image;
 	uint32_t     cx;
 	uint32_t     cy;
 };
@@ -27,42 +28,42 @@ static const char *image_source_get_name(void)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_load(struct image_source *context)
+static void image_source_set_image(struct image_source *context,
+		struct cached_image *image)
 {
-	char *file = context->file;
+	struct cached_image *old;
 
+	/* the image is used by the render callback, so only swap it inside
+	 * the graphics context */
 	obs_enter_graphics();
 
-	if (context->tex)
-		gs_texture_destroy(context->tex);
-	context->tex = NULL;
+	old            = context->image;
+	context->image = image;
+	context->cx    = 0;
+	context->cy    = 0;
+	cached_image_get_texture(image, &context->cx, &context->cy);
+
+	obs_leave_graphics();
+
+	image_cache_release(old);
+}
+
+static void image_source_load(struct image_source *context)
+{
+	char *file = context->file;
+	struct cached_image *image = NULL;
 
 	if (file && *file) {
 		debug("loading texture '%s'", file);
-
-		context->tex = gs_texture_create_from_file(file);
-		if (context->tex) {
-			context->cx = gs_texture_get_width(context->tex);
-			context->cy = gs_texture_get_height(context->tex);
-		} else {
-			warn("failed to load texture '%s'", file);
-			context->cx = 0;
-			context->cy = 0;
-		}
+		image = image_cache_acquire(file);
 	}
 
-	obs_leave_graphics();
+	image_source_set_image(context, image);
 }
 
 static void image_source_unload(struct image_source *context)
 {
-	obs_enter_graphics();
-
-	if (context->tex)
-		gs_texture_destroy(context->tex);
-	context->tex = NULL;
-
-	obs_leave_graphics();
+	image_source_set_image(context, NULL);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -139,14 +140,18 @@ static uint32_t image_source_getheight(void *data)
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *tex;
 
-	if (!context->tex)
+	/* images finish loading in the background */
+	tex = cached_image_get_texture(context->image,
+			&context->cx, &context->cy);
+	if (!tex)
 		return;
 
 	gs_reset_blend_state();
 	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			context->tex);
-	gs_draw_sprite(context->tex, 0, context->cx, context->cy);
+			tex);
+	gs_draw_sprite(tex, 0, context->cx, context->cy);
 }
 
 static const char *image_filter =
@@ -194,6 +199,12 @@ OBS_MODULE_USE_DEFAULT_LOCALE("image-source", "en-US")
 
 bool obs_module_load(void)
 {
+	image_cache_init();
 	obs_register_source(&image_source_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	image_cache_free();
+}
@@ -0,0 +1,328 @@
+/*
+Copyright (C) 2015 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <linux/videodev2.h>
+
+#include <util/bmem.h>
+#include <obs-ffmpeg-compat.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-decoder: " msg, ##__VA_ARGS__)
+
+/**
+ * Get the libavcodec decoder for a compressed v4l2 pixelformat
+ */
+static enum AVCodecID v4l2_to_codec_id(uint32_t pixelformat)
+{
+	switch (pixelformat) {
+	case V4L2_PIX_FMT_MJPEG:  return AV_CODEC_ID_MJPEG;
+	case V4L2_PIX_FMT_JPEG:   return AV_CODEC_ID_MJPEG;
+#ifdef V4L2_PIX_FMT_H264
+	case V4L2_PIX_FMT_H264:   return AV_CODEC_ID_H264;
+#endif
+	default:                  return AV_CODEC_ID_NONE;
+	}
+}
+
+/**
+ * Convert the decoded pixel format to an obs video format
+ *
+ * Planar 4:2:2, which most MJPEG cameras deliver, is not supported by obs
+ * and is repacked to YUY2.
+ */
+static enum video_format convert_pixel_format(int format, bool *repack)
+{
+	*repack = false;
+
+	switch (format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P: return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_NV12:     return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:  return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_UYVY422:  return VIDEO_FORMAT_UYVY;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P: return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		*repack = true;
+		return VIDEO_FORMAT_YUY2;
+	default:                  return VIDEO_FORMAT_NONE;
+	}
+}
+
+static inline bool is_full_range(const AVFrame *frame)
+{
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
+/**
+ * Repack planar 4:2:2 to YUY2 in the reusable conversion buffer
+ */
+static void v4l2_pack_yuv422p(struct v4l2_decoder *decoder,
+		const AVFrame *frame)
+{
+	const uint32_t pairs    = (uint32_t)frame->width / 2;
+	const uint32_t linesize = pairs * 4;
+
+	da_resize(decoder->convert, linesize * frame->height);
+
+	for (int y = 0; y < frame->height; ++y) {
+		const uint8_t *lum = frame->data[0] + y * frame->linesize[0];
+		const uint8_t *u   = frame->data[1] + y * frame->linesize[1];
+		const uint8_t *v   = frame->data[2] + y * frame->linesize[2];
+		uint8_t *out = decoder->convert.array + y * linesize;
+
+		for (uint32_t x = 0; x < pairs; ++x) {
+			*(out++) = lum[x * 2];
+			*(out++) = u[x];
+			*(out++) = lum[x * 2 + 1];
+			*(out++) = v[x];
+		}
+	}
+
+	memset(decoder->out.data, 0, sizeof(decoder->out.data));
+	memset(decoder->out.linesize, 0, sizeof(decoder->out.linesize));
+	decoder->out.data[0]     = decoder->convert.array;
+	decoder->out.linesize[0] = linesize;
+}
+
+/**
+ * Pass a decoded frame to obs
+ */
+static void v4l2_output_frame(struct v4l2_decoder *decoder,
+		const AVFrame *frame)
+{
+	struct obs_source_frame *out = &decoder->out;
+	enum video_format format;
+	bool full_range;
+	bool repack;
+
+	format = convert_pixel_format(frame->format, &repack);
+	if (format == VIDEO_FORMAT_NONE) {
+		if (!decoder->format_warned)
+			blog(LOG_ERROR, "unsupported decoded pixel format %d",
+					frame->format);
+		decoder->format_warned = true;
+		return;
+	}
+
+	full_range = is_full_range(frame);
+	if (format != out->format || full_range != out->full_range) {
+		out->format     = format;
+		out->full_range = full_range;
+		video_format_get_parameters(VIDEO_CS_DEFAULT,
+				full_range ? VIDEO_RANGE_FULL :
+				             VIDEO_RANGE_PARTIAL,
+				out->color_matrix, out->color_range_min,
+				out->color_range_max);
+	}
+
+	out->width     = frame->width;
+	out->height    = frame->height;
+	out->timestamp = (uint64_t)frame->pkt_pts;
+
+	if (repack) {
+		v4l2_pack_yuv422p(decoder, frame);
+	} else {
+		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
+			out->data[i]     = frame->data[i];
+			out->linesize[i] = frame->linesize[i];
+		}
+	}
+
+	obs_source_output_video(decoder->source, out);
+	decoder->decoded++;
+}
+
+static void v4l2_decode_packet(struct v4l2_decoder *decoder,
+		struct v4l2_packet *data)
+{
+	AVPacket packet;
+	int got_frame = 0;
+
+	av_init_packet(&packet);
+	packet.data = data->data.array;
+	packet.size = (int)data->size;
+	packet.pts  = (int64_t)data->timestamp;
+
+	if (avcodec_decode_video2(decoder->context, decoder->frame,
+			&got_frame, &packet) < 0) {
+		blog(LOG_DEBUG, "failed to decode frame");
+		return;
+	}
+
+	/* frame threads delay the output by a few frames */
+	if (got_frame)
+		v4l2_output_frame(decoder, decoder->frame);
+}
+
+/*
+ * Worker thread to decode the queued frames
+ */
+static void *v4l2_decode_thread(void *vptr)
+{
+	struct v4l2_decoder *decoder = vptr;
+
+	os_set_thread_name("v4l2: decode thread");
+
+	while (os_sem_wait(decoder->sem) == 0 && !decoder->exiting) {
+		struct v4l2_packet *packet = NULL;
+
+		pthread_mutex_lock(&decoder->mutex);
+		if (decoder->queued)
+			packet = &decoder->packets[decoder->read_idx];
+		pthread_mutex_unlock(&decoder->mutex);
+
+		if (!packet)
+			continue;
+
+		v4l2_decode_packet(decoder, packet);
+
+		pthread_mutex_lock(&decoder->mutex);
+		decoder->read_idx = (decoder->read_idx + 1) %
+			V4L2_DECODER_QUEUE_SIZE;
+		decoder->queued--;
+		pthread_mutex_unlock(&decoder->mutex);
+	}
+
+	return NULL;
+}
+
+int_fast32_t v4l2_decoder_init(struct v4l2_decoder *decoder,
+		obs_source_t *source, uint32_t pixelformat)
+{
+	enum AVCodecID id = v4l2_to_codec_id(pixelformat);
+
+	memset(decoder, 0, sizeof(struct v4l2_decoder));
+	decoder->source = source;
+	pthread_mutex_init_value(&decoder->mutex);
+
+	if (id == AV_CODEC_ID_NONE) {
+		blog(LOG_ERROR, "pixelformat is not a compressed format");
+		return -1;
+	}
+
+	avcodec_register_all();
+
+	decoder->codec = avcodec_find_decoder(id);
+	if (!decoder->codec) {
+		blog(LOG_ERROR, "unable to find decoder");
+		goto fail;
+	}
+
+	decoder->context = avcodec_alloc_context3(decoder->codec);
+	if (!decoder->context)
+		goto fail;
+
+	/* let libavcodec pick the thread count for the cpu */
+	decoder->context->thread_count = 0;
+	decoder->context->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if (avcodec_open2(decoder->context, decoder->codec, NULL) < 0) {
+		blog(LOG_ERROR, "unable to open decoder");
+		goto fail;
+	}
+
+	decoder->frame = av_frame_alloc();
+	if (!decoder->frame)
+		goto fail;
+
+	if (pthread_mutex_init(&decoder->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&decoder->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&decoder->thread, NULL, v4l2_decode_thread,
+			decoder) != 0)
+		goto fail;
+	decoder->thread_active = true;
+
+	blog(LOG_INFO, "Decoding %s with %d threads", decoder->codec->name,
+			decoder->context->thread_count);
+	return 0;
+
+fail:
+	v4l2_decoder_free(decoder);
+	return -1;
+}
+
+void v4l2_decoder_free(struct v4l2_decoder *decoder)
+{
+	if (decoder->thread_active) {
+		decoder->exiting = true;
+		os_sem_post(decoder->sem);
+		pthread_join(decoder->thread, NULL);
+
+		blog(LOG_INFO, "Decoded %"PRIu64" frames, dropped %"PRIu64,
+				decoder->decoded, decoder->dropped);
+	}
+
+	if (decoder->context) {
+		avcodec_close(decoder->context);
+		av_free(decoder->context);
+	}
+
+	if (decoder->frame)
+		av_frame_free(&decoder->frame);
+
+	for (size_t i = 0; i < V4L2_DECODER_QUEUE_SIZE; ++i)
+		da_free(decoder->packets[i].data);
+	da_free(decoder->convert);
+
+	os_sem_destroy(decoder->sem);
+	pthread_mutex_destroy(&decoder->mutex);
+
+	memset(decoder, 0, sizeof(struct v4l2_decoder));
+}
+
+void v4l2_decoder_push(struct v4l2_decoder *decoder, const uint8_t *data,
+		size_t size, uint64_t timestamp)
+{
+	struct v4l2_packet *packet;
+
+	/* the slot after the queued packets is owned by the capture thread
+	 * until it is marked as queued */
+	pthread_mutex_lock(&decoder->mutex);
+	if (decoder->queued == V4L2_DECODER_QUEUE_SIZE) {
+		decoder->dropped++;
+		pthread_mutex_unlock(&decoder->mutex);
+		return;
+	}
+	packet = &decoder->packets[(decoder->read_idx + decoder->queued) %
+		V4L2_DECODER_QUEUE_SIZE];
+	pthread_mutex_unlock(&decoder->mutex);
+
+	da_resize(packet->data, size + FF_INPUT_BUFFER_PADDING_SIZE);
+	memcpy(packet->data.array, data, size);
+	memset(packet->data.array + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+	packet->size      = size;
+	packet->timestamp = timestamp;
+
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->queued++;
+	pthread_mutex_unlock(&decoder->mutex);
+
+	os_sem_post(decoder->sem);
+}
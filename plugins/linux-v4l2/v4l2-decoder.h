@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2015 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <util/threading.h>
+#include <util/darray.h>
+#include <obs-module.h>
+
+#include <libavcodec/avcodec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** number of compressed frames that can wait for the decoder */
+#define V4L2_DECODER_QUEUE_SIZE 4
+
+/**
+ * Compressed frame waiting to be decoded
+ */
+struct v4l2_packet {
+	/** reused between frames, padded as required by libavcodec */
+	DARRAY(uint8_t) data;
+	/** number of valid bytes in data */
+	size_t size;
+	/** capture timestamp in nanoseconds */
+	uint64_t timestamp;
+};
+
+/**
+ * Decode stage for compressed capture formats
+ *
+ * The capture thread only copies the compressed frame out of the mapped
+ * device buffer and hands it to a dedicated decode thread, so the device
+ * buffer can be requeued immediately.  libavcodec decodes with frame and/or
+ * slice threads and the decoded planes are passed to obs without copying
+ * whenever obs supports the decoded pixel format.
+ */
+struct v4l2_decoder {
+	obs_source_t *source;
+
+	AVCodec *codec;
+	AVCodecContext *context;
+	AVFrame *frame;
+
+	/** output frame, reused for every decoded frame */
+	struct obs_source_frame out;
+	/** buffer for pixel formats that have to be repacked */
+	DARRAY(uint8_t) convert;
+
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	pthread_t thread;
+	bool thread_active;
+	volatile bool exiting;
+
+	/** ring of packets, only the queued ones belong to the decoder */
+	struct v4l2_packet packets[V4L2_DECODER_QUEUE_SIZE];
+	size_t read_idx;
+	size_t queued;
+
+	uint64_t decoded;
+	uint64_t dropped;
+	bool format_warned;
+};
+
+/**
+ * Initialize the decoder and start the decode thread
+ *
+ * @param decoder decoder data
+ * @param source the source decoded frames are output to
+ * @param pixelformat v4l2 pixelformat of the compressed frames
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_decoder_init(struct v4l2_decoder *decoder,
+		obs_source_t *source, uint32_t pixelformat);
+
+/**
+ * Stop the decode thread and free all decoder data
+ *
+ * @param decoder decoder data
+ */
+void v4l2_decoder_free(struct v4l2_decoder *decoder);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied, so the caller can reuse its buffer as soon as this
+ * returns.  If the decoder is falling behind the frame is dropped.
+ *
+ * @param decoder decoder data
+ * @param data compressed frame data
+ * @param size size of the compressed frame
+ * @param timestamp capture timestamp in nanoseconds
+ */
+void v4l2_decoder_push(struct v4l2_decoder *decoder, const uint8_t *data,
+		size_t size, uint64_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -73,6 +73,25 @@ static inline enum video_format v4l2_to_obs_video_format(uint_fast32_t format)
 	}
 }
 
+/**
+ * Check if a v4l2 pixel format is compressed and has to be decoded
+ *
+ * @param format v4l2 format id
+ *
+ * @return true if frames in this format can be decoded
+ */
+static inline bool v4l2_is_compressed_format(uint_fast32_t format)
+{
+	switch (format) {
+	case V4L2_PIX_FMT_MJPEG:  return true;
+	case V4L2_PIX_FMT_JPEG:   return true;
+#ifdef V4L2_PIX_FMT_H264
+	case V4L2_PIX_FMT_H264:   return true;
+#endif
+	default:                  return false;
+	}
+}
+
 /**
  * Fixed framesizes for devices that don't support enumerating discrete values.
  *
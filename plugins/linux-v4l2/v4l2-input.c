@@ -36,6 +36,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <obs-module.h>
 
 #include "v4l2-helpers.h"
+#include "v4l2-decoder.h"
+#include "v4l2-replay.h"
 
 #if HAVE_UDEV
 #include "v4l2-udev.h"
@@ -86,6 +88,11 @@ struct v4l2_data {
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+
+	/* decode stage for compressed formats */
+	bool compressed;
+	struct v4l2_decoder decoder;
+	struct v4l2_replay replay;
 };
 
 /* forward declarations */
@@ -198,9 +205,14 @@ static void *v4l2_thread(void *vptr)
 		out.timestamp -= first_ts;
 
 		start = (uint8_t *) data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+		if (data->compressed) {
+			v4l2_decoder_push(&data->decoder, start, buf.bytesused,
+					out.timestamp);
+		} else {
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+				out.data[i] = start + plane_offsets[i];
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
@@ -217,6 +229,44 @@ exit:
 	return NULL;
 }
 
+/*
+ * Worker thread to replay a frame dump through the decoder
+ */
+static void *v4l2_replay_thread(void *vptr)
+{
+	V4L2_DATA(vptr);
+	int fps_num, fps_denom;
+	uint64_t frames;
+	uint64_t interval;
+	uint64_t start_ts;
+
+	v4l2_unpack_tuple(&fps_num, &fps_denom, data->framerate);
+	if (data->framerate == -1 || fps_num <= 0 || fps_denom <= 0) {
+		fps_num   = 1;
+		fps_denom = 30;
+	}
+
+	frames   = 0;
+	interval = (uint64_t) fps_num * 1000000000ULL / fps_denom;
+	start_ts = os_gettime_ns();
+
+	while (os_event_try(data->event) == EAGAIN) {
+		size_t size;
+		size_t index = frames % v4l2_replay_frame_count(&data->replay);
+		const uint8_t *frame = v4l2_replay_frame(&data->replay, index,
+				&size);
+
+		v4l2_decoder_push(&data->decoder, frame, size,
+				frames * interval);
+
+		frames++;
+		os_sleepto_ns(start_ts + frames * interval);
+	}
+
+	blog(LOG_INFO, "Stopped replay after %"PRIu64" frames", frames);
+	return NULL;
+}
+
 static const char* v4l2_getname(void)
 {
 	return obs_module_text("V4L2Input");
@@ -388,7 +438,8 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 			dstr_cat(&buffer, " (Emulated)");
 
 		if (v4l2_to_obs_video_format(fmt.pixelformat)
-				!= VIDEO_FORMAT_NONE) {
+				!= VIDEO_FORMAT_NONE ||
+				v4l2_is_compressed_format(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 					fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -783,6 +834,10 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+	v4l2_decoder_free(&data->decoder);
+	v4l2_replay_close(&data->replay);
+	data->compressed = false;
+
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -815,6 +870,31 @@ static void v4l2_destroy(void *vptr)
 	bfree(data);
 }
 
+/**
+ * Initialize replay of a frame dump instead of a device
+ */
+static void v4l2_init_replay(struct v4l2_data *data)
+{
+	blog(LOG_INFO, "Start replay from %s", data->device_id);
+
+	if (v4l2_replay_open(&data->replay, data->device_id) < 0)
+		goto fail;
+	if (v4l2_decoder_init(&data->decoder, data->source,
+			V4L2_PIX_FMT_MJPEG) < 0)
+		goto fail;
+	data->compressed = true;
+
+	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->thread, NULL, v4l2_replay_thread, data)
+			!= 0)
+		goto fail;
+	return;
+fail:
+	blog(LOG_ERROR, "Initialization failed");
+	v4l2_terminate(data);
+}
+
 /**
  * Initialize the v4l2 device
  *
@@ -822,6 +902,7 @@ static void v4l2_destroy(void *vptr)
  * - tries to open the device
  * - sets pixelformat and requested resolution
  * - sets the requested framerate
+ * - starts the decoder for compressed formats
  * - maps the buffers
  * - starts the capture thread
  */
@@ -830,6 +911,11 @@ static void v4l2_init(struct v4l2_data *data)
 	uint32_t input_caps;
 	int fps_num, fps_denom;
 
+	if (v4l2_is_replay_device(data->device_id)) {
+		v4l2_init_replay(data);
+		return;
+	}
+
 	blog(LOG_INFO, "Start capture from %s", data->device_id);
 	data->dev = v4l2_open(data->device_id, O_RDWR | O_NONBLOCK);
 	if (data->dev == -1) {
@@ -873,7 +959,9 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	data->compressed = v4l2_is_compressed_format(data->pixfmt);
+	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE &&
+			!data->compressed) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -890,6 +978,13 @@ static void v4l2_init(struct v4l2_data *data)
 	v4l2_unpack_tuple(&fps_num, &fps_denom, data->framerate);
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
+	/* start decoder */
+	if (data->compressed && v4l2_decoder_init(&data->decoder,
+			data->source, data->pixfmt) < 0) {
+		blog(LOG_ERROR, "Unable to start decoder");
+		goto fail;
+	}
+
 	/* map buffers */
 	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2015 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <obs-module.h>
+
+#include "v4l2-replay.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-replay: " msg, ##__VA_ARGS__)
+
+bool v4l2_is_replay_device(const char *path)
+{
+	struct stat st;
+
+	if (!path || !*path || stat(path, &st) != 0)
+		return false;
+
+	return S_ISREG(st.st_mode);
+}
+
+/**
+ * Find the next JPEG start of image marker
+ */
+static size_t find_soi(const uint8_t *data, size_t size, size_t pos)
+{
+	for (; pos + 1 < size; ++pos) {
+		if (data[pos] == 0xFF && data[pos + 1] == 0xD8)
+			return pos;
+	}
+
+	return size;
+}
+
+/**
+ * Find the end of the frame starting at pos
+ *
+ * Marker bytes are escaped inside the entropy coded data, so an end of
+ * image marker followed by the next start of image (or the end of the
+ * dump) ends the frame.
+ */
+static size_t find_frame_end(const uint8_t *data, size_t size, size_t pos)
+{
+	for (pos += 2; pos + 1 < size; ++pos) {
+		if (data[pos] != 0xFF || data[pos + 1] != 0xD9)
+			continue;
+
+		if (pos + 2 == size)
+			return size;
+		if (pos + 3 < size && data[pos + 2] == 0xFF &&
+				data[pos + 3] == 0xD8)
+			return pos + 2;
+	}
+
+	return size;
+}
+
+static void v4l2_replay_index(struct v4l2_replay *replay)
+{
+	size_t pos = find_soi(replay->data, replay->size, 0);
+
+	while (pos < replay->size) {
+		struct v4l2_replay_frame *frame;
+		size_t end = find_frame_end(replay->data, replay->size, pos);
+
+		frame = da_push_back_new(replay->frames);
+		frame->offset = pos;
+		frame->size   = end - pos;
+
+		pos = find_soi(replay->data, replay->size, end);
+	}
+}
+
+int_fast32_t v4l2_replay_open(struct v4l2_replay *replay, const char *path)
+{
+	FILE *file;
+	int64_t size;
+
+	memset(replay, 0, sizeof(struct v4l2_replay));
+
+	file = os_fopen(path, "rb");
+	if (!file) {
+		blog(LOG_ERROR, "unable to open %s", path);
+		return -1;
+	}
+
+	size = os_fgetsize(file);
+	if (size <= 0) {
+		blog(LOG_ERROR, "%s is empty", path);
+		goto fail;
+	}
+
+	replay->size = (size_t)size;
+	replay->data = bmalloc(replay->size);
+	if (fread(replay->data, 1, replay->size, file) != replay->size) {
+		blog(LOG_ERROR, "unable to read %s", path);
+		goto fail;
+	}
+
+	fclose(file);
+
+	v4l2_replay_index(replay);
+	if (!replay->frames.num) {
+		blog(LOG_ERROR, "no frames found in %s", path);
+		v4l2_replay_close(replay);
+		return -1;
+	}
+
+	blog(LOG_INFO, "Replaying %zu frames from %s", replay->frames.num,
+			path);
+	return 0;
+
+fail:
+	fclose(file);
+	v4l2_replay_close(replay);
+	return -1;
+}
+
+void v4l2_replay_close(struct v4l2_replay *replay)
+{
+	bfree(replay->data);
+	da_free(replay->frames);
+	memset(replay, 0, sizeof(struct v4l2_replay));
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2015 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <util/darray.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fake device that replays recorded MJPEG frames
+ *
+ * When the device id of the source points to a regular file instead of a
+ * device node, the file is treated as a plain concatenation of JPEG images
+ * (as written by "v4l2-ctl --stream-to" or "ffmpeg -c:v copy -f mjpeg")
+ * and its frames are fed to the decode stage at the selected framerate.
+ * This allows testing and benchmarking the MJPEG path without a camera.
+ */
+struct v4l2_replay_frame {
+	/** offset of the frame in the dump */
+	size_t offset;
+	/** size of the frame */
+	size_t size;
+};
+
+struct v4l2_replay {
+	/** contents of the dump file */
+	uint8_t *data;
+	/** size of the dump file */
+	size_t size;
+	/** location of each frame in the dump */
+	DARRAY(struct v4l2_replay_frame) frames;
+};
+
+/**
+ * Check if a device id refers to a frame dump instead of a device
+ *
+ * @param path the device id
+ *
+ * @return true if the path is a regular file
+ */
+bool v4l2_is_replay_device(const char *path);
+
+/**
+ * Load a frame dump and index its frames
+ *
+ * @param replay replay data
+ * @param path path of the dump file
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_replay_open(struct v4l2_replay *replay, const char *path);
+
+/**
+ * Free a loaded frame dump
+ *
+ * @param replay replay data
+ */
+void v4l2_replay_close(struct v4l2_replay *replay);
+
+/**
+ * Get the number of frames in the dump
+ */
+static inline size_t v4l2_replay_frame_count(const struct v4l2_replay *replay)
+{
+	return replay->frames.num;
+}
+
+/**
+ * Get a frame from the dump
+ *
+ * @param replay replay data
+ * @param index index of the frame
+ * @param size set to the size of the frame
+ *
+ * @return pointer to the frame data
+ */
+static inline const uint8_t *v4l2_replay_frame(
+		const struct v4l2_replay *replay, size_t index, size_t *size)
+{
+	*size = replay->frames.array[index].size;
+	return replay->data + replay->frames.array[index].offset;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -21,6 +21,8 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <obs-avc.h>
+#include <inttypes.h>
 
 #include <libavutil/opt.h>
 #include <libavformat/avformat.h>
@@ -78,6 +80,25 @@ struct ffmpeg_data {
 	bool               initialized;
 };
 
+/* default bounds of the write queue */
+#define DEFAULT_MAX_QUEUE_MB 64
+#define DEFAULT_MAX_QUEUE_MS 3000
+
+struct queued_packet {
+	AVPacket           packet;
+	uint64_t           queue_time;
+};
+
+struct packet_queue_stats {
+	size_t             peak_packets;
+	size_t             peak_bytes;
+	uint64_t           latency_total;
+	uint64_t           latency_max;
+	uint64_t           written;
+	uint32_t           dropped;
+	uint32_t           dropped_audio;
+};
+
 struct ffmpeg_output {
 	obs_output_t       *output;
 	volatile bool      active;
@@ -92,7 +113,18 @@ struct ffmpeg_output {
 	os_sem_t           *write_sem;
 	os_event_t         *stop_event;
 
-	DARRAY(AVPacket)   packets;
+	/* queue of struct queued_packet, bounded by max_queue_bytes and
+	 * max_queue_usec.  when it is full, disposable video frames are
+	 * dropped, and once it reaches twice the bound, all video up to the
+	 * next keyframe.  twice max_queue_bytes is a hard limit: packets of
+	 * any type (audio and keyframes included) that would exceed it are
+	 * dropped */
+	struct circlebuf   packets;
+	size_t             queued_bytes;
+	size_t             max_queue_bytes;
+	uint64_t           max_queue_usec;
+	bool               drop_until_keyframe;
+	struct packet_queue_stats stats;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -571,6 +603,171 @@ static inline void copy_data(AVPicture *pic, const struct video_data *frame,
 	}
 }
 
+static inline size_t num_queued(const struct ffmpeg_output *output)
+{
+	return output->packets.size / sizeof(struct queued_packet);
+}
+
+/* age of the oldest queued packet, in microseconds */
+static inline uint64_t queue_duration(struct ffmpeg_output *output,
+		uint64_t now)
+{
+	struct queued_packet *oldest;
+
+	oldest = circlebuf_data(&output->packets, 0);
+	return oldest ? (now - oldest->queue_time) / 1000 : 0;
+}
+
+/* an h264 frame is disposable when no other frame references it */
+static bool is_disposable(struct ffmpeg_output *output, const AVPacket *packet)
+{
+	struct ffmpeg_data *data = &output->ff_data;
+	const uint8_t *nal_start, *nal_end;
+	const uint8_t *end;
+
+	if (!data->video || packet->stream_index != data->video->index)
+		return false;
+	if (data->output->flags & AVFMT_RAWPICTURE)
+		return true;
+	if (data->video->codec->codec_id != AV_CODEC_ID_H264)
+		return false;
+
+	end = packet->data + packet->size;
+	nal_start = obs_avc_find_startcode(packet->data, end);
+	while (true) {
+		int type;
+
+		while (nal_start < end && !*(nal_start++));
+
+		if (nal_start == end)
+			break;
+
+		type = nal_start[0] & 0x1F;
+		if (type == OBS_NAL_SLICE || type == OBS_NAL_SLICE_IDR)
+			return (nal_start[0] >> 5) == 0;
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		nal_start = nal_end;
+	}
+
+	return false;
+}
+
+static inline bool is_video(struct ffmpeg_output *output,
+		const AVPacket *packet)
+{
+	struct ffmpeg_data *data = &output->ff_data;
+	return data->video && packet->stream_index == data->video->index;
+}
+
+static bool should_drop(struct ffmpeg_output *output, const AVPacket *packet,
+		uint64_t now)
+{
+	size_t bytes = output->queued_bytes + packet->size;
+	uint64_t duration = queue_duration(output, now);
+	bool video = is_video(output, packet);
+
+	/* hard limit, the disk has fallen too far behind to keep anything */
+	if (bytes > output->max_queue_bytes * 2) {
+		if (video)
+			output->drop_until_keyframe = true;
+		return true;
+	}
+
+	if (!video)
+		return false;
+
+	if (output->drop_until_keyframe) {
+		if (!(packet->flags & AV_PKT_FLAG_KEY))
+			return true;
+
+		output->drop_until_keyframe = false;
+	}
+
+	if (bytes <= output->max_queue_bytes &&
+	    duration <= output->max_queue_usec)
+		return false;
+
+	if (is_disposable(output, packet))
+		return true;
+
+	if (duration > output->max_queue_usec * 2) {
+		if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+			output->drop_until_keyframe = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void push_packet(struct ffmpeg_output *output, AVPacket *packet)
+{
+	struct queued_packet queued = {0};
+	uint64_t now = os_gettime_ns();
+	bool dropped = false;
+	size_t packets;
+
+	pthread_mutex_lock(&output->write_mutex);
+
+	if (should_drop(output, packet, now)) {
+		if (is_video(output, packet))
+			output->stats.dropped++;
+		else
+			output->stats.dropped_audio++;
+		dropped = true;
+
+	} else {
+		queued.packet     = *packet;
+		queued.queue_time = now;
+		circlebuf_push_back(&output->packets, &queued, sizeof(queued));
+		output->queued_bytes += packet->size;
+
+		packets = num_queued(output);
+		if (packets > output->stats.peak_packets)
+			output->stats.peak_packets = packets;
+		if (output->queued_bytes > output->stats.peak_bytes)
+			output->stats.peak_bytes = output->queued_bytes;
+	}
+
+	pthread_mutex_unlock(&output->write_mutex);
+
+	if (dropped)
+		av_free_packet(packet);
+	else
+		os_sem_post(output->write_sem);
+}
+
+static void free_packets(struct ffmpeg_output *output)
+{
+	struct queued_packet queued;
+
+	while (output->packets.size) {
+		circlebuf_pop_front(&output->packets, &queued, sizeof(queued));
+		av_free_packet(&queued.packet);
+	}
+
+	circlebuf_free(&output->packets);
+	output->queued_bytes        = 0;
+	output->drop_until_keyframe = false;
+}
+
+static void log_queue_stats(struct ffmpeg_output *output)
+{
+	struct packet_queue_stats *stats = &output->stats;
+	double avg_latency = stats->written ?
+		(double)stats->latency_total / (double)stats->written : 0.0;
+
+	blog(LOG_INFO, "ffmpeg output: write queue peak: %zu packets, "
+			"%zu KB, writer latency: %.2f ms average, "
+			"%.2f ms max, %"PRIu32" frames and %"PRIu32" "
+			"audio packets dropped",
+			stats->peak_packets, stats->peak_bytes / 1024,
+			avg_latency / 1000000.0,
+			(double)stats->latency_max / 1000000.0,
+			stats->dropped, stats->dropped_audio);
+}
+
 static void receive_video(void *param, struct video_data *frame)
 {
 	struct ffmpeg_output *output = param;
@@ -603,10 +800,7 @@ static void receive_video(void *param, struct video_data *frame)
 		packet.data          = data->dst_picture.data[0];
 		packet.size          = sizeof(AVPicture);
 
-		pthread_mutex_lock(&output->write_mutex);
-		da_push_back(output->packets, &packet);
-		pthread_mutex_unlock(&output->write_mutex);
-		os_sem_post(output->write_sem);
+		push_packet(output, &packet);
 
 	} else {
 		data->vframe->pts = data->total_frames;
@@ -627,10 +821,7 @@ static void receive_video(void *param, struct video_data *frame)
 					context->time_base,
 					data->video->time_base);
 
-			pthread_mutex_lock(&output->write_mutex);
-			da_push_back(output->packets, &packet);
-			pthread_mutex_unlock(&output->write_mutex);
-			os_sem_post(output->write_sem);
+			push_packet(output, &packet);
 		} else {
 			ret = 0;
 		}
@@ -686,10 +877,7 @@ static void encode_audio(struct ffmpeg_output *output,
 			data->audio->time_base);
 	packet.stream_index = data->audio->index;
 
-	pthread_mutex_lock(&output->write_mutex);
-	da_push_back(output->packets, &packet);
-	pthread_mutex_unlock(&output->write_mutex);
-	os_sem_post(output->write_sem);
+	push_packet(output, &packet);
 }
 
 static bool prepare_audio(struct ffmpeg_data *data,
@@ -753,14 +941,15 @@ static void receive_audio(void *param, struct audio_data *frame)
 
 static bool process_packet(struct ffmpeg_output *output)
 {
-	AVPacket packet;
+	struct queued_packet queued;
 	bool new_packet = false;
+	uint64_t latency;
 	int ret;
 
 	pthread_mutex_lock(&output->write_mutex);
-	if (output->packets.num) {
-		packet = output->packets.array[0];
-		da_erase(output->packets, 0);
+	if (output->packets.size) {
+		circlebuf_pop_front(&output->packets, &queued, sizeof(queued));
+		output->queued_bytes -= queued.packet.size;
 		new_packet = true;
 	}
 	pthread_mutex_unlock(&output->write_mutex);
@@ -768,19 +957,24 @@ static bool process_packet(struct ffmpeg_output *output)
 	if (!new_packet)
 		return true;
 
-	/*blog(LOG_DEBUG, "size = %d, flags = %lX, stream = %d, "
-			"packets queued: %lu",
-			packet.size, packet.flags,
-			packet.stream_index, output->packets.num);*/
-
-	ret = av_interleaved_write_frame(output->ff_data.output, &packet);
+	ret = av_interleaved_write_frame(output->ff_data.output,
+			&queued.packet);
 	if (ret < 0) {
-		av_free_packet(&packet);
+		av_free_packet(&queued.packet);
 		blog(LOG_WARNING, "receive_audio: Error writing packet: %s",
 				av_err2str(ret));
 		return false;
 	}
 
+	latency = os_gettime_ns() - queued.queue_time;
+
+	pthread_mutex_lock(&output->write_mutex);
+	output->stats.latency_total += latency;
+	output->stats.written++;
+	if (latency > output->stats.latency_max)
+		output->stats.latency_max = latency;
+	pthread_mutex_unlock(&output->write_mutex);
+
 	return true;
 }
 
@@ -850,6 +1044,17 @@ static bool try_connect(struct ffmpeg_output *output)
 		return false;
 	}
 
+	output->max_queue_bytes = (size_t)obs_data_get_int(settings,
+			"max_queue_mb") * 1024 * 1024;
+	output->max_queue_usec = (uint64_t)obs_data_get_int(settings,
+			"max_queue_ms") * 1000;
+	memset(&output->stats, 0, sizeof(output->stats));
+
+	if (!output->max_queue_bytes)
+		output->max_queue_bytes = DEFAULT_MAX_QUEUE_MB * 1024 * 1024;
+	if (!output->max_queue_usec)
+		output->max_queue_usec = DEFAULT_MAX_QUEUE_MS * 1000;
+
 	if (!config.scale_width)
 		config.scale_width = config.width;
 	if (!config.scale_height)
@@ -924,25 +1129,38 @@ static void ffmpeg_output_stop(void *data)
 		}
 
 		pthread_mutex_lock(&output->write_mutex);
-
-		for (size_t i = 0; i < output->packets.num; i++)
-			av_free_packet(output->packets.array+i);
-		da_free(output->packets);
-
+		log_queue_stats(output);
+		free_packets(output);
 		pthread_mutex_unlock(&output->write_mutex);
 
 		ffmpeg_data_free(&output->ff_data);
 	}
 }
 
+static void ffmpeg_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "max_queue_mb",
+			DEFAULT_MAX_QUEUE_MB);
+	obs_data_set_default_int(settings, "max_queue_ms",
+			DEFAULT_MAX_QUEUE_MS);
+}
+
+static int ffmpeg_output_dropped_frames(void *data)
+{
+	struct ffmpeg_output *output = data;
+	return (int)output->stats.dropped;
+}
+
 struct obs_output_info ffmpeg_output = {
-	.id        = "ffmpeg_output",
-	.flags     = OBS_OUTPUT_AUDIO | OBS_OUTPUT_VIDEO,
-	.get_name  = ffmpeg_output_getname,
-	.create    = ffmpeg_output_create,
-	.destroy   = ffmpeg_output_destroy,
-	.start     = ffmpeg_output_start,
-	.stop      = ffmpeg_output_stop,
-	.raw_video = receive_video,
-	.raw_audio = receive_audio,
+	.id                 = "ffmpeg_output",
+	.flags              = OBS_OUTPUT_AUDIO | OBS_OUTPUT_VIDEO,
+	.get_name           = ffmpeg_output_getname,
+	.create             = ffmpeg_output_create,
+	.destroy            = ffmpeg_output_destroy,
+	.start              = ffmpeg_output_start,
+	.stop               = ffmpeg_output_stop,
+	.raw_video          = receive_video,
+	.raw_audio          = receive_audio,
+	.get_defaults       = ffmpeg_output_defaults,
+	.get_dropped_frames = ffmpeg_output_dropped_frames,
 };
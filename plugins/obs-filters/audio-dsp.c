@@ -0,0 +1,295 @@
+#include <xmmintrin.h>
+#include <graphics/math-defs.h>
+#include "audio-dsp.h"
+
+#define DENORMAL_LIMIT 1.0e-20f
+#define SHELF_Q        0.70710678118654752440
+
+static inline __m128 abs_ps(__m128 val)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), val);
+}
+
+static inline float hmax_ps(__m128 val)
+{
+	val = _mm_max_ps(val, _mm_movehl_ps(val, val));
+	val = _mm_max_ss(val, _mm_shuffle_ps(val, val, 1));
+	return _mm_cvtss_f32(val);
+}
+
+void dsp_process_blocks(struct obs_audio_data *audio,
+		dsp_block_cb callback, void *data)
+{
+	size_t channels = dsp_output_channels();
+	float  *planes[MAX_AV_PLANES];
+
+	if (channels > MAX_AV_PLANES)
+		channels = MAX_AV_PLANES;
+
+	for (uint32_t offset = 0; offset < audio->frames;
+			offset += DSP_BLOCK_FRAMES) {
+		uint32_t frames = audio->frames - offset;
+
+		if (frames > DSP_BLOCK_FRAMES)
+			frames = DSP_BLOCK_FRAMES;
+
+		for (size_t ch = 0; ch < channels; ch++)
+			planes[ch] = (float*)audio->data[ch] + offset;
+
+		callback(data, planes, channels, frames);
+	}
+}
+
+void dsp_apply_gain(float *samples, uint32_t frames, float start, float end)
+{
+	uint32_t i = 0;
+
+	if (start == end) {
+		__m128 gain = _mm_set1_ps(end);
+
+		for (; i + 4 <= frames; i += 4)
+			_mm_storeu_ps(samples + i, _mm_mul_ps(gain,
+					_mm_loadu_ps(samples + i)));
+		for (; i < frames; i++)
+			samples[i] *= end;
+		return;
+	}
+
+	/* the ramp reaches 'end' on the last frame */
+	float  step = (end - start) / (float)frames;
+	__m128 inc  = _mm_set1_ps(step * 4.0f);
+	__m128 gain = _mm_setr_ps(start + step, start + step * 2.0f,
+			start + step * 3.0f, start + step * 4.0f);
+
+	for (; i + 4 <= frames; i += 4) {
+		_mm_storeu_ps(samples + i, _mm_mul_ps(gain,
+				_mm_loadu_ps(samples + i)));
+		gain = _mm_add_ps(gain, inc);
+	}
+	for (; i < frames; i++)
+		samples[i] *= start + step * (float)(i + 1);
+}
+
+float dsp_peak(float *const *planes, size_t channels, uint32_t offset,
+		uint32_t frames)
+{
+	__m128 peak = _mm_setzero_ps();
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		const float *samples = planes[ch] + offset;
+		uint32_t i = 0;
+
+		for (; i + 4 <= frames; i += 4)
+			peak = _mm_max_ps(peak,
+					abs_ps(_mm_loadu_ps(samples + i)));
+		for (; i < frames; i++)
+			peak = _mm_max_ss(peak,
+					abs_ps(_mm_load_ss(samples + i)));
+	}
+
+	return hmax_ps(peak);
+}
+
+void dsp_apply_gain_steps(float **planes, size_t channels, uint32_t frames,
+		float *gain, const float *gains)
+{
+	for (uint32_t offset = 0, step = 0; offset < frames;
+			offset += DSP_CONTROL_FRAMES, step++) {
+		uint32_t count = frames - offset;
+
+		if (count > DSP_CONTROL_FRAMES)
+			count = DSP_CONTROL_FRAMES;
+
+		for (size_t ch = 0; ch < channels; ch++)
+			dsp_apply_gain(planes[ch] + offset, count, *gain,
+					gains[step]);
+
+		*gain = gains[step];
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void set_coeffs(struct dsp_biquad *bq, double b0, double b1, double b2,
+		double a0, double a1, double a2)
+{
+	bq->b0 = (float)(b0 / a0);
+	bq->b1 = (float)(b1 / a0);
+	bq->b2 = (float)(b2 / a0);
+	bq->a1 = (float)(a1 / a0);
+	bq->a2 = (float)(a2 / a0);
+}
+
+static inline double get_w0(float sample_rate, float freq)
+{
+	double max_freq = (double)sample_rate * 0.45;
+	double f = (double)freq;
+
+	if (f > max_freq)
+		f = max_freq;
+	if (f < 1.0)
+		f = 1.0;
+
+	return 2.0 * M_PI * f / (double)sample_rate;
+}
+
+void dsp_biquad_low_shelf(struct dsp_biquad *bq, float sample_rate,
+		float freq, float gain_db)
+{
+	double a     = pow(10.0, (double)gain_db / 40.0);
+	double w0    = get_w0(sample_rate, freq);
+	double cosw  = cos(w0);
+	double alpha = sin(w0) / (2.0 * SHELF_Q);
+	double sa    = 2.0 * sqrt(a) * alpha;
+
+	set_coeffs(bq,
+			a * ((a + 1.0) - (a - 1.0) * cosw + sa),
+			2.0 * a * ((a - 1.0) - (a + 1.0) * cosw),
+			a * ((a + 1.0) - (a - 1.0) * cosw - sa),
+			(a + 1.0) + (a - 1.0) * cosw + sa,
+			-2.0 * ((a - 1.0) + (a + 1.0) * cosw),
+			(a + 1.0) + (a - 1.0) * cosw - sa);
+}
+
+void dsp_biquad_peaking(struct dsp_biquad *bq, float sample_rate,
+		float freq, float q, float gain_db)
+{
+	double a     = pow(10.0, (double)gain_db / 40.0);
+	double w0    = get_w0(sample_rate, freq);
+	double cosw  = cos(w0);
+	double alpha = sin(w0) / (2.0 * (double)q);
+
+	set_coeffs(bq,
+			1.0 + alpha * a,
+			-2.0 * cosw,
+			1.0 - alpha * a,
+			1.0 + alpha / a,
+			-2.0 * cosw,
+			1.0 - alpha / a);
+}
+
+void dsp_biquad_high_shelf(struct dsp_biquad *bq, float sample_rate,
+		float freq, float gain_db)
+{
+	double a     = pow(10.0, (double)gain_db / 40.0);
+	double w0    = get_w0(sample_rate, freq);
+	double cosw  = cos(w0);
+	double alpha = sin(w0) / (2.0 * SHELF_Q);
+	double sa    = 2.0 * sqrt(a) * alpha;
+
+	set_coeffs(bq,
+			a * ((a + 1.0) + (a - 1.0) * cosw + sa),
+			-2.0 * a * ((a - 1.0) + (a + 1.0) * cosw),
+			a * ((a + 1.0) + (a - 1.0) * cosw - sa),
+			(a + 1.0) - (a - 1.0) * cosw + sa,
+			2.0 * ((a - 1.0) - (a + 1.0) * cosw),
+			(a + 1.0) - (a - 1.0) * cosw - sa);
+}
+
+struct biquad_coeffs {
+	__m128 b0, b1, b2;
+	__m128 a1, a2;
+};
+
+/* one frame of four channels */
+static inline __m128 biquad_step(const struct biquad_coeffs *c,
+		__m128 *z1, __m128 *z2, __m128 x)
+{
+	__m128 y = _mm_add_ps(_mm_mul_ps(c->b0, x), *z1);
+
+	*z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c->b1, x),
+				_mm_mul_ps(c->a1, y)), *z2);
+	*z2 = _mm_sub_ps(_mm_mul_ps(c->b2, x), _mm_mul_ps(c->a2, y));
+	return y;
+}
+
+static inline __m128 flush_denormals(__m128 val)
+{
+	__m128 mask = _mm_cmpge_ps(abs_ps(val), _mm_set1_ps(DENORMAL_LIMIT));
+	return _mm_and_ps(val, mask);
+}
+
+/*
+ * The recursion is serial in time, so four channels are filtered at once:
+ * each group of four frames is transposed to frame-major order, filtered and
+ * transposed back.
+ */
+static void biquad_group(const struct biquad_coeffs *c, float *z1_out,
+		float *z2_out, float **ptrs, uint32_t frames)
+{
+	__m128   z1 = _mm_loadu_ps(z1_out);
+	__m128   z2 = _mm_loadu_ps(z2_out);
+	uint32_t i  = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 x0 = _mm_loadu_ps(ptrs[0] + i);
+		__m128 x1 = _mm_loadu_ps(ptrs[1] + i);
+		__m128 x2 = _mm_loadu_ps(ptrs[2] + i);
+		__m128 x3 = _mm_loadu_ps(ptrs[3] + i);
+
+		_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+		x0 = biquad_step(c, &z1, &z2, x0);
+		x1 = biquad_step(c, &z1, &z2, x1);
+		x2 = biquad_step(c, &z1, &z2, x2);
+		x3 = biquad_step(c, &z1, &z2, x3);
+		_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+
+		_mm_storeu_ps(ptrs[0] + i, x0);
+		_mm_storeu_ps(ptrs[1] + i, x1);
+		_mm_storeu_ps(ptrs[2] + i, x2);
+		_mm_storeu_ps(ptrs[3] + i, x3);
+	}
+
+	for (; i < frames; i++) {
+		float  out[4];
+		__m128 x = _mm_setr_ps(ptrs[0][i], ptrs[1][i], ptrs[2][i],
+				ptrs[3][i]);
+
+		_mm_storeu_ps(out, biquad_step(c, &z1, &z2, x));
+		for (size_t k = 0; k < 4; k++)
+			ptrs[k][i] = out[k];
+	}
+
+	_mm_storeu_ps(z1_out, flush_denormals(z1));
+	_mm_storeu_ps(z2_out, flush_denormals(z2));
+}
+
+void dsp_biquad_process(const struct dsp_biquad *bq,
+		struct dsp_biquad_state *state, float **planes,
+		size_t channels, uint32_t frames)
+{
+	struct biquad_coeffs c;
+	float scratch[DSP_BLOCK_FRAMES];
+	bool  scratch_clear = false;
+
+	c.b0 = _mm_set1_ps(bq->b0);
+	c.b1 = _mm_set1_ps(bq->b1);
+	c.b2 = _mm_set1_ps(bq->b2);
+	c.a1 = _mm_set1_ps(bq->a1);
+	c.a2 = _mm_set1_ps(bq->a2);
+
+	if (frames > DSP_BLOCK_FRAMES)
+		frames = DSP_BLOCK_FRAMES;
+
+	for (size_t group = 0; group < channels; group += 4) {
+		float *ptrs[4];
+
+		for (size_t k = 0; k < 4; k++) {
+			if (group + k < channels) {
+				ptrs[k] = planes[group + k];
+				continue;
+			}
+
+			/* unused lanes filter silence, which keeps their
+			 * state at zero */
+			if (!scratch_clear) {
+				memset(scratch, 0, sizeof(float) * frames);
+				scratch_clear = true;
+			}
+			ptrs[k] = scratch;
+		}
+
+		biquad_group(&c, state->z1 + group, state->z2 + group, ptrs,
+				frames);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <math.h>
+#include <obs-module.h>
+
+/*
+ * Shared DSP code for the audio filters
+ *
+ *   Filters modify the planar float packet of the source in place.  Packets
+ * are split into blocks of at most DSP_BLOCK_FRAMES frames, so state and
+ * scratch space can be sized up front and nothing is allocated per packet.
+ */
+
+#define DSP_BLOCK_FRAMES   256
+
+/* frames per gain computation of the dynamics processors */
+#define DSP_CONTROL_FRAMES 32
+
+typedef void (*dsp_block_cb)(void *data, float **planes, size_t channels,
+		uint32_t frames);
+
+static inline size_t dsp_output_channels(void)
+{
+	return audio_output_get_channels(obs_get_audio());
+}
+
+static inline float dsp_sample_rate(void)
+{
+	return (float)audio_output_get_sample_rate(obs_get_audio());
+}
+
+static inline float dsp_db_to_mul(float db)
+{
+	return powf(10.0f, db / 20.0f);
+}
+
+static inline float dsp_mul_to_db(float mul)
+{
+	return (mul > 0.0f) ? 20.0f * log10f(mul) : -INFINITY;
+}
+
+/* per-step smoothing coefficient for a time constant in milliseconds */
+static inline float dsp_time_coeff(float ms, float steps_per_sec)
+{
+	return (ms > 0.0f) ? expf(-1000.0f / (ms * steps_per_sec)) : 0.0f;
+}
+
+/* calls 'callback' for each block of the packet */
+extern void dsp_process_blocks(struct obs_audio_data *audio,
+		dsp_block_cb callback, void *data);
+
+/* multiplies the samples by a gain ramping linearly from 'start' to 'end' */
+extern void dsp_apply_gain(float *samples, uint32_t frames,
+		float start, float end);
+
+/* highest absolute sample value across all channels */
+extern float dsp_peak(float *const *planes, size_t channels,
+		uint32_t offset, uint32_t frames);
+
+/*
+ * Applies the per-step gains of a dynamics processor: gains[i] is reached at
+ * the end of control step i, starting from *gain.
+ */
+extern void dsp_apply_gain_steps(float **planes, size_t channels,
+		uint32_t frames, float *gain, const float *gains);
+
+/* ------------------------------------------------------------------------- */
+
+struct dsp_biquad {
+	float b0, b1, b2;
+	float a1, a2;
+};
+
+/* transposed direct form II state of each channel */
+struct dsp_biquad_state {
+	float z1[MAX_AV_PLANES];
+	float z2[MAX_AV_PLANES];
+};
+
+/* RBJ cookbook filters, q of 0.707 for the shelves */
+extern void dsp_biquad_low_shelf(struct dsp_biquad *bq, float sample_rate,
+		float freq, float gain_db);
+extern void dsp_biquad_peaking(struct dsp_biquad *bq, float sample_rate,
+		float freq, float q, float gain_db);
+extern void dsp_biquad_high_shelf(struct dsp_biquad *bq, float sample_rate,
+		float freq, float gain_db);
+
+/* filters a block of at most DSP_BLOCK_FRAMES frames */
+extern void dsp_biquad_process(const struct dsp_biquad *bq,
+		struct dsp_biquad_state *state, float **planes,
+		size_t channels, uint32_t frames);
@@ -0,0 +1,161 @@
+#include "audio-dsp.h"
+
+#define SETTING_RATIO                  "ratio"
+#define SETTING_THRESHOLD              "threshold"
+#define SETTING_ATTACK_TIME            "attack_time"
+#define SETTING_RELEASE_TIME           "release_time"
+#define SETTING_OUTPUT_GAIN            "output_gain"
+
+#define TEXT_RATIO                     obs_module_text("Compressor.Ratio")
+#define TEXT_THRESHOLD                 obs_module_text("Compressor.Threshold")
+#define TEXT_ATTACK_TIME               obs_module_text("Compressor.AttackTime")
+#define TEXT_RELEASE_TIME              obs_module_text("Compressor.ReleaseTime")
+#define TEXT_OUTPUT_GAIN               obs_module_text("Compressor.OutputGain")
+
+#define MIN_RATIO 1.0
+#define MAX_RATIO 32.0
+
+#define CONTROL_STEPS (DSP_BLOCK_FRAMES / DSP_CONTROL_FRAMES)
+
+struct compressor_data {
+	obs_source_t                   *context;
+
+	float                          threshold_db;
+	/* gain reduction per dB above the threshold */
+	float                          slope;
+	float                          attack_coeff;
+	float                          release_coeff;
+	float                          output_gain;
+
+	float                          envelope;
+	float                          gain;
+	float                          gains[CONTROL_STEPS];
+};
+
+static const char *compressor_name(void)
+{
+	return obs_module_text("CompressorFilter");
+}
+
+static void compressor_update(void *data, obs_data_t *settings)
+{
+	struct compressor_data *filter = data;
+	float steps_per_sec = dsp_sample_rate() / (float)DSP_CONTROL_FRAMES;
+	double ratio = obs_data_get_double(settings, SETTING_RATIO);
+
+	if (ratio < MIN_RATIO)
+		ratio = MIN_RATIO;
+
+	/* the highest ratio limits the output to the threshold */
+	filter->slope = (ratio >= MAX_RATIO) ?
+		1.0f : (float)(1.0 - 1.0 / ratio);
+	filter->threshold_db = (float)obs_data_get_double(settings,
+			SETTING_THRESHOLD);
+	filter->attack_coeff = dsp_time_coeff((float)obs_data_get_int(
+				settings, SETTING_ATTACK_TIME), steps_per_sec);
+	filter->release_coeff = dsp_time_coeff((float)obs_data_get_int(
+				settings, SETTING_RELEASE_TIME), steps_per_sec);
+	filter->output_gain = dsp_db_to_mul((float)obs_data_get_double(
+				settings, SETTING_OUTPUT_GAIN));
+}
+
+static void *compressor_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct compressor_data *filter = bzalloc(sizeof(*filter));
+
+	filter->context = context;
+	compressor_update(filter, settings);
+	filter->gain = filter->output_gain;
+
+	return filter;
+}
+
+static void compressor_destroy(void *data)
+{
+	bfree(data);
+}
+
+static inline float compressor_gain(const struct compressor_data *filter)
+{
+	float over = dsp_mul_to_db(filter->envelope) - filter->threshold_db;
+
+	if (over <= 0.0f)
+		return filter->output_gain;
+
+	return dsp_db_to_mul(-over * filter->slope) * filter->output_gain;
+}
+
+static void compressor_block(void *data, float **planes, size_t channels,
+		uint32_t frames)
+{
+	struct compressor_data *filter = data;
+	size_t step = 0;
+
+	for (uint32_t offset = 0; offset < frames;
+			offset += DSP_CONTROL_FRAMES) {
+		uint32_t count = frames - offset;
+		float peak;
+		float coeff;
+
+		if (count > DSP_CONTROL_FRAMES)
+			count = DSP_CONTROL_FRAMES;
+
+		peak  = dsp_peak(planes, channels, offset, count);
+		coeff = (peak > filter->envelope) ?
+			filter->attack_coeff : filter->release_coeff;
+
+		filter->envelope = peak + coeff * (filter->envelope - peak);
+		filter->gains[step++] = compressor_gain(filter);
+	}
+
+	dsp_apply_gain_steps(planes, channels, frames, &filter->gain,
+			filter->gains);
+}
+
+static struct obs_audio_data *compressor_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	dsp_process_blocks(audio, compressor_block, data);
+	return audio;
+}
+
+static obs_properties_t *compressor_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_float_slider(props, SETTING_RATIO,
+			TEXT_RATIO, MIN_RATIO, MAX_RATIO, 0.5);
+	obs_properties_add_float_slider(props, SETTING_THRESHOLD,
+			TEXT_THRESHOLD, -60.0, 0.0, 0.1);
+	obs_properties_add_int(props, SETTING_ATTACK_TIME,
+			TEXT_ATTACK_TIME, 0, 500, 1);
+	obs_properties_add_int(props, SETTING_RELEASE_TIME,
+			TEXT_RELEASE_TIME, 1, 1000, 1);
+	obs_properties_add_float_slider(props, SETTING_OUTPUT_GAIN,
+			TEXT_OUTPUT_GAIN, -32.0, 32.0, 0.1);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+static void compressor_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, SETTING_RATIO, 10.0);
+	obs_data_set_default_double(settings, SETTING_THRESHOLD, -18.0);
+	obs_data_set_default_int(settings, SETTING_ATTACK_TIME, 6);
+	obs_data_set_default_int(settings, SETTING_RELEASE_TIME, 60);
+	obs_data_set_default_double(settings, SETTING_OUTPUT_GAIN, 0.0);
+}
+
+struct obs_source_info compressor_filter = {
+	.id                            = "compressor_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_AUDIO,
+	.get_name                      = compressor_name,
+	.create                        = compressor_create,
+	.destroy                       = compressor_destroy,
+	.update                        = compressor_update,
+	.filter_audio                  = compressor_filter_audio,
+	.get_properties                = compressor_properties,
+	.get_defaults                  = compressor_defaults
+};
@@ -0,0 +1,140 @@
+#include "audio-dsp.h"
+
+#define SETTING_LOW_GAIN               "low"
+#define SETTING_MID_GAIN               "mid"
+#define SETTING_HIGH_GAIN              "high"
+#define SETTING_LOW_FREQ               "low_freq"
+#define SETTING_MID_FREQ               "mid_freq"
+#define SETTING_HIGH_FREQ              "high_freq"
+
+#define TEXT_LOW_GAIN                  obs_module_text("EQ.Low")
+#define TEXT_MID_GAIN                  obs_module_text("EQ.Mid")
+#define TEXT_HIGH_GAIN                 obs_module_text("EQ.High")
+#define TEXT_LOW_FREQ                  obs_module_text("EQ.LowFreq")
+#define TEXT_MID_FREQ                  obs_module_text("EQ.MidFreq")
+#define TEXT_HIGH_FREQ                 obs_module_text("EQ.HighFreq")
+
+#define MID_Q 0.7f
+
+enum eq_band {
+	EQ_LOW,
+	EQ_MID,
+	EQ_HIGH,
+	EQ_BANDS
+};
+
+struct eq_data {
+	obs_source_t                   *context;
+
+	struct dsp_biquad              bands[EQ_BANDS];
+	struct dsp_biquad_state        states[EQ_BANDS];
+	/* flat bands are skipped */
+	bool                           active[EQ_BANDS];
+};
+
+static const char *eq_name(void)
+{
+	return obs_module_text("EqualizerFilter");
+}
+
+static void eq_update(void *data, obs_data_t *settings)
+{
+	struct eq_data *filter = data;
+	float sample_rate = dsp_sample_rate();
+	float low  = (float)obs_data_get_double(settings, SETTING_LOW_GAIN);
+	float mid  = (float)obs_data_get_double(settings, SETTING_MID_GAIN);
+	float high = (float)obs_data_get_double(settings, SETTING_HIGH_GAIN);
+
+	dsp_biquad_low_shelf(&filter->bands[EQ_LOW], sample_rate,
+			(float)obs_data_get_int(settings, SETTING_LOW_FREQ),
+			low);
+	dsp_biquad_peaking(&filter->bands[EQ_MID], sample_rate,
+			(float)obs_data_get_int(settings, SETTING_MID_FREQ),
+			MID_Q, mid);
+	dsp_biquad_high_shelf(&filter->bands[EQ_HIGH], sample_rate,
+			(float)obs_data_get_int(settings, SETTING_HIGH_FREQ),
+			high);
+
+	filter->active[EQ_LOW]  = low  != 0.0f;
+	filter->active[EQ_MID]  = mid  != 0.0f;
+	filter->active[EQ_HIGH] = high != 0.0f;
+}
+
+static void *eq_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct eq_data *filter = bzalloc(sizeof(*filter));
+
+	filter->context = context;
+	eq_update(filter, settings);
+
+	return filter;
+}
+
+static void eq_destroy(void *data)
+{
+	bfree(data);
+}
+
+static void eq_block(void *data, float **planes, size_t channels,
+		uint32_t frames)
+{
+	struct eq_data *filter = data;
+
+	for (size_t i = 0; i < EQ_BANDS; i++) {
+		if (filter->active[i])
+			dsp_biquad_process(&filter->bands[i],
+					&filter->states[i], planes, channels,
+					frames);
+	}
+}
+
+static struct obs_audio_data *eq_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	dsp_process_blocks(audio, eq_block, data);
+	return audio;
+}
+
+static obs_properties_t *eq_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_float_slider(props, SETTING_LOW_GAIN,
+			TEXT_LOW_GAIN, -20.0, 20.0, 0.1);
+	obs_properties_add_float_slider(props, SETTING_MID_GAIN,
+			TEXT_MID_GAIN, -20.0, 20.0, 0.1);
+	obs_properties_add_float_slider(props, SETTING_HIGH_GAIN,
+			TEXT_HIGH_GAIN, -20.0, 20.0, 0.1);
+	obs_properties_add_int(props, SETTING_LOW_FREQ,
+			TEXT_LOW_FREQ, 20, 1000, 1);
+	obs_properties_add_int(props, SETTING_MID_FREQ,
+			TEXT_MID_FREQ, 200, 8000, 1);
+	obs_properties_add_int(props, SETTING_HIGH_FREQ,
+			TEXT_HIGH_FREQ, 1000, 20000, 1);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+static void eq_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, SETTING_LOW_GAIN, 0.0);
+	obs_data_set_default_double(settings, SETTING_MID_GAIN, 0.0);
+	obs_data_set_default_double(settings, SETTING_HIGH_GAIN, 0.0);
+	obs_data_set_default_int(settings, SETTING_LOW_FREQ, 200);
+	obs_data_set_default_int(settings, SETTING_MID_FREQ, 1000);
+	obs_data_set_default_int(settings, SETTING_HIGH_FREQ, 5000);
+}
+
+struct obs_source_info eq_filter = {
+	.id                            = "eq_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_AUDIO,
+	.get_name                      = eq_name,
+	.create                        = eq_create,
+	.destroy                       = eq_destroy,
+	.update                        = eq_update,
+	.filter_audio                  = eq_filter_audio,
+	.get_properties                = eq_properties,
+	.get_defaults                  = eq_defaults
+};
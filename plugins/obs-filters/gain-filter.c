@@ -0,0 +1,91 @@
+#include "audio-dsp.h"
+
+#define SETTING_GAIN_DB                "db"
+
+#define TEXT_GAIN_DB                   obs_module_text("Gain.GainDB")
+
+struct gain_data {
+	obs_source_t                   *context;
+
+	/* target gain set by updates, and the gain last applied */
+	float                          target;
+	float                          gain;
+};
+
+static const char *gain_filter_name(void)
+{
+	return obs_module_text("GainFilter");
+}
+
+static void gain_filter_update(void *data, obs_data_t *settings)
+{
+	struct gain_data *filter = data;
+	double db = obs_data_get_double(settings, SETTING_GAIN_DB);
+
+	filter->target = dsp_db_to_mul((float)db);
+}
+
+static void *gain_filter_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct gain_data *filter = bzalloc(sizeof(*filter));
+
+	filter->context = context;
+	gain_filter_update(filter, settings);
+	filter->gain = filter->target;
+
+	return filter;
+}
+
+static void gain_filter_destroy(void *data)
+{
+	bfree(data);
+}
+
+static void gain_filter_block(void *data, float **planes, size_t channels,
+		uint32_t frames)
+{
+	struct gain_data *filter = data;
+	float target = filter->target;
+
+	/* changes are ramped over a block to avoid zipper noise */
+	for (size_t ch = 0; ch < channels; ch++)
+		dsp_apply_gain(planes[ch], frames, filter->gain, target);
+
+	filter->gain = target;
+}
+
+static struct obs_audio_data *gain_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	dsp_process_blocks(audio, gain_filter_block, data);
+	return audio;
+}
+
+static obs_properties_t *gain_filter_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_float_slider(props, SETTING_GAIN_DB,
+			TEXT_GAIN_DB, -30.0, 30.0, 0.1);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+static void gain_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, SETTING_GAIN_DB, 0.0);
+}
+
+struct obs_source_info gain_filter = {
+	.id                            = "gain_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_AUDIO,
+	.get_name                      = gain_filter_name,
+	.create                        = gain_filter_create,
+	.destroy                       = gain_filter_destroy,
+	.update                        = gain_filter_update,
+	.filter_audio                  = gain_filter_audio,
+	.get_properties                = gain_filter_properties,
+	.get_defaults                  = gain_filter_defaults
+};
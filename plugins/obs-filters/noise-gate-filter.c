@@ -0,0 +1,163 @@
+#include "audio-dsp.h"
+
+#define SETTING_OPEN_THRESHOLD         "open_threshold"
+#define SETTING_CLOSE_THRESHOLD        "close_threshold"
+#define SETTING_ATTACK_TIME            "attack_time"
+#define SETTING_HOLD_TIME              "hold_time"
+#define SETTING_RELEASE_TIME           "release_time"
+
+#define TEXT_OPEN_THRESHOLD            obs_module_text("Gate.OpenThreshold")
+#define TEXT_CLOSE_THRESHOLD           obs_module_text("Gate.CloseThreshold")
+#define TEXT_ATTACK_TIME               obs_module_text("Gate.AttackTime")
+#define TEXT_HOLD_TIME                 obs_module_text("Gate.HoldTime")
+#define TEXT_RELEASE_TIME              obs_module_text("Gate.ReleaseTime")
+
+#define CONTROL_STEPS (DSP_BLOCK_FRAMES / DSP_CONTROL_FRAMES)
+
+struct noise_gate_data {
+	obs_source_t                   *context;
+
+	float                          open_threshold;
+	float                          close_threshold;
+	/* gain change per control step while opening/closing */
+	float                          attack_rate;
+	float                          release_rate;
+	uint32_t                       hold_steps;
+
+	bool                           open;
+	uint32_t                       held_steps;
+	float                          gain;
+	float                          gains[CONTROL_STEPS];
+};
+
+static const char *noise_gate_name(void)
+{
+	return obs_module_text("NoiseGateFilter");
+}
+
+static inline float gate_rate(double ms, float steps_per_sec)
+{
+	return (ms > 0.0) ? (float)(1000.0 / (ms * steps_per_sec)) : 1.0f;
+}
+
+static void noise_gate_update(void *data, obs_data_t *settings)
+{
+	struct noise_gate_data *filter = data;
+	float steps_per_sec = dsp_sample_rate() / (float)DSP_CONTROL_FRAMES;
+	double hold_ms;
+
+	filter->open_threshold = dsp_db_to_mul((float)obs_data_get_double(
+				settings, SETTING_OPEN_THRESHOLD));
+	filter->close_threshold = dsp_db_to_mul((float)obs_data_get_double(
+				settings, SETTING_CLOSE_THRESHOLD));
+	filter->attack_rate = gate_rate(obs_data_get_int(settings,
+				SETTING_ATTACK_TIME), steps_per_sec);
+	filter->release_rate = gate_rate(obs_data_get_int(settings,
+				SETTING_RELEASE_TIME), steps_per_sec);
+
+	hold_ms = (double)obs_data_get_int(settings, SETTING_HOLD_TIME);
+	filter->hold_steps = (uint32_t)(hold_ms * steps_per_sec / 1000.0);
+}
+
+static void *noise_gate_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct noise_gate_data *filter = bzalloc(sizeof(*filter));
+
+	filter->context = context;
+	noise_gate_update(filter, settings);
+
+	return filter;
+}
+
+static void noise_gate_destroy(void *data)
+{
+	bfree(data);
+}
+
+static void noise_gate_block(void *data, float **planes, size_t channels,
+		uint32_t frames)
+{
+	struct noise_gate_data *filter = data;
+	float gain = filter->gain;
+	size_t step = 0;
+
+	for (uint32_t offset = 0; offset < frames;
+			offset += DSP_CONTROL_FRAMES) {
+		uint32_t count = frames - offset;
+		float peak;
+
+		if (count > DSP_CONTROL_FRAMES)
+			count = DSP_CONTROL_FRAMES;
+
+		peak = dsp_peak(planes, channels, offset, count);
+
+		if (peak >= filter->open_threshold) {
+			filter->open = true;
+			filter->held_steps = 0;
+		} else if (peak < filter->close_threshold && filter->open) {
+			if (filter->held_steps++ >= filter->hold_steps)
+				filter->open = false;
+		}
+
+		if (filter->open) {
+			gain += filter->attack_rate;
+			if (gain > 1.0f) gain = 1.0f;
+		} else {
+			gain -= filter->release_rate;
+			if (gain < 0.0f) gain = 0.0f;
+		}
+
+		filter->gains[step++] = gain;
+	}
+
+	dsp_apply_gain_steps(planes, channels, frames, &filter->gain,
+			filter->gains);
+}
+
+static struct obs_audio_data *noise_gate_filter_audio(void *data,
+		struct obs_audio_data *audio)
+{
+	dsp_process_blocks(audio, noise_gate_block, data);
+	return audio;
+}
+
+static obs_properties_t *noise_gate_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_float_slider(props, SETTING_CLOSE_THRESHOLD,
+			TEXT_CLOSE_THRESHOLD, -96.0, 0.0, 1.0);
+	obs_properties_add_float_slider(props, SETTING_OPEN_THRESHOLD,
+			TEXT_OPEN_THRESHOLD, -96.0, 0.0, 1.0);
+	obs_properties_add_int(props, SETTING_ATTACK_TIME,
+			TEXT_ATTACK_TIME, 0, 10000, 1);
+	obs_properties_add_int(props, SETTING_HOLD_TIME,
+			TEXT_HOLD_TIME, 0, 10000, 1);
+	obs_properties_add_int(props, SETTING_RELEASE_TIME,
+			TEXT_RELEASE_TIME, 0, 10000, 1);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+static void noise_gate_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, SETTING_OPEN_THRESHOLD, -26.0);
+	obs_data_set_default_double(settings, SETTING_CLOSE_THRESHOLD, -32.0);
+	obs_data_set_default_int(settings, SETTING_ATTACK_TIME, 25);
+	obs_data_set_default_int(settings, SETTING_HOLD_TIME, 200);
+	obs_data_set_default_int(settings, SETTING_RELEASE_TIME, 150);
+}
+
+struct obs_source_info noise_gate_filter = {
+	.id                            = "noise_gate_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_AUDIO,
+	.get_name                      = noise_gate_name,
+	.create                        = noise_gate_create,
+	.destroy                       = noise_gate_destroy,
+	.update                        = noise_gate_update,
+	.filter_audio                  = noise_gate_filter_audio,
+	.get_properties                = noise_gate_properties,
+	.get_defaults                  = noise_gate_defaults
+};
@@ -11,6 +11,10 @@ extern struct obs_source_info color_key_filter;
 extern struct obs_source_info sharpness_filter;
 extern struct obs_source_info chroma_key_filter;
 extern struct obs_source_info async_delay_filter;
+extern struct obs_source_info gain_filter;
+extern struct obs_source_info noise_gate_filter;
+extern struct obs_source_info compressor_filter;
+extern struct obs_source_info eq_filter;
 
 bool obs_module_load(void)
 {
@@ -21,5 +25,9 @@ bool obs_module_load(void)
 	obs_register_source(&sharpness_filter);
 	obs_register_source(&chroma_key_filter);
 	obs_register_source(&async_delay_filter);
+	obs_register_source(&gain_filter);
+	obs_register_source(&noise_gate_filter);
+	obs_register_source(&compressor_filter);
+	obs_register_source(&eq_filter);
 	return true;
 }
@@ -194,7 +194,7 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 		stream->sent_headers = true;
 	}
 
-	if (packet->type == OBS_ENCODER_VIDEO) {
+	if (packet->type == OBS_ENCODER_VIDEO && !packet->avcc) {
 		obs_parse_avc_packet(&parsed_packet, packet);
 		write_packet(stream, &parsed_packet, false);
 		obs_free_encoder_packet(&parsed_packet);
@@ -0,0 +1,642 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/array-serializer.h>
+#include "mp4-mux.h"
+
+#define MOVIE_TIMESCALE    1000
+#define LANGUAGE_UND       0x55C4
+
+#define TFHD_BASE_IS_MOOF  0x020000
+
+#define TRUN_DATA_OFFSET   0x000001
+#define TRUN_DURATION      0x000100
+#define TRUN_SIZE          0x000200
+#define TRUN_FLAGS         0x000400
+#define TRUN_CTS_OFFSET    0x000800
+
+#define SAMPLE_SYNC        0x02000000
+#define SAMPLE_NON_SYNC    0x01010000
+
+static const uint32_t unity_matrix[9] = {
+	0x00010000, 0, 0,
+	0, 0x00010000, 0,
+	0, 0, 0x40000000
+};
+
+/* ------------------------------------------------------------------------- */
+/* box helpers, only usable with array serializers                           */
+
+static inline void patch_wb32(struct serializer *s, size_t pos, uint32_t val)
+{
+	struct array_output_data *output = s->data;
+	uint8_t *p = output->bytes.array + pos;
+
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+static inline size_t start_box(struct serializer *s, const char *type)
+{
+	size_t pos = (size_t)serializer_get_pos(s);
+
+	s_wb32(s, 0);
+	s_write(s, type, 4);
+	return pos;
+}
+
+static inline size_t start_full_box(struct serializer *s, const char *type,
+		uint8_t version, uint32_t flags)
+{
+	size_t pos = start_box(s, type);
+
+	s_w8(s, version);
+	s_wb24(s, flags);
+	return pos;
+}
+
+static inline void end_box(struct serializer *s, size_t pos)
+{
+	patch_wb32(s, pos, (uint32_t)(serializer_get_pos(s) - pos));
+}
+
+static inline void write_zeros(struct serializer *s, size_t count)
+{
+	while (count--)
+		s_w8(s, 0);
+}
+
+static inline void write_matrix(struct serializer *s)
+{
+	for (size_t i = 0; i < 9; i++)
+		s_wb32(s, unity_matrix[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* init segment                                                              */
+
+static void write_ftyp(struct serializer *s)
+{
+	size_t box = start_box(s, "ftyp");
+
+	s_write(s, "isom", 4);
+	s_wb32(s, 0x200);
+	s_write(s, "isom", 4);
+	s_write(s, "iso6", 4);
+	s_write(s, "avc1", 4);
+	s_write(s, "mp41", 4);
+
+	end_box(s, box);
+}
+
+static void write_mvhd(struct serializer *s)
+{
+	size_t box = start_full_box(s, "mvhd", 0, 0);
+
+	s_wb32(s, 0);                   /* creation time */
+	s_wb32(s, 0);                   /* modification time */
+	s_wb32(s, MOVIE_TIMESCALE);
+	s_wb32(s, 0);                   /* duration, unknown when fragmented */
+	s_wb32(s, 0x00010000);          /* rate 1.0 */
+	s_wb16(s, 0x0100);              /* volume 1.0 */
+	write_zeros(s, 10);
+	write_matrix(s);
+	write_zeros(s, 24);
+	s_wb32(s, MP4_TRACKS + 1);      /* next track id */
+
+	end_box(s, box);
+}
+
+static void write_tkhd(struct serializer *s, size_t track, uint32_t width,
+		uint32_t height)
+{
+	size_t box = start_full_box(s, "tkhd", 0, 0x3);
+
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, (uint32_t)track + 1);
+	s_wb32(s, 0);
+	s_wb32(s, 0);                   /* duration */
+	write_zeros(s, 8);
+	s_wb16(s, 0);                   /* layer */
+	s_wb16(s, 0);                   /* alternate group */
+	s_wb16(s, track == MP4_AUDIO_TRACK ? 0x0100 : 0);
+	s_wb16(s, 0);
+	write_matrix(s);
+	s_wb32(s, width << 16);
+	s_wb32(s, height << 16);
+
+	end_box(s, box);
+}
+
+/* maps the start of the presentation to the first video frame, which is
+ * delayed by reordering */
+static void write_edts(struct serializer *s, int32_t media_time)
+{
+	size_t edts = start_box(s, "edts");
+	size_t elst = start_full_box(s, "elst", 0, 0);
+
+	s_wb32(s, 1);
+	s_wb32(s, 0);                   /* duration of the whole track */
+	s_wb32(s, (uint32_t)media_time);
+	s_wb16(s, 1);
+	s_wb16(s, 0);
+
+	end_box(s, elst);
+	end_box(s, edts);
+}
+
+static void write_mdhd(struct serializer *s, uint32_t timescale)
+{
+	size_t box = start_full_box(s, "mdhd", 0, 0);
+
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, timescale);
+	s_wb32(s, 0);
+	s_wb16(s, LANGUAGE_UND);
+	s_wb16(s, 0);
+
+	end_box(s, box);
+}
+
+static void write_hdlr(struct serializer *s, bool video)
+{
+	const char *name = video ? "VideoHandler" : "SoundHandler";
+	size_t box = start_full_box(s, "hdlr", 0, 0);
+
+	s_wb32(s, 0);
+	s_write(s, video ? "vide" : "soun", 4);
+	write_zeros(s, 12);
+	s_write(s, name, strlen(name) + 1);
+
+	end_box(s, box);
+}
+
+static void write_dinf(struct serializer *s)
+{
+	size_t dinf = start_box(s, "dinf");
+	size_t dref = start_full_box(s, "dref", 0, 0);
+	size_t url;
+
+	s_wb32(s, 1);
+	url = start_full_box(s, "url ", 0, 1); /* data is in this file */
+	end_box(s, url);
+
+	end_box(s, dref);
+	end_box(s, dinf);
+}
+
+static void write_avc1(struct serializer *s, obs_encoder_t *vencoder)
+{
+	size_t box = start_box(s, "avc1");
+	uint8_t *extra_data = NULL;
+	uint8_t *header = NULL;
+	size_t extra_size = 0;
+	size_t header_size;
+	size_t avcc;
+
+	write_zeros(s, 6);
+	s_wb16(s, 1);                   /* data reference index */
+	write_zeros(s, 16);
+	s_wb16(s, (uint16_t)obs_encoder_get_width(vencoder));
+	s_wb16(s, (uint16_t)obs_encoder_get_height(vencoder));
+	s_wb32(s, 0x00480000);          /* 72 dpi */
+	s_wb32(s, 0x00480000);
+	s_wb32(s, 0);
+	s_wb16(s, 1);                   /* frame count */
+	write_zeros(s, 32);             /* compressor name */
+	s_wb16(s, 0x0018);              /* depth */
+	s_wb16(s, 0xFFFF);
+
+	obs_encoder_get_extra_data(vencoder, &extra_data, &extra_size);
+	header_size = obs_parse_avc_header(&header, extra_data, extra_size);
+
+	avcc = start_box(s, "avcC");
+	s_write(s, header, header_size);
+	end_box(s, avcc);
+	bfree(header);
+
+	end_box(s, box);
+}
+
+static inline void write_descriptor(struct serializer *s, uint8_t tag,
+		size_t size)
+{
+	s_w8(s, tag);
+	s_w8(s, (uint8_t)(0x80 | ((size >> 21) & 0x7F)));
+	s_w8(s, (uint8_t)(0x80 | ((size >> 14) & 0x7F)));
+	s_w8(s, (uint8_t)(0x80 | ((size >> 7)  & 0x7F)));
+	s_w8(s, (uint8_t)(size & 0x7F));
+}
+
+#define DESCRIPTOR_HEADER_SIZE 5
+
+static void write_esds(struct serializer *s, obs_encoder_t *aencoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(aencoder);
+	uint32_t bitrate = (uint32_t)obs_data_get_int(settings, "bitrate");
+	uint8_t *config = NULL;
+	size_t config_size = 0;
+	size_t dec_config_size;
+	size_t box;
+
+	obs_data_release(settings);
+	obs_encoder_get_extra_data(aencoder, &config, &config_size);
+
+	dec_config_size = 13 + DESCRIPTOR_HEADER_SIZE + config_size;
+
+	box = start_full_box(s, "esds", 0, 0);
+
+	write_descriptor(s, 0x03, 3 + DESCRIPTOR_HEADER_SIZE +
+			dec_config_size + DESCRIPTOR_HEADER_SIZE + 1);
+	s_wb16(s, MP4_AUDIO_TRACK + 1);
+	s_w8(s, 0);
+
+	write_descriptor(s, 0x04, dec_config_size);
+	s_w8(s, 0x40);                  /* aac */
+	s_w8(s, 0x15);                  /* audio stream */
+	s_wb24(s, 0);
+	s_wb32(s, bitrate * 1000);
+	s_wb32(s, bitrate * 1000);
+
+	write_descriptor(s, 0x05, config_size);
+	s_write(s, config, config_size);
+
+	write_descriptor(s, 0x06, 1);
+	s_w8(s, 0x02);
+
+	end_box(s, box);
+}
+
+static void write_mp4a(struct serializer *s, obs_encoder_t *aencoder)
+{
+	audio_t *audio = obs_encoder_audio(aencoder);
+	size_t box = start_box(s, "mp4a");
+
+	write_zeros(s, 6);
+	s_wb16(s, 1);
+	write_zeros(s, 8);
+	s_wb16(s, (uint16_t)audio_output_get_channels(audio));
+	s_wb16(s, 16);
+	s_wb16(s, 0);
+	s_wb16(s, 0);
+	s_wb32(s, audio_output_get_sample_rate(audio) << 16);
+
+	write_esds(s, aencoder);
+
+	end_box(s, box);
+}
+
+/* fragmented tracks have empty sample tables */
+static void write_stbl(struct serializer *s, obs_encoder_t *encoder,
+		bool video)
+{
+	size_t stbl = start_box(s, "stbl");
+	size_t stsd = start_full_box(s, "stsd", 0, 0);
+	size_t box;
+
+	s_wb32(s, 1);
+	if (video)
+		write_avc1(s, encoder);
+	else
+		write_mp4a(s, encoder);
+	end_box(s, stsd);
+
+	box = start_full_box(s, "stts", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, box);
+
+	box = start_full_box(s, "stsc", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, box);
+
+	box = start_full_box(s, "stsz", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	end_box(s, box);
+
+	box = start_full_box(s, "stco", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, box);
+
+	end_box(s, stbl);
+}
+
+static void write_trak(struct mp4_mux *mux, struct serializer *s,
+		size_t track)
+{
+	bool video = track == MP4_VIDEO_TRACK;
+	obs_encoder_t *encoder = video ?
+		obs_output_get_video_encoder(mux->output) :
+		obs_output_get_audio_encoder(mux->output, 0);
+	struct mp4_track *t = mux->tracks + track;
+	size_t trak, mdia, minf, box;
+
+	trak = start_box(s, "trak");
+
+	if (video) {
+		write_tkhd(s, track, obs_encoder_get_width(encoder),
+				obs_encoder_get_height(encoder));
+		if (t->samples.num && t->samples.array[0].cts_offset)
+			write_edts(s, t->samples.array[0].cts_offset);
+	} else {
+		write_tkhd(s, track, 0, 0);
+	}
+
+	mdia = start_box(s, "mdia");
+	write_mdhd(s, t->timescale);
+	write_hdlr(s, video);
+
+	minf = start_box(s, "minf");
+	if (video) {
+		box = start_full_box(s, "vmhd", 0, 1);
+		write_zeros(s, 8);
+	} else {
+		box = start_full_box(s, "smhd", 0, 0);
+		write_zeros(s, 4);
+	}
+	end_box(s, box);
+
+	write_dinf(s);
+	write_stbl(s, encoder, video);
+
+	end_box(s, minf);
+	end_box(s, mdia);
+	end_box(s, trak);
+}
+
+static void write_mvex(struct serializer *s)
+{
+	size_t mvex = start_box(s, "mvex");
+
+	for (size_t i = 0; i < MP4_TRACKS; i++) {
+		size_t trex = start_full_box(s, "trex", 0, 0);
+
+		s_wb32(s, (uint32_t)i + 1);
+		s_wb32(s, 1);           /* sample description index */
+		s_wb32(s, 0);
+		s_wb32(s, 0);
+		s_wb32(s, 0);
+
+		end_box(s, trex);
+	}
+
+	end_box(s, mvex);
+}
+
+static void write_init_segment(struct mp4_mux *mux, struct serializer *s)
+{
+	size_t moov;
+
+	write_ftyp(s);
+
+	moov = start_box(s, "moov");
+	write_mvhd(s);
+	for (size_t i = 0; i < MP4_TRACKS; i++)
+		write_trak(mux, s, i);
+	write_mvex(s);
+	end_box(s, moov);
+}
+
+/* ------------------------------------------------------------------------- */
+/* fragments                                                                 */
+
+static inline int64_t sample_duration(struct mp4_track *track, size_t idx,
+		int64_t next_dts)
+{
+	if (idx + 1 < track->samples.num)
+		next_dts = track->samples.array[idx + 1].dts;
+
+	if (next_dts > track->samples.array[idx].dts)
+		track->last_duration = next_dts - track->samples.array[idx].dts;
+
+	return track->last_duration;
+}
+
+/* returns the position of the data offset, which is patched afterwards */
+static size_t write_traf(struct mp4_mux *mux, struct serializer *s,
+		size_t idx, int64_t next_dts)
+{
+	struct mp4_track *track = mux->tracks + idx;
+	uint64_t decode_time;
+	size_t traf, box, data_offset;
+
+	decode_time = (uint64_t)(track->samples.array[0].dts -
+			track->start_dts);
+
+	traf = start_box(s, "traf");
+
+	box = start_full_box(s, "tfhd", 0, TFHD_BASE_IS_MOOF);
+	s_wb32(s, (uint32_t)idx + 1);
+	end_box(s, box);
+
+	box = start_full_box(s, "tfdt", 1, 0);
+	s_wb64(s, decode_time);
+	end_box(s, box);
+
+	box = start_full_box(s, "trun", 1, TRUN_DATA_OFFSET | TRUN_DURATION |
+			TRUN_SIZE | TRUN_FLAGS | TRUN_CTS_OFFSET);
+	s_wb32(s, (uint32_t)track->samples.num);
+
+	data_offset = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+
+	for (size_t i = 0; i < track->samples.num; i++) {
+		struct mp4_sample *sample = track->samples.array + i;
+
+		s_wb32(s, (uint32_t)sample_duration(track, i, next_dts));
+		s_wb32(s, sample->size);
+		s_wb32(s, sample->keyframe ? SAMPLE_SYNC : SAMPLE_NON_SYNC);
+		s_wb32(s, (uint32_t)sample->cts_offset);
+	}
+
+	end_box(s, box);
+	end_box(s, traf);
+
+	return data_offset;
+}
+
+static void write_moof(struct mp4_mux *mux, struct serializer *s,
+		int64_t next_video_dts)
+{
+	size_t data_offsets[MP4_TRACKS] = {0};
+	size_t moof, box, offset;
+
+	moof = start_box(s, "moof");
+
+	box = start_full_box(s, "mfhd", 0, 0);
+	s_wb32(s, ++mux->sequence);
+	end_box(s, box);
+
+	for (size_t i = 0; i < MP4_TRACKS; i++) {
+		if (mux->tracks[i].samples.num)
+			data_offsets[i] = write_traf(mux, s, i,
+					i == MP4_VIDEO_TRACK ?
+					next_video_dts : -1);
+	}
+
+	end_box(s, moof);
+
+	/* the payload of each track follows the mdat header in track order */
+	offset = (size_t)serializer_get_pos(s) - moof + 8;
+
+	for (size_t i = 0; i < MP4_TRACKS; i++) {
+		if (!mux->tracks[i].samples.num)
+			continue;
+
+		patch_wb32(s, data_offsets[i], (uint32_t)offset);
+		offset += mux->tracks[i].data.num;
+	}
+
+	s_wb32(s, (uint32_t)(offset - ((size_t)serializer_get_pos(s) - moof)));
+	s_write(s, "mdat", 4);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void mp4_mux_init(struct mp4_mux *mux, obs_output_t *output)
+{
+	memset(mux, 0, sizeof(struct mp4_mux));
+	mux->output = output;
+	obs_avc_nal_index_init(&mux->nal_index);
+}
+
+void mp4_mux_free(struct mp4_mux *mux)
+{
+	for (size_t i = 0; i < MP4_TRACKS; i++) {
+		da_free(mux->tracks[i].samples);
+		da_free(mux->tracks[i].data);
+	}
+
+	obs_avc_nal_index_free(&mux->nal_index);
+}
+
+/* writes length prefixed NALs straight to the fragment data.  the NALs are
+ * indexed first, so the output size is known and the data only grows once */
+static size_t push_avc_data(struct mp4_mux *mux, struct mp4_track *track,
+		const uint8_t *data, size_t size)
+{
+	struct obs_avc_nal_index *index = &mux->nal_index;
+	size_t start_size = track->data.num;
+	size_t total = 0;
+	uint8_t *out;
+
+	obs_avc_nal_index_build(index, data, size, false);
+
+	for (size_t i = 0; i < index->nals.num; i++)
+		total += index->nals.array[i].size + 4;
+
+	da_resize(track->data, start_size + total);
+	out = track->data.array + start_size;
+
+	for (size_t i = 0; i < index->nals.num; i++) {
+		const struct obs_avc_nal *nal = index->nals.array + i;
+		uint32_t nal_size = (uint32_t)nal->size;
+
+		out[0] = (uint8_t)(nal_size >> 24);
+		out[1] = (uint8_t)(nal_size >> 16);
+		out[2] = (uint8_t)(nal_size >> 8);
+		out[3] = (uint8_t)nal_size;
+		memcpy(out + 4, data + nal->offset, nal_size);
+		out += nal_size + 4;
+	}
+
+	return total;
+}
+
+void mp4_mux_push(struct mp4_mux *mux, const struct encoder_packet *packet)
+{
+	bool video = packet->type == OBS_ENCODER_VIDEO;
+	struct mp4_track *track = mux->tracks +
+		(video ? MP4_VIDEO_TRACK : MP4_AUDIO_TRACK);
+	struct mp4_sample *sample;
+
+	if (!track->started) {
+		track->timescale = (uint32_t)packet->timebase_den;
+		track->start_dts = packet->dts;
+		track->started   = true;
+	}
+
+	sample = da_push_back_new(track->samples);
+	sample->dts        = packet->dts;
+	sample->cts_offset = (int32_t)(packet->pts - packet->dts);
+	sample->keyframe   = video ? packet->keyframe : true;
+
+	if (video && !packet->avcc) {
+		sample->size = (uint32_t)push_avc_data(mux, track,
+				packet->data, packet->size);
+	} else {
+		da_push_back_array(track->data, packet->data, packet->size);
+		sample->size = (uint32_t)packet->size;
+	}
+}
+
+int64_t mp4_mux_fragment_duration(const struct mp4_mux *mux)
+{
+	const struct mp4_track *track = mux->tracks + MP4_VIDEO_TRACK;
+	int64_t first, last;
+
+	if (!track->samples.num || !track->timescale)
+		return 0;
+
+	first = track->samples.array[0].dts;
+	last  = track->samples.array[track->samples.num - 1].dts;
+	return (last - first) * 1000000 / track->timescale;
+}
+
+bool mp4_mux_flush(struct mp4_mux *mux, struct mp4_fragment *fragment,
+		int64_t next_video_dts)
+{
+	struct array_output_data output;
+	struct serializer s;
+
+	memset(fragment, 0, sizeof(struct mp4_fragment));
+
+	/* the init segment needs the codec headers and the first video
+	 * frame, so it is written along with the first fragment */
+	if (!mux->wrote_init && !mux->tracks[MP4_VIDEO_TRACK].samples.num)
+		return false;
+	if (!mux->tracks[MP4_VIDEO_TRACK].samples.num &&
+	    !mux->tracks[MP4_AUDIO_TRACK].samples.num)
+		return false;
+
+	array_output_serializer_init(&s, &output);
+
+	if (!mux->wrote_init) {
+		write_init_segment(mux, &s);
+		mux->wrote_init = true;
+	}
+
+	write_moof(mux, &s, next_video_dts);
+
+	da_move(fragment->header, output.bytes);
+
+	/* hand the payloads over to the fragment instead of copying them */
+	for (size_t i = 0; i < MP4_TRACKS; i++) {
+		struct mp4_track *track = mux->tracks + i;
+
+		da_move(fragment->data[i], track->data);
+		da_resize(track->samples, 0);
+	}
+
+	return true;
+}
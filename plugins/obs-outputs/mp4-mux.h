@@ -0,0 +1,100 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/darray.h>
+
+/*
+ * Fragmented MP4 (ISO BMFF) muxer, hard-coded to h264 and aac like the FLV
+ * muxer.  Packets are appended to the current fragment as they come in, and
+ * each fragment is a self-contained moof/mdat pair, so a file cut off at any
+ * fragment boundary is still playable.
+ */
+
+#define MP4_VIDEO_TRACK 0
+#define MP4_AUDIO_TRACK 1
+#define MP4_TRACKS      2
+
+struct mp4_sample {
+	uint32_t size;
+	int64_t  dts;
+	int32_t  cts_offset;
+	bool     keyframe;
+};
+
+struct mp4_track {
+	uint32_t                  timescale;
+	bool                      started;
+	int64_t                   start_dts;
+	int64_t                   last_duration;
+
+	DARRAY(struct mp4_sample) samples;
+	DARRAY(uint8_t)           data;
+};
+
+struct mp4_mux {
+	obs_output_t              *output;
+	struct mp4_track          tracks[MP4_TRACKS];
+	uint32_t                  sequence;
+	bool                      wrote_init;
+
+	/* reused for every video packet that needs start codes replaced */
+	struct obs_avc_nal_index  nal_index;
+};
+
+/* a finished fragment: boxes, followed by the mdat payload of each track */
+struct mp4_fragment {
+	DARRAY(uint8_t)           header;
+	DARRAY(uint8_t)           data[MP4_TRACKS];
+};
+
+extern void mp4_mux_init(struct mp4_mux *mux, obs_output_t *output);
+extern void mp4_mux_free(struct mp4_mux *mux);
+
+/* appends a packet to the current fragment, annex-b video is converted to
+ * length prefixed NALs while it is copied */
+extern void mp4_mux_push(struct mp4_mux *mux,
+		const struct encoder_packet *packet);
+
+/* duration of the video in the current fragment, in microseconds */
+extern int64_t mp4_mux_fragment_duration(const struct mp4_mux *mux);
+
+/*
+ * Moves the current fragment to 'fragment', prefixed by the init segment if
+ * it is the first one.  'next_video_dts' is the dts of the packet that
+ * starts the next fragment, or -1 if there is none.
+ */
+extern bool mp4_mux_flush(struct mp4_mux *mux, struct mp4_fragment *fragment,
+		int64_t next_video_dts);
+
+static inline size_t mp4_fragment_size(const struct mp4_fragment *fragment)
+{
+	size_t size = fragment->header.num;
+	for (size_t i = 0; i < MP4_TRACKS; i++)
+		size += fragment->data[i].num;
+	return size;
+}
+
+static inline void mp4_fragment_free(struct mp4_fragment *fragment)
+{
+	da_free(fragment->header);
+	for (size_t i = 0; i < MP4_TRACKS; i++)
+		da_free(fragment->data[i]);
+}
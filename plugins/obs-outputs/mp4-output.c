@@ -0,0 +1,332 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+#include <inttypes.h>
+#include "mp4-mux.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define do_log(level, format, ...) \
+	blog(level, "[mp4 output: '%s'] " format, \
+			obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* fragments are cut at the first keyframe after this much video */
+#define DEFAULT_FRAGMENT_MS 2000
+
+struct mp4_output {
+	obs_output_t     *output;
+	struct dstr      path;
+	FILE             *file;
+	bool             active;
+
+	pthread_mutex_t  mux_mutex;
+	struct mp4_mux   mux;
+	int64_t          fragment_usec;
+
+	/* fragments waiting for the write thread */
+	pthread_t        write_thread;
+	bool             write_thread_active;
+	pthread_mutex_t  write_mutex;
+	os_sem_t         *write_sem;
+	struct circlebuf fragments;
+	bool             stopping;
+
+	uint64_t         total_bytes;
+	bool             write_failed;
+};
+
+static const char *mp4_output_getname(void)
+{
+	return obs_module_text("MP4Output");
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* makes sure the fragment reached the disk, not only the page cache, so a
+ * power loss cannot leave a partly written fragment behind earlier ones */
+static inline void sync_file(FILE *file)
+{
+	fflush(file);
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+}
+
+static bool write_fragment(struct mp4_output *stream,
+		struct mp4_fragment *fragment)
+{
+	size_t size = mp4_fragment_size(fragment);
+	size_t written;
+
+	written = fwrite(fragment->header.array, 1, fragment->header.num,
+			stream->file);
+	for (size_t i = 0; i < MP4_TRACKS; i++)
+		written += fwrite(fragment->data[i].array, 1,
+				fragment->data[i].num, stream->file);
+
+	sync_file(stream->file);
+	stream->total_bytes += written;
+	return written == size;
+}
+
+static void *write_thread(void *data)
+{
+	struct mp4_output *stream = data;
+
+	os_set_thread_name("mp4-output: write thread");
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		struct mp4_fragment fragment;
+		bool have_fragment = false;
+		bool stopping;
+
+		pthread_mutex_lock(&stream->write_mutex);
+		if (stream->fragments.size) {
+			circlebuf_pop_front(&stream->fragments, &fragment,
+					sizeof(fragment));
+			have_fragment = true;
+		}
+		stopping = stream->stopping;
+		pthread_mutex_unlock(&stream->write_mutex);
+
+		if (have_fragment) {
+			if (!stream->write_failed &&
+			    !write_fragment(stream, &fragment)) {
+				warn("Failed to write to '%s'",
+						stream->path.array);
+				stream->write_failed = true;
+				obs_output_signal_stop(stream->output,
+						OBS_OUTPUT_ERROR);
+			}
+
+			mp4_fragment_free(&fragment);
+
+		} else if (stopping) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void queue_fragment(struct mp4_output *stream,
+		struct mp4_fragment *fragment)
+{
+	pthread_mutex_lock(&stream->write_mutex);
+	circlebuf_push_back(&stream->fragments, fragment, sizeof(*fragment));
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	os_sem_post(stream->write_sem);
+}
+
+static void flush_fragment(struct mp4_output *stream, int64_t next_video_dts)
+{
+	struct mp4_fragment fragment;
+
+	if (mp4_mux_flush(&stream->mux, &fragment, next_video_dts))
+		queue_fragment(stream, &fragment);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void mp4_output_stop(void *data);
+
+static void mp4_output_destroy(void *data)
+{
+	struct mp4_output *stream = data;
+
+	if (stream->active)
+		mp4_output_stop(data);
+
+	os_sem_destroy(stream->write_sem);
+	pthread_mutex_destroy(&stream->write_mutex);
+	pthread_mutex_destroy(&stream->mux_mutex);
+	circlebuf_free(&stream->fragments);
+	dstr_free(&stream->path);
+	bfree(stream);
+}
+
+static void *mp4_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct mp4_output *stream = bzalloc(sizeof(struct mp4_output));
+	stream->output = output;
+	pthread_mutex_init_value(&stream->write_mutex);
+	pthread_mutex_init_value(&stream->mux_mutex);
+
+	if (pthread_mutex_init(&stream->write_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stream->mux_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	mp4_output_destroy(stream);
+	return NULL;
+}
+
+static void mp4_output_stop(void *data)
+{
+	struct mp4_output *stream = data;
+
+	if (!stream->active)
+		return;
+
+	obs_output_end_data_capture(stream->output);
+
+	pthread_mutex_lock(&stream->mux_mutex);
+	flush_fragment(stream, -1);
+	mp4_mux_free(&stream->mux);
+	pthread_mutex_unlock(&stream->mux_mutex);
+
+	if (stream->write_thread_active) {
+		pthread_mutex_lock(&stream->write_mutex);
+		stream->stopping = true;
+		pthread_mutex_unlock(&stream->write_mutex);
+
+		os_sem_post(stream->write_sem);
+		pthread_join(stream->write_thread, NULL);
+		stream->write_thread_active = false;
+	}
+
+	/* some file systems only report failed writes on close */
+	if (fclose(stream->file) != 0 && !stream->write_failed) {
+		warn("Failed to close '%s'", stream->path.array);
+		stream->write_failed = true;
+	}
+
+	stream->file   = NULL;
+	stream->active = false;
+
+	if (stream->write_failed)
+		warn("MP4 file output failed, %"PRIu64" bytes written",
+				stream->total_bytes);
+	else
+		info("MP4 file output complete, %"PRIu64" bytes written",
+				stream->total_bytes);
+}
+
+static bool mp4_output_start(void *data)
+{
+	struct mp4_output *stream = data;
+	obs_data_t *settings;
+	const char *path;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	settings = obs_output_get_settings(stream->output);
+	path = obs_data_get_string(settings, "path");
+	dstr_copy(&stream->path, path);
+	stream->fragment_usec =
+		obs_data_get_int(settings, "fragment_ms") * 1000;
+	obs_data_release(settings);
+
+	stream->file = os_fopen(stream->path.array, "wb");
+	if (!stream->file) {
+		warn("Unable to open MP4 file '%s'", stream->path.array);
+		return false;
+	}
+
+	mp4_mux_init(&stream->mux, stream->output);
+	stream->total_bytes  = 0;
+	stream->write_failed = false;
+	stream->stopping     = false;
+
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+				stream) != 0) {
+		warn("Failed to create write thread");
+		fclose(stream->file);
+		stream->file = NULL;
+		return false;
+	}
+
+	stream->write_thread_active = true;
+	stream->active = true;
+	obs_output_begin_data_capture(stream->output, 0);
+
+	info("Writing MP4 file '%s'...", stream->path.array);
+	return true;
+}
+
+static void mp4_output_data(void *data, struct encoder_packet *packet)
+{
+	struct mp4_output *stream = data;
+
+	pthread_mutex_lock(&stream->mux_mutex);
+
+	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe &&
+	    mp4_mux_fragment_duration(&stream->mux) >= stream->fragment_usec)
+		flush_fragment(stream, packet->dts);
+
+	mp4_mux_push(&stream->mux, packet);
+
+	pthread_mutex_unlock(&stream->mux_mutex);
+}
+
+static void mp4_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "fragment_ms", DEFAULT_FRAGMENT_MS);
+}
+
+static obs_properties_t *mp4_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, "path",
+			obs_module_text("MP4Output.FilePath"),
+			OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, "fragment_ms",
+			obs_module_text("MP4Output.FragmentDuration"),
+			100, 60000, 100);
+	return props;
+}
+
+struct obs_output_info mp4_output_info = {
+	.id             = "mp4_output",
+	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name       = mp4_output_getname,
+	.create         = mp4_output_create,
+	.destroy        = mp4_output_destroy,
+	.start          = mp4_output_start,
+	.stop           = mp4_output_stop,
+	.encoded_packet = mp4_output_data,
+	.get_defaults   = mp4_output_defaults,
+	.get_properties = mp4_output_properties
+};
@@ -0,0 +1,521 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <inttypes.h>
+#include "flv-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[replay buffer: '%s'] " format, \
+			obs_output_get_name(rb->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+#define OPT_DIRECTORY    "directory"
+#define OPT_MAX_TIME_SEC "max_time_sec"
+#define OPT_MAX_SIZE_MB  "max_size_mb"
+
+/*
+ * Replay buffer
+ *
+ *   Keeps the most recent encoded packets in memory instead of writing them
+ * out, and writes them to an FLV file when asked to (through the "save" proc
+ * or the hotkey).  The buffer always starts on a video keyframe: whole
+ * groups of pictures are dropped from the front once the buffer is longer or
+ * larger than configured.  Saving copies the packets and muxes them on a
+ * separate thread, so the encoders and the buffer keep running.
+ */
+
+struct replay_buffer {
+	obs_output_t     *output;
+
+	pthread_mutex_t  mutex;
+	struct circlebuf packets;
+	size_t           keyframes;
+	size_t           total_bytes;
+	bool             active;
+
+	int64_t          max_time_usec;
+	size_t           max_size_bytes;
+	struct dstr      directory;
+
+	obs_hotkey_id    hotkey;
+
+	pthread_t        save_thread;
+	bool             save_thread_active;
+	volatile bool    saving;
+
+	/* owned by the save thread while saving */
+	struct circlebuf save_packets;
+	struct dstr      save_path;
+};
+
+static const char *replay_buffer_getname(void)
+{
+	return obs_module_text("ReplayBuffer");
+}
+
+static inline bool is_keyframe(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+}
+
+static inline struct encoder_packet *get_packet(struct circlebuf *packets,
+		size_t idx)
+{
+	return circlebuf_data(packets, idx * sizeof(struct encoder_packet));
+}
+
+static inline size_t num_packets(const struct circlebuf *packets)
+{
+	return packets->size / sizeof(struct encoder_packet);
+}
+
+static void pop_packet(struct replay_buffer *rb)
+{
+	struct encoder_packet packet;
+
+	circlebuf_pop_front(&rb->packets, &packet, sizeof(packet));
+
+	if (is_keyframe(&packet))
+		rb->keyframes--;
+	rb->total_bytes -= packet.size;
+
+	obs_free_encoder_packet(&packet);
+}
+
+static inline void free_packets(struct circlebuf *packets)
+{
+	while (packets->size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(packets, &packet, sizeof(packet));
+		obs_free_encoder_packet(&packet);
+	}
+}
+
+static void clear_buffer(struct replay_buffer *rb)
+{
+	free_packets(&rb->packets);
+	rb->keyframes   = 0;
+	rb->total_bytes = 0;
+}
+
+static inline int64_t buffer_duration(struct replay_buffer *rb)
+{
+	struct encoder_packet *first, *last;
+
+	if (!rb->packets.size)
+		return 0;
+
+	first = get_packet(&rb->packets, 0);
+	last  = get_packet(&rb->packets, num_packets(&rb->packets) - 1);
+	return last->dts_usec - first->dts_usec;
+}
+
+/* drops the first group of pictures, unless it is the only one */
+static bool drop_first_gop(struct replay_buffer *rb)
+{
+	if (rb->keyframes < 2)
+		return false;
+
+	do {
+		pop_packet(rb);
+	} while (!is_keyframe(get_packet(&rb->packets, 0)));
+
+	return true;
+}
+
+static void trim_buffer(struct replay_buffer *rb)
+{
+	while (buffer_duration(rb) > rb->max_time_usec ||
+	       rb->total_bytes > rb->max_size_bytes) {
+		if (!drop_first_gop(rb))
+			break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void write_packet(FILE *file, struct encoder_packet *packet,
+		bool is_header, int64_t *last_ts)
+{
+	uint8_t *data;
+	size_t  size;
+
+	if (!is_header)
+		*last_ts = get_ms_time(packet, packet->dts);
+
+	flv_packet_mux(packet, &data, &size, is_header);
+	fwrite(data, 1, size, file);
+	bfree(data);
+}
+
+static void write_headers(struct replay_buffer *rb, FILE *file)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(rb->output);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(rb->output, 0);
+	uint8_t       *meta_data;
+	size_t        meta_data_size;
+	uint8_t       *header;
+	size_t        size;
+	int64_t       ts;
+
+	struct encoder_packet audio_packet = {
+		.type         = OBS_ENCODER_AUDIO,
+		.timebase_den = 1
+	};
+	struct encoder_packet video_packet = {
+		.type         = OBS_ENCODER_VIDEO,
+		.timebase_den = 1,
+		.keyframe     = true
+	};
+
+	flv_meta_data(rb->output, &meta_data, &meta_data_size, true, 0);
+	fwrite(meta_data, 1, meta_data_size, file);
+	bfree(meta_data);
+
+	obs_encoder_get_extra_data(aencoder, &header, &size);
+	audio_packet.data = header;
+	audio_packet.size = size;
+	write_packet(file, &audio_packet, true, &ts);
+
+	obs_encoder_get_extra_data(vencoder, &header, &size);
+	video_packet.size = obs_parse_avc_header(&video_packet.data, header,
+			size);
+	write_packet(file, &video_packet, true, &ts);
+	bfree(video_packet.data);
+}
+
+/* timestamps of the file start at the first keyframe */
+static inline void rebase_packet(struct encoder_packet *packet,
+		int64_t start_usec)
+{
+	int64_t num = packet->timebase_num ? packet->timebase_num : 1;
+	int64_t offset = start_usec * packet->timebase_den / (num * 1000000);
+
+	packet->dts -= offset;
+	packet->pts -= offset;
+}
+
+static void *save_thread(void *data)
+{
+	struct replay_buffer *rb = data;
+	struct calldata params = {0};
+	int64_t start_usec = 0;
+	int64_t last_ts = 0;
+	size_t count = num_packets(&rb->save_packets);
+	FILE *file;
+
+	os_set_thread_name("replay buffer: save thread");
+
+	file = os_fopen(rb->save_path.array, "wb");
+	if (!file) {
+		warn("Unable to open replay file '%s'", rb->save_path.array);
+		goto finish;
+	}
+
+	if (count)
+		start_usec = get_packet(&rb->save_packets, 0)->dts_usec;
+
+	write_headers(rb, file);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *packet;
+
+		packet = get_packet(&rb->save_packets, i);
+
+		rebase_packet(packet, start_usec);
+		write_packet(file, packet, false, &last_ts);
+	}
+
+	write_file_info(file, last_ts, os_ftelli64(file));
+	fclose(file);
+
+	info("Saved %d ms (%"PRIu64" packets) to '%s'", (int)last_ts,
+			(uint64_t)count, rb->save_path.array);
+
+	calldata_set_ptr(&params, "output", rb->output);
+	calldata_set_string(&params, "path", rb->save_path.array);
+	signal_handler_signal(obs_output_get_signal_handler(rb->output),
+			"replay_saved", &params);
+	calldata_free(&params);
+
+finish:
+	free_packets(&rb->save_packets);
+
+	pthread_mutex_lock(&rb->mutex);
+	rb->saving = false;
+	pthread_mutex_unlock(&rb->mutex);
+	return NULL;
+}
+
+static void join_save_thread(struct replay_buffer *rb)
+{
+	if (rb->save_thread_active) {
+		pthread_join(rb->save_thread, NULL);
+		rb->save_thread_active = false;
+	}
+}
+
+static void generate_path(struct replay_buffer *rb)
+{
+	char file_name[64];
+	time_t now = time(NULL);
+
+	strftime(file_name, sizeof(file_name), "Replay %Y-%m-%d %H-%M-%S.flv",
+			localtime(&now));
+
+	dstr_copy_dstr(&rb->save_path, &rb->directory);
+	dstr_replace(&rb->save_path, "\\", "/");
+	if (rb->save_path.len && dstr_end(&rb->save_path) != '/')
+		dstr_cat_ch(&rb->save_path, '/');
+	dstr_cat(&rb->save_path, file_name);
+}
+
+static bool replay_buffer_save(struct replay_buffer *rb)
+{
+	size_t count;
+
+	pthread_mutex_lock(&rb->mutex);
+
+	if (rb->saving) {
+		pthread_mutex_unlock(&rb->mutex);
+		warn("Already saving a replay");
+		return false;
+	}
+
+	count = num_packets(&rb->packets);
+	if (!rb->active || !count) {
+		pthread_mutex_unlock(&rb->mutex);
+		return false;
+	}
+
+	/* the previous save thread has finished at this point */
+	join_save_thread(rb);
+	rb->saving = true;
+
+	/* the buffer keeps going while the copies are written */
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *packet = get_packet(&rb->packets, i);
+		struct encoder_packet copy;
+
+		obs_duplicate_encoder_packet(&copy, packet);
+		circlebuf_push_back(&rb->save_packets, &copy, sizeof(copy));
+	}
+
+	generate_path(rb);
+
+	if (pthread_create(&rb->save_thread, NULL, save_thread, rb) != 0) {
+		warn("Failed to create save thread");
+		free_packets(&rb->save_packets);
+		rb->saving = false;
+		pthread_mutex_unlock(&rb->mutex);
+		return false;
+	}
+
+	rb->save_thread_active = true;
+	pthread_mutex_unlock(&rb->mutex);
+	return true;
+}
+
+static void save_proc(void *data, calldata_t *params)
+{
+	calldata_set_bool(params, "success", replay_buffer_save(data));
+}
+
+static void save_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey,
+		bool pressed)
+{
+	struct replay_buffer *rb = data;
+
+	if (pressed && rb->active)
+		replay_buffer_save(rb);
+
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void replay_buffer_stop(void *data);
+
+static void replay_buffer_destroy(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active)
+		replay_buffer_stop(data);
+
+	obs_hotkey_unregister(rb->hotkey);
+	join_save_thread(rb);
+
+	clear_buffer(rb);
+	circlebuf_free(&rb->packets);
+	circlebuf_free(&rb->save_packets);
+	dstr_free(&rb->directory);
+	dstr_free(&rb->save_path);
+	pthread_mutex_destroy(&rb->mutex);
+	bfree(rb);
+}
+
+static void replay_buffer_update(void *data, obs_data_t *settings)
+{
+	struct replay_buffer *rb = data;
+	int64_t max_time = obs_data_get_int(settings, OPT_MAX_TIME_SEC);
+	int64_t max_size = obs_data_get_int(settings, OPT_MAX_SIZE_MB);
+
+	pthread_mutex_lock(&rb->mutex);
+
+	rb->max_time_usec  = max_time * 1000000;
+	rb->max_size_bytes = (size_t)max_size * 1024 * 1024;
+	dstr_copy(&rb->directory, obs_data_get_string(settings,
+				OPT_DIRECTORY));
+	trim_buffer(rb);
+
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct replay_buffer *rb = bzalloc(sizeof(struct replay_buffer));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+
+	rb->output = output;
+	pthread_mutex_init_value(&rb->mutex);
+
+	if (pthread_mutex_init(&rb->mutex, NULL) != 0) {
+		bfree(rb);
+		return NULL;
+	}
+
+	replay_buffer_update(rb, settings);
+
+	proc_handler_add(ph, "void save(out bool success)", save_proc, rb);
+	signal_handler_add(sh, "void replay_saved(ptr output, string path)");
+
+	rb->hotkey = obs_hotkey_register_output(output, "ReplayBuffer.Save",
+			obs_module_text("ReplayBuffer.Save"), save_hotkey, rb);
+	return rb;
+}
+
+static bool replay_buffer_start(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (!obs_output_can_begin_data_capture(rb->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(rb->output, 0))
+		return false;
+
+	rb->active = true;
+	obs_output_begin_data_capture(rb->output, 0);
+
+	info("Buffering up to %d seconds / %d MB",
+			(int)(rb->max_time_usec / 1000000),
+			(int)(rb->max_size_bytes / (1024 * 1024)));
+	return true;
+}
+
+static void replay_buffer_stop(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active) {
+		obs_output_end_data_capture(rb->output);
+
+		pthread_mutex_lock(&rb->mutex);
+		rb->active = false;
+		clear_buffer(rb);
+		pthread_mutex_unlock(&rb->mutex);
+
+		info("Replay buffer stopped");
+	}
+}
+
+static void replay_buffer_data(void *data, struct encoder_packet *packet)
+{
+	struct replay_buffer  *rb = data;
+	struct encoder_packet new_packet;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		obs_parse_avc_packet(&new_packet, packet);
+	else
+		obs_duplicate_encoder_packet(&new_packet, packet);
+
+	pthread_mutex_lock(&rb->mutex);
+
+	/* the buffer has to start with a keyframe */
+	if (!rb->packets.size && !is_keyframe(&new_packet)) {
+		pthread_mutex_unlock(&rb->mutex);
+		obs_free_encoder_packet(&new_packet);
+		return;
+	}
+
+	circlebuf_push_back(&rb->packets, &new_packet, sizeof(new_packet));
+	if (is_keyframe(&new_packet))
+		rb->keyframes++;
+	rb->total_bytes += new_packet.size;
+
+	trim_buffer(rb);
+
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+static void replay_buffer_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_MAX_TIME_SEC, 20);
+	obs_data_set_default_int(defaults, OPT_MAX_SIZE_MB, 512);
+}
+
+static obs_properties_t *replay_buffer_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_path(props, OPT_DIRECTORY,
+			obs_module_text("ReplayBuffer.Directory"),
+			OBS_PATH_DIRECTORY, NULL, NULL);
+	obs_properties_add_int(props, OPT_MAX_TIME_SEC,
+			obs_module_text("ReplayBuffer.MaxTime"), 1, 21600, 1);
+	obs_properties_add_int(props, OPT_MAX_SIZE_MB,
+			obs_module_text("ReplayBuffer.MaxSize"), 1, 8192, 1);
+	return props;
+}
+
+struct obs_output_info replay_buffer_info = {
+	.id             = "replay_buffer",
+	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name       = replay_buffer_getname,
+	.create         = replay_buffer_create,
+	.destroy        = replay_buffer_destroy,
+	.start          = replay_buffer_start,
+	.stop           = replay_buffer_stop,
+	.encoded_packet = replay_buffer_data,
+	.update         = replay_buffer_update,
+	.get_defaults   = replay_buffer_defaults,
+	.get_properties = replay_buffer_properties
+};
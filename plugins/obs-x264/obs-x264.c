@@ -19,7 +19,9 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <obs-module.h>
+#include <obs-avc.h>
 
 #ifndef _STDINT_H_INCLUDED
 #define _STDINT_H_INCLUDED
@@ -43,8 +45,6 @@ struct obs_x264 {
 	x264_param_t           params;
 	x264_t                 *context;
 
-	DARRAY(uint8_t)        packet_data;
-
 	uint8_t                *extra_data;
 	uint8_t                *sei;
 
@@ -52,6 +52,21 @@ struct obs_x264 {
 	size_t                 sei_size;
 
 	os_performance_token_t *performance_token;
+
+	/* settings from update, applied by the encode thread before the next
+	 * frame, so the parameters and the encoder are only ever changed
+	 * there */
+	pthread_mutex_t        update_mutex;
+	obs_data_t             *pending_settings;
+
+	/* automatic preset step-down when the encoder is overloaded */
+	bool                   auto_preset;
+	x264_param_t           base_params;
+	char                   *tune;
+	int                    base_preset;
+	int                    cur_preset;
+	int                    overload_frames;
+	int                    headroom_frames;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -83,7 +98,9 @@ static void obs_x264_destroy(void *data)
 	if (obsx264) {
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
-		da_free(obsx264->packet_data);
+		obs_data_release(obsx264->pending_settings);
+		pthread_mutex_destroy(&obsx264->update_mutex);
+		bfree(obsx264->tune);
 		bfree(obsx264);
 	}
 }
@@ -96,6 +113,7 @@ static void obs_x264_defaults(obs_data_t *settings)
 	obs_data_set_default_int   (settings, "keyint_sec",  0);
 	obs_data_set_default_int   (settings, "crf",         23);
 	obs_data_set_default_bool  (settings, "cbr",         true);
+	obs_data_set_default_bool  (settings, "auto_preset", false);
 
 	obs_data_set_default_string(settings, "preset",      "veryfast");
 	obs_data_set_default_string(settings, "profile",     "");
@@ -118,6 +136,7 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_CRF        obs_module_text("CRF")
 #define TEXT_KEYINT_SEC obs_module_text("KeyframeIntervalSec")
 #define TEXT_PRESET     obs_module_text("CPUPreset")
+#define TEXT_AUTO_PRESET obs_module_text("AutoPreset")
 #define TEXT_PROFILE    obs_module_text("Profile")
 #define TEXT_TUNE       obs_module_text("Tune")
 #define TEXT_NONE       obs_module_text("None")
@@ -166,6 +185,8 @@ static obs_properties_t *obs_x264_props(void *unused)
 			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 	add_strings(list, x264_preset_names);
 
+	obs_properties_add_bool(props, "auto_preset", TEXT_AUTO_PRESET);
+
 	list = obs_properties_add_list(props, "profile", TEXT_PROFILE,
 			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 	obs_property_list_add_string(list, TEXT_NONE, "");
@@ -301,12 +322,29 @@ static inline const char *validate_preset(struct obs_x264 *obsx264,
 	return new_preset ? new_preset : "veryfast";
 }
 
+static int get_preset_idx(const char *preset)
+{
+	for (int i = 0; x264_preset_names[i]; i++) {
+		if (strcmp(x264_preset_names[i], preset) == 0)
+			return i;
+	}
+
+	return 0;
+}
+
 static bool reset_x264_params(struct obs_x264 *obsx264,
 		const char *preset, const char *tune)
 {
+	const char *valid_preset = validate_preset(obsx264, preset);
+	const char *valid_tune = validate(obsx264, tune, "tune",
+			x264_tune_names);
 	int ret = x264_param_default_preset(&obsx264->params,
-			validate_preset(obsx264, preset),
-			validate(obsx264, tune, "tune", x264_tune_names));
+			valid_preset, valid_tune);
+
+	bfree(obsx264->tune);
+	obsx264->tune        = bstrdup(valid_tune);
+	obsx264->base_preset = get_preset_idx(valid_preset);
+	obsx264->cur_preset  = obsx264->base_preset;
 	return ret == 0;
 }
 
@@ -455,6 +493,8 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings)
 
 	paramlist = strlist_split(opts, ' ', false);
 
+	obsx264->auto_preset = obs_data_get_bool(settings, "auto_preset");
+
 	if (!obsx264->context) {
 		override_base_params(obsx264, paramlist,
 				&preset, &profile, &tune);
@@ -477,6 +517,10 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings)
 
 	obsx264->params.b_repeat_headers = false;
 
+	/* size prefixed NALs can be passed to outputs without being copied
+	 * or scanned for start codes */
+	obsx264->params.b_annexb = false;
+
 	strlist_free(paramlist);
 	bfree(preset);
 	bfree(profile);
@@ -485,20 +529,141 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings)
 	return success;
 }
 
-static bool obs_x264_update(void *data, obs_data_t *settings)
+/* ------------------------------------------------------------------------- */
+
+/* seconds the encoder has to stay overloaded before stepping to a faster
+ * preset, and to have headroom before stepping back */
+#define PRESET_DOWN_SEC  2
+#define PRESET_UP_SEC    10
+
+/* x264 advises against reconfiguring to or from ultrafast, so superfast is
+ * as far as the preset is stepped down */
+#define PRESET_MIN       1
+
+/* encoder load (encode time / frame interval) thresholds */
+#define PRESET_DOWN_LOAD 0.9f
+#define PRESET_UP_LOAD   0.5f
+
+/*
+ * Only the analysis options of a preset can be changed on an open encoder;
+ * b-frames, lookahead and threads are fixed by x264 once it is opened.  The
+ * options of the configured preset are restored from the parameters the
+ * encoder was opened with, so custom x264 options survive a round trip.
+ */
+static bool set_preset(struct obs_x264 *obsx264, int idx)
 {
-	struct obs_x264 *obsx264 = data;
-	bool success = update_settings(obsx264, settings);
+	x264_param_t preset_params;
+	x264_param_t *src = &preset_params;
+	int weighted_pred = obsx264->params.analyse.i_weighted_pred;
+	int transform_8x8 = obsx264->params.analyse.b_transform_8x8;
 	int ret;
 
-	if (success) {
-		ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
-		if (ret != 0)
-			warn("Failed to reconfigure: %d", ret);
-		return ret == 0;
+	if (idx == obsx264->base_preset)
+		src = &obsx264->base_params;
+	else if (x264_param_default_preset(&preset_params,
+				x264_preset_names[idx], obsx264->tune) != 0)
+		return false;
+
+	obsx264->params.analyse             = src->analyse;
+	obsx264->params.i_frame_reference   = src->i_frame_reference;
+	obsx264->params.b_deblocking_filter = src->b_deblocking_filter;
+
+	/* these depend on the profile and cannot change after opening */
+	obsx264->params.analyse.i_weighted_pred = weighted_pred;
+	obsx264->params.analyse.b_transform_8x8 = transform_8x8;
+
+	ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
+	if (ret != 0) {
+		warn("Failed to change preset to %s: %d",
+				x264_preset_names[idx], ret);
+		return false;
+	}
+
+	info("preset changed from %s to %s (load: %.2f)",
+			x264_preset_names[obsx264->cur_preset],
+			x264_preset_names[idx],
+			obs_encoder_get_load(obsx264->encoder));
+
+	obsx264->cur_preset      = idx;
+	obsx264->overload_frames = 0;
+	obsx264->headroom_frames = 0;
+	return true;
+}
+
+static void check_load(struct obs_x264 *obsx264)
+{
+	float load = obs_encoder_get_load(obsx264->encoder);
+	int fps = obsx264->params.i_fps_den ?
+		(int)(obsx264->params.i_fps_num / obsx264->params.i_fps_den) :
+		30;
+
+	if (load >= PRESET_DOWN_LOAD && obsx264->cur_preset > PRESET_MIN)
+		obsx264->overload_frames++;
+	else
+		obsx264->overload_frames = 0;
+
+	if (load < PRESET_UP_LOAD &&
+	    obsx264->cur_preset < obsx264->base_preset)
+		obsx264->headroom_frames++;
+	else
+		obsx264->headroom_frames = 0;
+
+	if (obsx264->overload_frames >= fps * PRESET_DOWN_SEC)
+		set_preset(obsx264, obsx264->cur_preset - 1);
+	else if (obsx264->headroom_frames >= fps * PRESET_UP_SEC)
+		set_preset(obsx264, obsx264->cur_preset + 1);
+}
+
+/*
+ * The configured preset is restored from base_params, so they have to follow
+ * the new settings.  Only the analysis options of the configured preset are
+ * kept if a faster one is in use, the rest is already in the parameters.
+ */
+static void update_base_params(struct obs_x264 *obsx264)
+{
+	x264_param_t *base = &obsx264->base_params;
+	x264_param_t params = obsx264->params;
+
+	if (obsx264->cur_preset != obsx264->base_preset) {
+		params.analyse             = base->analyse;
+		params.i_frame_reference   = base->i_frame_reference;
+		params.b_deblocking_filter = base->b_deblocking_filter;
 	}
 
-	return false;
+	*base = params;
+}
+
+static void apply_settings(struct obs_x264 *obsx264, obs_data_t *settings)
+{
+	int ret;
+
+	if (!update_settings(obsx264, settings))
+		return;
+
+	update_base_params(obsx264);
+
+	ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
+	if (ret != 0)
+		warn("Failed to reconfigure: %d", ret);
+
+	if (!obsx264->auto_preset &&
+	    obsx264->cur_preset != obsx264->base_preset)
+		set_preset(obsx264, obsx264->base_preset);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool obs_x264_update(void *data, obs_data_t *settings)
+{
+	struct obs_x264 *obsx264 = data;
+
+	obs_data_addref(settings);
+
+	pthread_mutex_lock(&obsx264->update_mutex);
+	obs_data_release(obsx264->pending_settings);
+	obsx264->pending_settings = settings;
+	pthread_mutex_unlock(&obsx264->update_mutex);
+	return true;
 }
 
 static void load_headers(struct obs_x264 *obsx264)
@@ -523,6 +688,10 @@ static void load_headers(struct obs_x264 *obsx264)
 					nal->i_payload);
 	}
 
+	/* the header is expected to use start codes, while the SEI is
+	 * prepended to the first packet and so stays size prefixed */
+	obs_avc_to_annexb(header.array, header.num);
+
 	obsx264->extra_data      = header.array;
 	obsx264->extra_data_size = header.num;
 	obsx264->sei             = sei.array;
@@ -534,6 +703,11 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	struct obs_x264 *obsx264 = bzalloc(sizeof(struct obs_x264));
 	obsx264->encoder = encoder;
 
+	if (pthread_mutex_init(&obsx264->update_mutex, NULL) != 0) {
+		bfree(obsx264);
+		return NULL;
+	}
+
 	if (update_settings(obsx264, settings)) {
 		obsx264->context = x264_encoder_open(&obsx264->params);
 
@@ -541,11 +715,14 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 			warn("x264 failed to load");
 		else
 			load_headers(obsx264);
+
+		obsx264->base_params = obsx264->params;
 	} else {
 		warn("bad settings specified");
 	}
 
 	if (!obsx264->context) {
+		pthread_mutex_destroy(&obsx264->update_mutex);
 		bfree(obsx264);
 		return NULL;
 	}
@@ -556,26 +733,33 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	return obsx264;
 }
 
-static void parse_packet(struct obs_x264 *obsx264,
-		struct encoder_packet *packet, x264_nal_t *nals,
+static void parse_packet(struct encoder_packet *packet, x264_nal_t *nals,
 		int nal_count, x264_picture_t *pic_out)
 {
-	if (!nal_count) return;
+	int    priority = OBS_NAL_PRIORITY_DISPOSABLE;
+	size_t size     = 0;
 
-	da_resize(obsx264->packet_data, 0);
+	if (!nal_count) return;
 
+	/* x264 guarantees the payloads are sequential in memory, and they
+	 * stay valid until the next encode call, so no copy is needed */
 	for (int i = 0; i < nal_count; i++) {
 		x264_nal_t *nal = nals+i;
-		da_push_back_array(obsx264->packet_data, nal->p_payload,
-				nal->i_payload);
+
+		if (nal->i_type == NAL_SLICE || nal->i_type == NAL_SLICE_IDR)
+			priority = nal->i_ref_idc;
+		size += nal->i_payload;
 	}
 
-	packet->data          = obsx264->packet_data.array;
-	packet->size          = obsx264->packet_data.num;
+	packet->data          = nals[0].p_payload;
+	packet->size          = size;
 	packet->type          = OBS_ENCODER_VIDEO;
 	packet->pts           = pic_out->i_pts;
 	packet->dts           = pic_out->i_dts;
 	packet->keyframe      = pic_out->b_keyframe != 0;
+	packet->priority      = priority;
+	packet->drop_priority = obs_avc_drop_priority(priority);
+	packet->avcc          = true;
 }
 
 static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
@@ -607,10 +791,24 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	int             nal_count;
 	int             ret;
 	x264_picture_t  pic, pic_out;
+	obs_data_t      *settings;
 
 	if (!frame || !packet || !received_packet)
 		return false;
 
+	pthread_mutex_lock(&obsx264->update_mutex);
+	settings = obsx264->pending_settings;
+	obsx264->pending_settings = NULL;
+	pthread_mutex_unlock(&obsx264->update_mutex);
+
+	if (settings) {
+		apply_settings(obsx264, settings);
+		obs_data_release(settings);
+	}
+
+	if (obsx264->auto_preset)
+		check_load(obsx264);
+
 	if (frame)
 		init_pic_data(obsx264, &pic, frame);
 
@@ -622,7 +820,7 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	}
 
 	*received_packet = (nal_count != 0);
-	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
+	parse_packet(packet, nals, nal_count, &pic_out);
 
 	return true;
 }
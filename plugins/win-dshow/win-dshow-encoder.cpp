@@ -18,24 +18,27 @@ struct DShowEncoder {
 	long long              frameInterval;
 
 	bool                   first = true;
-	DARRAY(uint8_t)        firstPacket;
+	DARRAY(uint8_t)        packetData;
 	DARRAY(uint8_t)        header;
+	obs_avc_nal_index      nalIndex;
 
 	inline DShowEncoder(obs_encoder_t *context_, const wchar_t *device_)
 		: context(context_),
 		  device(device_)
 	{
-		da_init(firstPacket);
+		da_init(packetData);
 		da_init(header);
+		da_init(nalIndex.nals);
 	}
 
 	inline ~DShowEncoder()
 	{
-		da_free(firstPacket);
+		da_free(packetData);
 		da_free(header);
+		obs_avc_nal_index_free(&nalIndex);
 	}
 
-	inline void ParseFirstPacket(const uint8_t *data, size_t size);
+	inline void WritePacket(const uint8_t *data);
 
 	inline bool Update(obs_data_t *settings);
 	inline bool Encode(struct encoder_frame *frame,
@@ -116,7 +119,7 @@ inline bool DShowEncoder::Update(obs_data_t *settings)
 	config.path                   = id.path;
 
 	first = true;
-	da_resize(firstPacket, 0);
+	da_resize(packetData, 0);
 	da_resize(header, 0);
 
 	dstr_from_wcs(deviceName, id.name.c_str());
@@ -181,41 +184,38 @@ static void DestroyDShowEncoder(void *data)
 	delete reinterpret_cast<DShowEncoder*>(data);
 }
 
-/* the first packet contains the SPS/PPS (header) NALs, so parse the first
- * packet and separate the NALs */
-inline void DShowEncoder::ParseFirstPacket(const uint8_t *data, size_t size)
+/* rewrites the indexed NALs with size prefixes, so outputs can use them
+ * without scanning the packet again.  the first packet contains the SPS/PPS
+ * (header) NALs, which are separated out with start codes. */
+inline void DShowEncoder::WritePacket(const uint8_t *data)
 {
-	const uint8_t *nal_start, *nal_end, *nal_codestart;
-	const uint8_t *end = data + size;
-	int type;
+	static const uint8_t startCode[4] = {0, 0, 0, 1};
 
-	nal_start = obs_avc_find_startcode(data, end);
-	nal_end = nullptr;
-	while (nal_end != end) {
-		nal_codestart = nal_start;
+	da_resize(packetData, 0);
 
-		while (nal_start < end && !*(nal_start++));
+	for (size_t i = 0; i < nalIndex.nals.num; i++) {
+		const obs_avc_nal &nal = nalIndex.nals.array[i];
+		const uint8_t *nalData = data + nal.offset;
 
-		if (nal_start == end)
-			break;
-
-		type = nal_start[0] & 0x1F;
-
-		nal_end = obs_avc_find_startcode(nal_start, end);
-		if (!nal_end)
-			nal_end = end;
-
-		if (type == OBS_NAL_SPS || type == OBS_NAL_PPS) {
-			da_push_back_array(header, nal_codestart,
-					nal_end - nal_codestart);
+		if (first &&
+		    (nal.type == OBS_NAL_SPS || nal.type == OBS_NAL_PPS)) {
+			da_push_back_array(header, startCode, 4);
+			da_push_back_array(header, nalData, nal.size);
 
 		} else {
-			da_push_back_array(firstPacket, nal_codestart,
-					nal_end - nal_codestart);
+			uint8_t size[4] = {
+				uint8_t(nal.size >> 24),
+				uint8_t(nal.size >> 16),
+				uint8_t(nal.size >> 8),
+				uint8_t(nal.size)
+			};
+
+			da_push_back_array(packetData, size, 4);
+			da_push_back_array(packetData, nalData, nal.size);
 		}
-
-		nal_start = nal_end;
 	}
+
+	first = false;
 }
 
 inline bool DShowEncoder::Encode(struct encoder_frame *frame,
@@ -245,20 +245,20 @@ inline bool DShowEncoder::Encode(struct encoder_frame *frame,
 		return false;
 
 	if (new_packet && !!dshowPacket.data && !!dshowPacket.size) {
-		packet->data     = dshowPacket.data;
-		packet->size     = dshowPacket.size;
-		packet->type     = OBS_ENCODER_VIDEO;
-		packet->pts      = dshowPacket.pts / frameInterval;
-		packet->dts      = dshowPacket.dts / frameInterval;
-		packet->keyframe = obs_avc_keyframe(packet->data, packet->size);
-
-		/* first packet must be parsed in order to retrieve header */
-		if (first) {
-			first = false;
-			ParseFirstPacket(packet->data, packet->size);
-			packet->data = firstPacket.array;
-			packet->size = firstPacket.num;
-		}
+		obs_avc_nal_index_build(&nalIndex, dshowPacket.data,
+				dshowPacket.size, false);
+		WritePacket(dshowPacket.data);
+
+		packet->data          = packetData.array;
+		packet->size          = packetData.num;
+		packet->type          = OBS_ENCODER_VIDEO;
+		packet->pts           = dshowPacket.pts / frameInterval;
+		packet->dts           = dshowPacket.dts / frameInterval;
+		packet->keyframe      = nalIndex.keyframe;
+		packet->priority      = nalIndex.priority;
+		packet->drop_priority =
+			obs_avc_drop_priority(nalIndex.priority);
+		packet->avcc          = true;
 
 		*received_packet = true;
 	}
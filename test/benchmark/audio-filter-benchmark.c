@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <obs.h>
+
+#include "bench-util.h"
+
+/*
+ * Audio filter benchmark
+ *
+ *   Loads the modules, then pushes blocks of 8 channel audio through an
+ * audio-only source, first without filters and then with each of the audio
+ * filters of obs-filters in turn.  The per-block cost of a filter is the time
+ * over the unfiltered pass, and is also given as a share of the real time the
+ * block represents.  Results are written as JSON.
+ */
+
+#define DEFAULT_BLOCKS  20000
+#define DEFAULT_FRAMES  256
+#define CHANNELS        8
+#define SAMPLES_PER_SEC 48000
+#define MAX_COUNT       1000000
+
+struct filter_benchmark_config {
+	uint32_t    blocks;
+	uint32_t    frames;
+	const char  *module_bin;
+	const char  *module_data;
+	const char  *output_path;
+	bool        verbose;
+};
+
+struct filter_benchmark {
+	struct filter_benchmark_config config;
+
+	obs_source_t                   *source;
+	float                          *samples[CHANNELS];
+};
+
+struct filter_setting {
+	const char  *name;
+	double      val;
+};
+
+/* settings that keep every filter doing real work: gains other than 0 dB, so
+ * nothing is skipped, and a signal level between the gate thresholds and
+ * above the compressor threshold */
+static const struct filter_setting gain_settings[] = {
+	{"db", 6.0},
+	{NULL, 0.0}
+};
+
+static const struct filter_setting eq_settings[] = {
+	{"low", 3.0},
+	{"mid", -3.0},
+	{"high", 3.0},
+	{NULL, 0.0}
+};
+
+static const struct filter_setting no_settings[] = {
+	{NULL, 0.0}
+};
+
+static const struct {
+	const char                  *id;
+	const struct filter_setting *settings;
+} filters[] = {
+	{"gain_filter",       gain_settings},
+	{"noise_gate_filter", no_settings},
+	{"compressor_filter", no_settings},
+	{"eq_filter",         eq_settings}
+};
+
+#define NUM_FILTERS (sizeof(filters) / sizeof(filters[0]))
+
+/* ------------------------------------------------------------------------- */
+/* audio-only source, the benchmark outputs its audio itself                  */
+
+static const char *bench_source_getname(void)
+{
+	return "Audio Filter Benchmark Source";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info bench_source_info = {
+	.id           = "audio_filter_benchmark_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = bench_source_getname,
+	.create       = bench_source_create,
+	.destroy      = bench_source_destroy
+};
+
+/* ------------------------------------------------------------------------- */
+
+static double run_pass(struct filter_benchmark *bench)
+{
+	struct obs_source_audio audio = {
+		.frames          = bench->config.frames,
+		.speakers        = SPEAKERS_7POINT1,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = SAMPLES_PER_SEC
+	};
+	uint64_t start;
+
+	for (size_t i = 0; i < CHANNELS; i++)
+		audio.data[i] = (uint8_t*)bench->samples[i];
+
+	start = os_gettime_ns();
+	for (uint32_t i = 0; i < bench->config.blocks; i++) {
+		/* current timestamps keep the audio line from buffering
+		 * every block */
+		audio.timestamp = os_gettime_ns();
+		obs_source_output_audio(bench->source, &audio);
+	}
+
+	return bench_ns_per(start, bench->config.blocks);
+}
+
+static obs_source_t *create_filter(size_t idx)
+{
+	const struct filter_setting *setting = filters[idx].settings;
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *filter;
+
+	for (; setting->name; setting++)
+		obs_data_set_double(settings, setting->name, setting->val);
+
+	filter = obs_source_create(OBS_SOURCE_TYPE_FILTER, filters[idx].id,
+			filters[idx].id, settings, NULL);
+	obs_data_release(settings);
+	return filter;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_data_t *filter_data(struct filter_benchmark *bench, double ns,
+		double baseline_ns)
+{
+	obs_data_t *data = obs_data_create();
+	double block_ns = (double)bench->config.frames * 1000000000.0 /
+		SAMPLES_PER_SEC;
+	double cost = ns - baseline_ns;
+
+	obs_data_set_double(data, "us_per_block", cost / 1000.0);
+	obs_data_set_double(data, "real_time_percent",
+			cost * 100.0 / block_ns);
+	return data;
+}
+
+static obs_data_t *get_results(struct filter_benchmark *bench)
+{
+	struct filter_benchmark_config *config = &bench->config;
+	obs_data_t *results = obs_data_create();
+	obs_data_t *filter_results = obs_data_create();
+	double baseline;
+
+	/* one unmeasured pass to warm up the caches and the audio line */
+	run_pass(bench);
+	baseline = run_pass(bench);
+
+	for (size_t i = 0; i < NUM_FILTERS; i++) {
+		obs_source_t *filter = create_filter(i);
+		obs_data_t *data;
+
+		if (!filter) {
+			fprintf(stderr, "Failed to create '%s'\n",
+					filters[i].id);
+			continue;
+		}
+
+		obs_source_filter_add(bench->source, filter);
+		data = filter_data(bench, run_pass(bench), baseline);
+		obs_source_filter_remove(bench->source, filter);
+		obs_source_release(filter);
+
+		obs_data_set_obj(filter_results, filters[i].id, data);
+		obs_data_release(data);
+	}
+
+	obs_data_set_int(results, "blocks", config->blocks);
+	obs_data_set_int(results, "frames", config->frames);
+	obs_data_set_int(results, "channels", CHANNELS);
+	obs_data_set_double(results, "unfiltered_us_per_block",
+			baseline / 1000.0);
+	obs_data_set_obj(results, "filters", filter_results);
+	obs_data_release(filter_results);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *name)
+{
+	bench_print_usage(name, "",
+		"  --blocks <count>          blocks per pass (%d)\n"
+		"  --frames <count>          frames per block (%d)\n"
+		"  --module-path <bin> <data> additional module path\n"
+		"  --verbose                 print the libobs log\n",
+		DEFAULT_BLOCKS, DEFAULT_FRAMES);
+}
+
+static bool parse_args(struct filter_benchmark_config *config, int argc,
+		char *argv[])
+{
+	config->blocks = DEFAULT_BLOCKS;
+	config->frames = DEFAULT_FRAMES;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid;
+
+		if (strcmp(arg, "--verbose") == 0) {
+			config->verbose = true;
+			continue;
+		}
+
+		if (strcmp(arg, "--blocks") == 0) {
+			valid = bench_parse_uint(next, &config->blocks,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--frames") == 0) {
+			valid = bench_parse_uint(next, &config->frames,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--module-path") == 0) {
+			valid = next && i + 2 < argc;
+			if (valid) {
+				config->module_bin  = next;
+				config->module_data = argv[i + 2];
+				i++;
+			}
+		} else if (strcmp(arg, "--output") == 0) {
+			valid = (config->output_path = next) != NULL;
+		} else {
+			valid = false;
+		}
+
+		if (!valid)
+			return false;
+		i++;
+	}
+
+	return true;
+}
+
+static bool start(struct filter_benchmark *bench)
+{
+	struct filter_benchmark_config *config = &bench->config;
+	struct obs_audio_info oai = {
+		.samples_per_sec = SAMPLES_PER_SEC,
+		.speakers        = SPEAKERS_7POINT1,
+		.buffer_ms       = 1000
+	};
+
+	if (!obs_startup("en-US"))
+		return false;
+
+	if (config->module_bin)
+		obs_add_module_path(config->module_bin, config->module_data);
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Failed to initialize audio\n");
+		return false;
+	}
+
+	obs_load_all_modules();
+	obs_register_source(&bench_source_info);
+
+	bench->source = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+			bench_source_info.id, "audio filter benchmark",
+			NULL, NULL);
+	if (!bench->source) {
+		fprintf(stderr, "Failed to create the source\n");
+		return false;
+	}
+
+	/* -12 dBFS triangle waves, a different period on each channel */
+	for (size_t i = 0; i < CHANNELS; i++) {
+		uint32_t period = 64 + (uint32_t)i * 16;
+
+		bench->samples[i] = bmalloc(config->frames * sizeof(float));
+		for (uint32_t j = 0; j < config->frames; j++) {
+			float pos = (float)(j % period) / (float)period;
+			float val = pos < 0.5f ? pos : 1.0f - pos;
+
+			bench->samples[i][j] = (val * 4.0f - 1.0f) * 0.25f;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct filter_benchmark bench = {0};
+	obs_data_t *results;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&bench.config, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	base_set_log_handler(bench_log, &bench.config.verbose);
+
+	if (start(&bench)) {
+		results = get_results(&bench);
+		if (bench_write_results(results, bench.config.output_path))
+			ret = EXIT_SUCCESS;
+		obs_data_release(results);
+	}
+
+	obs_source_release(bench.source);
+	obs_shutdown();
+
+	for (size_t i = 0; i < CHANNELS; i++)
+		bfree(bench.samples[i]);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <obs.h>
+
+#include "bench-util.h"
+
+/*
+ * Audio tap benchmark
+ *
+ *   Pushes packets through the audio path of an audio-only source with no
+ * subscribers, then with a number of audio taps, decimated audio taps, and
+ * the same number of "audio_data" signal handlers, and reports the time per
+ * packet of each and the overhead over the unsubscribed path.  Results are
+ * written as JSON.
+ */
+
+#define DEFAULT_SUBSCRIBERS 50
+#define DEFAULT_PACKETS     5000
+#define DEFAULT_FRAMES      1024
+#define DECIMATION          10
+#define SAMPLES_PER_SEC     48000
+#define MAX_COUNT           1000000
+
+struct tap_benchmark_config {
+	uint32_t    subscribers;
+	uint32_t    packets;
+	uint32_t    frames;
+	const char  *output_path;
+	bool        verbose;
+};
+
+struct tap_benchmark;
+
+/* every subscriber needs its own param, or adding the same tap or signal
+ * handler again would be ignored */
+struct subscriber {
+	struct tap_benchmark        *bench;
+};
+
+struct tap_benchmark {
+	struct tap_benchmark_config config;
+
+	obs_source_t                *source;
+	float                       *samples[2];
+	struct subscriber           *subscribers;
+
+	/* touched by every subscriber so the calls cannot be optimized out */
+	volatile float              sink;
+	uint64_t                    calls;
+};
+
+enum subscriber_type {
+	SUBSCRIBER_NONE,
+	SUBSCRIBER_TAP,
+	SUBSCRIBER_DECIMATED_TAP,
+	SUBSCRIBER_SIGNAL
+};
+
+/* ------------------------------------------------------------------------- */
+/* audio-only source, the benchmark outputs its audio itself                  */
+
+static const char *tap_source_getname(void)
+{
+	return "Audio Tap Benchmark Source";
+}
+
+static void *tap_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void tap_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info tap_source_info = {
+	.id           = "audio_tap_benchmark_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = tap_source_getname,
+	.create       = tap_source_create,
+	.destroy      = tap_source_destroy
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void tap_callback(void *param, obs_source_t *source,
+		const struct audio_data *audio, bool muted)
+{
+	struct tap_benchmark *bench = ((struct subscriber*)param)->bench;
+	const float *samples = (const float*)audio->data[0];
+
+	bench->sink = samples[audio->frames - 1];
+	bench->calls++;
+
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(muted);
+}
+
+static void signal_callback(void *param, calldata_t *cd)
+{
+	struct tap_benchmark *bench = ((struct subscriber*)param)->bench;
+	struct audio_data *audio = calldata_ptr(cd, "data");
+	const float *samples = (const float*)audio->data[0];
+
+	bench->sink = samples[audio->frames - 1];
+	bench->calls++;
+}
+
+static void subscribe(struct tap_benchmark *bench, enum subscriber_type type,
+		bool add)
+{
+	signal_handler_t *handler;
+
+	handler = obs_source_get_signal_handler(bench->source);
+
+	for (uint32_t i = 0; i < bench->config.subscribers; i++) {
+		void *param = bench->subscribers + i;
+
+		if (type == SUBSCRIBER_SIGNAL) {
+			if (add)
+				signal_handler_connect(handler, "audio_data",
+						signal_callback, param);
+			else
+				signal_handler_disconnect(handler,
+						"audio_data", signal_callback,
+						param);
+
+		} else if (type != SUBSCRIBER_NONE) {
+			if (add)
+				obs_source_add_audio_tap(bench->source,
+						tap_callback, param,
+						type == SUBSCRIBER_TAP ?
+						0 : DECIMATION);
+			else
+				obs_source_remove_audio_tap(bench->source,
+						tap_callback, param);
+		}
+	}
+}
+
+static double run_pass(struct tap_benchmark *bench, enum subscriber_type type)
+{
+	struct obs_source_audio audio = {
+		.frames          = bench->config.frames,
+		.speakers        = SPEAKERS_STEREO,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = SAMPLES_PER_SEC
+	};
+	uint64_t start;
+
+	audio.data[0] = (uint8_t*)bench->samples[0];
+	audio.data[1] = (uint8_t*)bench->samples[1];
+
+	subscribe(bench, type, true);
+
+	start = os_gettime_ns();
+	for (uint32_t i = 0; i < bench->config.packets; i++) {
+		/* current timestamps keep the audio line from buffering
+		 * every packet */
+		audio.timestamp = os_gettime_ns();
+		obs_source_output_audio(bench->source, &audio);
+	}
+
+	subscribe(bench, type, false);
+
+	return bench_ns_per(start, bench->config.packets);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_data_t *pass_data(struct tap_benchmark *bench, double ns,
+		double baseline_ns)
+{
+	obs_data_t *data = obs_data_create();
+	double overhead = ns - baseline_ns;
+
+	obs_data_set_double(data, "ns_per_packet", ns);
+	obs_data_set_double(data, "overhead_ns_per_packet", overhead);
+	obs_data_set_double(data, "overhead_ns_per_subscriber",
+			overhead / bench->config.subscribers);
+	return data;
+}
+
+static obs_data_t *get_results(struct tap_benchmark *bench)
+{
+	struct tap_benchmark_config *config = &bench->config;
+	obs_data_t *results = obs_data_create();
+	obs_data_t *passes = obs_data_create();
+	double none, taps, decimated, signals;
+
+	/* one unmeasured pass to warm up the caches and the audio line */
+	run_pass(bench, SUBSCRIBER_NONE);
+
+	none      = run_pass(bench, SUBSCRIBER_NONE);
+	taps      = run_pass(bench, SUBSCRIBER_TAP);
+	decimated = run_pass(bench, SUBSCRIBER_DECIMATED_TAP);
+	signals   = run_pass(bench, SUBSCRIBER_SIGNAL);
+
+	obs_data_set_int(results, "subscribers", config->subscribers);
+	obs_data_set_int(results, "packets", config->packets);
+	obs_data_set_int(results, "frames", config->frames);
+	obs_data_set_int(results, "decimation", DECIMATION);
+	obs_data_set_int(results, "calls", (long long)bench->calls);
+
+	obs_data_set_double(passes, "none_ns_per_packet", none);
+	bench_set_obj(passes, "taps", pass_data(bench, taps, none));
+	bench_set_obj(passes, "decimated_taps",
+			pass_data(bench, decimated, none));
+	bench_set_obj(passes, "signals", pass_data(bench, signals, none));
+	bench_set_obj(results, "passes", passes);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *name)
+{
+	bench_print_usage(name, "",
+		"  --subscribers <count>     taps or signal handlers (%d)\n"
+		"  --packets <count>         packets per pass (%d)\n"
+		"  --frames <count>          frames per packet (%d)\n"
+		"  --verbose                 print the libobs log\n",
+		DEFAULT_SUBSCRIBERS, DEFAULT_PACKETS, DEFAULT_FRAMES);
+}
+
+static bool parse_args(struct tap_benchmark_config *config, int argc,
+		char *argv[])
+{
+	config->subscribers = DEFAULT_SUBSCRIBERS;
+	config->packets     = DEFAULT_PACKETS;
+	config->frames      = DEFAULT_FRAMES;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid;
+
+		if (strcmp(arg, "--verbose") == 0) {
+			config->verbose = true;
+			continue;
+		}
+
+		if (strcmp(arg, "--subscribers") == 0)
+			valid = bench_parse_uint(next, &config->subscribers,
+					MAX_COUNT);
+		else if (strcmp(arg, "--packets") == 0)
+			valid = bench_parse_uint(next, &config->packets,
+					MAX_COUNT);
+		else if (strcmp(arg, "--frames") == 0)
+			valid = bench_parse_uint(next, &config->frames,
+					MAX_COUNT);
+		else if (strcmp(arg, "--output") == 0)
+			valid = (config->output_path = next) != NULL;
+		else
+			valid = false;
+
+		if (!valid)
+			return false;
+		i++;
+	}
+
+	return true;
+}
+
+static bool start(struct tap_benchmark *bench)
+{
+	struct obs_audio_info oai = {
+		.samples_per_sec = SAMPLES_PER_SEC,
+		.speakers        = SPEAKERS_STEREO,
+		.buffer_ms       = 1000
+	};
+
+	if (!obs_startup("en-US"))
+		return false;
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Failed to initialize audio\n");
+		return false;
+	}
+
+	obs_register_source(&tap_source_info);
+
+	bench->source = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+			tap_source_info.id, "audio tap benchmark", NULL, NULL);
+	if (!bench->source) {
+		fprintf(stderr, "Failed to create the source\n");
+		return false;
+	}
+
+	bench->subscribers = bzalloc(bench->config.subscribers *
+			sizeof(struct subscriber));
+	for (uint32_t i = 0; i < bench->config.subscribers; i++)
+		bench->subscribers[i].bench = bench;
+
+	for (size_t i = 0; i < 2; i++) {
+		bench->samples[i] = bzalloc(bench->config.frames *
+				sizeof(float));
+		for (uint32_t j = 0; j < bench->config.frames; j++)
+			bench->samples[i][j] = (float)(j % 100) / 100.0f;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tap_benchmark bench = {0};
+	obs_data_t *results;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&bench.config, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	base_set_log_handler(bench_log, &bench.config.verbose);
+
+	if (start(&bench)) {
+		results = get_results(&bench);
+		if (bench_write_results(results, bench.config.output_path))
+			ret = EXIT_SUCCESS;
+		obs_data_release(results);
+	}
+
+	obs_source_release(bench.source);
+	obs_shutdown();
+
+	bfree(bench.samples[0]);
+	bfree(bench.samples[1]);
+	bfree(bench.subscribers);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <obs.h>
+
+#include "bench-util.h"
+#include <obs-avc.h>
+
+/*
+ * AVC parsing benchmark
+ *
+ *   Splits a raw H.264 stream (start codes, as written by "ffmpeg -i input
+ * -c:v libx264 -b:v 40M out.h264") into access units, then times the NAL
+ * parsing that outputs do for every video packet: a plain byte by byte start
+ * code search as the baseline, obs_avc_find_startcode, building a NAL index,
+ * converting with obs_parse_avc_packet, and indexing the converted (size
+ * prefixed) packets.  Results are written as JSON.
+ */
+
+#define DEFAULT_ITERATIONS 20
+#define DEFAULT_FPS        30
+#define MAX_COUNT          UINT32_MAX
+
+struct avc_benchmark_config {
+	const char  *path;
+	uint32_t    iterations;
+	uint32_t    fps;
+	const char  *output_path;
+};
+
+struct packet_range {
+	size_t      offset;
+	size_t      size;
+};
+
+struct avc_benchmark {
+	struct avc_benchmark_config config;
+
+	const uint8_t               *data;
+	size_t                      size;
+	DARRAY(struct packet_range) packets;
+	DARRAY(struct encoder_packet) avcc_packets;
+	struct obs_avc_nal_index    index;
+	size_t                      nals;
+};
+
+typedef size_t (*pass_func_t)(struct avc_benchmark *bench,
+		const uint8_t *data, size_t size, size_t idx);
+
+/* ------------------------------------------------------------------------- */
+
+static size_t count_bytewise(struct avc_benchmark *bench, const uint8_t *data,
+		size_t size, size_t idx)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i + 3 <= size; i++) {
+		if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+			count++;
+			i += 2;
+		}
+	}
+
+	UNUSED_PARAMETER(bench);
+	UNUSED_PARAMETER(idx);
+	return count;
+}
+
+static size_t count_startcodes(struct avc_benchmark *bench,
+		const uint8_t *data, size_t size, size_t idx)
+{
+	const uint8_t *end = data + size;
+	const uint8_t *nal = obs_avc_find_startcode(data, end);
+	size_t count = 0;
+
+	while (true) {
+		while (nal < end && !*(nal++));
+
+		if (nal == end)
+			break;
+
+		count++;
+		nal = obs_avc_find_startcode(nal, end);
+	}
+
+	UNUSED_PARAMETER(bench);
+	UNUSED_PARAMETER(idx);
+	return count;
+}
+
+static size_t build_index(struct avc_benchmark *bench, const uint8_t *data,
+		size_t size, size_t idx)
+{
+	obs_avc_nal_index_build(&bench->index, data, size, false);
+
+	UNUSED_PARAMETER(idx);
+	return bench->index.nals.num;
+}
+
+static size_t parse_packet(struct avc_benchmark *bench, const uint8_t *data,
+		size_t size, size_t idx)
+{
+	struct encoder_packet src = {0};
+	struct encoder_packet parsed;
+	size_t parsed_size;
+
+	src.data = (uint8_t*)data;
+	src.size = size;
+	src.type = OBS_ENCODER_VIDEO;
+
+	obs_parse_avc_packet(&parsed, &src);
+	parsed_size = parsed.size;
+	obs_free_encoder_packet(&parsed);
+
+	UNUSED_PARAMETER(bench);
+	UNUSED_PARAMETER(idx);
+	return parsed_size;
+}
+
+static size_t build_avcc_index(struct avc_benchmark *bench,
+		const uint8_t *data, size_t size, size_t idx)
+{
+	struct encoder_packet *packet = bench->avcc_packets.array + idx;
+
+	obs_avc_nal_index_build(&bench->index, packet->data, packet->size,
+			true);
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	return bench->index.nals.num;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool is_slice(int type)
+{
+	return type == OBS_NAL_SLICE || type == OBS_NAL_SLICE_IDR;
+}
+
+/* a new access unit starts with an AUD, SPS, PPS or SEI, or with the first
+ * slice of a picture (first_mb_in_slice of 0, coded as a single 1 bit) */
+static bool starts_access_unit(const uint8_t *data,
+		const struct obs_avc_nal *nal)
+{
+	if (is_slice(nal->type))
+		return nal->size > 1 && (data[nal->offset + 1] & 0x80) != 0;
+
+	return nal->type == OBS_NAL_AUD || nal->type == OBS_NAL_SPS ||
+	       nal->type == OBS_NAL_PPS || nal->type == OBS_NAL_SEI;
+}
+
+static inline size_t start_code_offset(const uint8_t *data, size_t offset)
+{
+	offset -= 3;
+	return (offset && !data[offset - 1]) ? offset - 1 : offset;
+}
+
+static void split_packets(struct avc_benchmark *bench)
+{
+	struct obs_avc_nal_index *index = &bench->index;
+	bool have_slice = false;
+	size_t start = 0;
+
+	obs_avc_nal_index_build(index, bench->data, bench->size, false);
+	bench->nals = index->nals.num;
+
+	for (size_t i = 0; i < index->nals.num; i++) {
+		const struct obs_avc_nal *nal = index->nals.array + i;
+
+		if (have_slice && starts_access_unit(bench->data, nal)) {
+			size_t end = start_code_offset(bench->data,
+					nal->offset);
+			struct packet_range range = {start, end - start};
+
+			da_push_back(bench->packets, &range);
+			start = end;
+			have_slice = false;
+		}
+
+		if (is_slice(nal->type))
+			have_slice = true;
+	}
+
+	if (have_slice) {
+		struct packet_range range = {start, bench->size - start};
+		da_push_back(bench->packets, &range);
+	}
+}
+
+static void convert_packets(struct avc_benchmark *bench)
+{
+	for (size_t i = 0; i < bench->packets.num; i++) {
+		struct packet_range *range = bench->packets.array + i;
+		struct encoder_packet src = {0};
+		struct encoder_packet *parsed;
+
+		src.data = (uint8_t*)bench->data + range->offset;
+		src.size = range->size;
+		src.type = OBS_ENCODER_VIDEO;
+
+		parsed = da_push_back_new(bench->avcc_packets);
+		obs_parse_avc_packet(parsed, &src);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_data_t *run_pass(struct avc_benchmark *bench, pass_func_t func,
+		size_t *result)
+{
+	obs_data_t *data = obs_data_create();
+	uint32_t iterations = bench->config.iterations;
+	double seconds, bytes;
+	uint64_t start;
+	size_t total = 0;
+
+	start = os_gettime_ns();
+	for (uint32_t i = 0; i < iterations; i++) {
+		total = 0;
+
+		for (size_t j = 0; j < bench->packets.num; j++) {
+			struct packet_range *range = bench->packets.array + j;
+			total += func(bench, bench->data + range->offset,
+					range->size, j);
+		}
+	}
+	seconds = (double)(os_gettime_ns() - start) / 1000000000.0;
+	bytes   = (double)bench->size * iterations;
+
+	obs_data_set_double(data, "ms_per_pass",
+			seconds * 1000.0 / iterations);
+	obs_data_set_double(data, "us_per_packet", seconds * 1000000.0 /
+			((double)bench->packets.num * iterations));
+	obs_data_set_double(data, "mb_per_sec",
+			bytes / seconds / (1024.0 * 1024.0));
+
+	*result = total;
+	return data;
+}
+
+static obs_data_t *get_results(struct avc_benchmark *bench, bool *valid)
+{
+	struct avc_benchmark_config *config = &bench->config;
+	obs_data_t *results = obs_data_create();
+	obs_data_t *stream = obs_data_create();
+	obs_data_t *passes = obs_data_create();
+	size_t bytewise, startcodes, indexed, parsed, avcc_indexed;
+	double bitrate;
+
+	bitrate = (double)bench->size * 8.0 * config->fps /
+		(double)bench->packets.num / 1000000.0;
+
+	obs_data_set_string(stream, "path", config->path);
+	obs_data_set_int(stream, "bytes", (long long)bench->size);
+	obs_data_set_int(stream, "packets", (long long)bench->packets.num);
+	obs_data_set_int(stream, "nals", (long long)bench->nals);
+	obs_data_set_int(stream, "fps", config->fps);
+	obs_data_set_double(stream, "bitrate_mbps", bitrate);
+	bench_set_obj(results, "stream", stream);
+	obs_data_set_int(results, "iterations", config->iterations);
+
+	bench_set_obj(passes, "bytewise",
+			run_pass(bench, count_bytewise, &bytewise));
+	bench_set_obj(passes, "find_startcode",
+			run_pass(bench, count_startcodes, &startcodes));
+	bench_set_obj(passes, "nal_index",
+			run_pass(bench, build_index, &indexed));
+	bench_set_obj(passes, "parse_avc_packet",
+			run_pass(bench, parse_packet, &parsed));
+	bench_set_obj(passes, "nal_index_avcc",
+			run_pass(bench, build_avcc_index, &avcc_indexed));
+	bench_set_obj(results, "passes", passes);
+	obs_data_set_int(results, "avcc_bytes", (long long)parsed);
+
+	/* every method has to find the same NALs, or the timings mean
+	 * nothing */
+	*valid = bytewise == startcodes && startcodes == indexed &&
+		indexed == avcc_indexed;
+	obs_data_set_bool(results, "valid", *valid);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *name)
+{
+	bench_print_usage(name, " <file.h264>",
+		"  --iterations <count>      passes over the stream (%d)\n"
+		"  --fps <fps>               stream frame rate, for the "
+			"bitrate (%d)\n",
+		DEFAULT_ITERATIONS, DEFAULT_FPS);
+}
+
+static bool parse_args(struct avc_benchmark_config *config, int argc,
+		char *argv[])
+{
+	config->iterations = DEFAULT_ITERATIONS;
+	config->fps        = DEFAULT_FPS;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid;
+
+		if (strcmp(arg, "--iterations") == 0) {
+			valid = bench_parse_uint(next, &config->iterations,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--fps") == 0) {
+			valid = bench_parse_uint(next, &config->fps,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--output") == 0) {
+			valid = (config->output_path = next) != NULL;
+		} else if (strncmp(arg, "--", 2) != 0 && !config->path) {
+			config->path = arg;
+			continue;
+		} else {
+			valid = false;
+		}
+
+		if (!valid)
+			return false;
+		i++;
+	}
+
+	return config->path != NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct avc_benchmark bench = {0};
+	obs_data_t *results;
+	bool valid = false;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&bench.config, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bench.data = os_map_file(bench.config.path, &bench.size);
+	if (!bench.data) {
+		fprintf(stderr, "Failed to open '%s'\n", bench.config.path);
+		return EXIT_FAILURE;
+	}
+
+	obs_avc_nal_index_init(&bench.index);
+	split_packets(&bench);
+
+	if (bench.packets.num) {
+		convert_packets(&bench);
+
+		results = get_results(&bench, &valid);
+		if (bench_write_results(results, bench.config.output_path) &&
+		    valid)
+			ret = EXIT_SUCCESS;
+		obs_data_release(results);
+
+		if (!valid)
+			fprintf(stderr, "NAL counts do not match\n");
+	} else {
+		fprintf(stderr, "No H.264 slices found in '%s'\n",
+				bench.config.path);
+	}
+
+	for (size_t i = 0; i < bench.avcc_packets.num; i++)
+		obs_free_encoder_packet(bench.avcc_packets.array + i);
+	da_free(bench.avcc_packets);
+	da_free(bench.packets);
+	obs_avc_nal_index_free(&bench.index);
+	os_unmap_file(bench.data, bench.size);
+
+	return ret;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/platform.h>
+
+#include "bench-util.h"
+
+void bench_log(int log_level, const char *msg, va_list args, void *param)
+{
+	bool *verbose = param;
+
+	if (log_level > LOG_WARNING && !*verbose)
+		return;
+
+	vfprintf(stderr, msg, args);
+	fputc('\n', stderr);
+}
+
+void bench_print_usage(const char *name, const char *args,
+		const char *options, ...)
+{
+	va_list va;
+
+	fprintf(stderr, "usage: %s [options]%s\n", name, args);
+
+	va_start(va, options);
+	vfprintf(stderr, options, va);
+	va_end(va);
+
+	fprintf(stderr, "  --output <file>           write JSON to a file "
+			"instead of stdout\n");
+}
+
+bool bench_parse_uint(const char *str, uint32_t *val, uint32_t max)
+{
+	char *end;
+	long long num;
+
+	if (!str)
+		return false;
+
+	num = strtoll(str, &end, 10);
+	if (*end || num <= 0 || num > (long long)max)
+		return false;
+
+	*val = (uint32_t)num;
+	return true;
+}
+
+void bench_set_obj(obs_data_t *data, const char *name, obs_data_t *obj)
+{
+	obs_data_set_obj(data, name, obj);
+	obs_data_release(obj);
+}
+
+void bench_set_array(obs_data_t *data, const char *name,
+		obs_data_array_t *array)
+{
+	obs_data_set_array(data, name, array);
+	obs_data_array_release(array);
+}
+
+double bench_ns_per(uint64_t start, uint64_t count)
+{
+	return (double)(os_gettime_ns() - start) / (double)count;
+}
+
+bool bench_write_results(obs_data_t *results, const char *path)
+{
+	const char *json = obs_data_get_json(results);
+
+	if (!path) {
+		puts(json);
+		return true;
+	}
+
+	if (!os_quick_write_utf8_file(path, json, strlen(json), false)) {
+		fprintf(stderr, "Failed to write '%s'\n", path);
+		return false;
+	}
+
+	return true;
+}
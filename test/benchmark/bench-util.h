@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include <obs.h>
+
+/*
+ * Helpers shared by the benchmark programs: argument parsing, usage text,
+ * logging, building the results, and writing them as JSON.
+ */
+
+/* Log handler.  param points to a bool, when false only warnings and errors
+ * are printed. */
+extern void bench_log(int log_level, const char *msg, va_list args,
+		void *param);
+
+/* Prints the usage line followed by the options, and the --output option
+ * every benchmark has.  options is a printf format. */
+extern void bench_print_usage(const char *name, const char *args,
+		const char *options, ...);
+
+/* Parses a number in the range 1 to max.  Fails for NULL, so the next
+ * argument can be passed without checking for it first. */
+extern bool bench_parse_uint(const char *str, uint32_t *val, uint32_t max);
+
+/* Sets the object or array and releases it, so results can be nested with
+ * calls that return new references */
+extern void bench_set_obj(obs_data_t *data, const char *name,
+		obs_data_t *obj);
+extern void bench_set_array(obs_data_t *data, const char *name,
+		obs_data_array_t *array);
+
+/* Average time of count operations that started at start */
+extern double bench_ns_per(uint64_t start, uint64_t count);
+
+/* Writes the results to path, or to stdout if path is NULL */
+extern bool bench_write_results(obs_data_t *results, const char *path);
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/config-file.h>
+#include <obs.h>
+
+#include "bench-util.h"
+
+/*
+ * Config file benchmark
+ *
+ *   Fills a config with a number of sections and keys, then times lookups
+ * with the names in their stored case and in a different case, setting
+ * existing keys, a number of config_save calls in a row, and the same number
+ * of config_save_deferred calls followed by the config_close that writes
+ * them.  The names are built up front, so only the config functions are
+ * timed.  Results are written as JSON.
+ */
+
+#define DEFAULT_SECTIONS   60
+#define DEFAULT_KEYS       50
+#define DEFAULT_ITERATIONS 200000
+#define DEFAULT_SAVES      100
+#define DEFAULT_FILE       "config-benchmark.ini"
+#define MAX_COUNT          100000000
+
+struct config_benchmark_config {
+	uint32_t    sections;
+	uint32_t    keys;
+	uint32_t    iterations;
+	uint32_t    saves;
+	const char  *file;
+	const char  *output_path;
+};
+
+struct config_name {
+	char        *section;
+	char        *key;
+};
+
+struct config_benchmark {
+	struct config_benchmark_config config;
+
+	config_t                       *config_file;
+	struct config_name             *names;
+	struct config_name             *upper_names;
+	size_t                         num_names;
+
+	/* touched by every lookup so the calls cannot be optimized out */
+	volatile int64_t               sink;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static char *make_name(const char *prefix, uint32_t idx)
+{
+	struct dstr name = {0};
+	dstr_printf(&name, "%s%u", prefix, idx);
+	return name.array;
+}
+
+static void make_names(struct config_benchmark *bench)
+{
+	struct config_benchmark_config *config = &bench->config;
+
+	bench->num_names   = (size_t)config->sections * config->keys;
+	bench->names       = bzalloc(bench->num_names *
+			sizeof(struct config_name));
+	bench->upper_names = bzalloc(bench->num_names *
+			sizeof(struct config_name));
+
+	for (uint32_t i = 0; i < config->sections; i++) {
+		for (uint32_t j = 0; j < config->keys; j++) {
+			size_t idx = (size_t)i * config->keys + j;
+
+			bench->names[idx].section = make_name("Section", i);
+			bench->names[idx].key = make_name("Key", j);
+			bench->upper_names[idx].section =
+				make_name("SECTION", i);
+			bench->upper_names[idx].key = make_name("KEY", j);
+		}
+	}
+}
+
+static void free_names(struct config_name *names, size_t num)
+{
+	if (!names)
+		return;
+
+	for (size_t i = 0; i < num; i++) {
+		bfree(names[i].section);
+		bfree(names[i].key);
+	}
+
+	bfree(names);
+}
+
+static void fill_config(struct config_benchmark *bench)
+{
+	for (size_t i = 0; i < bench->num_names; i++)
+		config_set_int(bench->config_file, bench->names[i].section,
+				bench->names[i].key, (int64_t)i);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static double run_get(struct config_benchmark *bench,
+		const struct config_name *names)
+{
+	uint32_t iterations = bench->config.iterations;
+	uint64_t start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		const struct config_name *name = names + i % bench->num_names;
+		bench->sink = config_get_int(bench->config_file,
+				name->section, name->key);
+	}
+
+	return bench_ns_per(start, iterations);
+}
+
+static double run_set(struct config_benchmark *bench)
+{
+	uint32_t iterations = bench->config.iterations;
+	uint64_t start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		const struct config_name *name =
+			bench->names + i % bench->num_names;
+		config_set_int(bench->config_file, name->section, name->key,
+				(int64_t)i);
+	}
+
+	return bench_ns_per(start, iterations);
+}
+
+/* every save changes a value first, so none of them can be skipped */
+static double run_save(struct config_benchmark *bench, bool deferred)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < bench->config.saves; i++) {
+		config_set_int(bench->config_file, bench->names[0].section,
+				bench->names[0].key, (int64_t)i);
+
+		if (deferred)
+			config_save_deferred(bench->config_file);
+		else
+			config_save(bench->config_file);
+	}
+
+	/* closing writes what is still pending */
+	if (deferred) {
+		config_close(bench->config_file);
+		bench->config_file = NULL;
+	}
+
+	return (double)(os_gettime_ns() - start) / 1000000.0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_data_t *get_results(struct config_benchmark *bench)
+{
+	struct config_benchmark_config *config = &bench->config;
+	obs_data_t *results = obs_data_create();
+	double get, get_mismatched, set, save, save_deferred;
+
+	/* one unmeasured pass to warm up the caches */
+	run_get(bench, bench->names);
+
+	get            = run_get(bench, bench->names);
+	get_mismatched = run_get(bench, bench->upper_names);
+	set            = run_set(bench);
+	save           = run_save(bench, false);
+	save_deferred  = run_save(bench, true);
+
+	obs_data_set_int(results, "sections", config->sections);
+	obs_data_set_int(results, "keys", config->keys);
+	obs_data_set_int(results, "iterations", config->iterations);
+	obs_data_set_int(results, "saves", config->saves);
+	obs_data_set_double(results, "get_ns", get);
+	obs_data_set_double(results, "get_case_mismatched_ns", get_mismatched);
+	obs_data_set_double(results, "set_existing_ns", set);
+	obs_data_set_double(results, "save_ms", save);
+	obs_data_set_double(results, "save_deferred_ms", save_deferred);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *name)
+{
+	bench_print_usage(name, "",
+		"  --sections <count>        sections (%d)\n"
+		"  --keys <count>            keys per section (%d)\n"
+		"  --iterations <count>      lookups per pass (%d)\n"
+		"  --saves <count>           saves per pass (%d)\n"
+		"  --file <file>             config file to save to (%s)\n",
+		DEFAULT_SECTIONS, DEFAULT_KEYS, DEFAULT_ITERATIONS,
+		DEFAULT_SAVES, DEFAULT_FILE);
+}
+
+static bool parse_args(struct config_benchmark_config *config, int argc,
+		char *argv[])
+{
+	config->sections   = DEFAULT_SECTIONS;
+	config->keys       = DEFAULT_KEYS;
+	config->iterations = DEFAULT_ITERATIONS;
+	config->saves      = DEFAULT_SAVES;
+	config->file       = DEFAULT_FILE;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid;
+
+		if (strcmp(arg, "--sections") == 0)
+			valid = bench_parse_uint(next, &config->sections,
+					MAX_COUNT);
+		else if (strcmp(arg, "--keys") == 0)
+			valid = bench_parse_uint(next, &config->keys,
+					MAX_COUNT);
+		else if (strcmp(arg, "--iterations") == 0)
+			valid = bench_parse_uint(next, &config->iterations,
+					MAX_COUNT);
+		else if (strcmp(arg, "--saves") == 0)
+			valid = bench_parse_uint(next, &config->saves,
+					MAX_COUNT);
+		else if (strcmp(arg, "--file") == 0)
+			valid = (config->file = next) != NULL;
+		else if (strcmp(arg, "--output") == 0)
+			valid = (config->output_path = next) != NULL;
+		else
+			valid = false;
+
+		if (!valid)
+			return false;
+		i++;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct config_benchmark bench = {0};
+	obs_data_t *results;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&bench.config, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (config_open(&bench.config_file, bench.config.file,
+				CONFIG_OPEN_ALWAYS) != CONFIG_SUCCESS) {
+		fprintf(stderr, "Failed to open '%s'\n", bench.config.file);
+		return EXIT_FAILURE;
+	}
+
+	make_names(&bench);
+	fill_config(&bench);
+
+	results = get_results(&bench);
+	if (bench_write_results(results, bench.config.output_path))
+		ret = EXIT_SUCCESS;
+	obs_data_release(results);
+
+	config_close(bench.config_file);
+	os_unlink(bench.config.file);
+
+	free_names(bench.names, bench.num_names);
+	free_names(bench.upper_names, bench.num_names);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -0,0 +1,983 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <graphics/vec2.h>
+#include <obs.h>
+
+#include "bench-util.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+/*
+ * Headless libobs benchmark
+ *
+ *   Starts libobs without a window (the software graphics module by
+ * default), renders a scene of synthetic sources at the requested canvas
+ * size and frame rate, and feeds the real video-io and audio-io threads into
+ * a video encoder and up to two audio encoders connected to a null output.
+ * When done, the results are written as JSON so they can be compared between
+ * commits.
+ */
+
+#if defined(DL_SOFTWARE)
+#define DEFAULT_GRAPHICS (*DL_SOFTWARE ? DL_SOFTWARE : "libobs-software")
+#else
+#define DEFAULT_GRAPHICS "libobs-software"
+#endif
+
+#define MAX_AUDIO_ENCODERS 2
+#define MAX_SOURCES        256
+#define SAMPLE_INTERVAL_MS 100
+#define MAX_COUNT          100000
+
+struct benchmark_config {
+	uint32_t    width;
+	uint32_t    height;
+	uint32_t    fps;
+	uint32_t    seconds;
+	uint32_t    warmup;
+	const char  *graphics;
+	const char  *video_source;
+	const char  *audio_source;
+	uint32_t    sources;
+	uint32_t    source_format;
+	uint32_t    audio_channels;
+	const char  *video_encoder;
+	const char  *audio_encoders[MAX_AUDIO_ENCODERS];
+	size_t      num_audio_encoders;
+	const char  *preset;
+	const char  *module_bin;
+	const char  *module_data;
+	const char  *output_path;
+	bool        verbose;
+};
+
+struct latency {
+	uint64_t    total;
+	uint64_t    max;
+	uint64_t    count;
+};
+
+struct packet_stats {
+	uint64_t    packets;
+	uint64_t    bytes;
+	uint64_t    keyframes;
+};
+
+struct encoder_stats {
+	float       load_total;
+	float       load_max;
+	uint64_t    lag_max;
+	uint32_t    samples;
+};
+
+struct benchmark {
+	struct benchmark_config config;
+
+	obs_scene_t             *scene;
+	DARRAY(obs_source_t*)   sources;
+	obs_encoder_t           *video_encoder;
+	obs_encoder_t           *audio_encoders[MAX_AUDIO_ENCODERS];
+	obs_output_t            *output;
+
+	/* everything below is written by the video-io, audio-io and encoder
+	 * threads and read by the main thread */
+	pthread_mutex_t         mutex;
+	bool                    measuring;
+	struct latency          video_latency;
+	struct latency          audio_latency;
+	uint64_t                audio_blocks;
+	struct packet_stats     video_packets;
+	struct packet_stats     audio_packets[MAX_AUDIO_ENCODERS];
+
+	struct encoder_stats    video_encoder_stats;
+	uint32_t                start_total_frames;
+	uint32_t                start_skipped_frames;
+	uint64_t                start_time;
+	uint64_t                end_time;
+};
+
+static inline void latency_add(struct latency *latency, uint64_t val)
+{
+	latency->total += val;
+	latency->count++;
+	if (val > latency->max)
+		latency->max = val;
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* null output, counts the packets of each track and discards them           */
+
+static const char *null_output_getname(void)
+{
+	return "Null Output (Benchmark)";
+}
+
+static void *null_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(output);
+	return output;
+}
+
+static void null_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool null_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	if (!obs_output_can_begin_data_capture(output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(output, 0);
+}
+
+static void null_output_stop(void *data)
+{
+	obs_output_end_data_capture(data);
+}
+
+static struct benchmark *cur_benchmark = NULL;
+
+static void null_output_data(void *data, struct encoder_packet *packet)
+{
+	struct benchmark *bench = cur_benchmark;
+	struct packet_stats *stats;
+
+	pthread_mutex_lock(&bench->mutex);
+
+	if (bench->measuring) {
+		if (packet->type == OBS_ENCODER_VIDEO)
+			stats = &bench->video_packets;
+		else if (packet->track_idx < MAX_AUDIO_ENCODERS)
+			stats = &bench->audio_packets[packet->track_idx];
+		else
+			stats = NULL;
+
+		if (stats) {
+			stats->packets++;
+			stats->bytes += packet->size;
+			if (packet->keyframe)
+				stats->keyframes++;
+		}
+	}
+
+	pthread_mutex_unlock(&bench->mutex);
+
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_output_info null_output_info = {
+	.id             = "benchmark_null_output",
+	.flags          = OBS_OUTPUT_AV |
+	                  OBS_OUTPUT_ENCODED |
+	                  OBS_OUTPUT_MULTI_TRACK,
+	.get_name       = null_output_getname,
+	.create         = null_output_create,
+	.destroy        = null_output_destroy,
+	.start          = null_output_start,
+	.stop           = null_output_stop,
+	.encoded_packet = null_output_data
+};
+
+/* ------------------------------------------------------------------------- */
+/* raw callbacks, measure how long frames take to get through the pipeline  */
+
+static void receive_video(void *param, struct video_data *frame)
+{
+	struct benchmark *bench = param;
+	uint64_t now = os_gettime_ns();
+
+	pthread_mutex_lock(&bench->mutex);
+	if (bench->measuring && now > frame->timestamp)
+		latency_add(&bench->video_latency, now - frame->timestamp);
+	pthread_mutex_unlock(&bench->mutex);
+}
+
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct benchmark *bench = param;
+	uint64_t now = os_gettime_ns();
+
+	pthread_mutex_lock(&bench->mutex);
+	if (bench->measuring) {
+		if (now > data->timestamp)
+			latency_add(&bench->audio_latency,
+					now - data->timestamp);
+		bench->audio_blocks++;
+	}
+	pthread_mutex_unlock(&bench->mutex);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+/* per thread cpu usage                                                      */
+
+struct thread_time {
+	long        tid;
+	char        name[32];
+	uint64_t    ticks;
+};
+
+#ifdef __linux__
+static bool read_thread_time(const char *tid, struct thread_time *tt)
+{
+	struct dstr path = {0};
+	char stat[1024];
+	char *name_start, *name_end;
+	unsigned long long utime, stime;
+	FILE *file;
+	size_t len;
+
+	/* procfs files have no size, so they are read with fgets rather than
+	 * os_quick_read_utf8_file */
+	dstr_printf(&path, "/proc/self/task/%s/stat", tid);
+	file = os_fopen(path.array, "rb");
+	dstr_free(&path);
+
+	if (!file)
+		return false;
+	if (!fgets(stat, sizeof(stat), file)) {
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+
+	/* the thread name can contain spaces and parentheses */
+	name_start = strchr(stat, '(');
+	name_end   = strrchr(stat, ')');
+	if (!name_start || !name_end || name_end < name_start)
+		return false;
+
+	len = name_end - name_start - 1;
+	if (len >= sizeof(tt->name))
+		len = sizeof(tt->name) - 1;
+	memcpy(tt->name, name_start + 1, len);
+	tt->name[len] = 0;
+
+	/* utime and stime are fields 14 and 15, the state is field 3 */
+	if (sscanf(name_end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+				"%llu %llu", &utime, &stime) != 2)
+		return false;
+
+	tt->tid   = strtol(tid, NULL, 10);
+	tt->ticks = utime + stime;
+	return true;
+}
+
+static void get_thread_times(struct darray *times_da)
+{
+	DARRAY(struct thread_time) times;
+	os_dir_t *dir = os_opendir("/proc/self/task");
+	struct os_dirent *ent;
+
+	times.da = *times_da;
+
+	if (dir) {
+		while ((ent = os_readdir(dir)) != NULL) {
+			struct thread_time tt;
+
+			if (ent->d_name[0] == '.')
+				continue;
+			if (read_thread_time(ent->d_name, &tt))
+				da_push_back(times, &tt);
+		}
+
+		os_closedir(dir);
+	}
+
+	*times_da = times.da;
+}
+
+static inline double ticks_per_sec(void)
+{
+	return (double)sysconf(_SC_CLK_TCK);
+}
+#else
+static void get_thread_times(struct darray *times_da)
+{
+	UNUSED_PARAMETER(times_da);
+}
+
+static inline double ticks_per_sec(void)
+{
+	return 1.0;
+}
+#endif
+
+static const struct thread_time *find_thread(const struct darray *times_da,
+		long tid)
+{
+	const struct thread_time *times = times_da->array;
+
+	for (size_t i = 0; i < times_da->num; i++) {
+		if (times[i].tid == tid)
+			return times + i;
+	}
+
+	return NULL;
+}
+
+static obs_data_array_t *get_thread_usage(const struct darray *start_da,
+		const struct darray *end_da, double seconds)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	const struct thread_time *end = end_da->array;
+
+	for (size_t i = 0; i < end_da->num; i++) {
+		const struct thread_time *start;
+		obs_data_t *item;
+		uint64_t ticks;
+
+		start = find_thread(start_da, end[i].tid);
+		ticks = end[i].ticks - (start ? start->ticks : 0);
+
+		item = obs_data_create();
+		obs_data_set_int(item, "tid", end[i].tid);
+		obs_data_set_string(item, "name", end[i].name);
+		obs_data_set_double(item, "cpu_percent",
+				(double)ticks / ticks_per_sec() / seconds *
+				100.0);
+		obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+
+	return array;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *name)
+{
+	bench_print_usage(name, "",
+		"  --width <cx>              canvas width (1280)\n"
+		"  --height <cy>             canvas height (720)\n"
+		"  --fps <fps>               frame rate (30)\n"
+		"  --seconds <sec>           measured duration (10)\n"
+		"  --warmup <sec>            unmeasured warmup (2)\n"
+		"  --graphics <module>       graphics module "
+						"(libobs-software)\n"
+		"  --video-source <id>       video source (synth_video)\n"
+		"  --audio-source <id>       audio source (synth_audio)\n"
+		"  --sources <count>         number of video and audio source "
+						"pairs (1)\n"
+		"  --source-format <format>  synth_video format, i420, nv12, "
+						"yvyu, yuy2,\n"
+		"                            uyvy, rgba, bgra, bgrx or i444 "
+						"(nv12)\n"
+		"  --channels <count>        synth_audio channels (2)\n"
+		"  --video-encoder <id>      video encoder (obs_x264)\n"
+		"  --audio-encoder <id>      audio encoder, can be given "
+						"twice\n"
+		"                            (ffmpeg_aac and libfdk_aac)\n"
+		"  --preset <preset>         x264 preset (veryfast)\n"
+		"  --module-path <bin> <data> additional module path\n"
+		"  --verbose                 print the libobs log\n");
+}
+
+static const char *format_names[] = {
+	[VIDEO_FORMAT_I420] = "i420",
+	[VIDEO_FORMAT_NV12] = "nv12",
+	[VIDEO_FORMAT_YVYU] = "yvyu",
+	[VIDEO_FORMAT_YUY2] = "yuy2",
+	[VIDEO_FORMAT_UYVY] = "uyvy",
+	[VIDEO_FORMAT_RGBA] = "rgba",
+	[VIDEO_FORMAT_BGRA] = "bgra",
+	[VIDEO_FORMAT_BGRX] = "bgrx",
+	[VIDEO_FORMAT_I444] = "i444"
+};
+
+#define NUM_FORMATS (sizeof(format_names) / sizeof(format_names[0]))
+
+static bool parse_format(const char *str, uint32_t *val)
+{
+	for (uint32_t i = 0; i < NUM_FORMATS; i++) {
+		if (format_names[i] && astrcmpi(format_names[i], str) == 0) {
+			*val = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool parse_args(struct benchmark_config *config, int argc, char *argv[])
+{
+	bool default_audio = true;
+
+	config->width          = 1280;
+	config->height         = 720;
+	config->fps            = 30;
+	config->seconds        = 10;
+	config->warmup         = 2;
+	config->graphics       = DEFAULT_GRAPHICS;
+	config->video_source   = "synth_video";
+	config->audio_source   = "synth_audio";
+	config->sources        = 1;
+	config->source_format  = VIDEO_FORMAT_NV12;
+	config->audio_channels = 2;
+	config->video_encoder  = "obs_x264";
+	config->preset         = "veryfast";
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg  = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid = true;
+
+		if (strcmp(arg, "--verbose") == 0) {
+			config->verbose = true;
+			continue;
+		}
+
+		if (!next) {
+			fprintf(stderr, "Missing value for '%s'\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--width") == 0) {
+			valid = bench_parse_uint(next, &config->width,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--height") == 0) {
+			valid = bench_parse_uint(next, &config->height,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--fps") == 0) {
+			valid = bench_parse_uint(next, &config->fps,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--seconds") == 0) {
+			valid = bench_parse_uint(next, &config->seconds,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--warmup") == 0) {
+			valid = bench_parse_uint(next, &config->warmup,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--graphics") == 0) {
+			config->graphics = next;
+		} else if (strcmp(arg, "--video-source") == 0) {
+			config->video_source = next;
+		} else if (strcmp(arg, "--audio-source") == 0) {
+			config->audio_source = next;
+		} else if (strcmp(arg, "--sources") == 0) {
+			valid = bench_parse_uint(next, &config->sources,
+					MAX_COUNT) &&
+				config->sources <= MAX_SOURCES;
+		} else if (strcmp(arg, "--source-format") == 0) {
+			valid = parse_format(next, &config->source_format);
+		} else if (strcmp(arg, "--channels") == 0) {
+			valid = bench_parse_uint(next, &config->audio_channels,
+					MAX_COUNT);
+		} else if (strcmp(arg, "--video-encoder") == 0) {
+			config->video_encoder = next;
+		} else if (strcmp(arg, "--audio-encoder") == 0) {
+			if (default_audio) {
+				config->num_audio_encoders = 0;
+				default_audio = false;
+			}
+			if (config->num_audio_encoders == MAX_AUDIO_ENCODERS) {
+				fprintf(stderr, "Too many audio encoders\n");
+				return false;
+			}
+			config->audio_encoders[
+				config->num_audio_encoders++] = next;
+		} else if (strcmp(arg, "--preset") == 0) {
+			config->preset = next;
+		} else if (strcmp(arg, "--module-path") == 0) {
+			if (i + 2 >= argc) {
+				fprintf(stderr, "Missing value for '%s'\n",
+						arg);
+				return false;
+			}
+			config->module_bin  = next;
+			config->module_data = argv[i + 2];
+			i++;
+		} else if (strcmp(arg, "--output") == 0) {
+			config->output_path = next;
+		} else {
+			fprintf(stderr, "Unknown option '%s'\n", arg);
+			return false;
+		}
+
+		if (!valid) {
+			fprintf(stderr, "Invalid value '%s' for '%s'\n",
+					next, arg);
+			return false;
+		}
+
+		i++;
+	}
+
+	if (default_audio) {
+		config->audio_encoders[0]  = "ffmpeg_aac";
+		config->audio_encoders[1]  = "libfdk_aac";
+		config->num_audio_encoders = 2;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool reset_video(struct benchmark *bench)
+{
+	struct benchmark_config *config = &bench->config;
+	struct obs_video_info ovi = {0};
+
+	ovi.graphics_module = config->graphics;
+	ovi.fps_num         = config->fps;
+	ovi.fps_den         = 1;
+	ovi.base_width      = config->width;
+	ovi.base_height     = config->height;
+	ovi.output_width    = config->width;
+	ovi.output_height   = config->height;
+	ovi.window_width    = config->width;
+	ovi.window_height   = config->height;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.colorspace      = VIDEO_CS_601;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	if (obs_reset_video(&ovi) != 0) {
+		fprintf(stderr, "Failed to initialize video with '%s'\n",
+				config->graphics);
+		return false;
+	}
+
+	return true;
+}
+
+static bool reset_audio(void)
+{
+	struct obs_audio_info oai = {
+		.samples_per_sec = 44100,
+		.speakers        = SPEAKERS_STEREO,
+		.buffer_ms       = 1000
+	};
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Failed to initialize audio\n");
+		return false;
+	}
+
+	return true;
+}
+
+static obs_source_t *create_source(struct benchmark *bench, const char *id,
+		const char *kind, size_t idx)
+{
+	struct benchmark_config *config = &bench->config;
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *source;
+	struct dstr name = {0};
+
+	/* settings of the synthetic test sources, other sources ignore them */
+	obs_data_set_int(settings, "width", config->width);
+	obs_data_set_int(settings, "height", config->height);
+	obs_data_set_int(settings, "fps", config->fps);
+	obs_data_set_int(settings, "format", config->source_format);
+	obs_data_set_int(settings, "channels", config->audio_channels);
+
+	dstr_printf(&name, "benchmark %s %d", kind, (int)idx);
+	source = obs_source_create(OBS_SOURCE_TYPE_INPUT, id, name.array,
+			settings, NULL);
+	dstr_free(&name);
+	obs_data_release(settings);
+
+	if (!source)
+		fprintf(stderr, "Source '%s' not found\n", id);
+	else
+		da_push_back(bench->sources, &source);
+
+	return source;
+}
+
+static bool create_scene(struct benchmark *bench)
+{
+	struct benchmark_config *config = &bench->config;
+	uint32_t cols = 1;
+	uint32_t rows;
+	struct vec2 bounds;
+
+	while (cols * cols < config->sources)
+		cols++;
+	rows = (config->sources + cols - 1) / cols;
+
+	/* the sources are laid out in a grid that covers the whole canvas, so
+	 * the renderer has to touch every pixel of every frame */
+	vec2_set(&bounds, (float)config->width / (float)cols,
+			(float)config->height / (float)rows);
+
+	bench->scene = obs_scene_create("benchmark scene");
+
+	for (uint32_t i = 0; i < config->sources; i++) {
+		obs_source_t *video, *audio;
+		obs_sceneitem_t *item;
+		struct vec2 pos;
+
+		video = create_source(bench, config->video_source, "video", i);
+		audio = create_source(bench, config->audio_source, "audio", i);
+		if (!video || !audio)
+			return false;
+
+		vec2_set(&pos, bounds.x * (float)(i % cols),
+				bounds.y * (float)(i / cols));
+
+		item = obs_scene_add(bench->scene, video);
+		obs_sceneitem_set_pos(item, &pos);
+		obs_sceneitem_set_bounds_type(item, OBS_BOUNDS_STRETCH);
+		obs_sceneitem_set_bounds(item, &bounds);
+
+		obs_scene_add(bench->scene, audio);
+	}
+
+	obs_set_output_source(0, obs_scene_get_source(bench->scene));
+	return true;
+}
+
+static bool create_encoders(struct benchmark *bench)
+{
+	struct benchmark_config *config = &bench->config;
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_string(settings, "preset", config->preset);
+	bench->video_encoder = obs_video_encoder_create(config->video_encoder,
+			"benchmark video encoder", settings, NULL);
+	obs_data_release(settings);
+
+	if (!bench->video_encoder) {
+		fprintf(stderr, "Video encoder '%s' not found\n",
+				config->video_encoder);
+		return false;
+	}
+
+	obs_encoder_set_video(bench->video_encoder, obs_get_video());
+	obs_output_set_video_encoder(bench->output, bench->video_encoder);
+
+	for (size_t i = 0; i < config->num_audio_encoders; i++) {
+		const char *id = config->audio_encoders[i];
+		obs_encoder_t *encoder;
+		struct dstr name = {0};
+
+		dstr_printf(&name, "benchmark audio encoder %d", (int)i);
+		encoder = obs_audio_encoder_create(id, name.array, NULL, 0,
+				NULL);
+		dstr_free(&name);
+
+		if (!encoder) {
+			fprintf(stderr, "Audio encoder '%s' not found\n", id);
+			return false;
+		}
+
+		obs_encoder_set_audio(encoder, obs_get_audio());
+		obs_output_set_audio_encoder(bench->output, encoder, i);
+		bench->audio_encoders[i] = encoder;
+	}
+
+	return true;
+}
+
+static void sample_encoder(struct benchmark *bench)
+{
+	struct encoder_stats *stats = &bench->video_encoder_stats;
+	float load = obs_encoder_get_load(bench->video_encoder);
+	uint64_t lag = obs_encoder_get_lag_ns(bench->video_encoder);
+
+	stats->load_total += load;
+	stats->samples++;
+	if (load > stats->load_max)
+		stats->load_max = load;
+	if (lag > stats->lag_max)
+		stats->lag_max = lag;
+}
+
+static void start_measuring(struct benchmark *bench)
+{
+	video_t *video = obs_get_video();
+
+	pthread_mutex_lock(&bench->mutex);
+	bench->start_total_frames   = video_output_get_total_frames(video);
+	bench->start_skipped_frames = video_output_get_skipped_frames(video);
+	bench->start_time           = os_gettime_ns();
+	bench->measuring            = true;
+	pthread_mutex_unlock(&bench->mutex);
+}
+
+static void stop_measuring(struct benchmark *bench)
+{
+	pthread_mutex_lock(&bench->mutex);
+	bench->measuring = false;
+	bench->end_time  = os_gettime_ns();
+	pthread_mutex_unlock(&bench->mutex);
+}
+
+static void run(struct benchmark *bench, struct darray *start_times,
+		struct darray *end_times)
+{
+	struct benchmark_config *config = &bench->config;
+	uint64_t end_time;
+
+	os_sleep_ms(config->warmup * 1000);
+
+	get_thread_times(start_times);
+	start_measuring(bench);
+
+	end_time = bench->start_time +
+		(uint64_t)config->seconds * 1000000000ULL;
+
+	while (os_gettime_ns() < end_time) {
+		os_sleep_ms(SAMPLE_INTERVAL_MS);
+		sample_encoder(bench);
+	}
+
+	stop_measuring(bench);
+	get_thread_times(end_times);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_data_t *latency_data(const struct latency *latency)
+{
+	obs_data_t *data = obs_data_create();
+	uint64_t avg = latency->count ? latency->total / latency->count : 0;
+
+	obs_data_set_double(data, "avg_ms", ns_to_ms(avg));
+	obs_data_set_double(data, "max_ms", ns_to_ms(latency->max));
+	return data;
+}
+
+static obs_data_t *packet_data(const struct packet_stats *stats,
+		double seconds)
+{
+	obs_data_t *data = obs_data_create();
+
+	obs_data_set_int(data, "packets", (long long)stats->packets);
+	obs_data_set_int(data, "bytes", (long long)stats->bytes);
+	obs_data_set_int(data, "keyframes", (long long)stats->keyframes);
+	obs_data_set_double(data, "packets_per_sec",
+			(double)stats->packets / seconds);
+	obs_data_set_double(data, "kbps",
+			(double)stats->bytes * 8.0 / 1000.0 / seconds);
+	return data;
+}
+
+static obs_data_t *config_data(const struct benchmark_config *config)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_array_t *audio = obs_data_array_create();
+
+	obs_data_set_int(data, "width", config->width);
+	obs_data_set_int(data, "height", config->height);
+	obs_data_set_int(data, "fps", config->fps);
+	obs_data_set_int(data, "seconds", config->seconds);
+	obs_data_set_string(data, "graphics", config->graphics);
+	obs_data_set_string(data, "video_source", config->video_source);
+	obs_data_set_string(data, "audio_source", config->audio_source);
+	obs_data_set_int(data, "sources", config->sources);
+	obs_data_set_string(data, "source_format",
+			format_names[config->source_format]);
+	obs_data_set_int(data, "channels", config->audio_channels);
+	obs_data_set_string(data, "video_encoder", config->video_encoder);
+	obs_data_set_string(data, "preset", config->preset);
+
+	for (size_t i = 0; i < config->num_audio_encoders; i++) {
+		obs_data_t *item = obs_data_create();
+		obs_data_set_string(item, "id", config->audio_encoders[i]);
+		obs_data_array_push_back(audio, item);
+		obs_data_release(item);
+	}
+
+	bench_set_array(data, "audio_encoders", audio);
+	return data;
+}
+
+static obs_data_t *get_results(struct benchmark *bench,
+		const struct darray *start_times,
+		const struct darray *end_times)
+{
+	struct benchmark_config *config = &bench->config;
+	struct encoder_stats *enc_stats = &bench->video_encoder_stats;
+	video_t *video = obs_get_video();
+	obs_data_t *results = obs_data_create();
+	obs_data_t *video_data = obs_data_create();
+	obs_data_t *audio_data = obs_data_create();
+	obs_data_t *encoder = obs_data_create();
+	obs_data_array_t *audio_encoders = obs_data_array_create();
+	double seconds;
+	uint32_t frames, skipped;
+
+	seconds = (double)(bench->end_time - bench->start_time) / 1000000000.0;
+	frames  = video_output_get_total_frames(video) -
+		bench->start_total_frames;
+	skipped = video_output_get_skipped_frames(video) -
+		bench->start_skipped_frames;
+
+	bench_set_obj(results, "config", config_data(config));
+	obs_data_set_double(results, "seconds", seconds);
+
+	/* video-io: frames delivered, and the time from the frame timestamp
+	 * to delivery, which covers rendering, download and conversion */
+	obs_data_set_int(video_data, "frames", frames);
+	obs_data_set_double(video_data, "fps", (double)frames / seconds);
+	obs_data_set_int(video_data, "skipped_frames", skipped);
+	bench_set_obj(video_data, "latency",
+			latency_data(&bench->video_latency));
+	bench_set_obj(results, "video", video_data);
+
+	obs_data_set_int(audio_data, "blocks", (long long)bench->audio_blocks);
+	bench_set_obj(audio_data, "latency",
+			latency_data(&bench->audio_latency));
+	bench_set_obj(results, "audio", audio_data);
+
+	obs_data_set_string(encoder, "id", config->video_encoder);
+	obs_data_set_double(encoder, "load_avg", enc_stats->samples ?
+			enc_stats->load_total / enc_stats->samples : 0.0f);
+	obs_data_set_double(encoder, "load_max", enc_stats->load_max);
+	obs_data_set_double(encoder, "encode_ms_avg", enc_stats->samples ?
+			enc_stats->load_total / enc_stats->samples * 1000.0 /
+			config->fps : 0.0);
+	obs_data_set_double(encoder, "lag_ms_max",
+			ns_to_ms(enc_stats->lag_max));
+	bench_set_obj(encoder, "output", packet_data(&bench->video_packets,
+				seconds));
+	bench_set_obj(results, "video_encoder", encoder);
+
+	for (size_t i = 0; i < config->num_audio_encoders; i++) {
+		obs_data_t *item = obs_data_create();
+		obs_data_set_string(item, "id", config->audio_encoders[i]);
+		bench_set_obj(item, "output",
+				packet_data(&bench->audio_packets[i], seconds));
+		obs_data_array_push_back(audio_encoders, item);
+		obs_data_release(item);
+	}
+	bench_set_array(results, "audio_encoders", audio_encoders);
+
+	obs_data_set_int(results, "dropped_frames", skipped +
+			obs_output_get_frames_dropped(bench->output));
+
+	if (end_times->num)
+		bench_set_array(results, "threads",
+				get_thread_usage(start_times, end_times,
+					seconds));
+
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool start(struct benchmark *bench)
+{
+	struct benchmark_config *config = &bench->config;
+
+	if (!obs_startup("en-US"))
+		return false;
+
+	if (config->module_bin)
+		obs_add_module_path(config->module_bin, config->module_data);
+
+	if (!reset_video(bench) || !reset_audio())
+		return false;
+
+	obs_load_all_modules();
+	obs_register_output(&null_output_info);
+
+	if (!create_scene(bench))
+		return false;
+
+	bench->output = obs_output_create(null_output_info.id,
+			"benchmark output", NULL, NULL);
+	if (!bench->output || !create_encoders(bench))
+		return false;
+
+	video_output_connect(obs_get_video(), NULL, receive_video, bench);
+	audio_output_connect(obs_get_audio(), 0, NULL, receive_audio, bench);
+
+	if (!obs_output_start(bench->output)) {
+		fprintf(stderr, "Failed to start the output\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void stop(struct benchmark *bench)
+{
+	if (!obs_initialized())
+		return;
+
+	if (bench->output)
+		obs_output_stop(bench->output);
+
+	video_output_disconnect(obs_get_video(), receive_video, bench);
+	audio_output_disconnect(obs_get_audio(), 0, receive_audio, bench);
+
+	obs_set_output_source(0, NULL);
+
+	obs_output_release(bench->output);
+	obs_encoder_release(bench->video_encoder);
+	for (size_t i = 0; i < MAX_AUDIO_ENCODERS; i++)
+		obs_encoder_release(bench->audio_encoders[i]);
+
+	for (size_t i = 0; i < bench->sources.num; i++)
+		obs_source_release(bench->sources.array[i]);
+	da_free(bench->sources);
+
+	obs_scene_release(bench->scene);
+}
+
+int main(int argc, char *argv[])
+{
+	struct benchmark bench = {0};
+	struct darray start_times = {0};
+	struct darray end_times = {0};
+	obs_data_t *results;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&bench.config, argc, argv)) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	base_set_log_handler(bench_log, &bench.config.verbose);
+
+	if (pthread_mutex_init(&bench.mutex, NULL) != 0)
+		return EXIT_FAILURE;
+
+	cur_benchmark = &bench;
+
+	if (start(&bench)) {
+		run(&bench, &start_times, &end_times);
+
+		results = get_results(&bench, &start_times, &end_times);
+		if (bench_write_results(results, bench.config.output_path))
+			ret = EXIT_SUCCESS;
+		obs_data_release(results);
+	}
+
+	stop(&bench);
+	obs_shutdown();
+
+	darray_free(&start_times);
+	darray_free(&end_times);
+	pthread_mutex_destroy(&bench.mutex);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
@@ -5,11 +5,15 @@ OBS_DECLARE_MODULE()
 extern struct obs_source_info test_random;
 extern struct obs_source_info test_sinewave;
 extern struct obs_source_info test_filter;
+extern struct obs_source_info test_synth_video;
+extern struct obs_source_info test_synth_audio;
 
 bool obs_module_load(void)
 {
 	obs_register_source(&test_random);
 	obs_register_source(&test_sinewave);
 	obs_register_source(&test_filter);
+	obs_register_source(&test_synth_video);
+	obs_register_source(&test_synth_audio);
 	return true;
 }
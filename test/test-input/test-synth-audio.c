@@ -0,0 +1,238 @@
+#include <math.h>
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <obs.h>
+
+/*
+ * Synthetic audio source for load testing
+ *
+ *   One second of planar float audio is generated when the source is created
+ * or updated, with a different whole number frequency on each channel so it
+ * loops without a seam, and the output thread sends it in 10 millisecond
+ * blocks.
+ */
+
+#define DEFAULT_CHANNELS        2
+#define DEFAULT_SAMPLES_PER_SEC 48000
+#define BLOCKS_PER_SEC          100
+#define BASE_FREQUENCY          220.0
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+struct synth_audio {
+	obs_source_t        *source;
+
+	enum speaker_layout speakers;
+	uint32_t            channels;
+	uint32_t            samples_per_sec;
+	uint32_t            block_frames;
+
+	/* samples_per_sec + block_frames frames, the tail repeats the start
+	 * so every block can be read in one piece */
+	float               *pool[MAX_AV_PLANES];
+
+	os_event_t          *stop_signal;
+	pthread_t           thread;
+	bool                thread_active;
+};
+
+static const char *synth_audio_getname(void)
+{
+	return "Synthetic Audio Source (Test)";
+}
+
+static enum speaker_layout get_speakers(uint32_t channels)
+{
+	switch (channels) {
+	case 1: return SPEAKERS_MONO;
+	case 2: return SPEAKERS_STEREO;
+	case 3: return SPEAKERS_2POINT1;
+	case 4: return SPEAKERS_QUAD;
+	case 5: return SPEAKERS_4POINT1;
+	case 6: return SPEAKERS_5POINT1;
+	case 8: return SPEAKERS_7POINT1;
+	}
+
+	return SPEAKERS_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void free_pool(struct synth_audio *sa)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		bfree(sa->pool[i]);
+		sa->pool[i] = NULL;
+	}
+}
+
+static void create_pool(struct synth_audio *sa)
+{
+	size_t frames = sa->samples_per_sec + sa->block_frames;
+
+	for (uint32_t c = 0; c < sa->channels; c++) {
+		double step = BASE_FREQUENCY * (c + 1) * 2.0 * M_PI /
+			(double)sa->samples_per_sec;
+		float *samples = bmalloc(frames * sizeof(float));
+
+		for (size_t i = 0; i < frames; i++)
+			samples[i] = (float)(sin(step * (double)i) * 0.5);
+
+		sa->pool[c] = samples;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *audio_thread(void *data)
+{
+	struct synth_audio *sa = data;
+	uint64_t interval = 1000000000ULL / BLOCKS_PER_SEC;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t cur_time = start_time;
+	uint64_t total_frames = 0;
+	size_t offset = 0;
+
+	struct obs_source_audio audio = {
+		.frames          = sa->block_frames,
+		.speakers        = sa->speakers,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = sa->samples_per_sec
+	};
+
+	while (os_event_try(sa->stop_signal) == EAGAIN) {
+		for (size_t i = 0; i < sa->channels; i++)
+			audio.data[i] = (uint8_t*)(sa->pool[i] + offset);
+
+		audio.timestamp = start_time + total_frames * 1000000000ULL /
+			sa->samples_per_sec;
+		obs_source_output_audio(sa->source, &audio);
+
+		total_frames += sa->block_frames;
+		offset += sa->block_frames;
+		if (offset >= sa->samples_per_sec)
+			offset -= sa->samples_per_sec;
+
+		/* timestamps are derived from the frame count, so if the
+		 * thread falls behind it catches up rather than skipping */
+		os_sleepto_ns(cur_time += interval);
+	}
+
+	return NULL;
+}
+
+static void stop_thread(struct synth_audio *sa)
+{
+	if (sa->thread_active) {
+		os_event_signal(sa->stop_signal);
+		pthread_join(sa->thread, NULL);
+		os_event_reset(sa->stop_signal);
+		sa->thread_active = false;
+	}
+}
+
+static void start_thread(struct synth_audio *sa)
+{
+	if (pthread_create(&sa->thread, NULL, audio_thread, sa) == 0)
+		sa->thread_active = true;
+	else
+		blog(LOG_WARNING, "synth_audio: Failed to create thread");
+}
+
+static void synth_audio_update(void *data, obs_data_t *settings)
+{
+	struct synth_audio *sa = data;
+	uint32_t channels = (uint32_t)obs_data_get_int(settings, "channels");
+	uint32_t rate = (uint32_t)obs_data_get_int(settings,
+			"samples_per_sec");
+
+	stop_thread(sa);
+	free_pool(sa);
+
+	if (get_speakers(channels) == SPEAKERS_UNKNOWN)
+		channels = DEFAULT_CHANNELS;
+	if (rate < BLOCKS_PER_SEC)
+		rate = DEFAULT_SAMPLES_PER_SEC;
+
+	/* whole blocks only, so one second is always a whole number of them
+	 * and the pool loops at the same offset */
+	rate -= rate % BLOCKS_PER_SEC;
+
+	sa->channels        = channels;
+	sa->speakers        = get_speakers(channels);
+	sa->samples_per_sec = rate;
+	sa->block_frames    = rate / BLOCKS_PER_SEC;
+
+	create_pool(sa);
+	start_thread(sa);
+}
+
+static void synth_audio_destroy(void *data)
+{
+	struct synth_audio *sa = data;
+
+	if (sa) {
+		stop_thread(sa);
+		free_pool(sa);
+		os_event_destroy(sa->stop_signal);
+		bfree(sa);
+	}
+}
+
+static void *synth_audio_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct synth_audio *sa = bzalloc(sizeof(struct synth_audio));
+	sa->source = source;
+
+	if (os_event_init(&sa->stop_signal, OS_EVENT_TYPE_MANUAL) != 0) {
+		synth_audio_destroy(sa);
+		return NULL;
+	}
+
+	synth_audio_update(sa, settings);
+	return sa;
+}
+
+static void synth_audio_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "channels", DEFAULT_CHANNELS);
+	obs_data_set_default_int(settings, "samples_per_sec",
+			DEFAULT_SAMPLES_PER_SEC);
+}
+
+static obs_properties_t *synth_audio_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *list;
+
+	list = obs_properties_add_list(props, "channels", "Channels",
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(list, "Mono", 1);
+	obs_property_list_add_int(list, "Stereo", 2);
+	obs_property_list_add_int(list, "2.1", 3);
+	obs_property_list_add_int(list, "4.0", 4);
+	obs_property_list_add_int(list, "4.1", 5);
+	obs_property_list_add_int(list, "5.1", 6);
+	obs_property_list_add_int(list, "7.1", 8);
+
+	obs_properties_add_int(props, "samples_per_sec", "Sample Rate",
+			8000, 192000, 100);
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+struct obs_source_info test_synth_audio = {
+	.id             = "synth_audio",
+	.type           = OBS_SOURCE_TYPE_INPUT,
+	.output_flags   = OBS_SOURCE_AUDIO,
+	.get_name       = synth_audio_getname,
+	.create         = synth_audio_create,
+	.destroy        = synth_audio_destroy,
+	.update         = synth_audio_update,
+	.get_defaults   = synth_audio_defaults,
+	.get_properties = synth_audio_properties
+};
@@ -0,0 +1,350 @@
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <media-io/video-frame.h>
+#include <obs.h>
+
+/*
+ * Synthetic async video source for load testing
+ *
+ *   All frames are generated up front into a small pool when the source is
+ * created or updated, and the output thread just cycles through the pool,
+ * so the cost of the source itself is close to nothing and only the cost of
+ * obs_source_output_video and whatever is downstream of it is measured.
+ */
+
+#define DEFAULT_WIDTH     1280
+#define DEFAULT_HEIGHT    720
+#define DEFAULT_FPS       30
+#define DEFAULT_POOL_SIZE 8
+#define MAX_POOL_SIZE     120
+
+struct synth_video {
+	obs_source_t        *source;
+
+	enum video_format   format;
+	uint32_t            width;
+	uint32_t            height;
+	uint32_t            fps;
+
+	struct video_frame  *pool;
+	size_t              pool_size;
+
+	os_event_t          *stop_signal;
+	pthread_t           thread;
+	bool                thread_active;
+};
+
+static const char *synth_video_getname(void)
+{
+	return "Synthetic Video Source (Test)";
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* a diagonal gradient in luma and horizontal/vertical ramps in chroma, moved
+ * along by 'shift' pixels so each frame of the pool is different */
+static inline uint8_t pattern_y(uint32_t x, uint32_t y, uint32_t shift)
+{
+	return (uint8_t)(16 + ((x + y + shift) % 220));
+}
+
+static inline uint8_t pattern_u(uint32_t x, uint32_t cx, uint32_t shift)
+{
+	return (uint8_t)(16 + ((x + shift) * 224 / cx) % 225);
+}
+
+static inline uint8_t pattern_v(uint32_t y, uint32_t cy)
+{
+	return (uint8_t)(16 + y * 224 / cy);
+}
+
+static void fill_planar(struct video_frame *frame, uint32_t cx, uint32_t cy,
+		uint32_t shift, uint32_t chroma_shift)
+{
+	uint32_t chroma_cx = cx >> chroma_shift;
+	uint32_t chroma_cy = cy >> chroma_shift;
+
+	for (uint32_t y = 0; y < cy; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+		for (uint32_t x = 0; x < cx; x++)
+			line[x] = pattern_y(x, y, shift);
+	}
+
+	for (uint32_t y = 0; y < chroma_cy; y++) {
+		uint8_t *u = frame->data[1] + y * frame->linesize[1];
+		uint8_t *v = frame->data[2] + y * frame->linesize[2];
+
+		for (uint32_t x = 0; x < chroma_cx; x++) {
+			u[x] = pattern_u(x, chroma_cx, shift);
+			v[x] = pattern_v(y, chroma_cy);
+		}
+	}
+}
+
+static void fill_nv12(struct video_frame *frame, uint32_t cx, uint32_t cy,
+		uint32_t shift)
+{
+	for (uint32_t y = 0; y < cy; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+		for (uint32_t x = 0; x < cx; x++)
+			line[x] = pattern_y(x, y, shift);
+	}
+
+	for (uint32_t y = 0; y < cy / 2; y++) {
+		uint8_t *uv = frame->data[1] + y * frame->linesize[1];
+
+		for (uint32_t x = 0; x < cx / 2; x++) {
+			uv[x * 2]     = pattern_u(x, cx / 2, shift);
+			uv[x * 2 + 1] = pattern_v(y, cy / 2);
+		}
+	}
+}
+
+/* byte offsets of y0, u, y1 and v within each macropixel */
+static void fill_packed_422(struct video_frame *frame, uint32_t cx,
+		uint32_t cy, uint32_t shift, const int offsets[4])
+{
+	for (uint32_t y = 0; y < cy; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+
+		for (uint32_t x = 0; x < cx / 2; x++) {
+			uint8_t *pixel = line + x * 4;
+
+			pixel[offsets[0]] = pattern_y(x * 2, y, shift);
+			pixel[offsets[1]] = pattern_u(x, cx / 2, shift);
+			pixel[offsets[2]] = pattern_y(x * 2 + 1, y, shift);
+			pixel[offsets[3]] = pattern_v(y, cy);
+		}
+	}
+}
+
+/* byte offsets of r, g, b and a within each pixel */
+static void fill_rgb(struct video_frame *frame, uint32_t cx, uint32_t cy,
+		uint32_t shift, const int offsets[4])
+{
+	for (uint32_t y = 0; y < cy; y++) {
+		uint8_t *line = frame->data[0] + y * frame->linesize[0];
+
+		for (uint32_t x = 0; x < cx; x++) {
+			uint8_t *pixel = line + x * 4;
+			uint32_t r = (x + shift) % cx * 255 / cx;
+
+			pixel[offsets[0]] = (uint8_t)r;
+			pixel[offsets[1]] = (uint8_t)(y * 255 / cy);
+			pixel[offsets[2]] = pattern_y(x, y, shift);
+			pixel[offsets[3]] = 0xFF;
+		}
+	}
+}
+
+static void fill_frame(struct video_frame *frame, enum video_format format,
+		uint32_t cx, uint32_t cy, uint32_t shift)
+{
+	static const int yuy2[4] = {0, 1, 2, 3};
+	static const int yvyu[4] = {0, 3, 2, 1};
+	static const int uyvy[4] = {1, 0, 3, 2};
+	static const int rgba[4] = {0, 1, 2, 3};
+	static const int bgra[4] = {2, 1, 0, 3};
+
+	switch (format) {
+	case VIDEO_FORMAT_I420: fill_planar(frame, cx, cy, shift, 1); break;
+	case VIDEO_FORMAT_I444: fill_planar(frame, cx, cy, shift, 0); break;
+	case VIDEO_FORMAT_NV12: fill_nv12(frame, cx, cy, shift); break;
+	case VIDEO_FORMAT_YUY2: fill_packed_422(frame, cx, cy, shift, yuy2);
+				break;
+	case VIDEO_FORMAT_YVYU: fill_packed_422(frame, cx, cy, shift, yvyu);
+				break;
+	case VIDEO_FORMAT_UYVY: fill_packed_422(frame, cx, cy, shift, uyvy);
+				break;
+	case VIDEO_FORMAT_RGBA: fill_rgb(frame, cx, cy, shift, rgba); break;
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX: fill_rgb(frame, cx, cy, shift, bgra); break;
+	case VIDEO_FORMAT_NONE: break;
+	}
+}
+
+static void free_pool(struct synth_video *sv)
+{
+	for (size_t i = 0; i < sv->pool_size; i++)
+		video_frame_free(&sv->pool[i]);
+
+	bfree(sv->pool);
+	sv->pool      = NULL;
+	sv->pool_size = 0;
+}
+
+static void create_pool(struct synth_video *sv, size_t pool_size)
+{
+	sv->pool      = bzalloc(sizeof(struct video_frame) * pool_size);
+	sv->pool_size = pool_size;
+
+	for (size_t i = 0; i < pool_size; i++) {
+		uint32_t shift = (uint32_t)(i * sv->width / pool_size);
+
+		video_frame_init(&sv->pool[i], sv->format, sv->width,
+				sv->height);
+		fill_frame(&sv->pool[i], sv->format, sv->width, sv->height,
+				shift);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *video_thread(void *data)
+{
+	struct synth_video *sv = data;
+	uint64_t interval = 1000000000ULL / sv->fps;
+	uint64_t cur_time = os_gettime_ns();
+	size_t idx = 0;
+
+	struct obs_source_frame frame = {
+		.width  = sv->width,
+		.height = sv->height,
+		.format = sv->format
+	};
+
+	video_format_get_parameters(VIDEO_CS_601, VIDEO_RANGE_PARTIAL,
+			frame.color_matrix,
+			frame.color_range_min,
+			frame.color_range_max);
+
+	while (os_event_try(sv->stop_signal) == EAGAIN) {
+		struct video_frame *pool_frame = &sv->pool[idx];
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			frame.data[i]     = pool_frame->data[i];
+			frame.linesize[i] = pool_frame->linesize[i];
+		}
+
+		frame.timestamp = cur_time;
+		obs_source_output_video(sv->source, &frame);
+
+		if (++idx == sv->pool_size)
+			idx = 0;
+
+		/* if the output cannot keep up, don't try to catch up */
+		if (!os_sleepto_ns(cur_time += interval))
+			cur_time = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+static void stop_thread(struct synth_video *sv)
+{
+	if (sv->thread_active) {
+		os_event_signal(sv->stop_signal);
+		pthread_join(sv->thread, NULL);
+		os_event_reset(sv->stop_signal);
+		sv->thread_active = false;
+	}
+}
+
+static void start_thread(struct synth_video *sv)
+{
+	if (pthread_create(&sv->thread, NULL, video_thread, sv) == 0)
+		sv->thread_active = true;
+	else
+		blog(LOG_WARNING, "synth_video: Failed to create thread");
+}
+
+static void synth_video_update(void *data, obs_data_t *settings)
+{
+	struct synth_video *sv = data;
+	int format = (int)obs_data_get_int(settings, "format");
+	int pool_size = (int)obs_data_get_int(settings, "pool_size");
+
+	stop_thread(sv);
+	free_pool(sv);
+
+	if (format <= VIDEO_FORMAT_NONE || format > VIDEO_FORMAT_I444)
+		format = VIDEO_FORMAT_NV12;
+	if (pool_size < 1 || pool_size > MAX_POOL_SIZE)
+		pool_size = DEFAULT_POOL_SIZE;
+
+	sv->format = (enum video_format)format;
+	sv->width  = (uint32_t)obs_data_get_int(settings, "width") & ~1;
+	sv->height = (uint32_t)obs_data_get_int(settings, "height") & ~1;
+	sv->fps    = (uint32_t)obs_data_get_int(settings, "fps");
+
+	if (!sv->width || !sv->height || !sv->fps)
+		return;
+
+	create_pool(sv, (size_t)pool_size);
+	start_thread(sv);
+}
+
+static void synth_video_destroy(void *data)
+{
+	struct synth_video *sv = data;
+
+	if (sv) {
+		stop_thread(sv);
+		free_pool(sv);
+		os_event_destroy(sv->stop_signal);
+		bfree(sv);
+	}
+}
+
+static void *synth_video_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct synth_video *sv = bzalloc(sizeof(struct synth_video));
+	sv->source = source;
+
+	if (os_event_init(&sv->stop_signal, OS_EVENT_TYPE_MANUAL) != 0) {
+		synth_video_destroy(sv);
+		return NULL;
+	}
+
+	synth_video_update(sv, settings);
+	return sv;
+}
+
+static void synth_video_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "width", DEFAULT_WIDTH);
+	obs_data_set_default_int(settings, "height", DEFAULT_HEIGHT);
+	obs_data_set_default_int(settings, "fps", DEFAULT_FPS);
+	obs_data_set_default_int(settings, "format", VIDEO_FORMAT_NV12);
+	obs_data_set_default_int(settings, "pool_size", DEFAULT_POOL_SIZE);
+}
+
+static obs_properties_t *synth_video_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *list;
+
+	obs_properties_add_int(props, "width", "Width", 2, 8192, 2);
+	obs_properties_add_int(props, "height", "Height", 2, 8192, 2);
+	obs_properties_add_int(props, "fps", "FPS", 1, 240, 1);
+	obs_properties_add_int(props, "pool_size", "Frame Pool Size", 1,
+			MAX_POOL_SIZE, 1);
+
+	list = obs_properties_add_list(props, "format", "Format",
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(list, "I420", VIDEO_FORMAT_I420);
+	obs_property_list_add_int(list, "NV12", VIDEO_FORMAT_NV12);
+	obs_property_list_add_int(list, "YVYU", VIDEO_FORMAT_YVYU);
+	obs_property_list_add_int(list, "YUY2", VIDEO_FORMAT_YUY2);
+	obs_property_list_add_int(list, "UYVY", VIDEO_FORMAT_UYVY);
+	obs_property_list_add_int(list, "RGBA", VIDEO_FORMAT_RGBA);
+	obs_property_list_add_int(list, "BGRA", VIDEO_FORMAT_BGRA);
+	obs_property_list_add_int(list, "BGRX", VIDEO_FORMAT_BGRX);
+	obs_property_list_add_int(list, "I444", VIDEO_FORMAT_I444);
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+struct obs_source_info test_synth_video = {
+	.id             = "synth_video",
+	.type           = OBS_SOURCE_TYPE_INPUT,
+	.output_flags   = OBS_SOURCE_ASYNC_VIDEO,
+	.get_name       = synth_video_getname,
+	.create         = synth_video_create,
+	.destroy        = synth_video_destroy,
+	.update         = synth_video_update,
+	.get_defaults   = synth_video_defaults,
+	.get_properties = synth_video_properties
+};